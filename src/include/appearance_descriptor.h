@@ -0,0 +1,39 @@
+#ifndef APPEARANCE_DESCRIPTOR_H
+#define APPEARANCE_DESCRIPTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+// Fixed-size hue/saturation appearance descriptor used by the tracker.
+//
+// Bins follow the former calcHist setup (16 hue bins over [0,180), 16
+// saturation bins over [0,256) with OpenCV's 8-bit HSV conversion). They are
+// stored as the square root of the L1-normalised histogram, so the
+// Bhattacharyya coefficient reduces to a dot product and the distance equals
+// compareHist(HISTCMP_BHATTACHARYYA).
+struct AppearanceDescriptor {
+    static constexpr int kHueBins = 16;
+    static constexpr int kSatBins = 16;
+    static constexpr int kSize = kHueBins * kSatBins;
+
+    alignas(16) float sqrtBins[kSize];
+    bool valid{false};
+};
+
+// Single pass over a BGR888 region: HSV conversion and binning are fused,
+// no intermediate HSV image is allocated. Large regions are grid-sampled.
+bool compute_appearance_descriptor(const uint8_t* bgr, int width, int height, size_t stride,
+                                   AppearanceDescriptor& out);
+bool compute_appearance_descriptor(const cv::Mat& bgr, AppearanceDescriptor& out);
+
+// Bhattacharyya distance in [0, 1]; 1 when either descriptor is invalid.
+float appearance_distance(const AppearanceDescriptor& a, const AppearanceDescriptor& b);
+// out[k] = appearance_distance(query, *candidates[k]), with the dot products
+// batched through simd_dot_f32_batch. out is resized to candidates.size().
+void appearance_distance_batch(const AppearanceDescriptor& query,
+                               const std::vector<const AppearanceDescriptor*>& candidates,
+                               std::vector<float>& out);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef ASSIGNMENT_SOLVER_H
+#define ASSIGNMENT_SOLVER_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Sparse, gated min-cost assignment between tracks (rows) and detections (cols).
+//
+// Only pairs whose cost is below the gate are added as edges; every other pair
+// means "leave unassigned". The bipartite graph is split into connected
+// components. Single-row / single-column components are resolved directly,
+// the rest use successive shortest augmenting paths (Dijkstra on reduced
+// costs) that only walk the gated edges, where the dense Hungarian always
+// paid O(n^3). Each row owns a private dummy column priced at the gate, so
+// the optimum equals the old padded Kuhn-Munkres on min(cost, gate).
+// All working storage is kept between calls.
+class AssignmentSolver {
+public:
+    void reset(int rows, int cols);
+    void addEdge(int row, int col, float cost);
+    size_t edgeCount() const { return edges.size(); }
+
+    // Appends (row, col) pairs with cost < maxCost to `out` (cleared first).
+    void solve(float maxCost, std::vector<std::pair<int, int>>& out);
+
+private:
+    struct Edge {
+        int row;
+        int col;
+        float cost;
+    };
+
+    int findRoot(int node);
+    void augmentRow(int row, float maxCost);
+
+    int rowCount{0};
+    int colCount{0};
+    std::vector<Edge> edges;
+
+    // Union-find over rows [0, rowCount) and cols [rowCount, rowCount + colCount).
+    std::vector<int> parent;
+    std::vector<int> rowComponent;
+    std::vector<int> componentRows;
+    std::vector<int> componentCols;
+    std::vector<int> componentBestEdge;
+
+    // Row-major adjacency (CSR) of the gated edges.
+    std::vector<int> rowEdgeStart;
+    std::vector<int> adjCol;
+    std::vector<float> adjCost;
+
+    // Shortest augmenting path state. Columns [colCount, colCount + rowCount)
+    // are the per-row dummy columns.
+    std::vector<float> u;
+    std::vector<float> v;
+    std::vector<float> dist;
+    std::vector<int> predRow;
+    std::vector<int> rowMatch;
+    std::vector<int> colMatch;
+    std::vector<char> colDone;
+    std::vector<int> pendingRows;
+    std::vector<int> touched;
+    std::vector<int> finished;
+    std::vector<std::pair<float, int>> heap;
+};
+
+#endif
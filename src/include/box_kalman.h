@@ -0,0 +1,61 @@
+#ifndef BOX_KALMAN_H
+#define BOX_KALMAN_H
+
+#include <cstdint>
+#include <vector>
+
+// Constant-velocity Kalman filter for [x, y, w, h] boxes, specialised for the
+// tracker's model: F = [[I, dt*I], [0, I]], H = [I, 0], diagonal Q/R/P0.
+// Under that model the 8x8 covariance is four independent 2x2 blocks, so each
+// axis is filtered in closed form with three covariance terms.
+//
+// State is stored as structure-of-arrays indexed by slot, so predicting every
+// track is one branch-free pass per axis that the compiler can vectorise.
+// Slots are recycled through a free list; predicting an unused slot is harmless.
+enum BoxKalmanModel {
+    // The former tinyekf calls (ekf_predict with fx = x, ekf_update with
+    // hx = z): the covariance evolves, the mean stays on the allocated box.
+    BOX_KALMAN_ANCHORED = 0,
+    // Predict and correct the mean with the constant-velocity model.
+    BOX_KALMAN_CONSTANT_VELOCITY,
+};
+
+struct BoxKalmanNoise {
+    float qPos[4];   // process noise on x, y, w, h per unit dt
+    float qVel[4];   // process noise on their velocities per unit dt
+    float r[4];      // measurement noise on x, y, w, h
+    float p0Pos;     // initial position variance
+    float p0Vel;     // initial velocity variance
+};
+
+class BoxKalmanBank {
+public:
+    static constexpr int kAxes = 4;
+
+    BoxKalmanBank(const BoxKalmanNoise& noise, BoxKalmanModel model);
+
+    int allocate(const float box[kAxes]);
+    void release(int slot);
+    void clear();
+
+    // Advances every slot by dt (in frames; 1.0 = one nominal frame step).
+    void predictAll(float dt);
+    void correct(int slot, const float z[kAxes]);
+
+    void position(int slot, float box[kAxes]) const;
+    float velocity(int slot, int axis) const { return vel[axis][slot]; }
+
+private:
+    BoxKalmanNoise noise;
+    BoxKalmanModel model;
+    // pos/vel: state; p00/p01/p11: per-axis 2x2 covariance [pos, vel].
+    std::vector<float> pos[kAxes];
+    std::vector<float> vel[kAxes];
+    std::vector<float> p00[kAxes];
+    std::vector<float> p01[kAxes];
+    std::vector<float> p11[kAxes];
+    std::vector<uint8_t> inUse;
+    std::vector<int> freeSlots;
+};
+
+#endif
@@ -14,6 +14,9 @@ struct DeviceConfig {
         int faceDetectInterval = CAPTURE_FACE_DETECT_INTERVAL;
         int faceInputMaxWidth = CAPTURE_FACE_INPUT_MAX_WIDTH;
         int maxFrameCandidates = CAPTURE_MAX_FRAME_CANDIDATES;
+        int candidateMemoryBudgetMb = CAPTURE_CANDIDATE_MEMORY_BUDGET_MB;
+        bool candidateCompressBelowTop = CAPTURE_CANDIDATE_COMPRESS_BELOW_TOP != 0;
+        int candidateRawTop = CAPTURE_CANDIDATE_RAW_TOP;
         int candidateQueueMax = CAPTURE_CANDIDATE_QUEUE_MAX;
         int candidatePerTrackMaxPending = CAPTURE_CANDIDATE_PER_TRACK_MAX_PENDING;
         float personContextExpandX = CAPTURE_PERSON_CONTEXT_EXPAND_X;
@@ -59,6 +62,14 @@ struct DeviceConfig {
         float maxBlurSeverity = CAPTURE_MAX_BLUR_SEVERITY;
         float fallbackMaxBlurSeverity = CAPTURE_FALLBACK_MAX_BLUR_SEVERITY;
         float blurSeverityScorePenalty = CAPTURE_BLUR_SEVERITY_SCORE_PENALTY;
+        double prescreenMinHeadSharpness = CAPTURE_PRESCREEN_MIN_HEAD_SHARPNESS;
+        double prescreenMinHeadContrast = CAPTURE_PRESCREEN_MIN_HEAD_CONTRAST;
+        float prescreenRelativeSharpness = CAPTURE_PRESCREEN_RELATIVE_SHARPNESS;
+        bool earlyFinalizeEnabled = CAPTURE_EARLY_FINALIZE_ENABLE != 0;
+        double earlyFinalizeMinClarity = CAPTURE_EARLY_FINALIZE_MIN_CLARITY;
+        float earlyFinalizeMaxYaw = CAPTURE_EARLY_FINALIZE_MAX_YAW;
+        int earlyFinalizeMinFaceShortSide = CAPTURE_EARLY_FINALIZE_MIN_FACE_SHORT_SIDE;
+        int framePoolSize = CAPTURE_FRAME_POOL_SIZE;
         int brightnessSampleInterval = CAMERA_BRIGHTNESS_SAMPLE_INTERVAL;
         double brightnessWhiteThreshold = CAMERA_BRIGHTNESS_WHITE_THRESHOLD;
         double brightnessBlackThreshold = CAMERA_BRIGHTNESS_BLACK_THRESHOLD;
@@ -79,6 +90,7 @@ struct DeviceConfig {
     std::string uploadServer = "http://101.200.56.225:11100";
     std::string uploadImagePath = "/receive/image/auto/minio";
     std::string uploadManualImagePath = "/receive/image/manual";
+    int uploadFaceEnhanceBudgetMs = UPLOAD_FACE_ENHANCE_BUDGET_MS;
     std::string tcpServerIp = "192.168.1.1";
     int tcpPort = 19000;
     int heartbeatIntervalSec = 10;
@@ -0,0 +1,53 @@
+#ifndef JPEG_ENCODER_H
+#define JPEG_ENCODER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+enum JpegBackend {
+    JPEG_BACKEND_VENC = 0,  // rk_mpi VENC hardware encoder, built with ENABLE_RK_VENC
+    JPEG_BACKEND_SOFTWARE,  // OpenCV / libjpeg-turbo on the CPU
+    JPEG_BACKEND_COUNT
+};
+
+struct JpegEncodeStats {
+    const char* name;
+    uint64_t encodes;
+    uint64_t failures;
+    uint64_t bytes;      // output bytes of the successful encodes
+    uint64_t elapsedUs;  // cumulative time of the successful encodes
+};
+
+// One JPEG backend. quality uses the IJG 1..100 scale of IMWRITE_JPEG_QUALITY.
+// An nv12 image is CV_8UC1 with height * 3 / 2 rows: the Y plane followed by
+// the interleaved UV plane. Both calls overwrite out and return false when
+// the image cannot be encoded by this backend.
+class JpegEncoder {
+public:
+    virtual ~JpegEncoder() = default;
+    virtual JpegBackend backend() const = 0;
+    // Size limits of the backend; images outside them go straight elsewhere.
+    virtual bool supports(int width, int height) const = 0;
+    virtual bool encodeBgr(const cv::Mat& bgr, int quality, std::vector<uchar>& out) = 0;
+    virtual bool encodeNv12(const cv::Mat& nv12, int quality, std::vector<uchar>& out) = 0;
+};
+
+std::unique_ptr<JpegEncoder> create_software_jpeg_encoder();
+// nullptr when built without ENABLE_RK_VENC or when the VENC cannot start.
+std::unique_ptr<JpegEncoder> create_venc_jpeg_encoder();
+
+// Start and release the process-wide VENC encoder (RK_MPI_SYS_Init /
+// RK_MPI_SYS_Exit). Calls nest; the last shutdown releases the channel once
+// no encode is using it. Without init everything is encoded in software.
+void jpeg_encoder_init();
+void jpeg_encoder_shutdown();
+
+// Process-wide encoding, safe from any thread: the VENC encoder between
+// init and shutdown, the software encoder for everything it rejects or fails on.
+bool jpeg_encode_bgr(const cv::Mat& bgr, int quality, std::vector<uchar>& out);
+bool jpeg_encode_nv12(const cv::Mat& nv12, int quality, std::vector<uchar>& out);
+std::vector<JpegEncodeStats> get_jpeg_encode_stats();
+
+#endif // JPEG_ENCODER_H
@@ -32,6 +32,9 @@
 #define CAPTURE_FACE_DETECT_INTERVAL     2
 #define CAPTURE_FACE_INPUT_MAX_WIDTH     640
 #define CAPTURE_MAX_FRAME_CANDIDATES     48
+#define CAPTURE_CANDIDATE_MEMORY_BUDGET_MB 96
+#define CAPTURE_CANDIDATE_COMPRESS_BELOW_TOP 0
+#define CAPTURE_CANDIDATE_RAW_TOP        4
 #define CAPTURE_CANDIDATE_QUEUE_MAX      128
 #define CAPTURE_CANDIDATE_PER_TRACK_MAX_PENDING 6
 #define CAPTURE_PERSON_CONTEXT_EXPAND_X  0.12f
@@ -78,6 +81,20 @@
 #define CAPTURE_MAX_BLUR_SEVERITY        0.62f
 #define CAPTURE_FALLBACK_MAX_BLUR_SEVERITY 0.78f
 #define CAPTURE_BLUR_SEVERITY_SCORE_PENALTY 380.0f
+// 720p head-region pre-screen before the 4K crop: Laplacian variance and
+// luma standard deviation floors, and the fraction of the track's recent
+// peak sharpness a frame must reach.
+#define CAPTURE_PRESCREEN_MIN_HEAD_SHARPNESS 4.0
+#define CAPTURE_PRESCREEN_MIN_HEAD_CONTRAST  6.0
+#define CAPTURE_PRESCREEN_RELATIVE_SHARPNESS 0.50f
+// Early finalization: a strong candidate at least this sharp, frontal and
+// large is uploaded immediately and its track stops producing eval jobs.
+#define CAPTURE_EARLY_FINALIZE_ENABLE         1
+#define CAPTURE_EARLY_FINALIZE_MIN_CLARITY    220.0
+#define CAPTURE_EARLY_FINALIZE_MAX_YAW        0.20f
+#define CAPTURE_EARLY_FINALIZE_MIN_FACE_SHORT_SIDE 120
+// Full-resolution frame buffers shared by capture, track history and eval jobs.
+#define CAPTURE_FRAME_POOL_SIZE          6
 
 // Brightness and IR-CUT thresholds.
 #define CAMERA_BRIGHTNESS_SAMPLE_INTERVAL  5
@@ -92,3 +109,7 @@
 #define CAMERA_BRIGHTNESS_MAX_BETA          25.0
 #define CAMERA_BRIGHTNESS_GAMMA              0.85
 #define CAMERA_BRIGHTNESS_DARK_BLEND         0.55
+
+// Upload enhancement: time budget per blurry face for trying enhancement
+// modes, 0 tries every eligible mode.
+#define UPLOAD_FACE_ENHANCE_BUDGET_MS      0
@@ -0,0 +1,54 @@
+#ifndef QUALITY_METRICS_H
+#define QUALITY_METRICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/core/mat.hpp>
+
+enum QualityMetricsFlags : unsigned {
+    QUALITY_GRADIENT_MAGNITUDE = 1u << 0,  // fill gradMagnitudeMean (one sqrt per pixel)
+    QUALITY_SHIFT_TRAILS = 1u << 1,        // second pass for the 2px shift trails
+};
+
+// Image-quality statistics of one grayscale view of an ROI.
+//
+// Everything the capture gates, candidate evaluation and the uploader used to
+// derive with separate cvtColor / Sobel / Laplacian / meanStdDev passes comes
+// out of a single integer pass: 3x3 Sobel dx/dy and the 4-neighbour Laplacian
+// with OpenCV's default BORDER_REFLECT_101, so the values match
+// cv::Sobel(..., 3) / cv::Laplacian(..., ksize=1) followed by meanStdDev.
+struct QualityMetrics {
+    bool valid{false};
+    int width{0};
+    int height{0};
+    double lumaMean{0.0};
+    double gradMeanX{0.0};
+    double gradMeanY{0.0};
+    double gradEnergyX{0.0};        // variance of Sobel dx
+    double gradEnergyY{0.0};        // variance of Sobel dy
+    double gradMagnitudeMean{0.0};  // mean sqrt(dx^2 + dy^2), QUALITY_GRADIENT_MAGNITUDE only
+    double tensorXX{0.0};           // mean dx*dx
+    double tensorYY{0.0};           // mean dy*dy
+    double tensorXY{0.0};           // mean dx*dy
+    double laplacianVar{0.0};
+    // mean |I(x,y) - I(x-dx, y-dy)| with replicated borders for a ~2px shift
+    // along the mean-gradient / structure-tensor direction; -1 when not
+    // computed (QUALITY_SHIFT_TRAILS).
+    double trailMeanGradient{-1.0};
+    double trailStructure{-1.0};
+
+    double directionalRatio() const;
+    // Dominant orientation from the structure tensor, in degrees.
+    double blurAngleDeg() const;
+    // 0 (sharp) .. 1 (blurred): directional imbalance, Laplacian variance and
+    // the mean-gradient trail. Needs QUALITY_SHIFT_TRAILS.
+    float motionBlurSeverity() const;
+};
+
+bool compute_quality_metrics(const uint8_t* gray, int width, int height, size_t stride,
+                             QualityMetrics& out, unsigned flags = 0);
+// CV_8UC1 or CV_8UC3 (BGR). Colour input is converted with OpenCV's
+// fixed-point BGR2GRAY weights into a per-thread buffer.
+bool compute_quality_metrics(const cv::Mat& img, QualityMetrics& out, unsigned flags = 0);
+
+#endif
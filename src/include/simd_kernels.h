@@ -0,0 +1,77 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Hand-written NEON / SSE2 / SSSE3 / AVX2 kernels for the per-pixel and
+// per-box hot loops, with a scalar reference for every kernel.
+//
+// The GCC 12 aarch64 workaround in CMakeLists.txt builds the project with
+// -O1 -fno-tree-vectorize, so these loops get no help from the
+// auto-vectorizer; explicit intrinsics are unaffected by those flags.
+// The best level the CPU supports is picked once at first use (NEON is
+// baseline on aarch64, x86 levels are probed with __builtin_cpu_supports).
+// Every kernel returns exactly what its scalar reference returns, except
+// gradMagnitude in simd_gradient_row and the dot products, whose float
+// summation order differs.
+
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_SSSE3,
+    SIMD_AVX2,
+    SIMD_NEON,
+};
+
+SimdLevel simd_active_level();
+const char* simd_level_name(SimdLevel level);
+// Selects a level at or below what the CPU supports (SIMD_SCALAR always
+// works); returns the level actually in effect. Intended for on-device
+// comparisons against the scalar reference.
+SimdLevel simd_set_level(SimdLevel level);
+
+constexpr int kSimdMedianMaxInputs = 8;
+
+// dst[i] = median of srcs[0..count)[i] (upper median for even counts, i.e.
+// the element nth_element puts at count / 2). 1 <= count <= kSimdMedianMaxInputs.
+void simd_median_u8(const uint8_t* const* srcs, int count, uint8_t* dst, size_t len);
+
+// Splits interleaved 3-channel pixels into three planes.
+void simd_deinterleave3_u8(const uint8_t* src, uint8_t* dst0, uint8_t* dst1, uint8_t* dst2,
+                           size_t pixels);
+void simd_deinterleave3_f32(const float* src, float* dst0, float* dst1, float* dst2,
+                            size_t pixels);
+
+// out[i] = IoU of (ax1, ay1, ax2, ay2) against box i, with the areas supplied
+// by the caller; same expression and evaluation order as the tracker's iou():
+// inter / (areaA + area[i] - inter + 1e-6f).
+void simd_iou_one_to_many(float ax1, float ay1, float ax2, float ay2, float areaA,
+                          const float* x1, const float* y1, const float* x2, const float* y2,
+                          const float* area, size_t count, float* out);
+
+// Dot product of two float vectors of len elements.
+float simd_dot_f32(const float* a, const float* b, size_t len);
+// out[k] = dot(a, bs[k]) for k in [0, count): a is loaded once per block of
+// candidates, for one-against-many descriptor comparisons.
+void simd_dot_f32_batch(const float* a, const float* const* bs, size_t count, size_t len, float* out);
+
+// Running sums of 3x3 Sobel dx/dy and the 4-neighbour Laplacian.
+struct GradientRowSums {
+    int64_t luma{0};
+    int64_t dx{0};
+    int64_t dy{0};
+    int64_t dxdx{0};
+    int64_t dydy{0};
+    int64_t dxdy{0};
+    int64_t lap{0};
+    int64_t laplap{0};
+    double magnitude{0.0};
+};
+
+// Adds the interior pixels x in [1, width - 1) of one row, given the rows
+// above and below; border columns are left to the caller.
+void simd_gradient_row(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int width,
+                       bool withMagnitude, GradientRowSums& sums);
+
+#endif
@@ -5,11 +5,13 @@
 #include <cstdint>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/types.hpp>
-#include "tinyekf.h"
 #include <algorithm>
 #include <cstdio>
 #include <functional>
 #include <unordered_set>
+#include "appearance_descriptor.h"
+#include "frame_pool.h"
+#include "quality_metrics.h"
 
 using namespace cv;
 
@@ -21,8 +23,9 @@ struct Detection {
 
 struct Track {
     int id;
-    ekf_t ekf;
-    cv::Mat hist;
+    int kf_slot;    // state slot in the tracker's BoxKalmanBank, published as TrackView::slot
+    uint32_t generation;
+    AppearanceDescriptor appearance;
     cv::Rect2f bbox;
     cv::Rect2f smoothed_bbox;
     cv::Rect2f last_det_bbox;
@@ -54,21 +57,88 @@ struct Track {
         float face_edge_occlusion;
         float motion_ratio;
         float blur_severity;
+        // Metrics of face_roi with gradient magnitude and shift trails, taken
+        // once by the evaluator; the uploader enhances the face from them
+        // instead of measuring the same crop again.
+        QualityMetrics face_quality;
+        // Filled in by the tracker when the candidate is stored.
+        double capture_priority{0.0};
+        // Candidates ranked below the raw top entries may keep their images
+        // JPEG-encoded here instead of in person_roi / face_roi.
+        std::vector<uchar> person_jpeg;
+        std::vector<uchar> face_jpeg;
+        // While set, person_roi / face_roi are views into this pooled frame
+        // and cost no candidate memory; they are copied out only for upload
+        // or by materialize_candidate_sources().
+        FrameHandle source;
     };
+    // Min-heap on capture_priority: front() is the next candidate to replace.
     std::vector<FrameData> frame_candidates;
 };
 
+// Compact read-only view of a track, published once per frame.
+// Kalman state, appearance descriptor and frame candidates stay inside the tracker and are
+// addressed by id (see add_frame_candidate).
+struct TrackView {
+    int id;
+    // Dense slot owned by this track until it retires, then recycled. The
+    // generation changes on every reuse so per-track state keyed by
+    // (slot, generation) never leaks into the next occupant.
+    int slot;
+    uint32_t generation;
+    cv::Rect2f bbox;
+    cv::Rect2f smoothed_bbox;
+    cv::Rect2f last_det_bbox;
+    float prop;
+    int hits;
+    int missed;
+    bool confirmed;
+    float bbox_jitter;
+    float area_trend_ratio;     // relative area change over the last <=8 history samples
+    size_t area_history_size;   // grows with every corrected detection (capped)
+    bool is_approaching;
+    bool has_captured;
+};
+
 void sort_init();
-std::vector<Track> sort_update(const std::vector<Detection>& dets);
-std::vector<Track> sort_predict_only();
+// Both calls refill `views` in place so the caller can reuse its buffer.
+// dt is the motion-model step since the previous call, in frames.
+void sort_update(const std::vector<Detection>& dets, std::vector<TrackView>& views, float dt = 1.0f);
+void sort_predict_only(std::vector<TrackView>& views, float dt = 1.0f);
 std::vector<Track> get_expiring_tracks();
-void set_upload_callback(std::function<void(const cv::Mat&, int, const std::string&)> callback,
+// quality points at the metrics of img when the tracker has them (raw face
+// crops), nullptr otherwise.
+void set_upload_callback(std::function<void(const cv::Mat&, int, const std::string&, const QualityMetrics*)> callback,
                          std::unordered_set<int>* person_ids,
                          std::unordered_set<int>* face_ids);
 void set_max_frame_candidates(size_t maxFrameCandidates);
 void set_capture_sort_preferences(float minAreaRatio,
                                   float nearAreaRatio,
                                   float maxPersonOcclusion);
+void set_candidate_memory_budget(size_t budgetBytes, bool compressBelowTop, size_t rawTopCount);
+// Ignored once the track has been finalized.
 void add_frame_candidate(int track_id, const Track::FrameData& frame_data);
+// Queues the best stored face (and person) frame of a live track for upload
+// and marks it captured, so it produces no further candidates. The upload
+// callback runs from the next sort_update, on the tracking thread. Returns
+// false and leaves the track alone when no face frame qualifies yet.
+bool finalize_track_capture(int track_id);
+
+struct CandidateMemoryStats {
+    size_t rawBytes;
+    size_t jpegBytes;
+    size_t budgetBytes;
+    size_t candidates;
+    size_t tracks;
+    uint64_t evictions;
+    uint64_t compressed;
+};
+CandidateMemoryStats get_candidate_memory_stats();
+
+// Frame-pool retention: appends the source frame of every stored candidate
+// that still views one (once per candidate), and copies the crops of the
+// candidates referencing a frame out of it.
+void collect_candidate_sources(std::vector<FrameHandle>& sources);
+void materialize_candidate_sources(uint64_t seq);
 
 #endif
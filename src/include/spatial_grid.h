@@ -0,0 +1,57 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/types.hpp>
+
+// Uniform-grid index over a small set of boxes (tracks, lost/recent entries).
+//
+// Each box is registered in every cell it touches; queries visit only the
+// cells under the query area and de-duplicate with a per-item stamp, so
+// overlap / IoU / nearest-center lookups cost O(local density) instead of a
+// scan over every box. Results come back in insertion order, which keeps
+// "first best wins" loops at the call sites unchanged. Storage is reused
+// across reset() calls.
+class SpatialGrid {
+public:
+    void reset(float width, float height, float cellSize);
+    // Returns the item index (insertion order). Empty boxes take an index
+    // but are never reported.
+    int insert(const cv::Rect2f& box);
+    size_t size() const { return items.size(); }
+    const cv::Rect2f& box(int item) const { return items[item]; }
+
+    // Items whose box touches `area` (closed intervals), ascending.
+    void query(const cv::Rect2f& area, std::vector<int>& out);
+    // max over other items of intersection / area(item).
+    float maxOverlapOn(int item);
+    // Highest IoU between `box` and any item; 0 and -1 when nothing overlaps.
+    // Ties between equal scores resolve in unspecified order.
+    float bestIou(const cv::Rect2f& box, int* bestItem = nullptr);
+    // Item whose center is closest to `point` and strictly within
+    // `maxDistance`, or -1.
+    int nearest(const cv::Point2f& point, float maxDistance);
+
+private:
+    static constexpr size_t kLinearScanLimit = 16;
+
+    // Same as query() without the ordering; for order-independent reductions.
+    void collect(const cv::Rect2f& area, std::vector<int>& out);
+    void cellRange(const cv::Rect2f& area, int& c0, int& r0, int& c1, int& r1) const;
+    // Cells are filled on the first query that needs them, so small sets
+    // never pay for bucketing.
+    void indexPending();
+
+    float invCell{1.0f};
+    int cols{0};
+    int rows{0};
+    std::vector<std::vector<int>> cells;
+    std::vector<cv::Rect2f> items;
+    size_t indexedCount{0};
+    std::vector<uint32_t> stamps;
+    uint32_t stamp{0};
+    std::vector<int> scratch;
+};
+
+#endif
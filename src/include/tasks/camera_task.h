@@ -5,6 +5,10 @@
 #include "device_config.h"
 #include "rknn_api.h"
 #include "main.h"
+#include "track_state_slab.h"
+#include "track_fusion.h"
+#include "spatial_grid.h"
+#include "quality_metrics.h"
 #include <thread>
 #include <atomic>
 #include <functional>
@@ -14,12 +18,51 @@
 #include <chrono>
 #include <mutex>
 #include <condition_variable>
+#include <array>
 #include <deque>
 #include <vector>
 
+// Capture gates of candidate evaluation, in the order they run. QUALITY and
+// FUSION measure rather than reject: QUALITY always passes, FUSION runs only
+// when enabled and passes when the fused ROI is used.
+enum CandidateGate {
+    CANDIDATE_GATE_MOTION = 0,
+    CANDIDATE_GATE_FACE_DETECT,
+    CANDIDATE_GATE_FACE_SCORE,
+    CANDIDATE_GATE_FACE_BOX,
+    CANDIDATE_GATE_FACE_GEOMETRY,
+    CANDIDATE_GATE_POSE,
+    CANDIDATE_GATE_HEADSHOT_CROP,
+    CANDIDATE_GATE_QUALITY,
+    CANDIDATE_GATE_FUSION,
+    CANDIDATE_GATE_DECISION,
+    CANDIDATE_GATE_COUNT
+};
+
+struct CandidateGateStats {
+    const char* name;
+    uint64_t evaluated;
+    uint64_t passed;
+    uint64_t elapsedNs;  // cumulative time spent in the gate
+};
+
+// Eval queue counters. Every enqueued job is either evaluated or counted
+// under exactly one drop reason.
+struct CandidateQueueStats {
+    size_t queued;
+    uint64_t enqueued;
+    uint64_t superseded;  // oldest job of a full track mailbox, replaced by a newer frame
+    uint64_t evicted;     // oldest job of the least valuable mailbox, when the queue is full
+    uint64_t rejected;    // new job worth less than all queued work
+    uint64_t retired;     // left queued by a track whose slot was reused
+    uint64_t finalized;   // queued for, or offered by, a track finalized early
+};
+
 class CameraTask {
 public:
-    using UploadCallback = std::function<void(const cv::Mat& img, int id, const std::string& type)>;
+    // quality: metrics of img measured by the evaluator, nullptr when not known.
+    using UploadCallback = std::function<void(const cv::Mat& img, int id, const std::string& type,
+                                              const QualityMetrics* quality)>;
     using PersonEventCallback = std::function<void(int personId, const std::string& eventType)>;
 
     CameraTask(const std::string& personModelPath,
@@ -43,15 +86,22 @@ public:
     long getTotalFrames() const { return totalFrames; }
     double getCurrentFPS() const { return currentFPS; }
     void resetFrameCount() { totalFrames = 0; }
+    std::vector<CandidateGateStats> getCandidateGateStats() const;
+    CandidateQueueStats getCandidateQueueStats();
 
 private:
     struct CandidateEvalJob {
         int trackId;
-        cv::Mat personRoi;
-        std::vector<cv::Mat> fusionHistory;
+        int trackSlot;
+        uint32_t trackGeneration;
+        cv::Mat personRoi;                           // view into personFrame, shared with the fusion history
+        uint64_t roiSeq;
+        FrameHandle personFrame;                     // keeps personRoi's pixels checked out
+        std::vector<TrackFusionFrame> fusionHistory;
         float areaRatio;
         float personOcclusion;
         float motionRatio;
+        float captureValue;                          // expected gain of evaluating it, see processFrame
     };
 
     struct TrackApproachState {
@@ -64,17 +114,69 @@ private:
         size_t lastHistorySize{0};
     };
 
+    // A stored fusion frame with the directional ratio measured when it was
+    // admitted, so the fusion stage does not differentiate it again.
+    struct TrackHistoryRoi {
+        TrackFusionFrame frame;
+        double directionalRatio{0.0};
+    };
+
+    // processFrame bookkeeping for one live track, kept in trackStates.
+    struct TrackFrameState {
+        bool reported{false};
+        bool hasLastCenter{false};
+        cv::Point2f lastCenter;
+        std::deque<TrackHistoryRoi> roiHistory;
+        uint64_t roiSeq{0};
+        int jobCooldown{0};             // frames until the next eval job may be cut
+        cv::Point2f velocity;           // smoothed 720p center step per frame
+        double peakHeadSharpness{0.0};  // decaying max of the 720p pre-screen sharpness
+        TrackApproachState approach;
+    };
+
+    // candidateEvalLoop bookkeeping for one track, kept on the eval thread.
+    struct TrackEvalState {
+        TrackFusionAccumulator fusion;
+        bool hasFace{false};
+        cv::Rect2f lastFace;  // last accepted face box, relative to the person ROI size
+        bool hasStrongCandidate{false};
+    };
+
+    // Bounded queue of eval jobs of one track, indexed by track slot.
+    struct CandidateMailbox {
+        uint32_t generation{0};          // 0 = unused
+        std::deque<CandidateEvalJob> jobs;
+        int readyIndex{-1};              // position in candidateReadySlots, -1 when empty
+        bool hasStrongCandidate{false};  // reported back by the eval thread
+        bool finalized{false};           // capture stored early; no more jobs are taken
+        uint64_t waitingSince{0};        // dispatch tick when the track was last served
+    };
+
     void run();
     void captureLoop();
     void candidateEvalLoop(rknn_context faceCtx);
     bool enqueueCandidateEvaluation(CandidateEvalJob job);
-    double computeFocusMeasure(const cv::Mat& img);
-    float computeMotionBlurSeverity(const cv::Mat& img);
+    bool takeCandidateEvaluation(CandidateEvalJob& job);
+    CandidateMailbox& candidateMailbox(int slot, uint32_t generation);
+    float candidateMailboxPriority(const CandidateMailbox& mailbox) const;
+    void unreadyCandidateMailbox(int slot);
+    void dropFinalizedCandidates(int slot, uint32_t generation);
+    void clearCandidateQueue();
+    void evaluateCandidate(const CandidateEvalJob& job,
+                           rknn_context faceCtx,
+                           TrackStateSlab<TrackEvalState>& evalStates);
+    bool finishCandidateGate(CandidateGate gate,
+                             std::chrono::steady_clock::time_point& start,
+                             bool passed);
+    void logCandidateGateStats();
+    void measureCandidateQuality(const cv::Mat& img, double& clarity, float& blurSeverity);
     bool isFrontalFace(const std::vector<cv::Point2f>& landmarks);
     bool isSideFace(const std::vector<cv::Point2f>& landmarks);
     void logTrackReject(const char* stage, int trackId, const char* reason, const std::string& detail);
     void clearTrackReject(const char* stage, int trackId);
-    void processFrame(const cv::Mat& frame, rknn_context personCtx);
+    void processFrame(const FrameHandle& frameHandle, rknn_context personCtx);
+    void releasePinnedFrames();
+    float trackerStepDt(std::chrono::steady_clock::time_point captureTime);
     void updateFPS();
     DeviceConfig::CaptureDefaults getCaptureConfigSnapshot() const;
     DeviceConfig::BrightnessBoostConfig getBrightnessBoostConfigSnapshot() const;
@@ -93,14 +195,27 @@ private:
 
     std::mutex frameMutex;
     std::condition_variable frameCv;
-    cv::Mat latestFrame;
+    FramePool framePool;
+    std::atomic<uint64_t> framePoolFallbacks{0};  // frames published as heap copies
+    FrameHandle latestFrame;
     uint64_t latestFrameSeq{0};
     uint64_t consumedFrameSeq{0};
 
     std::mutex candidateEvalMutex;
     std::condition_variable candidateEvalCv;
-    std::deque<CandidateEvalJob> candidateEvalQueue;
-    std::unordered_map<int, int> pendingCandidateEvalByTrack;
+    // Guarded by candidateEvalMutex.
+    std::vector<CandidateMailbox> candidateMailboxes;
+    std::vector<int> candidateReadySlots;  // slots whose mailbox holds jobs
+    size_t candidateQueuedJobs{0};
+    uint64_t candidateDispatchTick{0};
+    CandidateQueueStats candidateQueueCounters{};
+
+    struct CandidateGateCounter {
+        std::atomic<uint64_t> evaluated{0};
+        std::atomic<uint64_t> passed{0};
+        std::atomic<uint64_t> elapsedNs{0};
+    };
+    std::array<CandidateGateCounter, CANDIDATE_GATE_COUNT> candidateGateCounters;  // written by the eval thread
 
     struct RejectLogState {
         std::string reason;
@@ -121,12 +236,15 @@ private:
 
     unsigned char* resized_buffer_720p{nullptr};
 
-    std::unordered_map<int, cv::Point2f> lastTrackCenters;
-    std::unordered_map<int, std::deque<cv::Mat>> trackPersonRoiHistory;
-    std::unordered_map<int, TrackApproachState> trackApproachStates;
+    TrackStateSlab<TrackFrameState> trackStates;
+    std::vector<FrameHandle> pinnedFrames;         // releasePinnedFrames() scratch
+    std::vector<cv::Rect> trackBoxes720p;          // index-aligned with the published tracks
+    std::vector<float> trackOcclusionRatio;
+    SpatialGrid trackGrid;
     size_t candidateRoundRobinOffset{0};
+    std::chrono::steady_clock::time_point lastTrackerStepTime{};
+    double trackerFramePeriodMs{0.0};  // slow average of the interval between processed frames
 
-    std::unordered_set<int> reportedPersonIds;
     std::atomic<double> environmentBrightness{0.0};
     std::atomic<float> sensorExposureRatio{0.0f};  // exposure / max_exposure (0.0~1.0)
     std::atomic<float> sensorGainRatio{0.0f};      // (gain - min_gain) / (max_gain - min_gain) (0.0~1.0)
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A published camera frame. Its pixels are not written after publication, so
+// any thread holding the handle may keep views of image without copying.
+struct PooledFrame {
+    cv::Mat image;
+    uint64_t seq{0};
+    std::chrono::steady_clock::time_point captureTime;  // when the sensor handed it over
+};
+using FrameHandle = std::shared_ptr<const PooledFrame>;
+
+struct FramePoolStats {
+    size_t capacity;
+    size_t inUse;
+    uint64_t acquired;
+    uint64_t exhausted;  // acquire() calls that found every buffer checked out
+};
+
+// Fixed number of full-resolution frame buffers. Buffers are allocated on
+// first use and never freed while the pool lives; a buffer goes back to the
+// pool when the last handle to its frame is released, on whichever thread
+// that happens. Resident frame memory is therefore capacity * frame size.
+class FramePool {
+public:
+    // Drops the current buffers (outstanding frames stay valid until released).
+    void reset(size_t capacity, int rows, int cols, int type);
+
+    // A writable frame for the publisher, or an empty pointer when every
+    // buffer is checked out.
+    std::shared_ptr<PooledFrame> acquire();
+
+    // Buffers that acquire() could hand out right now.
+    size_t available() const;
+    FramePoolStats stats() const;
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::vector<cv::Mat> free;
+        size_t capacity{0};
+        size_t allocated{0};
+        size_t inUse{0};
+        int rows{0};
+        int cols{0};
+        int type{0};
+        uint64_t acquired{0};
+        uint64_t exhausted{0};
+    };
+
+    std::shared_ptr<State> state;
+};
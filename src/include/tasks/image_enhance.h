@@ -0,0 +1,89 @@
+#pragma once
+
+#include "quality_metrics.h"
+#include <opencv2/core/mat.hpp>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Face and person enhancement applied before upload.
+
+constexpr int kFaceProxyShortEdge = 128;       // 模糊人脸增强方式预选用的代理图短边
+constexpr int kFaceProxyMinSourceEdge = 240;   // 短边小于此值直接全尺寸比较，代理图省不下时间
+constexpr size_t kFaceProxyFinalists = 2;      // 代理图排名前两位的方式都做全尺寸比较
+
+// Focus, luma, gradient energy and ghosting of one candidate from a single
+// metrics pass; used for the input face and for every enhanced variant.
+struct FaceQuality {
+    double focus{0.0};
+    double luma{0.0};
+    double gradient{0.0};
+    double ghostPenalty{0.0};
+};
+
+// metrics must come from QUALITY_GRADIENT_MAGNITUDE | QUALITY_SHIFT_TRAILS.
+FaceQuality face_quality_from_metrics(const QualityMetrics& metrics);
+FaceQuality measure_face_quality(const cv::Mat& img);
+
+// The image a face enhancement step runs on, relative to the uploaded face.
+// On a downscaled proxy the size thresholds and targets are taken in
+// full-size pixels and the Laplacian variance is converted to its full-size
+// value, so the proxy goes down the same branches as the face itself.
+struct FaceEnhanceScale {
+    double size{1.0};   // pixels per full-size pixel
+    double focus{1.0};  // full-size Laplacian variance per unit measured here
+};
+
+cv::Mat resize_to_long_edge(const cv::Mat& img, int target_long_edge, int interpolation);
+cv::Mat apply_unsharp_mask(const cv::Mat& src, double sigma, float amount);
+cv::Mat upscale_small_face(const cv::Mat& face, const FaceEnhanceScale& at = {});
+cv::Mat motion_deblur_enhance_face(const cv::Mat& face, const FaceEnhanceScale& at = {});
+cv::Mat motion_deblur_enhance_person(const cv::Mat& person);
+
+// Score of an enhanced face against the input's quality. focus_scale converts
+// the focus measured on a proxy to full-size units.
+double score_face_candidate(const cv::Mat& candidate,
+                            double base_focus,
+                            double base_luma,
+                            double base_gradient,
+                            double scale_bonus = 0.0,
+                            double focus_scale = 1.0);
+
+// Enhancement modes for a moderately or heavily blurred face, in the order
+// they are tried. scaleBonus favours the modes that also upscale the face.
+struct FaceEnhanceMode {
+    const char* name;
+    cv::Mat (*apply)(const cv::Mat&, const FaceEnhanceScale&);
+    double scaleBonus;
+};
+
+constexpr size_t kFaceEnhanceModeCount = 4;
+extern const FaceEnhanceMode kFaceEnhanceModes[kFaceEnhanceModeCount];
+
+// Number of leading kFaceEnhanceModes eligible for a blurry face.
+size_t face_enhance_mode_count(double blur_severity, int short_edge);
+
+// Ranks the first mode_count modes on a proxy of face with a short edge of
+// proxy_short_edge, run with the face's full-size thresholds
+// (FaceEnhanceScale), best first; equal scores keep the mode order. No mode
+// after the first is started past deadline, so fewer may be returned.
+std::vector<size_t> rank_face_enhance_modes_on_proxy(const cv::Mat& face,
+                                                     const FaceQuality& base,
+                                                     size_t mode_count,
+                                                     int proxy_short_edge,
+                                                     std::chrono::steady_clock::time_point deadline);
+
+// Picks and applies the best enhancement mode of a blurry face. When more
+// than kFaceProxyFinalists modes are eligible, they are ranked on a proxy
+// with a short edge of kFaceProxyShortEdge and the best kFaceProxyFinalists
+// run at full size; the full-size scores decide. Faces too small for the
+// proxy to save time are scored at full size directly. modes_tried counts
+// proxy and full-size runs. Once budget_ms is spent no further mode is
+// started, but the first always runs.
+cv::Mat enhance_blurry_face(const cv::Mat& face,
+                            const FaceQuality& base,
+                            double blur_severity,
+                            int budget_ms,
+                            const char*& best_mode,
+                            double& best_score,
+                            size_t& modes_tried);
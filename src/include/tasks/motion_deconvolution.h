@@ -0,0 +1,16 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+
+// Wiener deconvolution by a straight motion PSF of kernel_len pixels along
+// angle_deg. Filters are kept in a per-thread LRU keyed by the rasterized PSF,
+// the padded DFT size and snr, so a cached call returns exactly what a
+// rebuilt filter would.
+
+// gray is 8-bit; it is reflect-padded to an optimal DFT size. The result is
+// CV_32F in [0, 1] at the input size.
+cv::Mat apply_motion_wiener_restore_luma(const cv::Mat& gray, double angle_deg, int kernel_len, float snr);
+
+// Deconvolves the luma only and carries the change back to the color
+// channels as a per-pixel ratio.
+cv::Mat apply_motion_wiener_restore_bgr(const cv::Mat& src, double angle_deg, int kernel_len, float snr);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/types.hpp>
+#include "frame_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// History frames kept per track for multi-frame fusion.
+constexpr size_t kTrackFusionHistorySize = 5;
+
+// A person ROI as captured by processFrame. roi is never written, so the
+// history and the eval jobs share it. While source is set, roi is a view into
+// that pooled frame and the two must be copied together; a materialized roi
+// owns its pixels and has no source.
+struct TrackFusionFrame {
+    cv::Mat roi;
+    uint64_t seq{0};  // per-track capture order
+    FrameHandle source;
+
+    void materialize() {
+        if (source) {
+            roi = roi.clone();
+            source.reset();
+        }
+    }
+};
+
+struct TrackFusionResult {
+    cv::Mat fused;
+    int acceptedFrames{0};
+    float meanSimilarity{0.0f};
+    double referenceFocus{0.0};
+    double bestAlignedFocus{0.0};
+};
+
+// Multi-frame fusion state of one track, owned by the candidate eval thread.
+//
+// Frames are registered by phase correlation against an anchor patch whose
+// spectrum is computed once; the shift of each frame (keyed by seq) is cached,
+// so a frame that stays in the history across several jobs is transformed
+// only once, and the reference of one job is already aligned when it shows up
+// as history in the next. Only the region the caller reads is warped.
+class TrackFusionAccumulator {
+public:
+    // history is oldest first; only the last kTrackFusionHistorySize entries
+    // are used. focusBox and outputRegion are in reference ROI coordinates.
+    // outputRegion is the part the caller will read (face box plus the
+    // uploaded crops): the median is only computed there and the rest of
+    // result.fused is a copy of the reference.
+    TrackFusionResult fuse(const TrackFusionFrame& reference,
+                           const std::vector<TrackFusionFrame>& history,
+                           const cv::Rect& focusBox,
+                           const cv::Rect& outputRegion);
+
+    void reset();
+
+private:
+    struct Alignment {
+        uint64_t seq{0};
+        bool valid{false};
+        cv::Point2d shift;  // displacement of the frame's content against the anchor
+    };
+
+    void setAnchor(const TrackFusionFrame& frame, const cv::Rect& rect);
+    bool computeSpectrum(const cv::Mat& roi, cv::Mat& spectrum);
+    Alignment alignToAnchor(const TrackFusionFrame& frame);
+    void pruneAlignments(uint64_t oldestSeq);
+
+    bool hasAnchor{false};
+    uint64_t anchorSeq{0};
+    cv::Rect anchorRect;  // in ROI coordinates, shared by every frame of the track
+    cv::Size paddedSize;
+    cv::Mat window;  // Hanning window of anchorRect's size
+    cv::Mat anchorSpectrum;
+    std::vector<Alignment> alignments;
+
+    // Scratch buffers reused across jobs.
+    cv::Mat patchGray;
+    cv::Mat patchFloat;
+    cv::Mat padded;
+    cv::Mat frameSpectrum;
+    cv::Mat crossPower;
+    cv::Mat correlation;
+};
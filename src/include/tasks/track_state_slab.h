@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-track state indexed by the tracker's dense slot (TrackView::slot).
+//
+// Entries live in one contiguous vector and are validated by generation: a
+// slot that the tracker recycled for a new track hands back a fresh T on the
+// first acquire(). Tracks that disappear are found by a linear sweep over the
+// entries not touched since beginFrame(), with no hashing or node allocation.
+template <typename T>
+class TrackStateSlab {
+public:
+    void beginFrame() { ++frameEpoch; }
+
+    T& acquire(int slot, uint32_t generation) {
+        if (static_cast<size_t>(slot) >= entries.size()) {
+            entries.resize(static_cast<size_t>(slot) + 1);
+        }
+        Entry& e = entries[slot];
+        if (e.generation != generation) {
+            e.state = T{};
+            e.generation = generation;
+        }
+        e.lastSeen = frameEpoch;
+        return e.state;
+    }
+
+    T* find(int slot, uint32_t generation) {
+        if (slot < 0 || static_cast<size_t>(slot) >= entries.size()) {
+            return nullptr;
+        }
+        Entry& e = entries[slot];
+        return e.generation == generation ? &e.state : nullptr;
+    }
+
+    // Resets every live entry that was not acquired since beginFrame().
+    // Returns the number of entries still live.
+    size_t retireUnseen() {
+        size_t live = 0;
+        for (Entry& e : entries) {
+            if (e.generation == 0) {
+                continue;
+            }
+            if (e.lastSeen != frameEpoch) {
+                e.state = T{};
+                e.generation = 0;
+            } else {
+                live++;
+            }
+        }
+        return live;
+    }
+
+    // Resets every live entry not acquired during the last maxIdleEpochs
+    // beginFrame() calls, for owners that see a track only now and then.
+    void retireIdle(uint64_t maxIdleEpochs) {
+        for (Entry& e : entries) {
+            if (e.generation != 0 && frameEpoch - e.lastSeen > maxIdleEpochs) {
+                e.state = T{};
+                e.generation = 0;
+            }
+        }
+    }
+
+    // Calls fn(state) for every live entry.
+    template <typename Fn>
+    void forEach(Fn&& fn) {
+        for (Entry& e : entries) {
+            if (e.generation != 0) {
+                fn(e.state);
+            }
+        }
+    }
+
+    void clear() { entries.clear(); }
+
+private:
+    struct Entry {
+        uint32_t generation{0};  // 0 = empty; the tracker starts at 1
+        uint64_t lastSeen{0};
+        T state{};
+    };
+
+    std::vector<Entry> entries;
+    uint64_t frameEpoch{0};
+};
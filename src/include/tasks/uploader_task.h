@@ -1,5 +1,7 @@
 #pragma once
-#include <queue>
+#include <deque>
+#include <vector>
+#include <chrono>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
@@ -7,6 +9,7 @@
 #include <string>
 #include <atomic>
 #include <functional>
+#include "quality_metrics.h"
 
 struct UploadItem {
     cv::Mat img;
@@ -15,6 +18,17 @@ struct UploadItem {
     std::string path;
     std::string uniqueCode;
     int retry = 0;
+    std::chrono::steady_clock::time_point enqueuedAt{};
+    QualityMetrics quality;  // metrics of img from the capture side; valid == false when unknown
+};
+
+// An item after enhancement and JPEG encoding. Retries resend the same bytes.
+struct PreparedUpload {
+    UploadItem item;
+    std::vector<uchar> jpeg;
+    double enhanceWaitMs{0.0};  // queued in front of the enhancement pool
+    double enhanceMs{0.0};      // enhancement and encoding
+    std::chrono::steady_clock::time_point preparedAt{};
 };
 
 class UploaderTask {
@@ -31,25 +45,36 @@ public:
                  int cameraNumber,
                  const std::string& type,
                  const std::string& path = "",
-                 const std::string& uniqueCode = "");
+                 const std::string& uniqueCode = "",
+                 const QualityMetrics* quality = nullptr);
     void setServerUrl(const std::string& url);
     void setEqCode(const std::string& code);
     void setUploadSuccessCallback(UploadSuccessCallback cb);
+    void setFaceEnhanceBudgetMs(int ms) { faceEnhanceBudgetMs.store(ms); }
 
 private:
-    void enqueue(const UploadItem& item);
     void run();
-    std::string uploadHttp(const cv::Mat& img,
-                           int cameraNumber,
-                           const std::string& type,
-                           const std::string& path = "",
-                           const std::string& uniqueCode = "");
+    std::deque<UploadItem>::iterator nextEnhanceItem();
+    void transferLoop();
+    bool prepareUploadImage(const UploadItem& item, std::vector<uchar>& jpeg);
+    void enqueueTransfer(PreparedUpload upload);
+    bool takeTransfer(const std::vector<const std::string*>& inFlightCodes, PreparedUpload& upload);
+    void finishTransfer(PreparedUpload upload, bool ok);
     std::string eqCode;
     std::string serverUrl;
-    std::queue<UploadItem> queue;
+    std::deque<UploadItem> queue;  // waiting for enhancement and encoding
+    std::vector<std::string> enhancingCodes;  // uniqueCodes of the items being enhanced
+    size_t enhancingItems{0};
     std::mutex mtx;
     std::condition_variable cv;
     std::atomic<bool> running;
-    std::thread worker;
+    std::vector<std::thread> enhanceWorkers;
+    std::thread transferWorker;    // curl multi loop
     UploadSuccessCallback uploadSuccessCallback;
+    std::atomic<int> faceEnhanceBudgetMs{0};  // 0 = no limit
+
+    std::mutex transferMutex;
+    // Guarded by transferMutex.
+    std::deque<PreparedUpload> transferQueue;
+    void* transferMulti{nullptr};  // CURLM* of transferLoop, woken up on new work
 };
@@ -53,6 +53,7 @@ int main(int argc, char** argv) {
     }
 
     UploaderTask uploader(config.deviceCode, config.uploadServer);
+    uploader.setFaceEnhanceBudgetMs(config.uploadFaceEnhanceBudgetMs);
     CameraTask camera(PERSON_MODEL_PATH, FACE_MODEL_PATH, CAMERA_INDEX_1);
     TcpClient tcpClient(&config, configPath);
     camera.setRuntimeConfig(config);
@@ -94,7 +95,7 @@ int main(int argc, char** argv) {
         return camera.getEnvironmentBrightness();
     });
 
-    camera.setUploadCallback([&](const cv::Mat& img, int id, const std::string& type) {
+    camera.setUploadCallback([&](const cv::Mat& img, int id, const std::string& type, const QualityMetrics* quality) {
         const std::string& targetPath = (type == "manual")
             ? config.uploadManualImagePath
             : config.uploadImagePath;
@@ -129,7 +130,7 @@ int main(int argc, char** argv) {
                     log_warn("Face upload id=%d has no paired person image, sending face only", id);
                 }
 
-                uploader.enqueue(img, config.cameraNumber, "face", targetPath, uniqueCode);
+                uploader.enqueue(img, config.cameraNumber, "face", targetPath, uniqueCode, quality);
                 groupedUniqueCode.erase(id);
                 return;
             }
@@ -169,6 +170,7 @@ int main(int argc, char** argv) {
         if (cmdType == "config_update") {
             uploader.setServerUrl(config.uploadServer);
             uploader.setEqCode(config.deviceCode);
+            uploader.setFaceEnhanceBudgetMs(config.uploadFaceEnhanceBudgetMs);
             camera.setRuntimeConfig(config);
             log_info("Config updated: upload server=%s, device_code=%s",
                      config.uploadServer.c_str(), config.deviceCode.c_str());
@@ -0,0 +1,147 @@
+// Appearance descriptors: normalisation, batched Bhattacharyya distances at
+// every SIMD level against a plain scalar reference, and the cost of one
+// detection row against a crowd of tracks.
+
+#include "appearance_descriptor.h"
+#include "simd_kernels.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+float referenceDistance(const AppearanceDescriptor& a, const AppearanceDescriptor& b) {
+    if (!a.valid || !b.valid) {
+        return 1.0f;
+    }
+    double bc = 0.0;
+    for (int i = 0; i < AppearanceDescriptor::kSize; ++i) {
+        bc += static_cast<double>(a.sqrtBins[i]) * b.sqrtBins[i];
+    }
+    return static_cast<float>(std::sqrt(std::max(0.0, 1.0 - bc)));
+}
+
+// Person-like patch: a few colour blobs plus noise, so descriptors differ
+// but share bins.
+void randomPatch(std::mt19937& rng, int width, int height, std::vector<uint8_t>& bgr) {
+    std::uniform_int_distribution<int> channel(0, 255);
+    std::normal_distribution<float> noise(0.0f, 12.0f);
+    uint8_t top[3], bottom[3];
+    for (int c = 0; c < 3; ++c) {
+        top[c] = static_cast<uint8_t>(channel(rng));
+        bottom[c] = static_cast<uint8_t>(channel(rng));
+    }
+    bgr.resize(static_cast<size_t>(width) * height * 3);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* base = y < height / 2 ? top : bottom;
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                float value = base[c] + noise(rng);
+                bgr[(static_cast<size_t>(y) * width + x) * 3 + c] =
+                    static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, value)));
+            }
+        }
+    }
+}
+
+void testDescriptors(std::vector<AppearanceDescriptor>& descriptors) {
+    std::mt19937 rng(29);
+    std::vector<uint8_t> patch;
+    const int sizes[][2] = {{1, 1}, {7, 13}, {48, 96}, {120, 260}, {300, 640}};
+    for (int n = 0; n < 220; ++n) {
+        const int* size = sizes[n % 5];
+        randomPatch(rng, size[0], size[1], patch);
+        AppearanceDescriptor d;
+        bool ok = compute_appearance_descriptor(patch.data(), size[0], size[1], size[0] * 3, d);
+        TEST_CHECK(ok && d.valid, "descriptor %d not computed", n);
+        double mass = 0.0;
+        for (float bin : d.sqrtBins) {
+            mass += static_cast<double>(bin) * bin;
+        }
+        TEST_CHECK(std::fabs(mass - 1.0) < 1e-4, "descriptor %d mass %.6f", n, mass);
+        TEST_CHECK(appearance_distance(d, d) < 2e-3f, "self distance %.5f", appearance_distance(d, d));
+        descriptors.push_back(d);
+    }
+    AppearanceDescriptor empty;
+    TEST_CHECK(!compute_appearance_descriptor(nullptr, 0, 0, 0, empty) && !empty.valid, "empty input accepted");
+}
+
+void testBatch(const std::vector<AppearanceDescriptor>& descriptors) {
+    std::vector<const AppearanceDescriptor*> candidates;
+    AppearanceDescriptor invalid = descriptors[1];
+    invalid.valid = false;
+    for (size_t k = 0; k < descriptors.size(); ++k) {
+        candidates.push_back(k % 37 == 5 ? &invalid : &descriptors[k]);
+    }
+    const SimdLevel best = simd_active_level();
+    const SimdLevel levels[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_SSSE3, SIMD_AVX2, SIMD_NEON};
+    std::vector<float> row;
+    for (SimdLevel level : levels) {
+        if (simd_set_level(level) != level) {
+            continue;
+        }
+        float maxError = 0.0f;
+        // Every prefix length, so the 4-wide blocks and their tails are hit.
+        for (size_t count = 0; count <= 9; ++count) {
+            std::vector<const AppearanceDescriptor*> prefix(candidates.begin(), candidates.begin() + count);
+            appearance_distance_batch(descriptors[0], prefix, row);
+            TEST_CHECK(row.size() == count, "%s: row size %zu", simd_level_name(level), row.size());
+        }
+        for (size_t q = 0; q < 12; ++q) {
+            appearance_distance_batch(descriptors[q], candidates, row);
+            for (size_t k = 0; k < candidates.size(); ++k) {
+                float expected = referenceDistance(descriptors[q], *candidates[k]);
+                maxError = std::max(maxError, std::fabs(row[k] - expected));
+                // sqrt(1 - bc) amplifies rounding near bc = 1, so identical
+                // descriptors get the looser bound.
+                float tolerance = expected < 0.05f ? 2e-3f : 1e-4f;
+                TEST_CHECK(std::fabs(row[k] - expected) <= tolerance, "%s: q=%zu k=%zu %.6f vs %.6f",
+                           simd_level_name(level), q, k, row[k], expected);
+                TEST_CHECK(std::fabs(row[k] - appearance_distance(descriptors[q], *candidates[k])) <= 1e-6f,
+                           "%s: batch and single distance differ", simd_level_name(level));
+            }
+        }
+        appearance_distance_batch(invalid, candidates, row);
+        for (float d : row) {
+            TEST_CHECK(d == 1.0f, "%s: invalid query gave %.3f", simd_level_name(level), d);
+        }
+        std::printf("%-6s batched distance max error %.2g\n", simd_level_name(level), maxError);
+    }
+    simd_set_level(best);
+}
+
+void benchmark(const std::vector<AppearanceDescriptor>& descriptors) {
+    std::vector<const AppearanceDescriptor*> tracks;
+    for (size_t k = 0; k < 200; ++k) {
+        tracks.push_back(&descriptors[k % descriptors.size()]);
+    }
+    std::vector<float> row(tracks.size());
+    const SimdLevel best = simd_active_level();
+    const SimdLevel levels[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_NEON};
+    for (SimdLevel level : levels) {
+        if (simd_set_level(level) != level) {
+            continue;
+        }
+        double batchUs = bench_us(2000, [&] { appearance_distance_batch(descriptors[0], tracks, row); });
+        double pairUs = bench_us(2000, [&] {
+            for (size_t k = 0; k < tracks.size(); ++k) {
+                row[k] = appearance_distance(descriptors[0], *tracks[k]);
+            }
+        });
+        std::printf("%-6s 1 detection x 200 tracks: batched %6.2f us  per pair %6.2f us\n",
+                    simd_level_name(level), batchUs, pairUs);
+    }
+    simd_set_level(best);
+}
+
+}  // namespace
+
+int main() {
+    std::vector<AppearanceDescriptor> descriptors;
+    testDescriptors(descriptors);
+    testBatch(descriptors);
+    benchmark(descriptors);
+    return test_finish("test_appearance_descriptor");
+}
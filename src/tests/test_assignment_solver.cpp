@@ -0,0 +1,251 @@
+// AssignmentSolver: optimality against brute force on small gated instances,
+// agreement with the dense padded Kuhn-Munkres it replaced, and timings up to
+// 200 tracks x 200 detections.
+
+#include "assignment_solver.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr float kGate = 0.65f;  // sort_update 的关联门限
+
+struct Instance {
+    int rows{0};
+    int cols{0};
+    std::vector<float> cost;  // rows x cols, >= kGate means "no edge"
+};
+
+// Objective the solver minimises: matched pairs pay their cost, every
+// unmatched row pays the gate.
+double objective(const Instance& inst, const std::vector<std::pair<int, int>>& pairs) {
+    double total = static_cast<double>(inst.rows - static_cast<int>(pairs.size())) * kGate;
+    for (const auto& p : pairs) {
+        total += inst.cost[p.first * inst.cols + p.second];
+    }
+    return total;
+}
+
+bool validMatching(const Instance& inst, const std::vector<std::pair<int, int>>& pairs) {
+    std::vector<char> rowUsed(inst.rows, 0);
+    std::vector<char> colUsed(inst.cols, 0);
+    for (const auto& p : pairs) {
+        if (p.first < 0 || p.first >= inst.rows || p.second < 0 || p.second >= inst.cols) {
+            return false;
+        }
+        if (rowUsed[p.first] || colUsed[p.second]) {
+            return false;
+        }
+        if (!(inst.cost[p.first * inst.cols + p.second] < kGate)) {
+            return false;
+        }
+        rowUsed[p.first] = 1;
+        colUsed[p.second] = 1;
+    }
+    return true;
+}
+
+void bruteForce(const Instance& inst, int row, std::vector<char>& colUsed, double current, double& best) {
+    if (row == inst.rows) {
+        best = std::min(best, current);
+        return;
+    }
+    bruteForce(inst, row + 1, colUsed, current + kGate, best);
+    for (int c = 0; c < inst.cols; ++c) {
+        float cost = inst.cost[row * inst.cols + c];
+        if (colUsed[c] || !(cost < kGate)) {
+            continue;
+        }
+        colUsed[c] = 1;
+        bruteForce(inst, row + 1, colUsed, current + cost, best);
+        colUsed[c] = 0;
+    }
+}
+
+// The former solver: dense Kuhn-Munkres over min(cost, gate), with one
+// gate-priced dummy column per row so that every row may stay unmatched.
+double denseHungarian(const Instance& inst) {
+    const int n = inst.rows;
+    const int m = inst.cols + inst.rows;
+    const double INF = std::numeric_limits<double>::infinity();
+    auto at = [&](int r, int c) -> double {
+        if (c < inst.cols) {
+            return std::min(inst.cost[r * inst.cols + c], kGate);
+        }
+        return c - inst.cols == r ? kGate : 1e6;
+    };
+    std::vector<double> u(n + 1, 0.0), v(m + 1, 0.0), minv(m + 1);
+    std::vector<int> p(m + 1, 0), way(m + 1, 0);
+    std::vector<char> used(m + 1);
+    for (int i = 1; i <= n; ++i) {
+        p[0] = i;
+        int j0 = 0;
+        std::fill(minv.begin(), minv.end(), INF);
+        std::fill(used.begin(), used.end(), 0);
+        do {
+            used[j0] = 1;
+            int i0 = p[j0], j1 = 0;
+            double delta = INF;
+            for (int j = 1; j <= m; ++j) {
+                if (used[j]) continue;
+                double cur = at(i0 - 1, j - 1) - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= m; ++j) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0);
+    }
+    double total = 0.0;
+    for (int j = 1; j <= m; ++j) {
+        if (p[j] != 0) {
+            total += at(p[j] - 1, j - 1);
+        }
+    }
+    return total;
+}
+
+void solve(AssignmentSolver& solver, const Instance& inst, std::vector<std::pair<int, int>>& out) {
+    solver.reset(inst.rows, inst.cols);
+    for (int r = 0; r < inst.rows; ++r) {
+        for (int c = 0; c < inst.cols; ++c) {
+            float cost = inst.cost[r * inst.cols + c];
+            if (cost < kGate) {
+                solver.addEdge(r, c, cost);
+            }
+        }
+    }
+    solver.solve(kGate, out);
+}
+
+// Small instances with a controllable edge density and coarse costs, so
+// ties, star components and long augmenting paths all show up.
+Instance randomInstance(std::mt19937& rng, int rows, int cols, float density) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<int> level(0, 12);
+    Instance inst;
+    inst.rows = rows;
+    inst.cols = cols;
+    inst.cost.resize(static_cast<size_t>(rows) * cols);
+    for (float& c : inst.cost) {
+        c = unit(rng) < density ? level(rng) * 0.05f : 1.0f;
+    }
+    return inst;
+}
+
+// Entrance-like crowd: tracks are boxes spread over a 1280x720 frame, every
+// track has a jittered detection and a few detections are new people.
+// Cost is 1 - IoU, gated like sort_update.
+Instance crowdInstance(std::mt19937& rng, int count) {
+    std::uniform_real_distribution<float> px(0.0f, 1180.0f);
+    std::uniform_real_distribution<float> py(0.0f, 520.0f);
+    std::uniform_real_distribution<float> size(60.0f, 180.0f);
+    std::normal_distribution<float> jitter(0.0f, 8.0f);
+    struct Box { float x, y, w, h; };
+    std::vector<Box> tracks(count), dets(count);
+    for (int i = 0; i < count; ++i) {
+        float w = size(rng);
+        tracks[i] = {px(rng), py(rng), w, w * 2.2f};
+        if (i % 10 == 9) {
+            dets[i] = {px(rng), py(rng), w, w * 2.2f};
+        } else {
+            dets[i] = {tracks[i].x + jitter(rng), tracks[i].y + jitter(rng), tracks[i].w + jitter(rng),
+                       tracks[i].h + jitter(rng)};
+        }
+    }
+    std::shuffle(dets.begin(), dets.end(), rng);
+    Instance inst;
+    inst.rows = count;
+    inst.cols = count;
+    inst.cost.resize(static_cast<size_t>(count) * count);
+    for (int r = 0; r < count; ++r) {
+        for (int c = 0; c < count; ++c) {
+            const Box& a = tracks[r];
+            const Box& b = dets[c];
+            float iw = std::max(0.0f, std::min(a.x + a.w, b.x + b.w) - std::max(a.x, b.x));
+            float ih = std::max(0.0f, std::min(a.y + a.h, b.y + b.h) - std::max(a.y, b.y));
+            float inter = iw * ih;
+            float iou = inter / (a.w * a.h + b.w * b.h - inter + 1e-6f);
+            inst.cost[r * count + c] = 1.0f - iou;
+        }
+    }
+    return inst;
+}
+
+void testAgainstBruteForce() {
+    std::mt19937 rng(27);
+    AssignmentSolver solver;
+    std::vector<std::pair<int, int>> pairs;
+    const float densities[] = {0.15f, 0.4f, 0.8f};
+    int trials = 0;
+    for (int rows = 1; rows <= 6; ++rows) {
+        for (int cols = 1; cols <= 6; ++cols) {
+            for (float density : densities) {
+                for (int t = 0; t < 40; ++t, ++trials) {
+                    Instance inst = randomInstance(rng, rows, cols, density);
+                    solve(solver, inst, pairs);
+                    std::vector<char> colUsed(cols, 0);
+                    double best = std::numeric_limits<double>::infinity();
+                    bruteForce(inst, 0, colUsed, 0.0, best);
+                    TEST_CHECK(validMatching(inst, pairs), "%dx%d density %.2f trial %d", rows, cols, density, t);
+                    double got = objective(inst, pairs);
+                    TEST_CHECK(std::fabs(got - best) < 1e-4, "%dx%d density %.2f trial %d: %.4f vs optimum %.4f",
+                               rows, cols, density, t, got, best);
+                }
+            }
+        }
+    }
+    std::printf("brute force: %d instances\n", trials);
+}
+
+void benchmarkCrowds() {
+    std::mt19937 rng(200);
+    AssignmentSolver solver;
+    std::vector<std::pair<int, int>> pairs;
+    const int sizes[] = {5, 30, 100, 200};
+    for (int n : sizes) {
+        Instance inst = crowdInstance(rng, n);
+        solve(solver, inst, pairs);
+        double dense = denseHungarian(inst);
+        double sparse = objective(inst, pairs);
+        TEST_CHECK(validMatching(inst, pairs), "crowd n=%d", n);
+        TEST_CHECK(std::fabs(dense - sparse) < 1e-3, "crowd n=%d: sparse %.4f vs dense %.4f", n, sparse, dense);
+
+        int iterations = n <= 30 ? 2000 : (n <= 100 ? 200 : 50);
+        double sparseUs = bench_us(iterations, [&] { solve(solver, inst, pairs); });
+        double denseUs = bench_us(std::max(5, iterations / 10), [&] { denseHungarian(inst); });
+        std::printf("n=%3d edges=%6zu  sparse %9.1f us  dense %9.1f us\n", n, solver.edgeCount(), sparseUs,
+                    denseUs);
+    }
+}
+
+}  // namespace
+
+int main() {
+    testAgainstBruteForce();
+    benchmarkCrowds();
+    return test_finish("test_assignment_solver");
+}
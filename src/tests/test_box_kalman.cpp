@@ -0,0 +1,459 @@
+// BoxKalmanBank against the generic tinyekf filter it replaced.
+//
+// The tracker called ekf_predict(fx = x) and ekf_update(hx = z), which never
+// moves the mean; BOX_KALMAN_ANCHORED must reproduce that call pattern. The
+// constant-velocity model is checked against tinyekf driven with the linear
+// model the bank specialises (fx = F x, hx = H x), and the covariance of both
+// call patterns must agree, since P never depends on fx / hx.
+
+#include "box_kalman.h"
+#include "test_util.h"
+#include "tinyekf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Same values as TRACK_KALMAN_NOISE in person_sort.cpp and the former
+// predict_track / correct_track / create_track.
+const BoxKalmanNoise kNoise = {
+    {1.0f, 1.0f, 0.5f, 0.5f},
+    {0.1f, 0.1f, 0.05f, 0.05f},
+    {16.0f, 16.0f, 64.0f, 64.0f},
+    1.0f,
+    10.0f,
+};
+
+void buildModel(float dt, _float_t F[EKF_N * EKF_N], _float_t Q[EKF_N * EKF_N]) {
+    for (int i = 0; i < EKF_N * EKF_N; ++i) {
+        F[i] = 0;
+        Q[i] = 0;
+    }
+    for (int i = 0; i < EKF_N; ++i) {
+        F[i * EKF_N + i] = 1;
+    }
+    for (int a = 0; a < BoxKalmanBank::kAxes; ++a) {
+        F[a * EKF_N + a + 4] = dt;
+        Q[a * EKF_N + a] = kNoise.qPos[a] * dt;
+        Q[(a + 4) * EKF_N + a + 4] = kNoise.qVel[a] * dt;
+    }
+}
+
+void initEkf(ekf_t& ekf, const float box[4]) {
+    _float_t pdiag[EKF_N];
+    for (int a = 0; a < 4; ++a) {
+        pdiag[a] = kNoise.p0Pos;
+        pdiag[a + 4] = kNoise.p0Vel;
+    }
+    ekf_initialize(&ekf, pdiag);
+    for (int a = 0; a < 4; ++a) {
+        ekf.x[a] = box[a];
+    }
+}
+
+const _float_t kH[EKF_M * EKF_N] = {
+    1, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 0, 0, 0, 0, 0, 0,
+    0, 0, 1, 0, 0, 0, 0, 0,
+    0, 0, 0, 1, 0, 0, 0, 0,
+};
+
+const _float_t kR[EKF_M * EKF_M] = {
+    16, 0, 0, 0,
+    0, 16, 0, 0,
+    0, 0, 64, 0,
+    0, 0, 0, 64,
+};
+
+void predictLinear(ekf_t& ekf, float dt) {
+    _float_t F[EKF_N * EKF_N], Q[EKF_N * EKF_N], fx[EKF_N];
+    buildModel(dt, F, Q);
+    for (int i = 0; i < EKF_N; ++i) {
+        fx[i] = 0;
+        for (int j = 0; j < EKF_N; ++j) {
+            fx[i] += F[i * EKF_N + j] * ekf.x[j];
+        }
+    }
+    ekf_predict(&ekf, fx, F, Q);
+}
+
+void correctLinear(ekf_t& ekf, const float z[4]) {
+    _float_t hx[EKF_M] = {ekf.x[0], ekf.x[1], ekf.x[2], ekf.x[3]};
+    ekf_update(&ekf, z, hx, kH, kR);
+}
+
+// Former person_sort.cpp call pattern.
+void predictLegacy(ekf_t& ekf, float dt) {
+    _float_t F[EKF_N * EKF_N], Q[EKF_N * EKF_N];
+    buildModel(dt, F, Q);
+    ekf_predict(&ekf, ekf.x, F, Q);
+}
+
+void correctLegacy(ekf_t& ekf, const float z[4]) {
+    ekf_update(&ekf, z, z, kH, kR);
+}
+
+struct Target {
+    float box[4];
+    float vel[4];
+};
+
+float relativeError(float a, float b) {
+    return std::fabs(a - b) / std::max(1.0f, std::max(std::fabs(a), std::fabs(b)));
+}
+
+// 50 walkers over 200 steps; a third of the measurements are dropped and
+// dt varies the way capture timestamps make it vary.
+void testEquivalence(bool variableDt) {
+    constexpr int kTracks = 50;
+    constexpr int kSteps = 200;
+    std::mt19937 rng(variableDt ? 280 : 28);
+    std::uniform_real_distribution<float> pos(50.0f, 1100.0f);
+    std::uniform_real_distribution<float> size(60.0f, 200.0f);
+    std::uniform_real_distribution<float> speed(-6.0f, 6.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 3.0f);
+    const float dts[] = {1.0f, 1.0f, 1.0f, 2.0f, 0.5f, 3.0f};
+    std::uniform_int_distribution<int> pickDt(0, 5);
+
+    BoxKalmanBank bank(kNoise, BOX_KALMAN_CONSTANT_VELOCITY);
+    BoxKalmanBank anchored(kNoise, BOX_KALMAN_ANCHORED);
+    std::vector<Target> targets(kTracks);
+    std::vector<ekf_t> linear(kTracks), legacy(kTracks);
+    std::vector<int> slots(kTracks), anchoredSlots(kTracks);
+    for (int i = 0; i < kTracks; ++i) {
+        Target& t = targets[i];
+        float w = size(rng);
+        float init[4] = {pos(rng), pos(rng) * 0.5f, w, w * 2.0f};
+        for (int a = 0; a < 4; ++a) {
+            t.box[a] = init[a];
+            t.vel[a] = a < 2 ? speed(rng) : speed(rng) * 0.1f;
+        }
+        slots[i] = bank.allocate(init);
+        anchoredSlots[i] = anchored.allocate(init);
+        initEkf(linear[i], init);
+        initEkf(legacy[i], init);
+    }
+
+    float maxError = 0.0f;
+    float maxAnchoredError = 0.0f;
+    for (int step = 0; step < kSteps; ++step) {
+        float dt = variableDt ? dts[pickDt(rng)] : 1.0f;
+        bank.predictAll(dt);
+        anchored.predictAll(dt);
+        for (int i = 0; i < kTracks; ++i) {
+            predictLinear(linear[i], dt);
+            predictLegacy(legacy[i], dt);
+            for (int a = 0; a < 4; ++a) {
+                targets[i].box[a] += targets[i].vel[a] * dt;
+            }
+            if (unit(rng) < 1.0f / 3.0f) {
+                continue;
+            }
+            float z[4];
+            for (int a = 0; a < 4; ++a) {
+                z[a] = targets[i].box[a] + noise(rng);
+            }
+            bank.correct(slots[i], z);
+            anchored.correct(anchoredSlots[i], z);
+            correctLinear(linear[i], z);
+            correctLegacy(legacy[i], z);
+        }
+
+        for (int i = 0; i < kTracks; ++i) {
+            float box[4], anchoredBox[4];
+            bank.position(slots[i], box);
+            anchored.position(anchoredSlots[i], anchoredBox);
+            for (int a = 0; a < 4; ++a) {
+                maxError = std::max(maxError, relativeError(box[a], linear[i].x[a]));
+                maxError = std::max(maxError, relativeError(bank.velocity(slots[i], a), linear[i].x[a + 4]));
+                maxAnchoredError = std::max(maxAnchoredError, relativeError(anchoredBox[a], legacy[i].x[a]));
+                maxAnchoredError = std::max(maxAnchoredError,
+                                            relativeError(anchored.velocity(anchoredSlots[i], a), legacy[i].x[a + 4]));
+            }
+        }
+    }
+    const char* label = variableDt ? "variable" : "unit";
+    TEST_CHECK(maxError < 1e-4f, "%s dt: max relative state error %.3g", label, maxError);
+    TEST_CHECK(maxAnchoredError == 0.0f, "%s dt: anchored state differs from the former calls by %.3g", label,
+               maxAnchoredError);
+    std::printf("%s dt: max relative state error vs tinyekf %.3g, anchored vs former calls %.3g\n", label,
+                maxError, maxAnchoredError);
+
+    float maxCovError = 0.0f;
+    for (int i = 0; i < kTracks; ++i) {
+        for (int k = 0; k < EKF_N * EKF_N; ++k) {
+            maxCovError = std::max(maxCovError, relativeError(legacy[i].P[k], linear[i].P[k]));
+        }
+    }
+    TEST_CHECK(maxCovError < 1e-5f, "%s dt: legacy covariance differs: %.3g", label, maxCovError);
+}
+
+// --- Tracking quality -----------------------------------------------------
+// The association geometry of person_sort.cpp on top of either model: the
+// Kalman box feeds the fused measurement, the IoU / centre references and
+// the velocity penalty, exactly where sort_update() uses kalman_bbox().
+
+constexpr float kDiag = 1468.6f;  // diagonal of the 1280x720 tracking frame
+
+struct Box {
+    float x, y, w, h;
+};
+
+float boxIou(const Box& a, const Box& b) {
+    float iw = std::min(a.x + a.w, b.x + b.w) - std::max(a.x, b.x);
+    float ih = std::min(a.y + a.h, b.y + b.h) - std::max(a.y, b.y);
+    if (iw <= 0.0f || ih <= 0.0f) {
+        return 0.0f;
+    }
+    float inter = iw * ih;
+    return inter / (a.w * a.h + b.w * b.h - inter);
+}
+
+float centerDistance(const Box& a, const Box& b) {
+    float dx = a.x + a.w * 0.5f - b.x - b.w * 0.5f;
+    float dy = a.y + a.h * 0.5f - b.y - b.h * 0.5f;
+    return std::sqrt(dx * dx + dy * dy) / kDiag;
+}
+
+// blend_bbox without the frame clamp.
+Box blend(const Box& prev, const Box& curr, float centerAlpha, float sizeAlpha) {
+    float cx = (prev.x + prev.w * 0.5f) * (1.0f - centerAlpha) + (curr.x + curr.w * 0.5f) * centerAlpha;
+    float cy = (prev.y + prev.h * 0.5f) * (1.0f - centerAlpha) + (curr.y + curr.h * 0.5f) * centerAlpha;
+    float w = prev.w * (1.0f - sizeAlpha) + curr.w * sizeAlpha;
+    float h = prev.h * (1.0f - sizeAlpha) + curr.h * sizeAlpha;
+    return {cx - w * 0.5f, cy - h * 0.5f, w, h};
+}
+
+struct SimTrack {
+    int slot;
+    Box smoothed;
+    int hits;
+    int missed;
+};
+
+struct TrackingScore {
+    int associations = 0;
+    int switches = 0;  // walker matched to a different track than last time
+    int missed = 0;    // detection left unmatched although its track exists
+    double centerErr = 0.0;
+    int centerSamples = 0;
+};
+
+Box kalmanBox(const BoxKalmanBank& bank, int slot) {
+    float b[4];
+    bank.position(slot, b);
+    return {b[0], b[1], std::max(10.0f, b[2]), std::max(10.0f, b[3])};
+}
+
+// Walkers crossing the frame once in both directions, 20% of detections
+// dropped and short occlusions, so tracks have to coast through gaps.
+TrackingScore runTracking(BoxKalmanModel model, uint32_t seed) {
+    constexpr int kWalkers = 14;
+    constexpr int kFrames = 150;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> speed(3.0f, 10.0f);
+    std::normal_distribution<float> noise(0.0f, 3.0f);
+
+    std::vector<Box> truth(kWalkers);
+    std::vector<float> vx(kWalkers), vy(kWalkers);
+    std::vector<int> occludedUntil(kWalkers, 0);
+    std::vector<int> lastTrack(kWalkers, -1);
+    for (int k = 0; k < kWalkers; ++k) {
+        float w = 70.0f + 40.0f * unit(rng);
+        truth[k] = {60.0f + 1100.0f * unit(rng), 40.0f + 420.0f * unit(rng), w, w * 2.2f};
+        vx[k] = (k % 2 ? 1.0f : -1.0f) * speed(rng);
+        vy[k] = (unit(rng) - 0.5f) * 2.0f;
+    }
+
+    BoxKalmanBank bank(kNoise, model);
+    std::vector<SimTrack> tracks(kWalkers);
+    for (int k = 0; k < kWalkers; ++k) {
+        float b[4] = {truth[k].x, truth[k].y, truth[k].w, truth[k].h};
+        tracks[k] = {bank.allocate(b), truth[k], 1, 0};
+    }
+
+    struct Pair {
+        float cost;
+        int track, det;
+    };
+    TrackingScore score;
+    std::vector<Box> dets;
+    std::vector<int> detWalker;
+    std::vector<Pair> pairs;
+    for (int frame = 0; frame < kFrames; ++frame) {
+        dets.clear();
+        detWalker.clear();
+        for (int k = 0; k < kWalkers; ++k) {
+            Box& b = truth[k];
+            b.x += vx[k];
+            b.y += vy[k];
+            if (b.x + b.w < 0.0f || b.x > 1280.0f) {
+                continue;  // left the frame
+            }
+            if (b.y < 0.0f || b.y + b.h > 720.0f) {
+                vy[k] = -vy[k];
+            }
+            if (occludedUntil[k] <= frame && unit(rng) < 0.02f) {
+                occludedUntil[k] = frame + 2 + static_cast<int>(unit(rng) * 4.0f);
+            }
+            if (frame < occludedUntil[k] || unit(rng) < 0.2f) {
+                continue;
+            }
+            dets.push_back({b.x + noise(rng), b.y + noise(rng), b.w + noise(rng), b.h + noise(rng)});
+            detWalker.push_back(k);
+        }
+
+        bank.predictAll(1.0f);
+        pairs.clear();
+        for (int i = 0; i < kWalkers; ++i) {
+            SimTrack& t = tracks[i];
+            t.missed++;
+            Box predicted = kalmanBox(bank, t.slot);
+            for (int j = 0; j < static_cast<int>(dets.size()); ++j) {
+                const Box& d = dets[j];
+                float iouScore = std::max(boxIou(predicted, d), boxIou(t.smoothed, d));
+                float center = std::min(centerDistance(predicted, d), centerDistance(t.smoothed, d));
+                float cost = (1.0f - iouScore) * 0.48f + std::min(1.0f, center / 0.28f) * 0.26f;
+                if (iouScore < 0.02f && center > 0.24f) {
+                    cost += 0.30f;
+                }
+                if (center > 0.42f) {
+                    cost += 0.25f;
+                }
+                if (t.hits >= 3 && centerDistance(predicted, d) > 0.15f) {
+                    cost += 0.15f;
+                }
+                if (cost < 0.65f) {
+                    pairs.push_back({cost, i, j});
+                }
+            }
+        }
+        std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.cost < b.cost; });
+        std::vector<int> trackOf(dets.size(), -1);
+        std::vector<uint8_t> trackUsed(kWalkers, 0);
+        for (const Pair& p : pairs) {
+            if (trackOf[p.det] >= 0 || trackUsed[p.track]) {
+                continue;
+            }
+            trackOf[p.det] = p.track;
+            trackUsed[p.track] = 1;
+        }
+
+        for (int j = 0; j < static_cast<int>(dets.size()); ++j) {
+            int i = trackOf[j];
+            score.associations++;
+            if (i < 0) {
+                score.missed++;
+                continue;
+            }
+            int& last = lastTrack[detWalker[j]];
+            if (last >= 0 && last != i) {
+                score.switches++;
+            }
+            last = i;
+            SimTrack& t = tracks[i];
+            const Box& d = dets[j];
+            float z[4] = {d.x, d.y, d.w, d.h};
+            bank.correct(t.slot, z);
+            Box fused = blend(d, kalmanBox(bank, t.slot), 0.28f, 0.20f);
+            float centerAlpha = 0.30f, sizeAlpha = 0.16f;
+            if (t.hits < 2) {
+                centerAlpha = 0.60f;
+                sizeAlpha = 0.38f;
+            } else if (t.missed > 1) {
+                centerAlpha = 0.48f;
+                sizeAlpha = 0.30f;
+            } else if (boxIou(t.smoothed, d) < 0.18f) {
+                centerAlpha = std::max(centerAlpha, 0.55f);
+                sizeAlpha = std::max(sizeAlpha, 0.36f);
+            }
+            t.smoothed = blend(t.smoothed, fused, centerAlpha, sizeAlpha);
+            t.missed = 0;
+            t.hits++;
+        }
+
+        for (int k = 0; k < kWalkers; ++k) {
+            if (tracks[k].missed == 0) {
+                score.centerErr += centerDistance(tracks[k].smoothed, truth[k]) * kDiag;
+                score.centerSamples++;
+            }
+        }
+    }
+    return score;
+}
+
+// The anchored mean drags the fused measurement back towards where each
+// person first appeared and fires the velocity penalty once they walk
+// away from it; following the target must associate at least as well.
+void testTrackingQuality() {
+    TrackingScore totals[2];
+    const BoxKalmanModel models[2] = {BOX_KALMAN_ANCHORED, BOX_KALMAN_CONSTANT_VELOCITY};
+    for (int m = 0; m < 2; ++m) {
+        for (uint32_t seed = 0; seed < 20; ++seed) {
+            TrackingScore s = runTracking(models[m], 2800 + seed);
+            totals[m].associations += s.associations;
+            totals[m].switches += s.switches;
+            totals[m].missed += s.missed;
+            totals[m].centerErr += s.centerErr;
+            totals[m].centerSamples += s.centerSamples;
+        }
+    }
+    const char* names[2] = {"anchored", "constant-velocity"};
+    for (int m = 0; m < 2; ++m) {
+        const TrackingScore& s = totals[m];
+        std::printf("%-17s detections %d  id switches %4d  unmatched %5.2f%%  smoothed centre error %.1f px\n",
+                    names[m], s.associations, s.switches, 100.0 * s.missed / s.associations,
+                    s.centerErr / std::max(1, s.centerSamples));
+    }
+    const TrackingScore& anchoredScore = totals[0];
+    const TrackingScore& cvScore = totals[1];
+    TEST_CHECK(cvScore.switches <= anchoredScore.switches, "constant velocity: %d id switches vs %d",
+               cvScore.switches, anchoredScore.switches);
+    TEST_CHECK(cvScore.missed <= anchoredScore.missed, "constant velocity: %d unmatched vs %d", cvScore.missed,
+               anchoredScore.missed);
+    TEST_CHECK(cvScore.centerErr / cvScore.centerSamples < anchoredScore.centerErr / anchoredScore.centerSamples,
+               "constant velocity smoothed boxes lag more");
+}
+
+void benchmark() {
+    const int counts[] = {10, 50, 200};
+    for (int n : counts) {
+        BoxKalmanBank bank(kNoise, BOX_KALMAN_ANCHORED);
+        std::vector<ekf_t> ekfs(n);
+        std::vector<int> slots(n);
+        for (int i = 0; i < n; ++i) {
+            float box[4] = {10.0f * i, 5.0f * i, 80.0f, 180.0f};
+            slots[i] = bank.allocate(box);
+            initEkf(ekfs[i], box);
+        }
+        float z[4] = {100.0f, 100.0f, 80.0f, 180.0f};
+        double bankUs = bench_us(2000, [&] {
+            bank.predictAll(1.0f);
+            for (int i = 0; i < n; ++i) {
+                bank.correct(slots[i], z);
+            }
+        });
+        double ekfUs = bench_us(200, [&] {
+            for (int i = 0; i < n; ++i) {
+                predictLegacy(ekfs[i], 1.0f);
+                correctLegacy(ekfs[i], z);
+            }
+        });
+        std::printf("tracks=%3d predict+correct: bank %8.2f us  tinyekf %8.2f us\n", n, bankUs, ekfUs);
+    }
+}
+
+}  // namespace
+
+int main() {
+    testEquivalence(false);
+    testEquivalence(true);
+    testTrackingQuality();
+    benchmark();
+    return test_finish("test_box_kalman");
+}
@@ -0,0 +1,247 @@
+// Blurry-face mode selection: enhance_blurry_face (proxy ranking, then the
+// top kFaceProxyFinalists at full size) against scoring every eligible mode at
+// full size, on synthetic motion-blurred faces of 160-520 px. Also prints how
+// often other proxy sizes and finalist counts would have agreed, and the time
+// per face both ways.
+
+#include "image_enhance.h"
+#include "test_util.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kFaces = 60;
+// A Python port of the same pipeline agreed on 82-93% of 60-face samples
+// (64-88% of the faces that took the proxy path) with a mean regret of 27-51.
+constexpr double kMinAgreement = 0.78;
+constexpr double kMinProxyAgreement = 0.55;
+constexpr double kMaxMeanRegret = 80.0;
+
+const int kSweepProxyEdges[] = {96, 128, 160};
+
+double uniform(std::mt19937& rng, double lo, double hi) {
+    return std::uniform_real_distribution<double>(lo, hi)(rng);
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Face-like crop drawn at 4x and area-downscaled (hair, skin, eyes, brows,
+// nose, mouth and a smooth texture), then motion blurred along a random
+// angle, possibly defocused, under- or over-exposed and noisy.
+cv::Mat synthFace(std::mt19937& rng, int shortEdge) {
+    const int w = shortEdge, h = static_cast<int>(shortEdge * 1.25);
+    const int W = w * 4, H = h * 4;
+    cv::Mat img(H, W, CV_32FC3,
+                cv::Scalar(uniform(rng, 30, 220), uniform(rng, 30, 220), uniform(rng, 30, 220)));
+    cv::RNG fieldRng(rng());
+    cv::Mat texture(H, W, CV_32F);
+    fieldRng.fill(texture, cv::RNG::NORMAL, 0.0, 1.0);
+    cv::GaussianBlur(texture, texture, cv::Size(0, 0), uniform(rng, 2, 10));
+    cv::Scalar textureMean, textureStd;
+    cv::meanStdDev(texture, textureMean, textureStd);
+    texture *= uniform(rng, 6, 20) / (textureStd[0] + 1e-6);
+
+    cv::Scalar skin(uniform(rng, 90, 190), uniform(rng, 110, 200), uniform(rng, 140, 235));
+    cv::Scalar hair(uniform(rng, 10, 90), uniform(rng, 10, 90), uniform(rng, 10, 90));
+    int cx = W / 2 + static_cast<int>(uniform(rng, -0.05, 0.05) * W);
+    int cy = static_cast<int>(H * 0.55);
+    int ax = static_cast<int>(W * uniform(rng, 0.30, 0.40));
+    int ay = static_cast<int>(H * uniform(rng, 0.33, 0.42));
+    cv::ellipse(img, cv::Point(cx, cy - ay / 3), cv::Size(static_cast<int>(ax * 1.08), ay), 0, 180, 360, hair, -1);
+    cv::ellipse(img, cv::Point(cx, cy), cv::Size(ax, ay), 0, 0, 360, skin, -1);
+    int ey = cy - ay / 5;
+    for (int side : {-1, 1}) {
+        int ex = cx + side * ax / 2;
+        cv::ellipse(img, cv::Point(ex, ey), cv::Size(ax / 5, ay / 12), 0, 0, 360, cv::Scalar(235, 235, 235), -1);
+        cv::circle(img, cv::Point(ex, ey), ay / 14, cv::Scalar(40, 30, 20), -1);
+        cv::line(img, cv::Point(ex - ax / 5, ey - ay / 6), cv::Point(ex + ax / 5, ey - ay / 5), hair,
+                 std::max(2, W / 60));
+    }
+    cv::line(img, cv::Point(cx, ey), cv::Point(cx - ax / 10, cy + ay / 4), skin * 0.7, std::max(2, W / 90));
+    cv::ellipse(img, cv::Point(cx, cy + ay / 2), cv::Size(ax / 3, ay / 10), 0, 0, 180, cv::Scalar(60, 60, 150),
+                std::max(2, W / 70));
+    cv::Mat texturePlanes[] = {texture, texture, texture};
+    cv::Mat texture3;
+    cv::merge(texturePlanes, 3, texture3);
+    img += texture3;
+
+    cv::Mat drawn, face;
+    img.convertTo(drawn, CV_8UC3);
+    cv::resize(drawn, face, cv::Size(w, h), 0, 0, cv::INTER_AREA);
+
+    int len = static_cast<int>(uniform(rng, 3, std::max(4.0, 0.07 * shortEdge))) | 1;
+    double rad = uniform(rng, 0, 180) * CV_PI / 180.0;
+    cv::Mat kernel = cv::Mat::zeros(len, len, CV_32F);
+    cv::Point center(len / 2, len / 2);
+    cv::Point delta(static_cast<int>(std::round(std::cos(rad) * (len / 2))),
+                    static_cast<int>(std::round(std::sin(rad) * (len / 2))));
+    cv::line(kernel, center - delta, center + delta, cv::Scalar(1.0f), 1, cv::LINE_AA);
+    kernel /= cv::sum(kernel)[0];
+    cv::Mat blurred;
+    face.convertTo(blurred, CV_32FC3);
+    cv::filter2D(blurred, blurred, -1, kernel, cv::Point(-1, -1), 0.0, cv::BORDER_REPLICATE);
+    double defocus = uniform(rng, 0.0, 1.6);
+    if (defocus > 0.3) {
+        cv::GaussianBlur(blurred, blurred, cv::Size(0, 0), defocus);
+    }
+    double gain = uniform(rng, 0.45, 1.15);
+    cv::Mat noise(blurred.size(), CV_32FC3);
+    fieldRng.fill(noise, cv::RNG::NORMAL, 0.0, uniform(rng, 0.8, 4.0));
+    cv::Mat degraded = blurred * gain + noise;
+    degraded.convertTo(face, CV_8UC3);
+    return face;
+}
+
+size_t modeIndex(const char* name) {
+    for (size_t i = 0; i < kFaceEnhanceModeCount; ++i) {
+        if (name && std::strcmp(name, kFaceEnhanceModes[i].name) == 0) {
+            return i;
+        }
+    }
+    return kFaceEnhanceModeCount;
+}
+
+void testAgainstExhaustive() {
+    std::mt19937 rng(47);
+    const int sizes[] = {160, 200, 240, 300, 400, 520};
+    std::uniform_int_distribution<size_t> pickSize(0, std::size(sizes) - 1);
+
+    int faces = 0, agreed = 0, proxyFaces = 0, proxyAgreed = 0;
+    double regret = 0.0, exhaustiveMs = 0.0, selectedMs = 0.0;
+    double proxyExhaustiveMs = 0.0, proxySelectedMs = 0.0;
+    int sweepAgreed[std::size(kSweepProxyEdges)][2] = {};
+    while (faces < kFaces) {
+        int shortEdge = sizes[pickSize(rng)];
+        cv::Mat face = synthFace(rng, shortEdge);
+        FaceQuality base = measure_face_quality(face);
+        // prepareUploadImage's severity; lighter blur never gets here.
+        double severity = std::max(0.0, std::min(1.0, (220.0 - base.focus) / 220.0));
+        if (severity < 0.40) {
+            continue;
+        }
+        ++faces;
+        size_t modeCount = face_enhance_mode_count(severity, shortEdge);
+
+        double fullScores[kFaceEnhanceModeCount];
+        size_t best = 0;
+        auto started = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < modeCount; ++i) {
+            const FaceEnhanceMode& mode = kFaceEnhanceModes[i];
+            fullScores[i] = score_face_candidate(mode.apply(face, FaceEnhanceScale()), base.focus, base.luma,
+                                                 base.gradient, mode.scaleBonus);
+            if (fullScores[i] > fullScores[best]) {
+                best = i;
+            }
+        }
+        double faceExhaustiveMs = elapsedMs(started);
+
+        const char* chosenName = nullptr;
+        double chosenScore = 0.0;
+        size_t tried = 0;
+        started = std::chrono::steady_clock::now();
+        cv::Mat enhanced = enhance_blurry_face(face, base, severity, 0, chosenName, chosenScore, tried);
+        double faceSelectedMs = elapsedMs(started);
+        exhaustiveMs += faceExhaustiveMs;
+        selectedMs += faceSelectedMs;
+
+        size_t chosen = modeIndex(chosenName);
+        TEST_CHECK(chosen < modeCount && !enhanced.empty(), "%dpx: mode %s of %zu eligible", shortEdge,
+                   chosenName ? chosenName : "none", modeCount);
+        if (chosen >= modeCount) {
+            continue;
+        }
+        // The finalists run at full size, so the kept score is the full-size one.
+        TEST_CHECK(std::fabs(chosenScore - fullScores[chosen]) <= 1e-6 * std::max(1.0, std::fabs(chosenScore)),
+                   "%dpx %s: score %.3f vs full-size %.3f", shortEdge, chosenName, chosenScore,
+                   fullScores[chosen]);
+        agreed += chosen == best;
+        regret += fullScores[best] - fullScores[chosen];
+
+        bool proxy = shortEdge >= kFaceProxyMinSourceEdge && modeCount > kFaceProxyFinalists;
+        if (!proxy) {
+            TEST_CHECK(tried == modeCount && chosen == best, "%dpx, %zu modes: tried %zu, chose %s over %s",
+                       shortEdge, modeCount, tried, chosenName, kFaceEnhanceModes[best].name);
+            continue;
+        }
+        TEST_CHECK(tried == modeCount + kFaceProxyFinalists, "%dpx, %zu modes: tried %zu", shortEdge, modeCount,
+                   tried);
+        ++proxyFaces;
+        proxyAgreed += chosen == best;
+        proxyExhaustiveMs += faceExhaustiveMs;
+        proxySelectedMs += faceSelectedMs;
+
+        // Which of the full-size scores above other proxy sizes and finalist
+        // counts would have picked.
+        for (size_t e = 0; e < std::size(kSweepProxyEdges); ++e) {
+            std::vector<size_t> ranked = rank_face_enhance_modes_on_proxy(
+                face, base, modeCount, kSweepProxyEdges[e], std::chrono::steady_clock::time_point::max());
+            TEST_CHECK(ranked.size() == modeCount, "proxy %d: ranked %zu of %zu modes", kSweepProxyEdges[e],
+                       ranked.size(), modeCount);
+            for (size_t finalists = 1; finalists <= 2 && finalists <= ranked.size(); ++finalists) {
+                size_t pick = ranked[0];
+                for (size_t k = 1; k < finalists; ++k) {
+                    if (fullScores[ranked[k]] > fullScores[pick]) {
+                        pick = ranked[k];
+                    }
+                }
+                sweepAgreed[e][finalists - 1] += pick == best;
+            }
+            if (kSweepProxyEdges[e] == kFaceProxyShortEdge && kFaceProxyFinalists == 2) {
+                size_t pick = fullScores[ranked[1]] > fullScores[ranked[0]] ? ranked[1] : ranked[0];
+                TEST_CHECK(pick == chosen, "%dpx: proxy ranking picks %s, enhance_blurry_face %s", shortEdge,
+                           kFaceEnhanceModes[pick].name, chosenName);
+            }
+        }
+    }
+
+    double agreement = agreed / static_cast<double>(faces);
+    double proxyAgreement = proxyFaces > 0 ? proxyAgreed / static_cast<double>(proxyFaces) : 1.0;
+    double meanRegret = regret / faces;
+    std::printf("%d faces: agree with exhaustive %.0f%%  mean regret %.1f  %.0f ms/face vs %.0f ms/face\n", faces,
+                agreement * 100.0, meanRegret, selectedMs / faces, exhaustiveMs / faces);
+    if (proxyFaces > 0) {
+        std::printf("%d proxy faces: agree %.0f%%  %.0f ms/face vs %.0f ms/face\n", proxyFaces,
+                    proxyAgreement * 100.0, proxySelectedMs / proxyFaces, proxyExhaustiveMs / proxyFaces);
+        for (size_t e = 0; e < std::size(kSweepProxyEdges); ++e) {
+            std::printf("  proxy %3d px: top-1 %.0f%%  top-2 %.0f%%\n", kSweepProxyEdges[e],
+                        100.0 * sweepAgreed[e][0] / proxyFaces, 100.0 * sweepAgreed[e][1] / proxyFaces);
+        }
+    }
+    TEST_CHECK(agreement >= kMinAgreement, "agreement %.2f", agreement);
+    TEST_CHECK(proxyAgreement >= kMinProxyAgreement, "proxy-path agreement %.2f", proxyAgreement);
+    TEST_CHECK(meanRegret <= kMaxMeanRegret, "mean regret %.1f", meanRegret);
+}
+
+void testBudget() {
+    // A spent budget still runs the proxy winner at full size.
+    std::mt19937 rng(470);
+    cv::Mat face = synthFace(rng, 400);
+    FaceQuality base = measure_face_quality(face);
+    const char* chosenName = nullptr;
+    double chosenScore = 0.0;
+    size_t tried = 0;
+    cv::Mat enhanced = enhance_blurry_face(face, base, 0.9, 1, chosenName, chosenScore, tried);
+    TEST_CHECK(!enhanced.empty() && modeIndex(chosenName) < kFaceEnhanceModeCount, "no mode applied");
+    TEST_CHECK(tried >= 2 && tried < face_enhance_mode_count(0.9, 400) + kFaceProxyFinalists,
+               "tried %zu with a 1 ms budget", tried);
+}
+
+}  // namespace
+
+int main() {
+    testAgainstExhaustive();
+    testBudget();
+    return test_finish("test_face_enhance");
+}
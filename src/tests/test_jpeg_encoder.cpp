@@ -0,0 +1,210 @@
+// jpeg_encode_bgr / jpeg_encode_nv12 round trips: every output decodes to the
+// input size within a PSNR floor, the caller's buffer is overwritten, odd
+// sizes are rejected by the VENC and land in the software counters, plus the
+// cost of one upload-sized encode per backend.
+
+#include "jpeg_encoder.h"
+#include "test_util.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kQuality = 92;
+constexpr double kMinPsnr = 30.0;       // q92 on upload-sized content is about 41 dB
+constexpr double kMinPsnrSmall = 22.0;  // below 64 px a side the edges dominate
+
+double minPsnr(const cv::Mat& img) {
+    return std::min(img.cols, img.rows) >= 64 ? kMinPsnr : kMinPsnrSmall;
+}
+
+// Upload-like content: shading, a few objects and mild noise.
+cv::Mat makeImage(std::mt19937& rng, int width, int height) {
+    std::uniform_int_distribution<int> level(20, 235);
+    cv::Mat img(height, width, CV_8UC3, cv::Scalar(level(rng), level(rng), level(rng)));
+    for (int k = 0; k < 12; ++k) {
+        cv::Point center(level(rng) * width / 255, level(rng) * height / 255);
+        int radius = std::max(1, level(rng) * std::min(width, height) / 600);
+        cv::circle(img, center, radius, cv::Scalar(level(rng), level(rng), level(rng)), -1);
+    }
+    cv::Mat noise(height, width, CV_8UC3);
+    cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(6));
+    cv::add(img, noise, img);
+    if (width >= 3 && height >= 3) {
+        cv::GaussianBlur(img, img, cv::Size(3, 3), 0.8);
+    }
+    return img;
+}
+
+// NV12 of an even-sized BGR image: the I420 Y plane, then U and V interleaved.
+cv::Mat toNv12(const cv::Mat& bgr) {
+    cv::Mat i420;
+    cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+    cv::Mat nv12(bgr.rows * 3 / 2, bgr.cols, CV_8UC1);
+    std::memcpy(nv12.data, i420.data, static_cast<size_t>(bgr.cols) * bgr.rows);
+    const uchar* u = i420.ptr<uchar>(bgr.rows);
+    const uchar* v = u + bgr.cols * bgr.rows / 4;
+    for (int y = 0; y < bgr.rows / 2; ++y) {
+        uchar* row = nv12.ptr<uchar>(bgr.rows + y);
+        for (int x = 0; x < bgr.cols / 2; ++x) {
+            row[2 * x] = u[y * bgr.cols / 2 + x];
+            row[2 * x + 1] = v[y * bgr.cols / 2 + x];
+        }
+    }
+    return nv12;
+}
+
+JpegEncodeStats statsOf(JpegBackend backend) {
+    return get_jpeg_encode_stats()[backend];
+}
+
+// Encodes through the process-wide entry point into a buffer holding stale
+// bytes and checks the decoded image.
+void checkBgrRoundTrip(const cv::Mat& img, JpegBackend expectedBackend) {
+    JpegEncodeStats before = statsOf(expectedBackend);
+    std::vector<uchar> out(4096, 0xAB);
+    bool ok = jpeg_encode_bgr(img, kQuality, out);
+    TEST_CHECK(ok && !out.empty(), "%dx%d: encode failed", img.cols, img.rows);
+    if (!ok) {
+        return;
+    }
+    TEST_CHECK(out.size() >= 4 && out[0] == 0xFF && out[1] == 0xD8 && out[out.size() - 2] == 0xFF &&
+                   out[out.size() - 1] == 0xD9,
+               "%dx%d: output is not a bare JPEG stream (%zu bytes)", img.cols, img.rows, out.size());
+    JpegEncodeStats after = statsOf(expectedBackend);
+    TEST_CHECK(after.encodes == before.encodes + 1, "%dx%d: not encoded by %s", img.cols, img.rows, after.name);
+
+    cv::Mat decoded = cv::imdecode(out, cv::IMREAD_COLOR);
+    TEST_CHECK(decoded.size() == img.size(), "%dx%d: decoded as %dx%d", img.cols, img.rows, decoded.cols,
+               decoded.rows);
+    if (decoded.size() == img.size()) {
+        double psnr = cv::PSNR(img, decoded);
+        TEST_CHECK(psnr >= minPsnr(img), "%dx%d via %s: PSNR %.1f dB", img.cols, img.rows, after.name, psnr);
+    }
+}
+
+void checkNv12RoundTrip(const cv::Mat& img, JpegBackend expectedBackend) {
+    cv::Mat nv12 = toNv12(img);
+    JpegEncodeStats before = statsOf(expectedBackend);
+    std::vector<uchar> out;
+    bool ok = jpeg_encode_nv12(nv12, kQuality, out);
+    TEST_CHECK(ok, "nv12 %dx%d: encode failed", img.cols, img.rows);
+    TEST_CHECK(statsOf(expectedBackend).encodes == before.encodes + 1, "nv12 %dx%d: wrong backend", img.cols,
+               img.rows);
+    cv::Mat decoded = cv::imdecode(out, cv::IMREAD_COLOR);
+    TEST_CHECK(decoded.size() == img.size(), "nv12 %dx%d: decoded as %dx%d", img.cols, img.rows, decoded.cols,
+               decoded.rows);
+    if (decoded.size() == img.size()) {
+        // Chroma is subsampled before either encoder sees it.
+        double psnr = cv::PSNR(img, decoded);
+        TEST_CHECK(psnr >= minPsnr(img) - 3.0, "nv12 %dx%d: PSNR %.1f dB", img.cols, img.rows, psnr);
+    }
+}
+
+void testRoundTrips(bool hasVenc) {
+    std::mt19937 rng(50);
+    JpegBackend evenBackend = hasVenc ? JPEG_BACKEND_VENC : JPEG_BACKEND_SOFTWARE;
+
+    const int evenSizes[][2] = {{16, 16}, {96, 64}, {640, 480}, {1280, 720}};
+    for (const auto& size : evenSizes) {
+        cv::Mat img = makeImage(rng, size[0], size[1]);
+        checkBgrRoundTrip(img, evenBackend);
+        checkNv12RoundTrip(img, evenBackend);
+    }
+
+    // Odd sizes (and sizes below the VENC minimum) go to software whole,
+    // without losing their last row or column.
+    const int softwareSizes[][2] = {{1, 1}, {15, 17}, {641, 481}, {640, 481}, {641, 480}, {8, 8}};
+    for (const auto& size : softwareSizes) {
+        cv::Mat img = makeImage(rng, size[0], size[1]);
+        checkBgrRoundTrip(img, JPEG_BACKEND_SOFTWARE);
+    }
+
+    // A ROI view with a row stride wider than its width.
+    cv::Mat frame = makeImage(rng, 800, 600);
+    checkBgrRoundTrip(frame(cv::Rect(11, 7, 320, 240)), evenBackend);
+
+    // Lower quality, fewer bytes.
+    cv::Mat img = makeImage(rng, 640, 480);
+    std::vector<uchar> high, low;
+    jpeg_encode_bgr(img, 92, high);
+    jpeg_encode_bgr(img, 55, low);
+    TEST_CHECK(!low.empty() && low.size() < high.size(), "q55 %zu bytes vs q92 %zu bytes", low.size(), high.size());
+
+    std::vector<uchar> out(16, 0xAB);
+    TEST_CHECK(!jpeg_encode_bgr(cv::Mat(), kQuality, out), "empty image encoded");
+}
+
+void testVencSizeLimits(JpegEncoder* venc) {
+    if (!venc) {
+        std::printf("VENC not available, software encoder only\n");
+        return;
+    }
+    TEST_CHECK(venc->backend() == JPEG_BACKEND_VENC, "VENC backend id");
+    TEST_CHECK(venc->supports(640, 480) && venc->supports(16, 16), "even sizes rejected");
+    TEST_CHECK(!venc->supports(641, 480) && !venc->supports(640, 481) && !venc->supports(15, 16) &&
+                   !venc->supports(8, 8),
+               "odd or tiny sizes accepted");
+    std::mt19937 rng(500);
+    std::vector<uchar> out;
+    TEST_CHECK(!venc->encodeBgr(makeImage(rng, 641, 481), kQuality, out), "VENC encoded an odd size");
+}
+
+void testSoftwareEncoder() {
+    std::unique_ptr<JpegEncoder> software = create_software_jpeg_encoder();
+    TEST_CHECK(software && software->backend() == JPEG_BACKEND_SOFTWARE, "software backend id");
+    TEST_CHECK(software->supports(1, 1) && software->supports(641, 481), "software size limits");
+    std::mt19937 rng(5000);
+    cv::Mat img = makeImage(rng, 33, 17);
+    std::vector<uchar> out;
+    TEST_CHECK(software->encodeBgr(img, kQuality, out), "software encode failed");
+    cv::Mat bad(10, 10, CV_8UC1);
+    TEST_CHECK(!software->encodeNv12(bad, kQuality, out), "nv12 with rows not a multiple of 3 accepted");
+}
+
+void benchmark(bool hasVenc) {
+    std::mt19937 rng(5);
+    cv::Mat img = makeImage(rng, 1280, 720);
+    std::vector<uchar> out;
+    std::unique_ptr<JpegEncoder> software = create_software_jpeg_encoder();
+    double softwareUs = bench_us(20, [&] { software->encodeBgr(img, kQuality, out); });
+    double defaultUs = bench_us(20, [&] { jpeg_encode_bgr(img, kQuality, out); });
+    std::printf("1280x720 q%d: software %.0f us  jpeg_encode_bgr (%s) %.0f us\n", kQuality, softwareUs,
+                hasVenc ? "venc" : "software", defaultUs);
+}
+
+}  // namespace
+
+int main() {
+    testSoftwareEncoder();
+
+    // Size limits are checked on a private instance; the VENC has a single
+    // channel, so it is released before the process-wide one starts.
+    {
+        std::unique_ptr<JpegEncoder> venc = create_venc_jpeg_encoder();
+        testVencSizeLimits(venc.get());
+    }
+    jpeg_encoder_init();
+    bool hasVenc = false;
+    {
+        // Whether init brought the VENC up shows in which counter an even
+        // encode lands.
+        std::mt19937 rng(1);
+        uint64_t before = statsOf(JPEG_BACKEND_VENC).encodes;
+        std::vector<uchar> out;
+        jpeg_encode_bgr(makeImage(rng, 64, 64), kQuality, out);
+        hasVenc = statsOf(JPEG_BACKEND_VENC).encodes > before;
+    }
+    testRoundTrips(hasVenc);
+    benchmark(hasVenc);
+    jpeg_encoder_shutdown();
+    return test_finish("test_jpeg_encoder");
+}
@@ -0,0 +1,182 @@
+// Cached Wiener deconvolution against a filter rebuilt on every call: the
+// former uncached path (full-size PSF, complex DFTs, no padding) with the PSF
+// wrapped around the origin, on blurred faces at optimal and padded DFT
+// sizes; repeated and post-eviction calls must be bit-identical to the first.
+
+#include "motion_deconvolution.h"
+#include "test_util.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Former apply_motion_wiener_restore_gray, building its filter every call.
+// The PSF is drawn at the centre as before and then rolled to the origin,
+// which is what the cached filter rasterizes directly.
+cv::Mat restoreUncached(const cv::Mat& gray, double angleDeg, int kernelLen, float snr) {
+    kernelLen = std::max(3, kernelLen | 1);
+    cv::Mat centred = cv::Mat::zeros(gray.size(), CV_32F);
+    cv::Point center(centred.cols / 2, centred.rows / 2);
+    double rad = angleDeg * CV_PI / 180.0;
+    cv::Point delta(static_cast<int>(std::round(std::cos(rad) * (kernelLen / 2))),
+                    static_cast<int>(std::round(std::sin(rad) * (kernelLen / 2))));
+    cv::line(centred, center - delta, center + delta, cv::Scalar(1.0f), 1, cv::LINE_AA);
+    double psfSum = cv::sum(centred)[0];
+    if (psfSum <= 1e-6) {
+        centred.at<float>(center) = 1.0f;
+        psfSum = 1.0;
+    }
+    centred /= static_cast<float>(psfSum);
+    cv::Mat psf(gray.size(), CV_32F);
+    for (int y = 0; y < psf.rows; ++y) {
+        for (int x = 0; x < psf.cols; ++x) {
+            psf.at<float>(y, x) = centred.at<float>((y + center.y) % psf.rows, (x + center.x) % psf.cols);
+        }
+    }
+
+    cv::Mat grayF;
+    gray.convertTo(grayF, CV_32F, 1.0 / 255.0);
+    cv::Mat planesImg[] = {grayF.clone(), cv::Mat::zeros(gray.size(), CV_32F)};
+    cv::Mat complexImg;
+    cv::merge(planesImg, 2, complexImg);
+    cv::dft(complexImg, complexImg);
+
+    cv::Mat planesPsf[] = {psf, cv::Mat::zeros(gray.size(), CV_32F)};
+    cv::Mat complexPsf;
+    cv::merge(planesPsf, 2, complexPsf);
+    cv::dft(complexPsf, complexPsf);
+
+    std::vector<cv::Mat> h(2);
+    cv::split(complexPsf, h);
+    cv::Mat denom = h[0].mul(h[0]) + h[1].mul(h[1]) + 1.0f / std::max(0.5f, snr);
+    cv::Mat real = h[0] / denom;
+    cv::Mat imag = -h[1] / denom;
+    cv::Mat invPlanes[] = {real, imag};
+    cv::Mat inverse;
+    cv::merge(invPlanes, 2, inverse);
+
+    cv::mulSpectrums(complexImg, inverse, complexImg, 0);
+    cv::idft(complexImg, grayF, cv::DFT_REAL_OUTPUT | cv::DFT_SCALE);
+    cv::max(grayF, 0.0, grayF);
+    cv::min(grayF, 1.0, grayF);
+    return grayF;
+}
+
+// Face-like gray plane, motion blurred along angleDeg.
+cv::Mat blurredFace(std::mt19937& rng, int width, int height, double angleDeg, int kernelLen) {
+    std::uniform_int_distribution<int> level(40, 220);
+    std::uniform_int_distribution<int> px(0, width - 1), py(0, height - 1), radius(3, 24);
+    cv::Mat face(height, width, CV_8U, cv::Scalar(level(rng)));
+    for (int k = 0; k < 60; ++k) {
+        cv::circle(face, cv::Point(px(rng), py(rng)), radius(rng), cv::Scalar(level(rng)), -1);
+    }
+    cv::GaussianBlur(face, face, cv::Size(0, 0), 0.8);
+
+    cv::Mat kernel = cv::Mat::zeros(kernelLen, kernelLen, CV_32F);
+    cv::Point center(kernelLen / 2, kernelLen / 2);
+    double rad = angleDeg * CV_PI / 180.0;
+    cv::Point delta(static_cast<int>(std::round(std::cos(rad) * (kernelLen / 2))),
+                    static_cast<int>(std::round(std::sin(rad) * (kernelLen / 2))));
+    cv::line(kernel, center - delta, center + delta, cv::Scalar(1.0f), 1, cv::LINE_AA);
+    kernel /= cv::sum(kernel)[0];
+    cv::filter2D(face, face, -1, kernel, cv::Point(-1, -1), 0.0, cv::BORDER_REPLICATE);
+    return face;
+}
+
+double maxAbsDiff(const cv::Mat& a, const cv::Mat& b) {
+    return cv::norm(a, b, cv::NORM_INF);
+}
+
+double meanAbsDiff(const cv::Mat& a, const cv::Mat& b) {
+    cv::Mat diff;
+    cv::absdiff(a, b, diff);
+    return cv::mean(diff)[0];
+}
+
+struct Case {
+    int width;
+    int height;
+    double angleDeg;
+    int kernelLen;
+    float snr;
+};
+
+void testAgainstUncached() {
+    std::mt19937 rng(48);
+    // 160x200, 240x240 and 320x256 are optimal DFT sizes, the others are padded.
+    const Case cases[] = {
+        {160, 200, 0.0, 9, 6.0f},   {160, 200, 37.0, 11, 5.5f}, {240, 240, 90.0, 13, 6.5f},
+        {320, 256, -52.0, 9, 7.0f}, {157, 203, 12.0, 9, 6.0f},  {233, 241, 71.0, 11, 5.0f},
+        {301, 389, -20.0, 13, 6.5f},
+    };
+    for (const Case& c : cases) {
+        cv::Mat gray = blurredFace(rng, c.width, c.height, c.angleDeg, c.kernelLen);
+        cv::Mat miss = apply_motion_wiener_restore_luma(gray, c.angleDeg, c.kernelLen, c.snr);
+        cv::Mat hit = apply_motion_wiener_restore_luma(gray, c.angleDeg, c.kernelLen, c.snr);
+        TEST_CHECK(miss.size() == gray.size() && miss.type() == CV_32F, "%dx%d: restored size or type", c.width,
+                   c.height);
+        TEST_CHECK(maxAbsDiff(miss, hit) == 0.0, "%dx%d: cache hit differs from miss", c.width, c.height);
+
+        cv::Mat reference = restoreUncached(gray, c.angleDeg, c.kernelLen, c.snr);
+        bool optimal = cv::getOptimalDFTSize(c.width) == c.width && cv::getOptimalDFTSize(c.height) == c.height;
+        if (optimal) {
+            // Same transform up to float rounding of the two DFT layouts.
+            double diff = maxAbsDiff(miss, reference) * 255.0;
+            TEST_CHECK(diff < 0.05, "%dx%d angle %.0f: cached vs uncached max diff %.4f levels", c.width, c.height,
+                       c.angleDeg, diff);
+        } else {
+            // Reflect padding instead of wrap-around only changes the borders.
+            int margin = c.kernelLen * 2;
+            cv::Rect inner(margin, margin, c.width - 2 * margin, c.height - 2 * margin);
+            double whole = meanAbsDiff(miss, reference) * 255.0;
+            double interior = meanAbsDiff(miss(inner), reference(inner)) * 255.0;
+            TEST_CHECK(interior < 0.25, "%dx%d angle %.0f: interior mean diff %.3f levels", c.width, c.height,
+                       c.angleDeg, interior);
+            TEST_CHECK(whole < 2.0, "%dx%d angle %.0f: mean diff %.3f levels", c.width, c.height, c.angleDeg, whole);
+        }
+    }
+
+    // Filters large enough to overflow the cache evict the first ones; the
+    // rebuilt filter must give the same output.
+    cv::Mat gray = blurredFace(rng, 160, 200, 37.0, 11);
+    cv::Mat before = apply_motion_wiener_restore_luma(gray, 37.0, 11, 5.5f);
+    cv::Mat big(1024, 1024, CV_8U, cv::Scalar(128));
+    for (int k = 0; k < 4; ++k) {
+        apply_motion_wiener_restore_luma(big, 15.0 * k, 9, 6.0f);
+    }
+    cv::Mat after = apply_motion_wiener_restore_luma(gray, 37.0, 11, 5.5f);
+    TEST_CHECK(maxAbsDiff(before, after) == 0.0, "output changed after eviction");
+
+    // The color wrapper carries the luma change back through the ratio.
+    cv::Mat bgr;
+    cv::cvtColor(gray, bgr, cv::COLOR_GRAY2BGR);
+    cv::Mat restoredBgr = apply_motion_wiener_restore_bgr(bgr, 37.0, 11, 5.5f);
+    cv::Mat restoredGray;
+    cv::cvtColor(restoredBgr, restoredGray, cv::COLOR_BGR2GRAY);
+    cv::Mat expected;
+    before.convertTo(expected, CV_8U, 255.0);
+    double bgrDiff = meanAbsDiff(restoredGray, expected);
+    TEST_CHECK(bgrDiff < 1.0, "bgr restore differs from luma by %.3f levels", bgrDiff);
+}
+
+void benchmark() {
+    std::mt19937 rng(480);
+    cv::Mat gray = blurredFace(rng, 233, 241, 30.0, 11);
+    double cachedUs = bench_us(50, [&] { apply_motion_wiener_restore_luma(gray, 30.0, 11, 6.0f); });
+    double uncachedUs = bench_us(50, [&] { restoreUncached(gray, 30.0, 11, 6.0f); });
+    std::printf("233x241 face: cached %.0f us  uncached %.0f us\n", cachedUs, uncachedUs);
+}
+
+}  // namespace
+
+int main() {
+    testAgainstUncached();
+    benchmark();
+    return test_finish("test_motion_deconvolution");
+}
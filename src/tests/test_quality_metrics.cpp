@@ -0,0 +1,214 @@
+// QualityMetrics against the separate OpenCV passes it replaced: cvtColor,
+// Sobel / Laplacian + meanStdDev, magnitude, the structure-tensor blur angle
+// and the warpAffine shift trails, on random and blurred BGR / gray images
+// (including ROI views), plus the cost of scoring one face both ways.
+
+#include "quality_metrics.h"
+#include "test_util.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+// Former uploader / camera helpers, on a gray image.
+double laplacianVariance(const cv::Mat& gray) {
+    cv::Mat lap;
+    cv::Laplacian(gray, lap, CV_32F);
+    cv::Scalar mu, sigma;
+    cv::meanStdDev(lap, mu, sigma);
+    return sigma[0] * sigma[0];
+}
+
+double blurAngleDeg(const cv::Mat& gray) {
+    cv::Mat gx, gy;
+    cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
+    cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
+    double sumXX = 0.0, sumYY = 0.0, sumXY = 0.0;
+    for (int y = 0; y < gray.rows; ++y) {
+        const float* px = gx.ptr<float>(y);
+        const float* py = gy.ptr<float>(y);
+        for (int x = 0; x < gray.cols; ++x) {
+            sumXX += static_cast<double>(px[x]) * px[x];
+            sumYY += static_cast<double>(py[x]) * py[x];
+            sumXY += static_cast<double>(px[x]) * py[x];
+        }
+    }
+    return 0.5 * std::atan2(2.0 * sumXY, sumXX - sumYY) * 180.0 / CV_PI;
+}
+
+double shiftTrail(const cv::Mat& gray, double radians) {
+    int dx = static_cast<int>(std::round(std::cos(radians) * 2.0));
+    int dy = static_cast<int>(std::round(std::sin(radians) * 2.0));
+    if (dx == 0 && dy == 0) {
+        dx = 1;
+    }
+    cv::Mat shifted, diff;
+    cv::Mat transform = (cv::Mat_<double>(2, 3) << 1, 0, dx, 0, 1, dy);
+    cv::warpAffine(gray, shifted, transform, gray.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    cv::absdiff(gray, shifted, diff);
+    return cv::mean(diff)[0];
+}
+
+// Former CameraTask::computeMotionBlurSeverity, without its downscale.
+float motionBlurSeverity(const cv::Mat& gray) {
+    cv::Mat gx, gy;
+    cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
+    cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
+    cv::Scalar gxMean, gxStd, gyMean, gyStd;
+    cv::meanStdDev(gx, gxMean, gxStd);
+    cv::meanStdDev(gy, gyMean, gyStd);
+    double ex = gxStd[0] * gxStd[0];
+    double ey = gyStd[0] * gyStd[0];
+    if (ex + ey < 1.0) {
+        return 1.0f;
+    }
+    double dirRatio = std::min(ex, ey) / (std::max(ex, ey) + 1e-6);
+    float dirSeverity = std::max(0.0f, std::min(1.0f, static_cast<float>(1.0 - dirRatio)));
+    float sharpSeverity =
+        std::max(0.0f, std::min(1.0f, static_cast<float>((200.0 - laplacianVariance(gray)) / 200.0)));
+    double trail = shiftTrail(gray, std::atan2(gyMean[0], gxMean[0]));
+    float trailSeverity = std::max(0.0f, std::min(1.0f, static_cast<float>((16.0 - trail) / 16.0)));
+    return std::max(0.0f, std::min(1.0f, dirSeverity * 0.25f + sharpSeverity * 0.45f + trailSeverity * 0.30f));
+}
+
+bool close(double got, double expected, double tolerance = 1e-5) {
+    return std::fabs(got - expected) <= tolerance * std::max(1.0, std::fabs(expected));
+}
+
+void checkImage(const cv::Mat& img, const char* label) {
+    QualityMetrics m;
+    bool ok = compute_quality_metrics(img, m, QUALITY_GRADIENT_MAGNITUDE | QUALITY_SHIFT_TRAILS);
+    TEST_CHECK(ok && m.valid, "%s %dx%d: not computed", label, img.cols, img.rows);
+    if (!ok) {
+        return;
+    }
+
+    cv::Mat gray;
+    if (img.channels() == 3) {
+        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+    } else {
+        gray = img;
+    }
+    cv::Mat gx, gy, magnitude;
+    cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
+    cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
+    cv::magnitude(gx, gy, magnitude);
+    cv::Scalar gxMean, gxStd, gyMean, gyStd;
+    cv::meanStdDev(gx, gxMean, gxStd);
+    cv::meanStdDev(gy, gyMean, gyStd);
+
+    const int w = img.cols, h = img.rows;
+    TEST_CHECK(close(m.lumaMean, cv::mean(gray)[0]), "%s %dx%d: luma %.6f vs %.6f", label, w, h, m.lumaMean,
+               cv::mean(gray)[0]);
+    TEST_CHECK(close(m.gradMeanX, gxMean[0], 1e-4) && close(m.gradMeanY, gyMean[0], 1e-4),
+               "%s %dx%d: gradient mean", label, w, h);
+    TEST_CHECK(close(m.gradEnergyX, gxStd[0] * gxStd[0], 1e-4), "%s %dx%d: energy x %.4f vs %.4f", label, w, h,
+               m.gradEnergyX, gxStd[0] * gxStd[0]);
+    TEST_CHECK(close(m.gradEnergyY, gyStd[0] * gyStd[0], 1e-4), "%s %dx%d: energy y %.4f vs %.4f", label, w, h,
+               m.gradEnergyY, gyStd[0] * gyStd[0]);
+    TEST_CHECK(close(m.gradMagnitudeMean, cv::mean(magnitude)[0], 1e-4), "%s %dx%d: magnitude %.4f vs %.4f",
+               label, w, h, m.gradMagnitudeMean, cv::mean(magnitude)[0]);
+    double lapVar = laplacianVariance(gray);
+    TEST_CHECK(close(m.laplacianVar, lapVar, 1e-4), "%s %dx%d: laplacian %.4f vs %.4f", label, w, h,
+               m.laplacianVar, lapVar);
+    // The angle is ill-defined on flat images; compare it where the tensor has energy.
+    if (m.tensorXX + m.tensorYY > 1.0) {
+        double angle = blurAngleDeg(gray);
+        TEST_CHECK(std::fabs(m.blurAngleDeg() - angle) < 1e-3, "%s %dx%d: blur angle %.4f vs %.4f", label, w, h,
+                   m.blurAngleDeg(), angle);
+    }
+    double trailMean = shiftTrail(gray, std::atan2(gyMean[0], gxMean[0]));
+    double trailStructure = shiftTrail(gray, blurAngleDeg(gray) * CV_PI / 180.0);
+    TEST_CHECK(close(m.trailMeanGradient, trailMean), "%s %dx%d: mean-gradient trail %.5f vs %.5f", label, w, h,
+               m.trailMeanGradient, trailMean);
+    TEST_CHECK(close(m.trailStructure, trailStructure), "%s %dx%d: structure trail %.5f vs %.5f", label, w, h,
+               m.trailStructure, trailStructure);
+    float severity = motionBlurSeverity(gray);
+    TEST_CHECK(std::fabs(m.motionBlurSeverity() - severity) < 1e-4f, "%s %dx%d: severity %.5f vs %.5f", label, w,
+               h, m.motionBlurSeverity(), severity);
+}
+
+// Face-like content: smooth shading, a few edges and sensor noise.
+cv::Mat randomImage(std::mt19937& rng, int width, int height) {
+    std::uniform_int_distribution<int> level(0, 255);
+    cv::Mat img(height, width, CV_8UC3, cv::Scalar(level(rng), level(rng), level(rng)));
+    for (int k = 0; k < 6; ++k) {
+        cv::Point a(level(rng) % std::max(1, width), level(rng) % std::max(1, height));
+        cv::Point b(level(rng) % std::max(1, width), level(rng) % std::max(1, height));
+        cv::rectangle(img, a, b, cv::Scalar(level(rng), level(rng), level(rng)), -1);
+    }
+    cv::Mat noise(height, width, CV_8UC3);
+    cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(16));
+    cv::add(img, noise, img);
+    return img;
+}
+
+void testAgainstOpenCv() {
+    std::mt19937 rng(33);
+    const int sizes[][2] = {{1, 1}, {2, 3}, {3, 2}, {7, 5}, {16, 16}, {33, 47}, {96, 112}, {160, 200}, {300, 240}};
+    for (const auto& size : sizes) {
+        for (int variant = 0; variant < 4; ++variant) {
+            cv::Mat img = randomImage(rng, size[0], size[1]);
+            if (variant == 1 && size[0] >= 5 && size[1] >= 5) {
+                cv::GaussianBlur(img, img, cv::Size(5, 5), 1.6);
+            } else if (variant == 2 && size[0] >= 9) {
+                // Horizontal motion blur.
+                cv::Mat kernel(1, 9, CV_32F, cv::Scalar(1.0 / 9.0));
+                cv::filter2D(img, img, -1, kernel);
+            }
+            checkImage(img, "bgr");
+            cv::Mat gray;
+            cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+            checkImage(gray, "gray");
+            if (variant == 3 && size[0] > 4 && size[1] > 4) {
+                // A view with a row stride wider than the crop.
+                cv::Rect inner(1, 2, size[0] - 3, size[1] - 4);
+                checkImage(img(inner), "bgr roi");
+                checkImage(gray(inner), "gray roi");
+            }
+        }
+    }
+    QualityMetrics empty;
+    TEST_CHECK(!compute_quality_metrics(cv::Mat(), empty) && !empty.valid, "empty image accepted");
+}
+
+void benchmark() {
+    std::mt19937 rng(330);
+    cv::Mat face = randomImage(rng, 200, 240);
+    cv::GaussianBlur(face, face, cv::Size(3, 3), 1.0);
+    QualityMetrics m;
+    double singleUs = bench_us(300, [&] {
+        compute_quality_metrics(face, m, QUALITY_GRADIENT_MAGNITUDE | QUALITY_SHIFT_TRAILS);
+    });
+    // The four helpers score_face_candidate used to call, each converting
+    // and differentiating the image again.
+    volatile double sink = 0.0;
+    double separateUs = bench_us(300, [&] {
+        cv::Mat gray, gx, gy, magnitude;
+        cv::cvtColor(face, gray, cv::COLOR_BGR2GRAY);
+        sink = sink + laplacianVariance(gray);
+        cv::cvtColor(face, gray, cv::COLOR_BGR2GRAY);
+        sink = sink + cv::mean(gray)[0];
+        cv::cvtColor(face, gray, cv::COLOR_BGR2GRAY);
+        cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
+        cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
+        cv::magnitude(gx, gy, magnitude);
+        sink = sink + cv::mean(magnitude)[0];
+        cv::cvtColor(face, gray, cv::COLOR_BGR2GRAY);
+        sink = sink + shiftTrail(gray, blurAngleDeg(gray) * CV_PI / 180.0) + laplacianVariance(gray);
+    });
+    std::printf("200x240 face: QualityMetrics %.1f us  separate passes %.1f us\n", singleUs, separateUs);
+}
+
+}  // namespace
+
+int main() {
+    testAgainstOpenCv();
+    benchmark();
+    return test_finish("test_quality_metrics");
+}
@@ -0,0 +1,269 @@
+// simd_kernels: every kernel at every level the CPU supports against a plain
+// reference (exact, except gradient magnitude and the dot products, which
+// sum floats in a different order), then the timings of each level.
+
+#include "simd_kernels.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+const SimdLevel kLevels[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_SSSE3, SIMD_AVX2, SIMD_NEON};
+
+// Lengths around every block size (16 / 32 lanes, 4- and 8-wide floats) and
+// one full 4K row.
+const size_t kLengths[] = {0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 100, 3840};
+
+std::vector<uint8_t> randomBytes(std::mt19937& rng, size_t n) {
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<uint8_t> v(n);
+    for (uint8_t& b : v) {
+        b = static_cast<uint8_t>(byte(rng));
+    }
+    return v;
+}
+
+std::vector<float> randomFloats(std::mt19937& rng, size_t n, float lo, float hi) {
+    std::uniform_real_distribution<float> value(lo, hi);
+    std::vector<float> v(n);
+    for (float& f : v) {
+        f = value(rng);
+    }
+    return v;
+}
+
+void testMedian(SimdLevel level, std::mt19937& rng) {
+    for (int count = 1; count <= kSimdMedianMaxInputs; ++count) {
+        for (size_t len : kLengths) {
+            // +1 keeps the rows unaligned.
+            std::vector<std::vector<uint8_t>> rows;
+            std::vector<const uint8_t*> srcs;
+            for (int f = 0; f < count; ++f) {
+                rows.push_back(randomBytes(rng, len + 1));
+            }
+            for (int f = 0; f < count; ++f) {
+                srcs.push_back(rows[f].data() + 1);
+            }
+            std::vector<uint8_t> dst(len + 1, 0);
+            simd_median_u8(srcs.data(), count, dst.data() + 1, len);
+            int mismatches = 0;
+            uint8_t v[kSimdMedianMaxInputs] = {};
+            for (size_t i = 0; i < len; ++i) {
+                for (int f = 0; f < count; ++f) {
+                    v[f] = srcs[f][i];
+                }
+                std::nth_element(v, v + count / 2, v + count);
+                mismatches += dst[i + 1] != v[count / 2];
+            }
+            TEST_CHECK(mismatches == 0, "%s median count=%d len=%zu: %d mismatches", simd_level_name(level), count,
+                       len, mismatches);
+        }
+    }
+}
+
+void testDeinterleave(SimdLevel level, std::mt19937& rng) {
+    for (size_t pixels : kLengths) {
+        std::vector<uint8_t> src = randomBytes(rng, pixels * 3 + 1);
+        std::vector<uint8_t> d0(pixels + 1), d1(pixels + 1), d2(pixels + 1);
+        simd_deinterleave3_u8(src.data() + 1, d0.data() + 1, d1.data() + 1, d2.data() + 1, pixels);
+        bool same = true;
+        for (size_t i = 0; i < pixels; ++i) {
+            same = same && d0[i + 1] == src[1 + i * 3] && d1[i + 1] == src[2 + i * 3] && d2[i + 1] == src[3 + i * 3];
+        }
+        TEST_CHECK(same, "%s deinterleave u8 pixels=%zu", simd_level_name(level), pixels);
+
+        std::vector<float> fsrc = randomFloats(rng, pixels * 3 + 1, -1.0f, 1.0f);
+        std::vector<float> f0(pixels + 1), f1(pixels + 1), f2(pixels + 1);
+        simd_deinterleave3_f32(fsrc.data() + 1, f0.data() + 1, f1.data() + 1, f2.data() + 1, pixels);
+        same = true;
+        for (size_t i = 0; i < pixels; ++i) {
+            same = same && f0[i + 1] == fsrc[1 + i * 3] && f1[i + 1] == fsrc[2 + i * 3] &&
+                   f2[i + 1] == fsrc[3 + i * 3];
+        }
+        TEST_CHECK(same, "%s deinterleave f32 pixels=%zu", simd_level_name(level), pixels);
+    }
+}
+
+void testIou(SimdLevel level, std::mt19937& rng) {
+    std::uniform_real_distribution<float> pos(0.0f, 600.0f);
+    std::uniform_real_distribution<float> size(0.0f, 200.0f);
+    for (size_t count : kLengths) {
+        std::vector<float> x1(count), y1(count), x2(count), y2(count), area(count), out(count);
+        for (size_t i = 0; i < count; ++i) {
+            x1[i] = pos(rng);
+            y1[i] = pos(rng);
+            x2[i] = x1[i] + size(rng);
+            y2[i] = y1[i] + size(rng);
+            area[i] = (x2[i] - x1[i]) * (y2[i] - y1[i]);
+        }
+        float ax1 = 250.0f, ay1 = 250.0f, ax2 = 380.0f, ay2 = 420.0f;
+        float areaA = (ax2 - ax1) * (ay2 - ay1);
+        simd_iou_one_to_many(ax1, ay1, ax2, ay2, areaA, x1.data(), y1.data(), x2.data(), y2.data(), area.data(),
+                             count, out.data());
+        int mismatches = 0;
+        for (size_t i = 0; i < count; ++i) {
+            float w = std::max(0.0f, std::min(ax2, x2[i]) - std::max(ax1, x1[i]));
+            float h = std::max(0.0f, std::min(ay2, y2[i]) - std::max(ay1, y1[i]));
+            float inter = w * h;
+            mismatches += out[i] != inter / (areaA + area[i] - inter + 1e-6f);
+        }
+        TEST_CHECK(mismatches == 0, "%s iou count=%zu: %d mismatches", simd_level_name(level), count, mismatches);
+    }
+}
+
+GradientRowSums referenceGradient(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int width) {
+    GradientRowSums s;
+    for (int x = 1; x + 1 < width; ++x) {
+        int gx = (up[x + 1] - up[x - 1]) + 2 * (mid[x + 1] - mid[x - 1]) + (down[x + 1] - down[x - 1]);
+        int gy = (down[x - 1] + 2 * down[x] + down[x + 1]) - (up[x - 1] + 2 * up[x] + up[x + 1]);
+        int lap = up[x] + down[x] + mid[x - 1] + mid[x + 1] - 4 * mid[x];
+        s.luma += mid[x];
+        s.dx += gx;
+        s.dy += gy;
+        s.dxdx += gx * gx;
+        s.dydy += gy * gy;
+        s.dxdy += gx * gy;
+        s.lap += lap;
+        s.laplap += lap * lap;
+        s.magnitude += std::sqrt(static_cast<double>(gx * gx + gy * gy));
+    }
+    return s;
+}
+
+void testGradient(SimdLevel level, std::mt19937& rng) {
+    for (size_t len : kLengths) {
+        int width = static_cast<int>(len);
+        std::vector<uint8_t> up = randomBytes(rng, len + 1);
+        std::vector<uint8_t> mid = randomBytes(rng, len + 1);
+        std::vector<uint8_t> down = randomBytes(rng, len + 1);
+        // Flat runs as well, so min/max saturation corners are covered.
+        for (size_t i = len / 2; i < len && i < len / 2 + 20; ++i) {
+            up[i + 1] = 255;
+            down[i + 1] = 0;
+        }
+        GradientRowSums expected = referenceGradient(up.data() + 1, mid.data() + 1, down.data() + 1, width);
+        for (bool withMagnitude : {false, true}) {
+            GradientRowSums got;
+            simd_gradient_row(up.data() + 1, mid.data() + 1, down.data() + 1, width, withMagnitude, got);
+            bool same = got.luma == expected.luma && got.dx == expected.dx && got.dy == expected.dy &&
+                        got.dxdx == expected.dxdx && got.dydy == expected.dydy && got.dxdy == expected.dxdy &&
+                        got.lap == expected.lap && got.laplap == expected.laplap;
+            TEST_CHECK(same, "%s gradient width=%d magnitude=%d: integer sums differ", simd_level_name(level), width,
+                       withMagnitude);
+            double magnitude = withMagnitude ? expected.magnitude : 0.0;
+            TEST_CHECK(std::fabs(got.magnitude - magnitude) <= 1e-5 * std::max(1.0, magnitude),
+                       "%s gradient width=%d magnitude %.3f vs %.3f", simd_level_name(level), width, got.magnitude,
+                       magnitude);
+        }
+    }
+}
+
+void testDot(SimdLevel level, std::mt19937& rng) {
+    std::vector<float> a = randomFloats(rng, 3841, 0.0f, 0.2f);
+    std::vector<std::vector<float>> bs;
+    std::vector<const float*> ptrs;
+    for (int k = 0; k < 11; ++k) {
+        bs.push_back(randomFloats(rng, 3841, 0.0f, 0.2f));
+    }
+    for (const auto& b : bs) {
+        ptrs.push_back(b.data() + 1);
+    }
+    std::vector<float> out(ptrs.size());
+    for (size_t len : kLengths) {
+        for (size_t count = 0; count <= ptrs.size(); ++count) {
+            simd_dot_f32_batch(a.data() + 1, ptrs.data(), count, len, out.data());
+            for (size_t k = 0; k < count; ++k) {
+                double expected = 0.0;
+                for (size_t i = 0; i < len; ++i) {
+                    expected += static_cast<double>(a[i + 1]) * ptrs[k][i];
+                }
+                TEST_CHECK(std::fabs(out[k] - expected) <= 1e-4 * std::max(1.0, expected),
+                           "%s dot len=%zu count=%zu k=%zu: %.7f vs %.7f", simd_level_name(level), len, count, k,
+                           out[k], expected);
+                TEST_CHECK(out[k] == simd_dot_f32(a.data() + 1, ptrs[k], len),
+                           "%s dot len=%zu: batch and single differ", simd_level_name(level), len);
+            }
+        }
+    }
+}
+
+void benchmark(SimdLevel level, double scalarUs[6]) {
+    std::mt19937 rng(34);
+    const size_t kRow = 3840;
+    std::vector<std::vector<uint8_t>> rows;
+    std::vector<const uint8_t*> srcs;
+    for (int f = 0; f < 5; ++f) {
+        rows.push_back(randomBytes(rng, kRow * 3));
+    }
+    for (const auto& row : rows) {
+        srcs.push_back(row.data());
+    }
+    std::vector<uint8_t> u0(kRow * 3), u1(kRow), u2(kRow);
+    std::vector<float> fsrc = randomFloats(rng, kRow * 3, 0.0f, 1.0f), f0(kRow), f1(kRow), f2(kRow);
+    std::vector<float> x1 = randomFloats(rng, 200, 0.0f, 600.0f), y1 = randomFloats(rng, 200, 0.0f, 600.0f);
+    std::vector<float> x2(200), y2(200), area(200), ious(200);
+    for (size_t i = 0; i < 200; ++i) {
+        x2[i] = x1[i] + 90.0f;
+        y2[i] = y1[i] + 200.0f;
+        area[i] = 90.0f * 200.0f;
+    }
+    std::vector<float> a = randomFloats(rng, 512, 0.0f, 0.1f);
+    std::vector<std::vector<float>> bs;
+    std::vector<const float*> ptrs;
+    for (int k = 0; k < 200; ++k) {
+        bs.push_back(randomFloats(rng, 512, 0.0f, 0.1f));
+    }
+    for (const auto& b : bs) {
+        ptrs.push_back(b.data());
+    }
+    std::vector<float> dots(200);
+    GradientRowSums sums;
+
+    double us[6];
+    us[0] = bench_us(500, [&] { simd_median_u8(srcs.data(), 5, u0.data(), kRow * 3); });
+    us[1] = bench_us(2000, [&] { simd_deinterleave3_u8(rows[0].data(), u0.data(), u1.data(), u2.data(), kRow); });
+    us[2] = bench_us(2000, [&] { simd_deinterleave3_f32(fsrc.data(), f0.data(), f1.data(), f2.data(), kRow); });
+    us[3] = bench_us(20000, [&] {
+        simd_iou_one_to_many(100.0f, 100.0f, 190.0f, 300.0f, 18000.0f, x1.data(), y1.data(), x2.data(), y2.data(),
+                             area.data(), 200, ious.data());
+    });
+    us[4] = bench_us(2000, [&] {
+        simd_gradient_row(rows[0].data(), rows[1].data(), rows[2].data(), static_cast<int>(kRow), true, sums);
+    });
+    us[5] = bench_us(2000, [&] { simd_dot_f32_batch(a.data(), ptrs.data(), 200, 512, dots.data()); });
+    if (level == SIMD_SCALAR) {
+        std::copy(us, us + 6, scalarUs);
+    }
+    const char* names[] = {"median5 4K rgb row", "deinterleave u8 4K", "deinterleave f32 4K",
+                           "iou 1x200", "gradient 4K row", "dot 200x512"};
+    for (int k = 0; k < 6; ++k) {
+        std::printf("%-6s %-20s %9.2f us  (%.1fx scalar)\n", simd_level_name(level), names[k], us[k],
+                    scalarUs[k] / std::max(1e-9, us[k]));
+    }
+}
+
+}  // namespace
+
+int main() {
+    const SimdLevel best = simd_active_level();
+    std::printf("best level: %s\n", simd_level_name(best));
+    double scalarUs[6] = {};
+    for (SimdLevel level : kLevels) {
+        if (simd_set_level(level) != level) {
+            continue;
+        }
+        std::mt19937 rng(34);
+        testMedian(level, rng);
+        testDeinterleave(level, rng);
+        testIou(level, rng);
+        testGradient(level, rng);
+        testDot(level, rng);
+        benchmark(level, scalarUs);
+    }
+    simd_set_level(best);
+    return test_finish("test_simd_kernels");
+}
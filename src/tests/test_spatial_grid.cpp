@@ -0,0 +1,199 @@
+// SpatialGrid against brute-force scans: query, maxOverlapOn, bestIou and
+// nearest on random 720p scenes, plus the occlusion pass at 10, 50 and 200
+// boxes compared with the all-pairs loop it replaced.
+
+#include "spatial_grid.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr float kWidth = 1280.0f;   // IMAGE_WIDTH
+constexpr float kHeight = 720.0f;   // IMAGE_HEIGHT
+constexpr float kCellSize = 64.0f;  // GRID_CELL_SIZE in person_sort.cpp
+
+float intersection(const cv::Rect2f& a, const cv::Rect2f& b) {
+    float w = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+    float h = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+    return (w > 0.0f && h > 0.0f) ? w * h : 0.0f;
+}
+
+bool touches(const cv::Rect2f& area, const cv::Rect2f& b) {
+    return b.width > 0.0f && b.height > 0.0f &&
+           b.x <= area.x + area.width && area.x <= b.x + b.width &&
+           b.y <= area.y + area.height && area.y <= b.y + b.height;
+}
+
+// Former rect_overlap_ratio_on_a all-pairs loop.
+float bruteOverlapOn(const std::vector<cv::Rect2f>& boxes, int item) {
+    const cv::Rect2f& a = boxes[item];
+    if (a.width <= 0.0f || a.height <= 0.0f) {
+        return 0.0f;
+    }
+    float area = std::max(1.0f, a.area());
+    float best = 0.0f;
+    for (int other = 0; other < static_cast<int>(boxes.size()); ++other) {
+        if (other != item) {
+            best = std::max(best, intersection(a, boxes[other]) / area);
+        }
+    }
+    return best;
+}
+
+float iouOf(const cv::Rect2f& a, const cv::Rect2f& b) {
+    float inter = intersection(a, b);
+    return inter > 0.0f ? inter / (a.area() + b.area() - inter + 1e-6f) : 0.0f;
+}
+
+// Person boxes, a few of them partly outside the frame, degenerate or
+// sharing an edge with another box. People get smaller as the crowd grows,
+// the way they do on an entrance camera.
+std::vector<cv::Rect2f> randomScene(std::mt19937& rng, int count) {
+    std::uniform_real_distribution<float> px(-60.0f, kWidth - 20.0f);
+    std::uniform_real_distribution<float> py(-60.0f, kHeight - 40.0f);
+    float maxWidth = std::min(260.0f, 1600.0f / std::sqrt(static_cast<float>(std::max(count, 1))));
+    std::uniform_real_distribution<float> size(20.0f, std::max(30.0f, maxWidth));
+    std::uniform_int_distribution<int> kind(0, 19);
+    std::vector<cv::Rect2f> boxes;
+    for (int i = 0; i < count; ++i) {
+        float w = size(rng);
+        cv::Rect2f box(px(rng), py(rng), w, w * 2.1f);
+        int k = kind(rng);
+        if (k == 0) {
+            box.width = 0.0f;
+        } else if (k == 1 && !boxes.empty()) {
+            const cv::Rect2f& prev = boxes.back();
+            box.x = prev.x + prev.width;  // touching edge
+            box.y = prev.y;
+        } else if (k == 2 && !boxes.empty()) {
+            box = boxes[i / 2];  // duplicate
+        }
+        boxes.push_back(box);
+    }
+    return boxes;
+}
+
+void checkScene(std::mt19937& rng, SpatialGrid& grid, const std::vector<cv::Rect2f>& boxes) {
+    grid.reset(kWidth, kHeight, kCellSize);
+    // Insert half, query, then insert the rest: cells are indexed lazily.
+    std::vector<cv::Rect2f> inserted;
+    std::vector<int> got;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (i == boxes.size() / 2) {
+            grid.query(cv::Rect2f(0.0f, 0.0f, kWidth, kHeight), got);
+        }
+        int index = grid.insert(boxes[i]);
+        TEST_CHECK(index == static_cast<int>(i), "insert returned %d for %zu", index, i);
+        inserted.push_back(boxes[i]);
+    }
+
+    std::uniform_real_distribution<float> px(-100.0f, kWidth + 50.0f);
+    std::uniform_real_distribution<float> py(-100.0f, kHeight + 50.0f);
+    std::uniform_real_distribution<float> size(0.0f, 400.0f);
+    for (int q = 0; q < 60; ++q) {
+        cv::Rect2f area(px(rng), py(rng), size(rng), size(rng));
+        if (q % 10 == 0 && !boxes.empty()) {
+            area = boxes[q % boxes.size()];
+        }
+        grid.query(area, got);
+        std::vector<int> expected;
+        for (int i = 0; i < static_cast<int>(boxes.size()); ++i) {
+            if (touches(area, boxes[i])) {
+                expected.push_back(i);
+            }
+        }
+        TEST_CHECK(got == expected, "n=%zu query %d: %zu items vs %zu", boxes.size(), q, got.size(),
+                   expected.size());
+
+        int bestItem = -2;
+        float best = grid.bestIou(area, &bestItem);
+        float bruteBest = 0.0f;
+        for (const cv::Rect2f& b : boxes) {
+            bruteBest = std::max(bruteBest, iouOf(area, b));
+        }
+        TEST_CHECK(best == bruteBest, "n=%zu bestIou %.6f vs %.6f", boxes.size(), best, bruteBest);
+        TEST_CHECK(bestItem >= 0 ? iouOf(area, boxes[bestItem]) == best : best == 0.0f,
+                   "n=%zu bestIou item %d", boxes.size(), bestItem);
+
+        cv::Point2f point(area.x, area.y);
+        float maxDistance = 10.0f + size(rng) * 0.5f;
+        int nearestItem = grid.nearest(point, maxDistance);
+        float bruteSq = maxDistance * maxDistance;
+        int bruteItem = -1;
+        for (int i = 0; i < static_cast<int>(boxes.size()); ++i) {
+            const cv::Rect2f& b = boxes[i];
+            if (b.width <= 0.0f || b.height <= 0.0f) {
+                continue;
+            }
+            float dx = b.x + b.width * 0.5f - point.x;
+            float dy = b.y + b.height * 0.5f - point.y;
+            if (dx * dx + dy * dy < bruteSq) {
+                bruteSq = dx * dx + dy * dy;
+                bruteItem = i;
+            }
+        }
+        if (bruteItem < 0 || nearestItem < 0) {
+            TEST_CHECK(bruteItem == nearestItem, "n=%zu nearest %d vs %d", boxes.size(), nearestItem, bruteItem);
+        } else {
+            const cv::Rect2f& b = boxes[nearestItem];
+            float dx = b.x + b.width * 0.5f - point.x;
+            float dy = b.y + b.height * 0.5f - point.y;
+            TEST_CHECK(dx * dx + dy * dy == bruteSq, "n=%zu nearest distance differs", boxes.size());
+        }
+    }
+
+    for (int i = 0; i < static_cast<int>(boxes.size()); ++i) {
+        float got = grid.maxOverlapOn(i);
+        float expected = bruteOverlapOn(boxes, i);
+        TEST_CHECK(got == expected, "n=%zu maxOverlapOn(%d) %.6f vs %.6f", boxes.size(), i, got, expected);
+    }
+}
+
+void benchmark() {
+    std::mt19937 rng(320);
+    SpatialGrid grid;
+    std::vector<float> ratios;
+    const int counts[] = {10, 50, 200};
+    for (int n : counts) {
+        std::vector<cv::Rect2f> boxes = randomScene(rng, n);
+        ratios.resize(n);
+        int iterations = n <= 50 ? 5000 : 500;
+        double gridUs = bench_us(iterations, [&] {
+            grid.reset(kWidth, kHeight, kCellSize);
+            for (const cv::Rect2f& box : boxes) {
+                grid.insert(box);
+            }
+            for (int i = 0; i < n; ++i) {
+                ratios[i] = grid.maxOverlapOn(i);
+            }
+        });
+        double bruteUs = bench_us(iterations, [&] {
+            for (int i = 0; i < n; ++i) {
+                ratios[i] = bruteOverlapOn(boxes, i);
+            }
+        });
+        std::vector<int> hits;
+        double queryUs = bench_us(iterations * 4, [&] { grid.query(boxes[n / 2], hits); });
+        std::printf("boxes=%3d occlusion pass: grid %8.2f us  all-pairs %8.2f us  | one query %.3f us\n", n,
+                    gridUs, bruteUs, queryUs);
+    }
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 rng(32);
+    SpatialGrid grid;
+    const int counts[] = {0, 1, 5, 16, 17, 40, 120, 300};
+    for (int n : counts) {
+        for (int scene = 0; scene < 8; ++scene) {
+            checkScene(rng, grid, randomScene(rng, n));
+        }
+    }
+    benchmark();
+    return test_finish("test_spatial_grid");
+}
@@ -0,0 +1,352 @@
+// TrackFusionAccumulator against the per-job fusion it replaced, which
+// re-aligned every history frame with cv::phaseCorrelate against the
+// reference and warped whole ROIs: a track of sub-pixel shifted, noisy
+// frames is fused job by job through one accumulator (so anchors and cached
+// shifts carry over) and through the former path, plus the cost of both.
+
+#include "track_fusion.h"
+#include "quality_metrics.h"
+#include "simd_kernels.h"
+#include "test_util.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr float kMaxShiftRatio = 0.25f;
+constexpr float kMinSimilarity = 0.28f;
+constexpr int kRoiWidth = 320;
+constexpr int kRoiHeight = 400;
+constexpr int kTrackFrames = 14;
+constexpr int kOccludedFrame = 6;   // black occluder over the face, rejected on similarity
+constexpr int kDefocusedFrame = 9;  // dropped by the focus filter
+
+cv::Rect clampRectToSize(const cv::Rect& rect, const cv::Size& bounds) {
+    int x = std::max(0, std::min(rect.x, bounds.width - 1));
+    int y = std::max(0, std::min(rect.y, bounds.height - 1));
+    int width = std::max(1, std::min(rect.width, bounds.width - x));
+    int height = std::max(1, std::min(rect.height, bounds.height - y));
+    return cv::Rect(x, y, width, height);
+}
+
+cv::Rect expandRectFromCenter(const cv::Rect& rect, float scale, const cv::Size& bounds) {
+    float cx = rect.x + rect.width * 0.5f;
+    float cy = rect.y + rect.height * 0.5f;
+    float width = rect.width * scale;
+    float height = rect.height * scale;
+    cv::Rect expanded(static_cast<int>(std::round(cx - width * 0.5f)),
+                      static_cast<int>(std::round(cy - height * 0.5f)),
+                      static_cast<int>(std::round(width)),
+                      static_cast<int>(std::round(height)));
+    return clampRectToSize(expanded, bounds);
+}
+
+double focusVariance(const cv::Mat& gray) {
+    if (gray.empty() || gray.cols <= 1 || gray.rows <= 1) {
+        return 0.0;
+    }
+    QualityMetrics metrics;
+    compute_quality_metrics(gray, metrics);
+    return metrics.laplacianVar;
+}
+
+// Former fuseTrackHistoryPersonRoi of camera_task.cpp, without its unused
+// low-light and motion parameters.
+TrackFusionResult fuseLegacy(const cv::Mat& reference, const std::vector<cv::Mat>& history,
+                             const cv::Rect& focusBox, const cv::Rect& outputRegion) {
+    TrackFusionResult result;
+    if (reference.empty() || history.empty() || focusBox.width < 16 || focusBox.height < 16) {
+        return result;
+    }
+
+    cv::Rect safeFocus = expandRectFromCenter(focusBox, 1.45f, reference.size());
+    cv::Mat referenceGray;
+    cv::cvtColor(reference, referenceGray, cv::COLOR_BGR2GRAY);
+    result.referenceFocus = focusVariance(referenceGray(safeFocus));
+    result.bestAlignedFocus = result.referenceFocus;
+
+    struct FrameEntry {
+        cv::Mat frame;
+        double focus;
+    };
+    std::vector<FrameEntry> candidates;
+    candidates.push_back({reference.clone(), result.referenceFocus});
+
+    cv::Mat referenceFocusF;
+    referenceGray(safeFocus).convertTo(referenceFocusF, CV_32F);
+    cv::GaussianBlur(referenceFocusF, referenceFocusF, cv::Size(0, 0), 0.8);
+
+    float similaritySum = 0.0f;
+    int similarityCount = 0;
+    size_t begin = history.size() > kTrackFusionHistorySize ? history.size() - kTrackFusionHistorySize : 0;
+    for (size_t i = begin; i < history.size(); ++i) {
+        cv::Mat candidateGray;
+        cv::cvtColor(history[i], candidateGray, cv::COLOR_BGR2GRAY);
+        cv::Mat candidateFocusF;
+        candidateGray(safeFocus).convertTo(candidateFocusF, CV_32F);
+        cv::GaussianBlur(candidateFocusF, candidateFocusF, cv::Size(0, 0), 0.8);
+
+        cv::Point2d shift = cv::phaseCorrelate(referenceFocusF, candidateFocusF);
+        float shiftNorm = std::sqrt(static_cast<float>(shift.x * shift.x + shift.y * shift.y));
+        float maxShift = std::max(4.0f, std::min(safeFocus.width, safeFocus.height) * kMaxShiftRatio);
+        if (shiftNorm > maxShift) {
+            continue;
+        }
+
+        cv::Mat transform = (cv::Mat_<double>(2, 3) << 1.0, 0.0, shift.x, 0.0, 1.0, shift.y);
+        cv::Mat aligned;
+        cv::warpAffine(history[i], aligned, transform, reference.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+
+        cv::Mat alignedGray, diff, diffF;
+        cv::cvtColor(aligned, alignedGray, cv::COLOR_BGR2GRAY);
+        cv::absdiff(alignedGray, referenceGray, diff);
+        diff.convertTo(diffF, CV_32F);
+        cv::Mat similarity = 1.0f - (diffF - 14.0f) / 62.0f;
+        cv::max(similarity, 0.0f, similarity);
+        cv::min(similarity, 1.0f, similarity);
+        float meanSimilarity = static_cast<float>(cv::mean(similarity(safeFocus))[0]);
+        if (meanSimilarity < kMinSimilarity) {
+            continue;
+        }
+
+        double alignedFocus = focusVariance(alignedGray(safeFocus));
+        candidates.push_back({std::move(aligned), alignedFocus});
+        result.bestAlignedFocus = std::max(result.bestAlignedFocus, alignedFocus);
+        similaritySum += meanSimilarity;
+        similarityCount++;
+        result.acceptedFrames++;
+    }
+
+    if (result.acceptedFrames <= 0) {
+        result.acceptedFrames = 1;
+        return result;
+    }
+    result.meanSimilarity = similarityCount > 0 ? similaritySum / similarityCount : 0.0f;
+
+    double bestFocus = 0.0;
+    for (const auto& entry : candidates) {
+        bestFocus = std::max(bestFocus, entry.focus);
+    }
+    std::vector<cv::Mat> goodFrames;
+    for (auto& entry : candidates) {
+        if (entry.focus >= bestFocus * 0.60) {
+            goodFrames.push_back(std::move(entry.frame));
+        }
+    }
+    if (goodFrames.empty()) {
+        return result;
+    }
+    result.fused = goodFrames[0].clone();
+    cv::Rect region = outputRegion & cv::Rect(0, 0, reference.cols, reference.rows);
+    if (goodFrames.size() <= 2 || region.empty()) {
+        return result;
+    }
+
+    int n = std::min(static_cast<int>(goodFrames.size()), kSimdMedianMaxInputs);
+    const uint8_t* framePtrs[kSimdMedianMaxInputs];
+    for (int r = region.y; r < region.y + region.height; r++) {
+        for (int f = 0; f < n; f++) {
+            framePtrs[f] = goodFrames[f].ptr<uint8_t>(r) + region.x * 3;
+        }
+        simd_median_u8(framePtrs, n, result.fused.ptr<uint8_t>(r) + region.x * 3, region.width * 3);
+    }
+    return result;
+}
+
+// Face-like scene: smooth shading, blobs with soft edges and fine texture.
+cv::Mat makeScene(std::mt19937& rng, int width, int height) {
+    std::uniform_int_distribution<int> level(30, 225);
+    std::uniform_int_distribution<int> px(0, width - 1), py(0, height - 1), radius(4, 40);
+    cv::Mat scene(height, width, CV_8UC3, cv::Scalar(level(rng), level(rng), level(rng)));
+    for (int k = 0; k < 120; ++k) {
+        cv::circle(scene, cv::Point(px(rng), py(rng)), radius(rng), cv::Scalar(level(rng), level(rng), level(rng)), -1);
+    }
+    cv::Mat texture(height, width, CV_8UC3);
+    cv::randu(texture, cv::Scalar::all(0), cv::Scalar::all(40));
+    cv::GaussianBlur(texture, texture, cv::Size(0, 0), 1.2);
+    cv::add(scene, texture, scene);
+    cv::GaussianBlur(scene, scene, cv::Size(0, 0), 0.9);
+    return scene;
+}
+
+// The scene as seen by one frame: frame(x) = scene(x + offset), with noise.
+cv::Mat viewScene(const cv::Mat& scene, cv::Point2d offset, std::mt19937& rng) {
+    cv::Mat transform = (cv::Mat_<double>(2, 3) << 1.0, 0.0, offset.x, 0.0, 1.0, offset.y);
+    cv::Mat view;
+    cv::warpAffine(scene, view, transform, cv::Size(kRoiWidth, kRoiHeight), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP,
+                   cv::BORDER_REPLICATE);
+    cv::Mat noise(view.size(), CV_32FC3);
+    std::normal_distribution<float> sigma(3.0f, 0.5f);
+    cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(sigma(rng)));
+    cv::Mat noisy;
+    view.convertTo(noisy, CV_32FC3);
+    noisy += noise;
+    noisy.convertTo(view, CV_8UC3);
+    return view;
+}
+
+double meanAbsDiff(const cv::Mat& a, const cv::Mat& b) {
+    cv::Mat diff;
+    cv::absdiff(a, b, diff);
+    cv::Scalar m = cv::mean(diff);
+    return (m[0] + m[1] + m[2]) / 3.0;
+}
+
+struct Track {
+    std::vector<cv::Mat> frames;
+    std::vector<cv::Mat> clean;  // noise-free views, the fusion target
+};
+
+// A face drifting by about a pixel per frame, with one occluded and one
+// defocused frame.
+Track makeTrack(unsigned seed) {
+    std::mt19937 rng(seed);
+    cv::Mat scene = makeScene(rng, kRoiWidth + 80, kRoiHeight + 80);
+    std::uniform_real_distribution<double> jitter(-0.6, 0.6);
+    Track track;
+    cv::Point2d offset(40.0, 40.0);
+    for (int i = 0; i < kTrackFrames; ++i) {
+        offset += cv::Point2d(0.9 + jitter(rng), -0.5 + jitter(rng));
+        cv::Mat transform = (cv::Mat_<double>(2, 3) << 1.0, 0.0, offset.x, 0.0, 1.0, offset.y);
+        cv::Mat view;
+        cv::warpAffine(scene, view, transform, cv::Size(kRoiWidth, kRoiHeight),
+                       cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+        track.clean.push_back(view);
+        if (i == kOccludedFrame) {
+            cv::Mat occluded = viewScene(scene, offset, rng);
+            occluded(cv::Rect(60, 60, 200, 260)).setTo(cv::Scalar::all(0));
+            track.frames.push_back(occluded);
+        } else if (i == kDefocusedFrame) {
+            cv::Mat blurred = viewScene(scene, offset, rng);
+            cv::GaussianBlur(blurred, blurred, cv::Size(0, 0), 3.0);
+            track.frames.push_back(blurred);
+        } else {
+            track.frames.push_back(viewScene(scene, offset, rng));
+        }
+    }
+    return track;
+}
+
+const cv::Rect kFocusBox(110, 120, 100, 120);
+const cv::Rect kOutputRegion(80, 90, 160, 200);
+
+std::vector<TrackFusionFrame> historyOf(const Track& track, int job) {
+    std::vector<TrackFusionFrame> history;
+    for (int i = std::max(0, job - static_cast<int>(kTrackFusionHistorySize)); i < job; ++i) {
+        history.push_back({track.frames[i], static_cast<uint64_t>(i + 1), FrameHandle()});
+    }
+    return history;
+}
+
+std::vector<cv::Mat> legacyHistoryOf(const Track& track, int job) {
+    std::vector<cv::Mat> history;
+    for (int i = std::max(0, job - static_cast<int>(kTrackFusionHistorySize)); i < job; ++i) {
+        history.push_back(track.frames[i]);
+    }
+    return history;
+}
+
+// The two paths take the same frames, but the former registration (no
+// window, no mean removal) drifts on smooth texture, so the fused pixels are
+// compared with the noise-free view rather than with each other.
+void testAgainstLegacy() {
+    double referenceError = 0.0, legacyError = 0.0, fusedError = 0.0, freshError = 0.0;
+    int jobs = 0;
+    for (unsigned seed = 1; seed <= 6; ++seed) {
+        Track track = makeTrack(seed);
+        TrackFusionAccumulator accumulator;
+        for (int job = 1; job < kTrackFrames; ++job) {
+            const cv::Mat& ref = track.frames[job];
+            TrackFusionResult legacy = fuseLegacy(ref, legacyHistoryOf(track, job), kFocusBox, kOutputRegion);
+            TrackFusionFrame reference{ref, static_cast<uint64_t>(job + 1), FrameHandle()};
+            TrackFusionResult fused = accumulator.fuse(reference, historyOf(track, job), kFocusBox, kOutputRegion);
+
+            // Same job through an accumulator with nothing cached.
+            TrackFusionAccumulator fresh;
+            TrackFusionResult uncached = fresh.fuse(reference, historyOf(track, job), kFocusBox, kOutputRegion);
+
+            TEST_CHECK(fused.acceptedFrames == legacy.acceptedFrames, "seed %u job %d: accepted %d vs %d", seed, job,
+                       fused.acceptedFrames, legacy.acceptedFrames);
+            TEST_CHECK(fused.referenceFocus == legacy.referenceFocus, "seed %u job %d: reference focus %.3f vs %.3f",
+                       seed, job, fused.referenceFocus, legacy.referenceFocus);
+            TEST_CHECK(std::fabs(fused.meanSimilarity - legacy.meanSimilarity) < 0.1f,
+                       "seed %u job %d: similarity %.4f vs %.4f", seed, job, fused.meanSimilarity,
+                       legacy.meanSimilarity);
+            TEST_CHECK(fused.fused.empty() == legacy.fused.empty(), "seed %u job %d: fused presence", seed, job);
+            TEST_CHECK(uncached.acceptedFrames == fused.acceptedFrames && uncached.fused.empty() == fused.fused.empty(),
+                       "seed %u job %d: cached accepted %d vs %d", seed, job, fused.acceptedFrames,
+                       uncached.acceptedFrames);
+            if (fused.fused.empty() || legacy.fused.empty() || uncached.fused.empty()) {
+                continue;
+            }
+
+            // Outside the region read back both paths return the reference,
+            // unless it lost the focus filter to a history frame.
+            if (job != kDefocusedFrame) {
+                cv::Mat outside = cv::Mat::ones(ref.size(), CV_8U);
+                outside(kOutputRegion).setTo(0);
+                TEST_CHECK(cv::norm(fused.fused, ref, cv::NORM_INF, outside) == 0.0,
+                           "seed %u job %d: outside differs", seed, job);
+            }
+
+            cv::Mat clean = track.clean[job](kOutputRegion);
+            double errReference = meanAbsDiff(ref(kOutputRegion), clean);
+            double errFused = meanAbsDiff(fused.fused(kOutputRegion), clean);
+            TEST_CHECK(errFused <= errReference + 1.5, "seed %u job %d: fused error %.3f, reference %.3f", seed, job,
+                       errFused, errReference);
+            referenceError += errReference;
+            legacyError += meanAbsDiff(legacy.fused(kOutputRegion), clean);
+            fusedError += errFused;
+            freshError += meanAbsDiff(uncached.fused(kOutputRegion), clean);
+            ++jobs;
+        }
+    }
+    TEST_CHECK(jobs > 0, "no job fused");
+    if (jobs == 0) {
+        return;
+    }
+    referenceError /= jobs;
+    legacyError /= jobs;
+    fusedError /= jobs;
+    freshError /= jobs;
+    std::printf("%d jobs, error to clean view: reference %.3f  legacy %.3f  accumulator %.3f  fresh %.3f\n", jobs,
+                referenceError, legacyError, fusedError, freshError);
+    TEST_CHECK(fusedError <= legacyError, "accumulator error %.3f above legacy %.3f", fusedError, legacyError);
+    TEST_CHECK(fusedError <= referenceError, "accumulator error %.3f above reference %.3f", fusedError,
+               referenceError);
+    TEST_CHECK(fusedError <= freshError * 1.05, "cached shifts cost accuracy: %.3f vs %.3f", fusedError, freshError);
+}
+
+void benchmark() {
+    Track track = makeTrack(42);
+    // Whole track, one job per frame: the accumulator keeps its anchor and
+    // shifts across jobs, so it aligns one new frame per job.
+    double legacyUs = bench_us(5, [&] {
+        for (int job = 1; job < kTrackFrames; ++job) {
+            fuseLegacy(track.frames[job], legacyHistoryOf(track, job), kFocusBox, kOutputRegion);
+        }
+    });
+    double accumulatorUs = bench_us(5, [&] {
+        TrackFusionAccumulator accumulator;
+        for (int job = 1; job < kTrackFrames; ++job) {
+            TrackFusionFrame reference{track.frames[job], static_cast<uint64_t>(job + 1), FrameHandle()};
+            accumulator.fuse(reference, historyOf(track, job), kFocusBox, kOutputRegion);
+        }
+    });
+    std::printf("%dx%d ROI, %zu history frames: legacy %.0f us  accumulator %.0f us per job\n", kRoiWidth, kRoiHeight,
+                kTrackFusionHistorySize, legacyUs / (kTrackFrames - 1), accumulatorUs / (kTrackFrames - 1));
+}
+
+}  // namespace
+
+int main() {
+    testAgainstLegacy();
+    benchmark();
+    return test_finish("test_track_fusion");
+}
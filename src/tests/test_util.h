@@ -0,0 +1,44 @@
+#pragma once
+
+// Shared helpers of the kernel tests. Each test is a standalone executable
+// registered with ctest: checks print the failing expression and the test
+// exits non-zero when any check failed. Benchmarks only print their timings.
+
+#include <chrono>
+#include <cstdio>
+
+inline int& test_failure_count() {
+    static int failures = 0;
+    return failures;
+}
+
+#define TEST_CHECK(cond, ...)                                                      \
+    do {                                                                           \
+        if (!(cond)) {                                                             \
+            std::fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+            std::fprintf(stderr, __VA_ARGS__);                                     \
+            std::fputc('\n', stderr);                                              \
+            ++test_failure_count();                                                \
+        }                                                                          \
+    } while (0)
+
+// Microseconds per call of fn, after one untimed warm-up call.
+template <typename Fn>
+double bench_us(int iterations, Fn&& fn) {
+    fn();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+inline int test_finish(const char* name) {
+    if (test_failure_count() > 0) {
+        std::printf("%s: %d check(s) failed\n", name, test_failure_count());
+        return 1;
+    }
+    std::printf("%s: ok\n", name);
+    return 0;
+}
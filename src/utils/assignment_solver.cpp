@@ -0,0 +1,233 @@
+#include "assignment_solver.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+void AssignmentSolver::reset(int rows, int cols) {
+    rowCount = std::max(0, rows);
+    colCount = std::max(0, cols);
+    edges.clear();
+}
+
+void AssignmentSolver::addEdge(int row, int col, float cost) {
+    if (row < 0 || row >= rowCount || col < 0 || col >= colCount) {
+        return;
+    }
+    edges.push_back({row, col, cost});
+}
+
+int AssignmentSolver::findRoot(int node) {
+    while (parent[node] != node) {
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+    return node;
+}
+
+void AssignmentSolver::solve(float maxCost, std::vector<std::pair<int, int>>& out) {
+    out.clear();
+
+    // Drop edges that can never be accepted; they only widen components.
+    edges.erase(std::remove_if(edges.begin(), edges.end(),
+                               [maxCost](const Edge& e) { return !(e.cost < maxCost); }),
+                edges.end());
+    if (edges.empty()) {
+        return;
+    }
+
+    const int nodeCount = rowCount + colCount;
+    parent.resize(nodeCount);
+    for (int i = 0; i < nodeCount; ++i) {
+        parent[i] = i;
+    }
+    for (const Edge& e : edges) {
+        int a = findRoot(e.row);
+        int b = findRoot(rowCount + e.col);
+        if (a != b) {
+            parent[b] = a;
+        }
+    }
+
+    // Per-component row/col counts and cheapest edge, indexed by root node.
+    // CSR adjacency is built in the same pass.
+    componentRows.assign(nodeCount, 0);
+    componentCols.assign(nodeCount, 0);
+    componentBestEdge.assign(nodeCount, -1);
+    rowComponent.assign(rowCount, -1);
+    rowEdgeStart.assign(rowCount + 1, 0);
+    std::vector<char>& colSeen = colDone;
+    colSeen.assign(colCount + rowCount, 0);
+    for (int i = 0; i < static_cast<int>(edges.size()); ++i) {
+        const Edge& e = edges[i];
+        int root = findRoot(e.row);
+        if (rowComponent[e.row] < 0) {
+            rowComponent[e.row] = root;
+            componentRows[root]++;
+        }
+        if (!colSeen[e.col]) {
+            colSeen[e.col] = 1;
+            componentCols[root]++;
+        }
+        int& best = componentBestEdge[root];
+        if (best < 0 || e.cost < edges[best].cost) {
+            best = i;
+        }
+        rowEdgeStart[e.row + 1]++;
+    }
+    for (int r = 0; r < rowCount; ++r) {
+        rowEdgeStart[r + 1] += rowEdgeStart[r];
+    }
+    adjCol.resize(edges.size());
+    adjCost.resize(edges.size());
+    touched.assign(rowEdgeStart.begin(), rowEdgeStart.end() - 1);
+    for (const Edge& e : edges) {
+        int slot = touched[e.row]++;
+        adjCol[slot] = e.col;
+        adjCost[slot] = e.cost;
+    }
+
+    const float INF = std::numeric_limits<float>::infinity();
+    const int totalCols = colCount + rowCount;
+    u.assign(rowCount, 0.0f);
+    v.assign(totalCols, 0.0f);
+    dist.assign(totalCols, INF);
+    predRow.assign(totalCols, -1);
+    colMatch.assign(totalCols, -1);
+    colDone.assign(totalCols, 0);
+    rowMatch.assign(rowCount, -1);
+    touched.clear();
+
+    // Dual start: u[r] = cheapest edge of row r, v = 0, so every reduced cost
+    // is non-negative. A row whose cheapest column is still free takes it
+    // right away (tight edge); in steady tracking that settles most rows and
+    // leaves only real conflicts for the augmenting-path search.
+    pendingRows.clear();
+    for (int r = 0; r < rowCount; ++r) {
+        int root = rowComponent[r];
+        if (root < 0) {
+            continue;
+        }
+        if (componentRows[root] == 1 || componentCols[root] == 1) {
+            // Star-shaped component: only one pair can be matched, so the
+            // cheapest edge is optimal. Emit it once per component.
+            int best = componentBestEdge[root];
+            if (best >= 0 && edges[best].row == r) {
+                out.push_back({edges[best].row, edges[best].col});
+            }
+            continue;
+        }
+
+        int bestSlot = rowEdgeStart[r];
+        for (int k = rowEdgeStart[r] + 1; k < rowEdgeStart[r + 1]; ++k) {
+            if (adjCost[k] < adjCost[bestSlot]) {
+                bestSlot = k;
+            }
+        }
+        u[r] = adjCost[bestSlot];
+        int c = adjCol[bestSlot];
+        if (colMatch[c] < 0) {
+            colMatch[c] = r;
+            rowMatch[r] = c;
+        } else {
+            pendingRows.push_back(r);
+        }
+    }
+
+    for (int r : pendingRows) {
+        augmentRow(r, maxCost);
+    }
+
+    for (int c = 0; c < colCount; ++c) {
+        if (colMatch[c] >= 0) {
+            out.push_back({colMatch[c], c});
+        }
+    }
+}
+
+void AssignmentSolver::augmentRow(int row, float maxCost) {
+    const float INF = std::numeric_limits<float>::infinity();
+    const auto heapOrder = std::greater<std::pair<float, int>>();
+    heap.clear();
+    finished.clear();
+
+    auto relax = [&](int r, float base) {
+        for (int k = rowEdgeStart[r]; k < rowEdgeStart[r + 1]; ++k) {
+            int c = adjCol[k];
+            if (colDone[c]) {
+                continue;
+            }
+            float nd = base + adjCost[k] - u[r] - v[c];
+            if (nd < dist[c]) {
+                if (dist[c] == INF) {
+                    touched.push_back(c);
+                }
+                dist[c] = nd;
+                predRow[c] = r;
+                heap.push_back({nd, c});
+                std::push_heap(heap.begin(), heap.end(), heapOrder);
+            }
+        }
+        int dummy = colCount + r;
+        float nd = base + maxCost - u[r] - v[dummy];
+        if (!colDone[dummy] && nd < dist[dummy]) {
+            if (dist[dummy] == INF) {
+                touched.push_back(dummy);
+            }
+            dist[dummy] = nd;
+            predRow[dummy] = r;
+            heap.push_back({nd, dummy});
+            std::push_heap(heap.begin(), heap.end(), heapOrder);
+        }
+    };
+
+    relax(row, 0.0f);
+    int sink = -1;
+    float dmin = 0.0f;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heapOrder);
+        std::pair<float, int> top = heap.back();
+        heap.pop_back();
+        int c = top.second;
+        if (colDone[c] || top.first > dist[c]) {
+            continue;
+        }
+        colDone[c] = 1;
+        if (colMatch[c] < 0) {
+            sink = c;
+            dmin = top.first;
+            break;
+        }
+        finished.push_back(c);
+        relax(colMatch[c], top.first);
+    }
+
+    if (sink >= 0) {
+        // Only nodes settled before the sink move their potentials; shifting
+        // every other node by the same constant would not change reduced costs.
+        u[row] += dmin;
+        for (int c : finished) {
+            float shift = dmin - dist[c];
+            v[c] -= shift;
+            u[colMatch[c]] += shift;
+        }
+
+        int c = sink;
+        while (true) {
+            int r = predRow[c];
+            int next = rowMatch[r];
+            colMatch[c] = r;
+            rowMatch[r] = c;
+            if (r == row) {
+                break;
+            }
+            c = next;
+        }
+    }
+
+    for (int c : touched) {
+        dist[c] = INF;
+        colDone[c] = 0;
+    }
+    touched.clear();
+}
@@ -0,0 +1,103 @@
+#include "box_kalman.h"
+
+BoxKalmanBank::BoxKalmanBank(const BoxKalmanNoise& noise, BoxKalmanModel model) : noise(noise), model(model) {}
+
+int BoxKalmanBank::allocate(const float box[kAxes]) {
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<int>(inUse.size());
+        inUse.push_back(0);
+        for (int a = 0; a < kAxes; ++a) {
+            pos[a].push_back(0.0f);
+            vel[a].push_back(0.0f);
+            p00[a].push_back(0.0f);
+            p01[a].push_back(0.0f);
+            p11[a].push_back(0.0f);
+        }
+    }
+
+    inUse[slot] = 1;
+    for (int a = 0; a < kAxes; ++a) {
+        pos[a][slot] = box[a];
+        vel[a][slot] = 0.0f;
+        p00[a][slot] = noise.p0Pos;
+        p01[a][slot] = 0.0f;
+        p11[a][slot] = noise.p0Vel;
+    }
+    return slot;
+}
+
+void BoxKalmanBank::release(int slot) {
+    if (slot < 0 || slot >= static_cast<int>(inUse.size()) || !inUse[slot]) {
+        return;
+    }
+    inUse[slot] = 0;
+    freeSlots.push_back(slot);
+}
+
+void BoxKalmanBank::clear() {
+    inUse.clear();
+    freeSlots.clear();
+    for (int a = 0; a < kAxes; ++a) {
+        pos[a].clear();
+        vel[a].clear();
+        p00[a].clear();
+        p01[a].clear();
+        p11[a].clear();
+    }
+}
+
+void BoxKalmanBank::predictAll(float dt) {
+    // x' = x + dt*v
+    // P' = F P F^T + dt*Q  ->  p00 += 2dt*p01 + dt^2*p11 + qp*dt
+    //                          p01 += dt*p11
+    //                          p11 += qv*dt
+    const int n = static_cast<int>(inUse.size());
+    const float dt2 = dt * dt;
+    for (int a = 0; a < kAxes; ++a) {
+        const float qp = noise.qPos[a] * dt;
+        const float qv = noise.qVel[a] * dt;
+        float* __restrict x = pos[a].data();
+        const float* __restrict v = vel[a].data();
+        float* __restrict c00 = p00[a].data();
+        float* __restrict c01 = p01[a].data();
+        float* __restrict c11 = p11[a].data();
+        for (int i = 0; i < n; ++i) {
+            x[i] += dt * v[i];
+            c00[i] += 2.0f * dt * c01[i] + dt2 * c11[i] + qp;
+            c01[i] += dt * c11[i];
+            c11[i] += qv;
+        }
+    }
+}
+
+void BoxKalmanBank::correct(int slot, const float z[kAxes]) {
+    // S = p00 + r, K = [p00, p01] / S, P' = (I - K H) P.
+    // Anchored slots keep a zero velocity, so predictAll leaves them in place too.
+    const bool moveMean = model == BOX_KALMAN_CONSTANT_VELOCITY;
+    for (int a = 0; a < kAxes; ++a) {
+        float s = p00[a][slot] + noise.r[a];
+        float k0 = p00[a][slot] / s;
+        float k1 = p01[a][slot] / s;
+        if (moveMean) {
+            float innovation = z[a] - pos[a][slot];
+            pos[a][slot] += k0 * innovation;
+            vel[a][slot] += k1 * innovation;
+        }
+
+        float c00 = p00[a][slot];
+        float c01 = p01[a][slot];
+        p00[a][slot] = c00 - k0 * c00;
+        p01[a][slot] = c01 - k0 * c01;
+        p11[a][slot] -= k1 * c01;
+    }
+}
+
+void BoxKalmanBank::position(int slot, float box[kAxes]) const {
+    for (int a = 0; a < kAxes; ++a) {
+        box[a] = pos[a][slot];
+    }
+}
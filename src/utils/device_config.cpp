@@ -86,7 +86,8 @@ static json buildDefaultJson(const DeviceConfig& cfg) {
     j["upload"] = {
         {"server", cfg.uploadServer},
         {"image_path", cfg.uploadImagePath},
-        {"manual_image_path", cfg.uploadManualImagePath}
+        {"manual_image_path", cfg.uploadManualImagePath},
+        {"face_enhance_budget_ms", cfg.uploadFaceEnhanceBudgetMs}
     };
     j["tcp"] = {
         {"server_ip", cfg.tcpServerIp},
@@ -103,6 +104,9 @@ static json buildDefaultJson(const DeviceConfig& cfg) {
         {"face_detect_interval", cfg.captureDefaults.faceDetectInterval},
         {"face_input_max_width", cfg.captureDefaults.faceInputMaxWidth},
         {"max_frame_candidates", cfg.captureDefaults.maxFrameCandidates},
+        {"candidate_memory_budget_mb", cfg.captureDefaults.candidateMemoryBudgetMb},
+        {"candidate_compress_below_top", cfg.captureDefaults.candidateCompressBelowTop},
+        {"candidate_raw_top", cfg.captureDefaults.candidateRawTop},
         {"candidate_queue_max", cfg.captureDefaults.candidateQueueMax},
         {"candidate_per_track_max_pending", cfg.captureDefaults.candidatePerTrackMaxPending},
         {"person_context_expand_x", configFloat(cfg.captureDefaults.personContextExpandX)},
@@ -148,6 +152,14 @@ static json buildDefaultJson(const DeviceConfig& cfg) {
         {"max_blur_severity", configFloat(cfg.captureDefaults.maxBlurSeverity)},
         {"fallback_max_blur_severity", configFloat(cfg.captureDefaults.fallbackMaxBlurSeverity)},
         {"blur_severity_score_penalty", configFloat(cfg.captureDefaults.blurSeverityScorePenalty)},
+        {"prescreen_min_head_sharpness", configFloat(cfg.captureDefaults.prescreenMinHeadSharpness)},
+        {"prescreen_min_head_contrast", configFloat(cfg.captureDefaults.prescreenMinHeadContrast)},
+        {"prescreen_relative_sharpness", configFloat(cfg.captureDefaults.prescreenRelativeSharpness)},
+        {"early_finalize_enabled", cfg.captureDefaults.earlyFinalizeEnabled},
+        {"early_finalize_min_clarity", configFloat(cfg.captureDefaults.earlyFinalizeMinClarity)},
+        {"early_finalize_max_yaw", configFloat(cfg.captureDefaults.earlyFinalizeMaxYaw)},
+        {"early_finalize_min_face_short_side", cfg.captureDefaults.earlyFinalizeMinFaceShortSide},
+        {"frame_pool_size", cfg.captureDefaults.framePoolSize},
         {"brightness_sample_interval", cfg.captureDefaults.brightnessSampleInterval},
         {"brightness_white_threshold", configFloat(cfg.captureDefaults.brightnessWhiteThreshold)},
         {"brightness_black_threshold", configFloat(cfg.captureDefaults.brightnessBlackThreshold)}
@@ -185,6 +197,9 @@ static void loadFromJson(DeviceConfig* cfg, const json& j) {
         if (j["upload"].contains("manual_image_path")) {
             cfg->uploadManualImagePath = j["upload"]["manual_image_path"].get<std::string>();
         }
+        if (j["upload"].contains("face_enhance_budget_ms")) {
+            cfg->uploadFaceEnhanceBudgetMs = std::max(0, j["upload"]["face_enhance_budget_ms"].get<int>());
+        }
     }
 
     if (j.contains("tcp")) {
@@ -240,6 +255,9 @@ static void loadFromJson(DeviceConfig* cfg, const json& j) {
         loadInt("face_detect_interval", cfg->captureDefaults.faceDetectInterval);
         loadInt("face_input_max_width", cfg->captureDefaults.faceInputMaxWidth);
         loadInt("max_frame_candidates", cfg->captureDefaults.maxFrameCandidates);
+        loadInt("candidate_memory_budget_mb", cfg->captureDefaults.candidateMemoryBudgetMb);
+        loadBool("candidate_compress_below_top", cfg->captureDefaults.candidateCompressBelowTop);
+        loadInt("candidate_raw_top", cfg->captureDefaults.candidateRawTop);
         loadInt("candidate_queue_max", cfg->captureDefaults.candidateQueueMax);
         loadInt("candidate_per_track_max_pending", cfg->captureDefaults.candidatePerTrackMaxPending);
         loadFloat("person_context_expand_x", cfg->captureDefaults.personContextExpandX);
@@ -285,6 +303,14 @@ static void loadFromJson(DeviceConfig* cfg, const json& j) {
         loadFloat("max_blur_severity", cfg->captureDefaults.maxBlurSeverity);
         loadFloat("fallback_max_blur_severity", cfg->captureDefaults.fallbackMaxBlurSeverity);
         loadFloat("blur_severity_score_penalty", cfg->captureDefaults.blurSeverityScorePenalty);
+        loadDouble("prescreen_min_head_sharpness", cfg->captureDefaults.prescreenMinHeadSharpness);
+        loadDouble("prescreen_min_head_contrast", cfg->captureDefaults.prescreenMinHeadContrast);
+        loadFloat("prescreen_relative_sharpness", cfg->captureDefaults.prescreenRelativeSharpness);
+        loadBool("early_finalize_enabled", cfg->captureDefaults.earlyFinalizeEnabled);
+        loadDouble("early_finalize_min_clarity", cfg->captureDefaults.earlyFinalizeMinClarity);
+        loadFloat("early_finalize_max_yaw", cfg->captureDefaults.earlyFinalizeMaxYaw);
+        loadInt("early_finalize_min_face_short_side", cfg->captureDefaults.earlyFinalizeMinFaceShortSide);
+        loadInt("frame_pool_size", cfg->captureDefaults.framePoolSize);
         loadInt("brightness_sample_interval", cfg->captureDefaults.brightnessSampleInterval);
         loadDouble("brightness_white_threshold", cfg->captureDefaults.brightnessWhiteThreshold);
         loadDouble("brightness_black_threshold", cfg->captureDefaults.brightnessBlackThreshold);
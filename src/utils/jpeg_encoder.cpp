@@ -0,0 +1,403 @@
+#include "jpeg_encoder.h"
+extern "C" {
+#include "log.h"
+}
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
+#ifdef ENABLE_RK_VENC
+#include "rk_mpi_mb.h"
+#include "rk_mpi_sys.h"
+#include "rk_mpi_venc.h"
+#endif
+
+namespace {
+
+constexpr const char* kJpegBackendNames[JPEG_BACKEND_COUNT] = {"venc", "software"};
+
+class SoftwareJpegEncoder : public JpegEncoder {
+public:
+    JpegBackend backend() const override { return JPEG_BACKEND_SOFTWARE; }
+    bool supports(int, int) const override { return true; }
+
+    bool encodeBgr(const cv::Mat& bgr, int quality, std::vector<uchar>& out) override {
+        if (bgr.empty()) {
+            return false;
+        }
+        static thread_local std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, 0};
+        params[1] = quality;
+        return cv::imencode(".jpg", bgr, out, params);
+    }
+
+    bool encodeNv12(const cv::Mat& nv12, int quality, std::vector<uchar>& out) override {
+        if (nv12.empty() || nv12.type() != CV_8UC1 || nv12.rows % 3 != 0) {
+            return false;
+        }
+        static thread_local cv::Mat bgr;
+        cv::cvtColor(nv12, bgr, cv::COLOR_YUV2BGR_NV12);
+        return encodeBgr(bgr, quality, out);
+    }
+};
+
+#ifdef ENABLE_RK_VENC
+
+constexpr VENC_CHN kVencJpegChannel = 15;  // 避开录像等模块常用的低编号通道
+constexpr int kVencTimeoutMs = 200;
+constexpr int kVencMinSide = 16;
+constexpr int kVencMaxSide = 8192;
+
+inline int align16(int value) { return (value + 15) & ~15; }
+
+// Single VENC JPEG channel, reconfigured when the picture size or the
+// quality changes. Encodes are serialized: the channel holds one picture.
+class VencJpegEncoder : public JpegEncoder {
+public:
+    ~VencJpegEncoder() override {
+        destroyChannel();
+        if (inputBlk) {
+            RK_MPI_SYS_MmzFree(inputBlk);
+        }
+        if (sysReady) {
+            RK_MPI_SYS_Exit();
+        }
+    }
+
+    bool init() {
+        sysReady = RK_MPI_SYS_Init() == RK_SUCCESS;
+        if (!sysReady) {
+            log_warn("JpegEncoder: RK_MPI_SYS_Init failed, VENC disabled");
+        }
+        return sysReady;
+    }
+
+    JpegBackend backend() const override { return JPEG_BACKEND_VENC; }
+
+    // NV12 needs even sizes; odd ones go to the software encoder whole
+    // rather than losing their last row or column.
+    bool supports(int width, int height) const override {
+        return width >= kVencMinSide && height >= kVencMinSide &&
+               width <= kVencMaxSide && height <= kVencMaxSide &&
+               width % 2 == 0 && height % 2 == 0;
+    }
+
+    bool encodeBgr(const cv::Mat& bgr, int quality, std::vector<uchar>& out) override {
+        if (bgr.empty() || bgr.type() != CV_8UC3 || !supports(bgr.cols, bgr.rows)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!prepare(bgr.cols, bgr.rows, quality)) {
+            return false;
+        }
+        // NV12 is the VENC's native input; the conversion writes straight
+        // into the DMA buffer at the channel stride.
+        cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+        uchar* dst = static_cast<uchar*>(RK_MPI_MB_Handle2VirAddr(inputBlk));
+        copyPlanes(i420.ptr<uchar>(0), i420.ptr<uchar>(bgr.rows), i420.ptr<uchar>(bgr.rows) + bgr.cols * bgr.rows / 4,
+                   bgr.cols, bgr.rows, dst);
+        return encodeInput(bgr.cols, bgr.rows, out);
+    }
+
+    bool encodeNv12(const cv::Mat& nv12, int quality, std::vector<uchar>& out) override {
+        if (nv12.empty() || nv12.type() != CV_8UC1 || nv12.rows % 3 != 0) {
+            return false;
+        }
+        int width = nv12.cols;
+        int height = nv12.rows * 2 / 3;
+        if (!supports(width, height)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!prepare(width, height, quality)) {
+            return false;
+        }
+        uchar* dst = static_cast<uchar*>(RK_MPI_MB_Handle2VirAddr(inputBlk));
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(dst + y * virWidth, nv12.ptr<uchar>(y), width);
+        }
+        uchar* dst_uv = dst + virWidth * virHeight;
+        for (int y = 0; y < height / 2; ++y) {
+            std::memcpy(dst_uv + y * virWidth, nv12.ptr<uchar>(height + y), width);
+        }
+        return encodeInput(width, height, out);
+    }
+
+private:
+    // Y rows, then the U and V planes of I420 interleaved into NV12's UV rows.
+    void copyPlanes(const uchar* y_plane, const uchar* u_plane, const uchar* v_plane,
+                    int width, int height, uchar* dst) const {
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(dst + y * virWidth, y_plane + y * width, width);
+        }
+        uchar* dst_uv = dst + virWidth * virHeight;
+        int chroma_width = width / 2;
+        for (int y = 0; y < height / 2; ++y) {
+            const uchar* u_row = u_plane + y * chroma_width;
+            const uchar* v_row = v_plane + y * chroma_width;
+            uchar* uv_row = dst_uv + y * virWidth;
+            for (int x = 0; x < chroma_width; ++x) {
+                uv_row[2 * x] = u_row[x];
+                uv_row[2 * x + 1] = v_row[x];
+            }
+        }
+    }
+
+    bool prepare(int width, int height, int quality) {
+        if (!sysReady) {
+            return false;
+        }
+        if (!channelReady || width != picWidth || height != picHeight) {
+            if (!configureChannel(width, height)) {
+                return false;
+            }
+        }
+        quality = std::max(1, std::min(99, quality));
+        if (quality != channelQuality) {
+            VENC_JPEG_PARAM_S param;
+            std::memset(&param, 0, sizeof(param));
+            RK_MPI_VENC_GetJpegParam(kVencJpegChannel, &param);
+            param.u32Qfactor = static_cast<RK_U32>(quality);
+            if (RK_MPI_VENC_SetJpegParam(kVencJpegChannel, &param) != RK_SUCCESS) {
+                log_warn("JpegEncoder: VENC set quality %d failed", quality);
+                return false;
+            }
+            channelQuality = quality;
+        }
+
+        size_t input_bytes = static_cast<size_t>(virWidth) * virHeight * 3 / 2;
+        if (input_bytes > inputBytes) {
+            if (inputBlk) {
+                RK_MPI_SYS_MmzFree(inputBlk);
+                inputBlk = nullptr;
+                inputBytes = 0;
+            }
+            if (RK_MPI_SYS_MmzAlloc_Cached(&inputBlk, nullptr, nullptr, static_cast<RK_U32>(input_bytes)) != RK_SUCCESS) {
+                log_warn("JpegEncoder: VENC input buffer of %zu bytes unavailable", input_bytes);
+                inputBlk = nullptr;
+                return false;
+            }
+            inputBytes = input_bytes;
+        }
+        return true;
+    }
+
+    bool configureChannel(int width, int height) {
+        VENC_CHN_ATTR_S attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.stVencAttr.enType = RK_VIDEO_ID_JPEG;
+        attr.stVencAttr.enPixelFormat = RK_FMT_YUV420SP;
+        attr.stVencAttr.u32PicWidth = static_cast<RK_U32>(width);
+        attr.stVencAttr.u32PicHeight = static_cast<RK_U32>(height);
+        attr.stVencAttr.u32VirWidth = static_cast<RK_U32>(align16(width));
+        attr.stVencAttr.u32VirHeight = static_cast<RK_U32>(align16(height));
+        attr.stVencAttr.u32StreamBufCnt = 1;
+        attr.stVencAttr.u32BufSize = attr.stVencAttr.u32VirWidth * attr.stVencAttr.u32VirHeight * 3 / 2;
+        attr.stVencAttr.stAttrJpege.enReceiveMode = VENC_PIC_RECEIVE_SINGLE;
+
+        // 尺寸变化时优先在线修改属性，失败再重建通道
+        bool ok = channelReady && RK_MPI_VENC_SetChnAttr(kVencJpegChannel, &attr) == RK_SUCCESS;
+        if (!ok) {
+            destroyChannel();
+            if (RK_MPI_VENC_CreateChn(kVencJpegChannel, &attr) != RK_SUCCESS) {
+                log_warn("JpegEncoder: VENC channel %dx%d create failed", width, height);
+                return false;
+            }
+            VENC_RECV_PIC_PARAM_S recv;
+            std::memset(&recv, 0, sizeof(recv));
+            recv.s32RecvPicNum = -1;
+            if (RK_MPI_VENC_StartRecvFrame(kVencJpegChannel, &recv) != RK_SUCCESS) {
+                RK_MPI_VENC_DestroyChn(kVencJpegChannel);
+                log_warn("JpegEncoder: VENC channel start failed");
+                return false;
+            }
+            channelReady = true;
+            channelQuality = -1;
+        }
+        picWidth = width;
+        picHeight = height;
+        virWidth = align16(width);
+        virHeight = align16(height);
+        return true;
+    }
+
+    void destroyChannel() {
+        if (channelReady) {
+            RK_MPI_VENC_StopRecvFrame(kVencJpegChannel);
+            RK_MPI_VENC_DestroyChn(kVencJpegChannel);
+            channelReady = false;
+        }
+    }
+
+    bool encodeInput(int width, int height, std::vector<uchar>& out) {
+        RK_MPI_SYS_MmzFlushCache(inputBlk, RK_FALSE);
+
+        VIDEO_FRAME_INFO_S frame;
+        std::memset(&frame, 0, sizeof(frame));
+        frame.stVFrame.pMbBlk = inputBlk;
+        frame.stVFrame.u32Width = static_cast<RK_U32>(width);
+        frame.stVFrame.u32Height = static_cast<RK_U32>(height);
+        frame.stVFrame.u32VirWidth = static_cast<RK_U32>(virWidth);
+        frame.stVFrame.u32VirHeight = static_cast<RK_U32>(virHeight);
+        frame.stVFrame.enPixelFormat = RK_FMT_YUV420SP;
+        frame.stVFrame.enCompressMode = COMPRESS_MODE_NONE;
+        if (RK_MPI_VENC_SendFrame(kVencJpegChannel, &frame, kVencTimeoutMs) != RK_SUCCESS) {
+            log_warn("JpegEncoder: VENC send frame %dx%d failed", width, height);
+            return false;
+        }
+
+        VENC_PACK_S pack;
+        VENC_STREAM_S stream;
+        std::memset(&pack, 0, sizeof(pack));
+        std::memset(&stream, 0, sizeof(stream));
+        stream.pstPack = &pack;
+        if (RK_MPI_VENC_GetStream(kVencJpegChannel, &stream, kVencTimeoutMs) != RK_SUCCESS) {
+            log_warn("JpegEncoder: VENC get stream %dx%d failed", width, height);
+            // 丢弃通道内残留的输入，下一次编码重建通道
+            destroyChannel();
+            return false;
+        }
+        const uchar* data = static_cast<const uchar*>(RK_MPI_MB_Handle2VirAddr(pack.pMbBlk));
+        bool ok = data != nullptr && pack.u32Len > 0;
+        if (ok) {
+            out.assign(data + pack.u32Offset, data + pack.u32Offset + pack.u32Len);
+        }
+        RK_MPI_VENC_ReleaseStream(kVencJpegChannel, &stream);
+        return ok;
+    }
+
+    std::mutex mtx;
+    bool sysReady{false};
+    bool channelReady{false};
+    int picWidth{0};
+    int picHeight{0};
+    int virWidth{0};
+    int virHeight{0};
+    int channelQuality{-1};
+    MB_BLK inputBlk{nullptr};
+    size_t inputBytes{0};
+    cv::Mat i420;
+};
+
+#endif // ENABLE_RK_VENC
+
+struct JpegBackendCounter {
+    std::atomic<uint64_t> encodes{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> elapsedUs{0};
+};
+
+std::array<JpegBackendCounter, JPEG_BACKEND_COUNT> jpeg_counters;
+
+JpegEncoder& software_encoder() {
+    static SoftwareJpegEncoder encoder;
+    return encoder;
+}
+
+// Owned between jpeg_encoder_init and jpeg_encoder_shutdown. Encodes hold
+// their own reference, so the last one in flight releases the VENC.
+std::mutex hardware_mutex;
+int hardware_users = 0;
+std::shared_ptr<JpegEncoder> hardware;
+
+std::shared_ptr<JpegEncoder> hardware_encoder() {
+    std::lock_guard<std::mutex> lock(hardware_mutex);
+    return hardware;
+}
+
+template <typename Encode>
+bool timed_encode(JpegEncoder& encoder, std::vector<uchar>& out, Encode encode) {
+    auto start = std::chrono::steady_clock::now();
+    bool ok = encode(encoder);
+    JpegBackendCounter& counter = jpeg_counters[encoder.backend()];
+    if (!ok) {
+        counter.failures.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    counter.encodes.fetch_add(1, std::memory_order_relaxed);
+    counter.bytes.fetch_add(out.size(), std::memory_order_relaxed);
+    counter.elapsedUs.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+    return true;
+}
+
+template <typename Encode>
+bool encode_with_fallback(int width, int height, std::vector<uchar>& out, Encode encode) {
+    std::shared_ptr<JpegEncoder> hardware = hardware_encoder();
+    if (hardware && hardware->supports(width, height) && timed_encode(*hardware, out, encode)) {
+        return true;
+    }
+    return timed_encode(software_encoder(), out, encode);
+}
+
+}  // namespace
+
+std::unique_ptr<JpegEncoder> create_software_jpeg_encoder() {
+    return std::unique_ptr<JpegEncoder>(new SoftwareJpegEncoder());
+}
+
+std::unique_ptr<JpegEncoder> create_venc_jpeg_encoder() {
+#ifdef ENABLE_RK_VENC
+    std::unique_ptr<VencJpegEncoder> encoder(new VencJpegEncoder());
+    if (!encoder->init()) {
+        return nullptr;
+    }
+    log_info("JpegEncoder: VENC JPEG encoder ready");
+    return std::unique_ptr<JpegEncoder>(encoder.release());
+#else
+    return nullptr;
+#endif
+}
+
+void jpeg_encoder_init() {
+    std::lock_guard<std::mutex> lock(hardware_mutex);
+    if (hardware_users++ == 0) {
+        hardware = create_venc_jpeg_encoder();
+    }
+}
+
+void jpeg_encoder_shutdown() {
+    std::shared_ptr<JpegEncoder> released;
+    {
+        std::lock_guard<std::mutex> lock(hardware_mutex);
+        if (hardware_users == 0 || --hardware_users > 0) {
+            return;
+        }
+        released.swap(hardware);
+    }
+    if (released) {
+        log_info("JpegEncoder: VENC JPEG encoder released");
+    }
+}
+
+bool jpeg_encode_bgr(const cv::Mat& bgr, int quality, std::vector<uchar>& out) {
+    return encode_with_fallback(bgr.cols, bgr.rows, out, [&](JpegEncoder& encoder) {
+        return encoder.encodeBgr(bgr, quality, out);
+    });
+}
+
+bool jpeg_encode_nv12(const cv::Mat& nv12, int quality, std::vector<uchar>& out) {
+    return encode_with_fallback(nv12.cols, nv12.rows * 2 / 3, out, [&](JpegEncoder& encoder) {
+        return encoder.encodeNv12(nv12, quality, out);
+    });
+}
+
+std::vector<JpegEncodeStats> get_jpeg_encode_stats() {
+    std::vector<JpegEncodeStats> stats;
+    stats.reserve(JPEG_BACKEND_COUNT);
+    for (int i = 0; i < JPEG_BACKEND_COUNT; ++i) {
+        const JpegBackendCounter& counter = jpeg_counters[i];
+        stats.push_back({kJpegBackendNames[i],
+                         counter.encodes.load(std::memory_order_relaxed),
+                         counter.failures.load(std::memory_order_relaxed),
+                         counter.bytes.load(std::memory_order_relaxed),
+                         counter.elapsedUs.load(std::memory_order_relaxed)});
+    }
+    return stats;
+}
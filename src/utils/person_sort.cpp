@@ -3,10 +3,16 @@
 #include "main.h"
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
 #include <algorithm>
 #include <cmath>
 #include <cstdio>
-#include "tinyekf.h"
+#include "assignment_solver.h"
+#include "box_kalman.h"
+#include "appearance_descriptor.h"
+#include "spatial_grid.h"
+#include "simd_kernels.h"
+#include "jpeg_encoder.h"
 #include <functional>
 #include <mutex>
 #include <unordered_set>
@@ -18,10 +24,19 @@ static std::vector<Track> tracks;
 static int next_id = 1;
 static std::mutex tracks_mutex;
 static size_t g_max_frame_candidates = CAPTURE_MAX_FRAME_CANDIDATES;
+static size_t g_candidate_budget_bytes = static_cast<size_t>(CAPTURE_CANDIDATE_MEMORY_BUDGET_MB) * 1024 * 1024;
+static bool g_candidate_compress_below_top = CAPTURE_CANDIDATE_COMPRESS_BELOW_TOP != 0;
+static size_t g_candidate_raw_top = CAPTURE_CANDIDATE_RAW_TOP;
+static constexpr int CANDIDATE_JPEG_QUALITY = 92;
+// Bytes held by the frame candidates of all live tracks (tracks_mutex).
+static size_t candidate_raw_bytes = 0;
+static size_t candidate_jpeg_bytes = 0;
+static uint64_t candidate_evictions = 0;
+static uint64_t candidate_compressed = 0;
 
 struct PendingTrack {
     cv::Rect2f bbox;
-    cv::Mat hist;
+    AppearanceDescriptor appearance;
     float prop;
     int hits;
     int ttl;
@@ -30,14 +45,14 @@ struct PendingTrack {
 struct LostTrack {
     int id;
     cv::Rect2f bbox;
-    cv::Mat hist;
+    AppearanceDescriptor appearance;
     int ttl;
 };
 
 struct RecentCapture {
     int id;
     cv::Rect2f bbox;
-    cv::Mat hist;
+    AppearanceDescriptor appearance;
     int ttl;
 };
 
@@ -59,8 +74,83 @@ static constexpr float TRACK_BBOX_JITTER_ALPHA = 0.28f;
 static float g_capture_min_area_ratio = CAPTURE_MIN_AREA_RATIO;
 static float g_capture_near_area_ratio = CAPTURE_NEAR_AREA_RATIO;
 static float g_capture_max_person_occlusion = CAPTURE_MAX_PERSON_OCCLUSION;
+static constexpr float ASSIGN_MAX_COST = 0.65f;
+
+// Constant-velocity box model: position noise x/y 1.0, w/h 0.5; velocity
+// noise x/y 0.1, w/h 0.05 (per frame); measurement noise x/y 16, w/h 64.
+static const BoxKalmanNoise TRACK_KALMAN_NOISE = {
+    {1.0f, 1.0f, 0.5f, 0.5f},
+    {0.1f, 0.1f, 0.05f, 0.05f},
+    {16.0f, 16.0f, 64.0f, 64.0f},
+    1.0f,
+    10.0f,
+};
+static std::vector<uint32_t> slot_generations;  // never reset, so generations stay unique per slot
+static BoxKalmanBank kalman_bank(TRACK_KALMAN_NOISE, BOX_KALMAN_CONSTANT_VELOCITY);
+
+// Association scratch, reused across frames (guarded by tracks_mutex).
+static AssignmentSolver assignment_solver;
+static std::vector<std::pair<int,int>> assignment_pairs;
+static std::vector<cv::Rect2f> assign_det_rects;
+static std::vector<cv::Rect2f> assign_stable_bboxes;
+static std::vector<cv::Rect2f> assign_predicted_bboxes;
+static std::vector<AppearanceDescriptor> det_descriptors;
+
+// A track/detection pair that passed the geometric gate; its appearance term
+// is filled in per detection, in one batched distance row.
+struct AssignCandidate {
+    int track;
+    int det;
+    float geometry_cost;
+    float area_severity;
+    float center_cost;
+};
+static std::vector<AssignCandidate> assign_candidates;
+static std::vector<int> assign_det_offsets;       // det j's candidates: [offsets[j], offsets[j + 1])
+static std::vector<int> assign_det_cursors;
+static std::vector<int> assign_candidate_order;   // candidate indices grouped by detection
+static std::vector<const AppearanceDescriptor*> assign_track_appearances;
+static std::vector<float> assign_hist_row;
+
+// Detection rects as columns, so one track box is scored against every
+// detection with simd_iou_one_to_many.
+struct BoxColumns {
+    std::vector<float> x1, y1, x2, y2, area;
+
+    void resize(size_t n) {
+        x1.resize(n);
+        y1.resize(n);
+        x2.resize(n);
+        y2.resize(n);
+        area.resize(n);
+    }
 
-static Track create_track(const Detection& det, int id, bool already_captured = false);
+    void set(size_t i, const cv::Rect2f& r) {
+        x1[i] = r.x;
+        y1[i] = r.y;
+        x2[i] = r.x + r.width;
+        y2[i] = r.y + r.height;
+        area[i] = r.area();
+    }
+};
+static BoxColumns assign_det_columns;
+static std::vector<float> assign_iou_row;
+static std::vector<float> assign_iou_scratch;
+
+// Grids over track / lost / recent boxes. The lost and recent ones are
+// rebuilt lazily after their lists change; indices match list positions.
+static constexpr float GRID_CELL_SIZE = 64.0f;
+static SpatialGrid track_grid;
+static SpatialGrid lost_grid;
+static SpatialGrid recent_grid;
+static bool lost_grid_dirty = true;
+static bool recent_grid_dirty = true;
+static std::vector<int> grid_hits;
+
+static Track create_track(const Detection& det,
+                          const AppearanceDescriptor& appearance,
+                          int id,
+                          bool already_captured = false);
 
 static bool is_valid_bbox(const cv::Rect2f& bbox) {
     return bbox.width > 1.0f && bbox.height > 1.0f;
@@ -101,6 +191,15 @@ static cv::Rect2f blend_bbox(const cv::Rect2f& prev,
                                  height));
 }
 
+// Smoothing weight for a step of dt frames that matches `alpha` applied once
+// per frame, so box smoothing follows elapsed time rather than call count.
+static float alpha_for_dt(float alpha, float dt) {
+    if (dt == 1.0f) {
+        return alpha;
+    }
+    return 1.0f - std::pow(1.0f - alpha, std::max(0.0f, dt));
+}
+
 static void append_area_history(std::vector<float>& history, float area) {
     history.push_back(std::max(1.0f, area));
     if (history.size() > BBOX_HISTORY_LIMIT) {
@@ -115,21 +214,77 @@ static cv::Rect2f stable_track_bbox(const Track& t) {
     return clamp_bbox(t.bbox);
 }
 
+static float area_trend_ratio(const std::vector<float>& history) {
+    if (history.size() < 4) {
+        return 0.0f;
+    }
+
+    size_t span = std::min<size_t>(8, history.size() - 1);
+    float area_now = history.back();
+    float area_prev = history[history.size() - 1 - span];
+    return (area_now - area_prev) / (area_prev + 1e-6f);
+}
+
+// Caller must hold tracks_mutex. Reuses the caller's buffer capacity.
+static void publish_track_views(std::vector<TrackView>& views) {
+    views.clear();
+    views.reserve(tracks.size());
+    for (const auto& t : tracks) {
+        TrackView v;
+        v.id = t.id;
+        v.slot = t.kf_slot;
+        v.generation = t.generation;
+        v.bbox = t.bbox;
+        v.smoothed_bbox = t.smoothed_bbox;
+        v.last_det_bbox = t.last_det_bbox;
+        v.prop = t.prop;
+        v.hits = t.hits;
+        v.missed = t.missed;
+        v.confirmed = t.confirmed;
+        v.bbox_jitter = t.bbox_jitter;
+        v.area_trend_ratio = area_trend_ratio(t.bbox_history);
+        v.area_history_size = t.bbox_history.size();
+        v.is_approaching = t.is_approaching;
+        v.has_captured = t.has_captured;
+        views.push_back(v);
+    }
+}
+
+struct PendingUpload {
+    int trackId;
+    bool uploadPerson{false};
+    bool uploadFace{false};
+    Track::FrameData personFrame;
+    Track::FrameData faceFrame;
+    float faceOcclusion{0.0f};
+};
+
+// Early finalizations made on the candidate-eval thread, guarded by
+// tracks_mutex. The upload callback's state belongs to the tracking thread,
+// so sort_update dispatches them there with its own uploads.
+static std::vector<PendingUpload> early_uploads;
+
 void sort_init() { 
     std::unique_lock<std::mutex> lock(tracks_mutex);
     tracks.clear(); 
+    kalman_bank.clear();
+    candidate_raw_bytes = 0;
+    candidate_jpeg_bytes = 0;
     lost_tracks.clear();
     recent_captures.clear();
+    lost_grid_dirty = true;
+    recent_grid_dirty = true;
     pending_tracks.clear();
+    early_uploads.clear();
     next_id = 1; 
 }
 
 // 娣诲姞涓婁紶鍥炶皟鍑芥暟鎸囬拡
-static std::function<void(const cv::Mat&, int, const std::string&)> upload_callback = nullptr;
+static std::function<void(const cv::Mat&, int, const std::string&, const QualityMetrics*)> upload_callback = nullptr;
 static std::unordered_set<int>* captured_person_ids = nullptr;
 static std::unordered_set<int>* captured_face_ids = nullptr;
 
-void set_upload_callback(std::function<void(const cv::Mat&, int, const std::string&)> callback,
+void set_upload_callback(std::function<void(const cv::Mat&, int, const std::string&, const QualityMetrics*)> callback,
                         std::unordered_set<int>* person_ids, std::unordered_set<int>* face_ids) {
     upload_callback = callback;
     captured_person_ids = person_ids;
@@ -141,6 +296,13 @@ void set_max_frame_candidates(size_t maxFrameCandidates) {
     g_max_frame_candidates = std::max<size_t>(1, maxFrameCandidates);
 }
 
+void set_candidate_memory_budget(size_t budgetBytes, bool compressBelowTop, size_t rawTopCount) {
+    std::lock_guard<std::mutex> lock(tracks_mutex);
+    g_candidate_budget_bytes = budgetBytes;
+    g_candidate_compress_below_top = compressBelowTop;
+    g_candidate_raw_top = std::max<size_t>(1, rawTopCount);
+}
+
 void set_capture_sort_preferences(float minAreaRatio,
                                   float nearAreaRatio,
                                   float maxPersonOcclusion) {
@@ -179,24 +341,13 @@ static float iou(const cv::Rect2f& a, const cv::Rect2f& b) {
     return inter / (a.area() + b.area() - inter + 1e-6f);
 }
 
-static cv::Mat calc_hist(const cv::Mat& roi) {
-    cv::Mat hsv;
-    cv::cvtColor(roi, hsv, cv::COLOR_BGR2HSV);
-    int h_bins = 16;
-    int s_bins = 16;
-    int histSize[] = {h_bins, s_bins};
-    float h_ranges[] = {0,180};
-    float s_ranges[] = {0,256};
-    const float* ranges[] = {h_ranges, s_ranges};
-    int channels[] = {0,1};
-    cv::Mat hist;
-    cv::calcHist(&hsv, 1, channels, cv::Mat(), hist, 2, histSize, ranges);
-    cv::normalize(hist, hist, 0, 1, cv::NORM_MINMAX);
-    return hist;
-}
-
-static float hist_distance(const cv::Mat& a, const cv::Mat& b) {
-    return cv::compareHist(a, b, cv::HISTCMP_BHATTACHARYYA);
+// Appearance descriptors for every detection of this frame, computed once from
+// the 720p ROIs and shared by association, pending and id-reuse checks.
+static void compute_det_descriptors(const std::vector<Detection>& dets) {
+    det_descriptors.resize(dets.size());
+    for (size_t j = 0; j < dets.size(); j++) {
+        compute_appearance_descriptor(dets[j].roi, det_descriptors[j]);
+    }
 }
 
 static float center_distance_norm(const cv::Rect2f& a, const cv::Rect2f& b) {
@@ -225,26 +376,44 @@ static void age_lost_tracks() {
     for (auto& lt : lost_tracks) {
         lt.ttl--;
     }
+    size_t before = lost_tracks.size();
     lost_tracks.erase(
         std::remove_if(lost_tracks.begin(), lost_tracks.end(), [](const LostTrack& lt) {
             return lt.ttl <= 0;
         }),
         lost_tracks.end());
+    lost_grid_dirty |= lost_tracks.size() != before;
 }
 
 static void age_recent_captures() {
     for (auto& rc : recent_captures) {
         rc.ttl--;
     }
+    size_t before = recent_captures.size();
     recent_captures.erase(
         std::remove_if(recent_captures.begin(), recent_captures.end(), [](const RecentCapture& rc) {
             return rc.ttl <= 0;
         }),
         recent_captures.end());
+    recent_grid_dirty |= recent_captures.size() != before;
+}
+
+// Area that holds every box which overlaps `det_rect` or whose center lies
+// within `center_radius` (normalised like center_distance_norm) of it.
+static cv::Rect2f reuse_query_area(const cv::Rect2f& det_rect, float center_radius) {
+    float diag = std::sqrt((float)IMAGE_WIDTH * IMAGE_WIDTH + (float)IMAGE_HEIGHT * IMAGE_HEIGHT);
+    float r = center_radius * (diag + 1e-6f);
+    float cx = det_rect.x + det_rect.width * 0.5f;
+    float cy = det_rect.y + det_rect.height * 0.5f;
+    float x1 = std::min(det_rect.x, cx - r);
+    float y1 = std::min(det_rect.y, cy - r);
+    float x2 = std::max(det_rect.x + det_rect.width, cx + r);
+    float y2 = std::max(det_rect.y + det_rect.height, cy + r);
+    return cv::Rect2f(x1, y1, x2 - x1, y2 - y1);
 }
 
 static void cache_lost_track(const Track& t) {
-    if (!t.confirmed || t.hist.empty()) {
+    if (!t.confirmed || !t.appearance.valid) {
         return;
     }
 
@@ -257,13 +426,14 @@ static void cache_lost_track(const Track& t) {
     LostTrack lt;
     lt.id = t.id;
     lt.bbox = stable_track_bbox(t);
-    lt.hist = t.hist.clone();
+    lt.appearance = t.appearance;
     lt.ttl = LOST_TRACK_TTL;
     lost_tracks.push_back(std::move(lt));
+    lost_grid_dirty = true;
 }
 
 static void remember_recent_capture(const Track& t) {
-    if (!has_track_uploaded_asset(t.id) || t.hist.empty()) {
+    if (!has_track_uploaded_asset(t.id) || !t.appearance.valid) {
         return;
     }
 
@@ -276,28 +446,39 @@ static void remember_recent_capture(const Track& t) {
     RecentCapture rc;
     rc.id = t.id;
     rc.bbox = stable_track_bbox(t);
-    rc.hist = t.hist.clone();
+    rc.appearance = t.appearance;
     rc.ttl = RECENT_CAPTURE_TTL;
     recent_captures.push_back(std::move(rc));
+    recent_grid_dirty = true;
 }
 
-static int reuse_lost_track_id(const Detection& det, const cv::Mat& det_hist) {
-    if (lost_tracks.empty() || det_hist.empty()) {
+static int reuse_lost_track_id(const Detection& det, const AppearanceDescriptor& det_appearance) {
+    if (lost_tracks.empty() || !det_appearance.valid) {
         return -1;
     }
 
+    if (lost_grid_dirty) {
+        lost_grid.reset(IMAGE_WIDTH, IMAGE_HEIGHT, GRID_CELL_SIZE);
+        for (const auto& lt : lost_tracks) {
+            lost_grid.insert(lt.bbox);
+        }
+        lost_grid_dirty = false;
+    }
+
     cv::Rect2f det_rect(det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1);
     float best_score = -1.0f;
     int best_idx = -1;
 
-    for (int i = 0; i < static_cast<int>(lost_tracks.size()); ++i) {
+    // Entries outside this area fail the iou/center test below anyway.
+    lost_grid.query(reuse_query_area(det_rect, 0.15f), grid_hits);
+    for (int i : grid_hits) {
         const auto& lt = lost_tracks[i];
-        if (lt.hist.empty()) {
+        if (!lt.appearance.valid) {
             continue;
         }
 
         float iou_score = iou(lt.bbox, det_rect);
-        float hist_score = hist_distance(lt.hist, det_hist);
+        float hist_score = appearance_distance(lt.appearance, det_appearance);
         float center_dist = center_distance_norm(lt.bbox, det_rect);
         float center_score = 1.0f - std::min(1.0f, center_dist / 0.20f);
 
@@ -318,6 +499,7 @@ static int reuse_lost_track_id(const Detection& det, const cv::Mat& det_hist) {
     if (best_idx != -1 && best_score >= 0.55f) {
         int reused_id = lost_tracks[best_idx].id;
         lost_tracks.erase(lost_tracks.begin() + best_idx);
+        lost_grid_dirty = true;
         log_debug("Reuse lost track id: %d (score=%.3f)", reused_id, best_score);
         return reused_id;
     }
@@ -325,22 +507,31 @@ static int reuse_lost_track_id(const Detection& det, const cv::Mat& det_hist) {
     return -1;
 }
 
-static int reuse_recent_capture_id(const Detection& det, const cv::Mat& det_hist) {
-    if (recent_captures.empty() || det_hist.empty()) {
+static int reuse_recent_capture_id(const Detection& det, const AppearanceDescriptor& det_appearance) {
+    if (recent_captures.empty() || !det_appearance.valid) {
         return -1;
     }
 
+    if (recent_grid_dirty) {
+        recent_grid.reset(IMAGE_WIDTH, IMAGE_HEIGHT, GRID_CELL_SIZE);
+        for (const auto& rc : recent_captures) {
+            recent_grid.insert(rc.bbox);
+        }
+        recent_grid_dirty = false;
+    }
+
     cv::Rect2f det_rect(det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1);
     float best_score = -1.0f;
     int best_idx = -1;
 
-    for (int i = 0; i < static_cast<int>(recent_captures.size()); ++i) {
+    recent_grid.query(reuse_query_area(det_rect, 0.08f), grid_hits);
+    for (int i : grid_hits) {
         const auto& rc = recent_captures[i];
-        if (rc.hist.empty()) {
+        if (!rc.appearance.valid) {
             continue;
         }
 
-        float hist_score = hist_distance(rc.hist, det_hist);
+        float hist_score = appearance_distance(rc.appearance, det_appearance);
         float iou_score = iou(rc.bbox, det_rect);
         float center_dist = center_distance_norm(rc.bbox, det_rect);
         float center_score = 1.0f - std::min(1.0f, center_dist / 0.14f);
@@ -365,6 +556,7 @@ static int reuse_recent_capture_id(const Detection& det, const cv::Mat& det_hist
     if (best_idx != -1 && best_score >= 0.75f) {
         int reused_id = recent_captures[best_idx].id;
         recent_captures.erase(recent_captures.begin() + best_idx);
+        recent_grid_dirty = true;
         log_debug("Reuse recent captured id: %d (score=%.3f)", reused_id, best_score);
         return reused_id;
     }
@@ -372,8 +564,42 @@ static int reuse_recent_capture_id(const Detection& det, const cv::Mat& det_hist
     return -1;
 }
 
+static bool has_person_image(const Track::FrameData& frame) {
+    return !frame.person_roi.empty() || !frame.person_jpeg.empty();
+}
+
+static bool has_face_image(const Track::FrameData& frame) {
+    return !frame.face_roi.empty() || !frame.face_jpeg.empty();
+}
+
+// Raw image if present, otherwise decoded from the in-memory JPEG. Called
+// outside tracks_mutex on the frames picked for upload.
+static cv::Mat candidate_image(const cv::Mat& roi, const std::vector<uchar>& jpeg) {
+    if (!roi.empty() || jpeg.empty()) {
+        return roi;
+    }
+    return cv::imdecode(jpeg, cv::IMREAD_COLOR);
+}
+
+static size_t mat_bytes(const cv::Mat& m) {
+    return m.empty() ? 0 : m.total() * m.elemSize();
+}
+
+// Views into a pooled frame are not counted: the frame pool bounds them.
+static void account_candidate(const Track::FrameData& frame, bool add) {
+    size_t raw = frame.source ? 0 : mat_bytes(frame.person_roi) + mat_bytes(frame.face_roi);
+    size_t jpeg = frame.person_jpeg.size() + frame.face_jpeg.size();
+    if (add) {
+        candidate_raw_bytes += raw;
+        candidate_jpeg_bytes += jpeg;
+    } else {
+        candidate_raw_bytes -= std::min(candidate_raw_bytes, raw);
+        candidate_jpeg_bytes -= std::min(candidate_jpeg_bytes, jpeg);
+    }
+}
+
 static bool is_usable_face_frame(const Track::FrameData& frame) {
-    return frame.has_face && frame.face_pose_level >= 1 && !frame.face_roi.empty();
+    return frame.has_face && frame.face_pose_level >= 1 && has_face_image(frame);
 }
 
 static float frame_occlusion(const Track::FrameData& frame) {
@@ -504,10 +730,10 @@ static bool better_face_capture(const Track::FrameData& candidate,
 
 static bool better_person_capture(const Track::FrameData& candidate,
                                   const Track::FrameData& current) {
-    if (candidate.person_roi.empty()) {
+    if (!has_person_image(candidate)) {
         return false;
     }
-    if (current.person_roi.empty()) {
+    if (!has_person_image(current)) {
         return true;
     }
 
@@ -558,7 +784,7 @@ static size_t select_best_face_frame_index(const std::vector<Track::FrameData>&
 static size_t select_best_person_frame_index(const std::vector<Track::FrameData>& frames) {
     size_t best_index = SIZE_MAX;
     for (size_t i = 0; i < frames.size(); ++i) {
-        if (frames[i].person_roi.empty()) {
+        if (!has_person_image(frames[i])) {
             continue;
         }
         if (best_index == SIZE_MAX || better_person_capture(frames[i], frames[best_index])) {
@@ -568,18 +794,21 @@ static size_t select_best_person_frame_index(const std::vector<Track::FrameData>
     return best_index;
 }
 
+// track_grid must hold stable_track_bbox() of every entry in `tracks`.
 static bool should_suppress_new_track(const Detection& det) {
     cv::Rect2f det_rect(det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1);
 
     // Check against active tracks.
-    for (const auto& t : tracks) {
-        cv::Rect2f ref_bbox = stable_track_bbox(t);
-        float iou_score = iou(ref_bbox, det_rect);
-        float center_dist = center_distance_norm(ref_bbox, det_rect);
-        if (iou_score > 0.38f || center_dist < 0.05f) {
-            return true;
-        }
+    if (track_grid.bestIou(det_rect) > 0.38f) {
+        return true;
     }
+    float diag = std::sqrt((float)IMAGE_WIDTH * IMAGE_WIDTH + (float)IMAGE_HEIGHT * IMAGE_HEIGHT);
+    cv::Point2f det_center(det_rect.x + det_rect.width * 0.5f, det_rect.y + det_rect.height * 0.5f);
+    if (track_grid.nearest(det_center, 0.05f * (diag + 1e-6f)) >= 0) {
+        return true;
+    }
+    // Pending entries live a few frames and are rewritten by every update, so
+    // they are scanned directly.
     // Also check against pending tracks to avoid duplicate pending entries.
     for (const auto& pt : pending_tracks) {
         float iou_score = iou(pt.bbox, det_rect);
@@ -591,14 +820,14 @@ static bool should_suppress_new_track(const Detection& det) {
     return false;
 }
 
-static int update_pending_track(const Detection& det, const cv::Mat& det_hist) {
+static int update_pending_track(const Detection& det, const AppearanceDescriptor& det_appearance) {
     cv::Rect2f det_rect(det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1);
 
     int best_idx = -1;
     float best_score = -1.0f;
     for (int i = 0; i < static_cast<int>(pending_tracks.size()); ++i) {
         float iou_score = iou(pending_tracks[i].bbox, det_rect);
-        float hist_score = hist_distance(pending_tracks[i].hist, det_hist);
+        float hist_score = appearance_distance(pending_tracks[i].appearance, det_appearance);
         float center_dist = center_distance_norm(pending_tracks[i].bbox, det_rect);
         float center_score = 1.0f - std::min(1.0f, center_dist / 0.15f);
         float score = iou_score * 0.45f + (1.0f - hist_score) * 0.35f + center_score * 0.20f;
@@ -611,7 +840,7 @@ static int update_pending_track(const Detection& det, const cv::Mat& det_hist) {
     if (best_idx == -1) {
         PendingTrack pt;
         pt.bbox = det_rect;
-        pt.hist = det_hist.clone();
+        pt.appearance = det_appearance;
         pt.prop = det.prop;
         pt.hits = 1;
         pt.ttl = PENDING_TRACK_TTL;
@@ -621,20 +850,20 @@ static int update_pending_track(const Detection& det, const cv::Mat& det_hist) {
 
     auto& pt = pending_tracks[best_idx];
     pt.bbox = blend_bbox(pt.bbox, det_rect, 0.55f, 0.35f);
-    pt.hist = det_hist.clone();
+    pt.appearance = det_appearance;
     pt.prop = det.prop;
     pt.hits++;
     pt.ttl = PENDING_TRACK_TTL;
 
     if (pt.hits >= PENDING_TRACK_HITS_REQUIRED) {
-        int reused_id = reuse_lost_track_id(det, det_hist);
+        int reused_id = reuse_lost_track_id(det, det_appearance);
         if (reused_id <= 0) {
-            reused_id = reuse_recent_capture_id(det, det_hist);
+            reused_id = reuse_recent_capture_id(det, det_appearance);
         }
         int assigned_id = (reused_id > 0) ? reused_id : next_id++;
         bool already_captured = is_track_fully_captured(assigned_id);
 
-        tracks.push_back(create_track(det, assigned_id, already_captured));
+        tracks.push_back(create_track(det, det_appearance, assigned_id, already_captured));
         pending_tracks.erase(pending_tracks.begin() + best_idx);
         return assigned_id;
     }
@@ -643,202 +872,42 @@ static int update_pending_track(const Detection& det, const cv::Mat& det_hist) {
 }
 
 
-static std::vector<std::pair<int,int>> hungarian_algorithm(const std::vector<std::vector<float>>& cost_matrix, float max_cost) {
-    // Kuhn-Munkres (Hungarian) algorithm — O(n^3) globally optimal assignment.
-    // For n<10 (typical 1-5 persons) this runs in <0.1ms on ARM Cortex-A55.
-    int n = static_cast<int>(cost_matrix.size());
-    int m = n > 0 ? static_cast<int>(cost_matrix[0].size()) : 0;
-    if (n == 0 || m == 0) return {};
-
-    int sz = std::max(n, m);
-    std::vector<std::vector<float>> C(sz, std::vector<float>(sz, max_cost));
-    for (int i = 0; i < n; i++)
-        for (int j = 0; j < m; j++)
-            C[i][j] = cost_matrix[i][j];
-
-    const float INF = 1e9f;
-    std::vector<float> u(sz + 1, 0.0f), v(sz + 1, 0.0f);
-    std::vector<int> p(sz + 1, 0), way(sz + 1, 0);
-
-    for (int i = 1; i <= sz; i++) {
-        p[0] = i;
-        int j0 = 0;
-        std::vector<float> minv(sz + 1, INF);
-        std::vector<bool> used(sz + 1, false);
-        do {
-            used[j0] = true;
-            int i0 = p[j0], j1 = 0;
-            float delta = INF;
-            for (int j = 1; j <= sz; j++) {
-                if (!used[j]) {
-                    float cur = C[i0 - 1][j - 1] - u[i0] - v[j];
-                    if (cur < minv[j]) { minv[j] = cur; way[j] = j0; }
-                    if (minv[j] < delta) { delta = minv[j]; j1 = j; }
-                }
-            }
-            for (int j = 0; j <= sz; j++) {
-                if (used[j]) { u[p[j]] += delta; v[j] -= delta; }
-                else { minv[j] -= delta; }
-            }
-            j0 = j1;
-        } while (p[j0] != 0);
-        do { int j1 = way[j0]; p[j0] = p[j1]; j0 = j1; } while (j0);
-    }
-
-    std::vector<std::pair<int,int>> assignments;
-    for (int j = 1; j <= sz; j++) {
-        int i = p[j] - 1;
-        int col = j - 1;
-        if (i >= 0 && i < n && col >= 0 && col < m && cost_matrix[i][col] < max_cost) {
-            assignments.push_back({i, col});
-        }
-    }
-    return assignments;
-}
-
 //-----------------Track EKF鎿嶄綔-----------------
 
-static void predict_track(Track& t) {
-    // 鏀硅繘鐨?鐘舵€佽繍鍔ㄦā鍨? [x, y, w, h, vx, vy, vw, vh]
-    _float_t dt = 1.0f;  // 鏃堕棿姝ラ暱
-    _float_t F[EKF_N*EKF_N] = {
-        1,0,0,0,dt, 0, 0, 0,  // x = x + vx*dt
-        0,1,0,0, 0,dt, 0, 0,  // y = y + vy*dt  
-        0,0,1,0, 0, 0,dt, 0,  // w = w + vw*dt
-        0,0,0,1, 0, 0, 0,dt,  // h = h + vh*dt
-        0,0,0,0, 1, 0, 0, 0,  // vx = vx (甯搁€熷害妯″瀷)
-        0,0,0,0, 0, 1, 0, 0,  // vy = vy
-        0,0,0,0, 0, 0, 1, 0,  // vw = vw  
-        0,0,0,0, 0, 0, 0, 1   // vh = vh
-    };
-    
-    // 鏀硅繘鐨勮繃绋嬪櫔澹扮煩闃?- 鏍规嵁杩愬姩涓嶇‘瀹氭€ц皟鏁?
-    _float_t Q[EKF_N*EKF_N] = {0};
-    // 浣嶇疆鍣０
-    Q[0*EKF_N+0] = 1.0f;   // x浣嶇疆鍣０
-    Q[1*EKF_N+1] = 1.0f;   // y浣嶇疆鍣０
-    Q[2*EKF_N+2] = 0.5f;   // width鍣０(杈冨皬)
-    Q[3*EKF_N+3] = 0.5f;   // height鍣０(杈冨皬)
-    // 閫熷害鍣０
-    Q[4*EKF_N+4] = 0.1f;   // x閫熷害鍣０
-    Q[5*EKF_N+5] = 0.1f;   // y閫熷害鍣０  
-    Q[6*EKF_N+6] = 0.05f;  // width鍙樺寲閫熷害鍣０
-    Q[7*EKF_N+7] = 0.05f;  // height鍙樺寲閫熷害鍣０
-    
-    ekf_predict(&t.ekf, t.ekf.x, F, Q);
-
-    t.bbox = clamp_bbox(cv::Rect2f(t.ekf.x[0],
-                                   t.ekf.x[1],
-                                   std::max(10.0f, t.ekf.x[2]),
-                                   std::max(10.0f, t.ekf.x[3])));
-    t.bbox.width  = std::max(10.0f, t.ekf.x[2]);   // 闃叉瀹藉害杩囧皬
-    t.bbox.height = std::max(10.0f, t.ekf.x[3]);   // 闃叉楂樺害杩囧皬
-
-    // 杈圭晫妫€鏌ワ紝闃叉bbox瓒呭嚭鍥惧儚杈圭晫锛堢幇鍦ㄤ娇鐢?20p鍧愭爣绯伙級
-    t.bbox.x = std::max(0.0f, std::min((float)(IMAGE_WIDTH - t.bbox.width), t.bbox.x));
-    t.bbox.y = std::max(0.0f, std::min((float)(IMAGE_HEIGHT - t.bbox.height), t.bbox.y));
-    
-    // 纭繚bbox鍦ㄥ浘鍍忚寖鍥村唴
-    if (t.bbox.x + t.bbox.width > IMAGE_WIDTH) {
-        t.bbox.width = IMAGE_WIDTH - t.bbox.x;
-    }
-    if (t.bbox.y + t.bbox.height > IMAGE_HEIGHT) {
-        t.bbox.height = IMAGE_HEIGHT - t.bbox.y;
-    }
+static cv::Rect2f kalman_bbox(const Track& t) {
+    float box[BoxKalmanBank::kAxes];
+    kalman_bank.position(t.kf_slot, box);
+    return clamp_bbox(cv::Rect2f(box[0],
+                                 box[1],
+                                 std::max(10.0f, box[2]),
+                                 std::max(10.0f, box[3])));
+}
 
+// Call after kalman_bank.predictAll(), which advances every track in one pass.
+static void apply_track_prediction(Track& t) {
+    t.bbox = kalman_bbox(t);
     t.age++;
     t.missed++;
 }
 
-static void correct_track(Track& t, const Detection& det) {
-    _float_t z[EKF_M] = {det.x1, det.y1, det.x2-det.x1, det.y2-det.y1};
-    _float_t H[EKF_M*EKF_N] = {1,0,0,0,
-                                0,1,0,0,
-                                0,0,1,0,
-                                0,0,0,1};
-    _float_t R[EKF_M*EKF_M] = {16.0,0,0,0,
-                                0,16.0,0,0,
-                                0,0,64.0,0,
-                                0,0,0,64.0};
-    ekf_update(&t.ekf, z, z, H, R);
-
-    t.bbox = clamp_bbox(cv::Rect2f(det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1));
-    t.smoothed_bbox = t.bbox;
-    t.last_det_bbox = t.bbox;
-    t.hist = calc_hist(det.roi);
-    t.prop = det.prop;  // 鏇存柊缃俊搴?
-    t.missed = 0;
-    t.hits++;
-    t.active = true;
-    
-    // 缁忚繃3娆℃垚鍔熷尮閰嶅悗纭track
-    if (t.hits >= 3) {
-        t.confirmed = true;
+static void release_track(const Track& t) {
+    kalman_bank.release(t.kf_slot);
+    for (const auto& frame : t.frame_candidates) {
+        account_candidate(frame, false);
     }
-
-    // 璁板綍妫€娴嬫闈㈢Н鍘嗗彶
-    float area = t.bbox.width * t.bbox.height;
-    t.bbox_history.push_back(area);
-    // 鍙繚鐣欐渶杩?0甯?
-    if (t.bbox_history.size() > 20) t.bbox_history.erase(t.bbox_history.begin());
-}
-
-//-----------------鏂板缓Track-----------------
-
-static void predict_track_robust(Track& t) {
-    _float_t dt = 1.0f;
-    _float_t F[EKF_N * EKF_N] = {
-        1,0,0,0,dt, 0, 0, 0,
-        0,1,0,0, 0,dt, 0, 0,
-        0,0,1,0, 0, 0,dt, 0,
-        0,0,0,1, 0, 0, 0,dt,
-        0,0,0,0, 1, 0, 0, 0,
-        0,0,0,0, 0, 1, 0, 0,
-        0,0,0,0, 0, 0, 1, 0,
-        0,0,0,0, 0, 0, 0, 1
-    };
-
-    _float_t Q[EKF_N * EKF_N] = {0};
-    Q[0 * EKF_N + 0] = 1.0f;
-    Q[1 * EKF_N + 1] = 1.0f;
-    Q[2 * EKF_N + 2] = 0.5f;
-    Q[3 * EKF_N + 3] = 0.5f;
-    Q[4 * EKF_N + 4] = 0.1f;
-    Q[5 * EKF_N + 5] = 0.1f;
-    Q[6 * EKF_N + 6] = 0.05f;
-    Q[7 * EKF_N + 7] = 0.05f;
-
-    ekf_predict(&t.ekf, t.ekf.x, F, Q);
-    t.bbox = clamp_bbox(cv::Rect2f(t.ekf.x[0],
-                                   t.ekf.x[1],
-                                   std::max(10.0f, t.ekf.x[2]),
-                                   std::max(10.0f, t.ekf.x[3])));
-    t.age++;
-    t.missed++;
 }
 
-static void correct_track_robust(Track& t, const Detection& det) {
+static void correct_track_robust(Track& t, const Detection& det, const AppearanceDescriptor& appearance, float dt) {
     int prev_hits = t.hits;
     int prev_missed = t.missed;
     cv::Rect2f prev_smoothed = t.smoothed_bbox;
     cv::Rect2f det_rect(det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1);
 
-    _float_t z[EKF_M] = {det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1};
-    _float_t H[EKF_M * EKF_N] = {1,0,0,0,
-                                 0,1,0,0,
-                                 0,0,1,0,
-                                 0,0,0,1};
-    _float_t R[EKF_M * EKF_M] = {16.0,0,0,0,
-                                 0,16.0,0,0,
-                                 0,0,64.0,0,
-                                 0,0,0,64.0};
-    ekf_update(&t.ekf, z, z, H, R);
-
-    cv::Rect2f ekf_rect = clamp_bbox(cv::Rect2f(t.ekf.x[0],
-                                                t.ekf.x[1],
-                                                std::max(10.0f, t.ekf.x[2]),
-                                                std::max(10.0f, t.ekf.x[3])));
-    cv::Rect2f fused_measurement = blend_bbox(det_rect, ekf_rect, 0.28f, 0.20f);
+    float z[BoxKalmanBank::kAxes] = {det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1};
+    kalman_bank.correct(t.kf_slot, z);
+
+    cv::Rect2f kf_rect = kalman_bbox(t);
+    cv::Rect2f fused_measurement = blend_bbox(det_rect, kf_rect, 0.28f, 0.20f);
 
     float jitter_sample = 0.0f;
     if (is_valid_bbox(prev_smoothed)) {
@@ -863,10 +932,10 @@ static void correct_track_robust(Track& t, const Detection& det) {
 
     t.last_det_bbox = det_rect;
     t.smoothed_bbox = is_valid_bbox(prev_smoothed)
-        ? blend_bbox(prev_smoothed, fused_measurement, center_alpha, size_alpha)
+        ? blend_bbox(prev_smoothed, fused_measurement, alpha_for_dt(center_alpha, dt), alpha_for_dt(size_alpha, dt))
         : clamp_bbox(fused_measurement);
     t.bbox = t.smoothed_bbox;
-    t.hist = calc_hist(det.roi);
+    t.appearance = appearance;
     t.prop = det.prop;
     t.missed = 0;
     t.hits++;
@@ -880,20 +949,26 @@ static void correct_track_robust(Track& t, const Detection& det) {
     append_area_history(t.bbox_history, t.bbox.area());
 }
 
-static Track create_track(const Detection& det, int id, bool already_captured) {
+//-----------------鏂板缓Track-----------------
+
+static Track create_track(const Detection& det,
+                          const AppearanceDescriptor& appearance,
+                          int id,
+                          bool already_captured) {
     Track t;
     t.id = id;
 
-    _float_t Pdiag[EKF_N] = {1,1,1,1,10,10,10,10};  // 浣嶇疆鏂瑰樊杈冨皬锛岄€熷害鏂瑰樊杈冨ぇ
-    ekf_initialize(&t.ekf, Pdiag);
-
-    _float_t state[EKF_N] = {det.x1, det.y1, det.x2-det.x1, det.y2-det.y1, 0, 0, 0, 0};
-    memcpy(t.ekf.x, state, sizeof(state));
+    float box[BoxKalmanBank::kAxes] = {det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1};
+    t.kf_slot = kalman_bank.allocate(box);
+    if (static_cast<size_t>(t.kf_slot) >= slot_generations.size()) {
+        slot_generations.resize(t.kf_slot + 1, 0);
+    }
+    t.generation = ++slot_generations[t.kf_slot];
 
     t.bbox = clamp_bbox(cv::Rect2f(det.x1, det.y1, det.x2 - det.x1, det.y2 - det.y1));
     t.smoothed_bbox = t.bbox;
     t.last_det_bbox = t.bbox;
-    t.hist = calc_hist(det.roi);
+    t.appearance = appearance;
     t.prop = det.prop;
     t.age = 1;
     t.missed = 0;
@@ -909,148 +984,185 @@ static Track create_track(const Detection& det, int id, bool already_captured) {
     return t;
 }
 
-//-----------------涓绘洿鏂板嚱鏁?----------------
-
-std::vector<Track> sort_update(const std::vector<Detection>& dets) {
-    struct PendingUpload {
-        int trackId;
-        bool uploadPerson{false};
-        bool uploadFace{false};
-        Track::FrameData personFrame;
-        Track::FrameData faceFrame;
-        float faceOcclusion{0.0f};
-    };
+// Picks the frames of t still to be uploaded and marks them captured.
+// Caller must hold tracks_mutex. With require_face nothing is queued unless
+// a face frame qualifies (early finalization never settles for less).
+static void collect_track_upload(const Track& t,
+                                 std::vector<PendingUpload>& pendingUploads,
+                                 bool require_face = false) {
+    if (!upload_callback || t.frame_candidates.empty() || !captured_person_ids || !captured_face_ids) {
+        log_debug("Track %d upload conditions not met", t.id);
+        if (has_track_uploaded_asset(t.id)) {
+            remember_recent_capture(t);
+        }
+        return;
+    }
 
-    std::vector<PendingUpload> pendingUploads;
-    std::vector<Track> snapshot;
+    if (is_track_fully_captured(t.id)) {
+        remember_recent_capture(t);
+        log_debug("Track %d already captured, refresh recent cache only", t.id);
+        return;
+    }
 
-    std::unique_lock<std::mutex> lock(tracks_mutex);
-    age_lost_tracks();
-    age_recent_captures();
-    age_pending_tracks();
+    size_t best_face_index = select_best_face_frame_index(t.frame_candidates);
+    size_t best_person_index = select_best_person_frame_index(t.frame_candidates);
+    if (best_face_index == SIZE_MAX && best_person_index == SIZE_MAX) {
+        log_debug("Track %d skipped upload: no usable candidate", t.id);
+        return;
+    }
 
-    auto queue_upload_if_needed = [&](const Track& t) {
-        if (!upload_callback || t.frame_candidates.empty() || !captured_person_ids || !captured_face_ids) {
-            log_debug("Track %d upload conditions not met", t.id);
-            if (has_track_uploaded_asset(t.id)) {
-                remember_recent_capture(t);
-            }
-            return;
-        }
+    const float person_area_threshold =
+        std::max(g_capture_min_area_ratio * 1.10f, g_capture_near_area_ratio * 0.82f);
+    const float face_area_threshold =
+        std::max(g_capture_min_area_ratio * 1.22f, g_capture_near_area_ratio * 0.88f);
 
-        if (is_track_fully_captured(t.id)) {
-            remember_recent_capture(t);
-            log_debug("Track %d already captured, refresh recent cache only", t.id);
-            return;
-        }
+    PendingUpload pending;
+    pending.trackId = t.id;
 
-        size_t best_face_index = select_best_face_frame_index(t.frame_candidates);
-        size_t best_person_index = select_best_person_frame_index(t.frame_candidates);
-        if (best_face_index == SIZE_MAX && best_person_index == SIZE_MAX) {
-            log_debug("Track %d skipped upload: no usable candidate", t.id);
-            return;
+    if (!is_track_face_captured(t.id) && best_face_index != SIZE_MAX) {
+        const auto& best_face_frame = t.frame_candidates[best_face_index];
+        if (best_face_frame.area_ratio >= face_area_threshold) {
+            pending.uploadFace = true;
+            pending.faceFrame = best_face_frame;
+            pending.faceOcclusion = frame_occlusion(best_face_frame);
         }
+    }
 
-        const float person_area_threshold =
-            std::max(g_capture_min_area_ratio * 1.10f, g_capture_near_area_ratio * 0.82f);
-        const float face_area_threshold =
-            std::max(g_capture_min_area_ratio * 1.22f, g_capture_near_area_ratio * 0.88f);
-
-        PendingUpload pending;
-        pending.trackId = t.id;
+    if (require_face && !pending.uploadFace) {
+        return;
+    }
 
-        if (!is_track_face_captured(t.id) && best_face_index != SIZE_MAX) {
-            const auto& best_face_frame = t.frame_candidates[best_face_index];
-            if (best_face_frame.area_ratio >= face_area_threshold) {
-                pending.uploadFace = true;
-                pending.faceFrame = best_face_frame;
-                pending.faceOcclusion = frame_occlusion(best_face_frame);
+    if (!is_track_person_captured(t.id)) {
+        if (pending.uploadFace) {
+            pending.uploadPerson = true;
+            pending.personFrame = pending.faceFrame;
+        } else if (best_person_index != SIZE_MAX) {
+            const auto& best_person_frame = t.frame_candidates[best_person_index];
+            bool area_ok = best_person_frame.area_ratio >= person_area_threshold;
+            bool occlusion_ok = best_person_frame.person_occlusion <=
+                std::max(g_capture_max_person_occlusion * 1.10f, 0.62f);
+            if (area_ok && occlusion_ok) {
+                pending.uploadPerson = true;
+                pending.personFrame = best_person_frame;
             }
         }
+    }
 
-        if (!is_track_person_captured(t.id)) {
-            if (pending.uploadFace) {
+    if (!pending.uploadPerson && !pending.uploadFace) {
+        // ── 无脸人体兜底上传 ──
+        // 当没有合格人脸时，仍然上传最佳人体全身图，避免漏抓侧脸/低头/远距离人员。
+        if (!is_track_person_captured(t.id) && best_person_index != SIZE_MAX) {
+            const auto& fallback_person = t.frame_candidates[best_person_index];
+            // 兜底上传使用更宽松的面积和遮挡门槛
+            float fallback_area_threshold =
+                std::max(g_capture_min_area_ratio * 0.90f, g_capture_near_area_ratio * 0.65f);
+            float fallback_occlusion_max =
+                std::max(g_capture_max_person_occlusion * 1.25f, 0.68f);
+            bool fallback_area_ok = fallback_person.area_ratio >= fallback_area_threshold;
+            bool fallback_occ_ok = fallback_person.person_occlusion <= fallback_occlusion_max;
+            if (fallback_area_ok && fallback_occ_ok) {
                 pending.uploadPerson = true;
-                pending.personFrame = pending.faceFrame;
-            } else if (best_person_index != SIZE_MAX) {
-                const auto& best_person_frame = t.frame_candidates[best_person_index];
-                bool area_ok = best_person_frame.area_ratio >= person_area_threshold;
-                bool occlusion_ok = best_person_frame.person_occlusion <=
-                    std::max(g_capture_max_person_occlusion * 1.10f, 0.62f);
-                if (area_ok && occlusion_ok) {
-                    pending.uploadPerson = true;
-                    pending.personFrame = best_person_frame;
-                }
+                pending.personFrame = fallback_person;
+                log_info("Track %d fallback person-only upload: no usable face, area=%.4f occ=%.2f clarity=%.1f",
+                         t.id,
+                         fallback_person.area_ratio,
+                         fallback_person.person_occlusion,
+                         fallback_person.clarity);
             }
         }
+    }
 
-        if (!pending.uploadPerson && !pending.uploadFace) {
-            // ── 无脸人体兜底上传 ──
-            // 当没有合格人脸时，仍然上传最佳人体全身图，避免漏抓侧脸/低头/远距离人员。
-            if (!is_track_person_captured(t.id) && best_person_index != SIZE_MAX) {
-                const auto& fallback_person = t.frame_candidates[best_person_index];
-                // 兜底上传使用更宽松的面积和遮挡门槛
-                float fallback_area_threshold =
-                    std::max(g_capture_min_area_ratio * 0.90f, g_capture_near_area_ratio * 0.65f);
-                float fallback_occlusion_max =
-                    std::max(g_capture_max_person_occlusion * 1.25f, 0.68f);
-                bool fallback_area_ok = fallback_person.area_ratio >= fallback_area_threshold;
-                bool fallback_occ_ok = fallback_person.person_occlusion <= fallback_occlusion_max;
-                if (fallback_area_ok && fallback_occ_ok) {
-                    pending.uploadPerson = true;
-                    pending.personFrame = fallback_person;
-                    log_info("Track %d fallback person-only upload: no usable face, area=%.4f occ=%.2f clarity=%.1f",
-                             t.id,
-                             fallback_person.area_ratio,
-                             fallback_person.person_occlusion,
-                             fallback_person.clarity);
-                }
-            }
+    if (!pending.uploadPerson && !pending.uploadFace) {
+        float best_area_ratio = 0.0f;
+        if (best_face_index != SIZE_MAX) {
+            best_area_ratio = std::max(best_area_ratio, t.frame_candidates[best_face_index].area_ratio);
+        }
+        if (best_person_index != SIZE_MAX) {
+            best_area_ratio = std::max(best_area_ratio, t.frame_candidates[best_person_index].area_ratio);
         }
+        log_debug("Track %d skipped upload: target still too far or too occluded (best_area=%.4f)",
+                  t.id,
+                  best_area_ratio);
+        return;
+    }
+
+    pendingUploads.push_back(std::move(pending));
+    if (pendingUploads.back().uploadPerson) {
+        captured_person_ids->insert(t.id);
+    }
+    if (pendingUploads.back().uploadFace) {
+        captured_face_ids->insert(t.id);
+    }
+    remember_recent_capture(t);
+}
 
-        if (!pending.uploadPerson && !pending.uploadFace) {
-            float best_area_ratio = 0.0f;
-            if (best_face_index != SIZE_MAX) {
-                best_area_ratio = std::max(best_area_ratio, t.frame_candidates[best_face_index].area_ratio);
+// Runs the upload callback; called with tracks_mutex released.
+static void dispatch_uploads(const std::vector<PendingUpload>& pendingUploads) {
+    for (const auto& upload : pendingUploads) {
+        if (upload.uploadPerson) {
+            cv::Mat person = candidate_image(upload.personFrame.person_roi, upload.personFrame.person_jpeg);
+            if (!person.empty()) {
+                upload_callback(person, upload.trackId, "person", nullptr);
             }
-            if (best_person_index != SIZE_MAX) {
-                best_area_ratio = std::max(best_area_ratio, t.frame_candidates[best_person_index].area_ratio);
+        }
+        if (upload.uploadFace) {
+            cv::Mat face = candidate_image(upload.faceFrame.face_roi, upload.faceFrame.face_jpeg);
+            // A JPEG round trip changes the statistics, so decoded crops go
+            // without their metrics.
+            const QualityMetrics* quality =
+                (!upload.faceFrame.face_roi.empty() && upload.faceFrame.face_quality.valid)
+                    ? &upload.faceFrame.face_quality
+                    : nullptr;
+            if (!face.empty()) {
+                upload_callback(face, upload.trackId, "face", quality);
             }
-            log_debug("Track %d skipped upload: target still too far or too occluded (best_area=%.4f)",
-                      t.id,
-                      best_area_ratio);
-            return;
         }
+        const auto& log_frame = upload.uploadFace ? upload.faceFrame : upload.personFrame;
+        log_info("Track %d upload queued: person=%d face=%d clarity=%.2f area=%.2f%% occ=%.2f motion=%.4f blur=%.2f score=%.2f",
+                 upload.trackId,
+                 upload.uploadPerson ? 1 : 0,
+                 upload.uploadFace ? 1 : 0,
+                 log_frame.clarity,
+                 log_frame.area_ratio * 100.0f,
+                 upload.uploadFace ? upload.faceOcclusion : log_frame.person_occlusion,
+                 log_frame.motion_ratio,
+                 log_frame.blur_severity,
+                 log_frame.score);
+    }
+}
+
+//-----------------涓绘洿鏂板嚱鏁?----------------
+
+void sort_update(const std::vector<Detection>& dets, std::vector<TrackView>& views, float dt) {
+    std::vector<PendingUpload> pendingUploads;
+
+    std::unique_lock<std::mutex> lock(tracks_mutex);
+    pendingUploads.swap(early_uploads);
+    age_lost_tracks();
+    age_recent_captures();
+    age_pending_tracks();
 
-        pendingUploads.push_back(std::move(pending));
-        if (pendingUploads.back().uploadPerson) {
-            captured_person_ids->insert(t.id);
-        }
-        if (pendingUploads.back().uploadFace) {
-            captured_face_ids->insert(t.id);
-        }
-        remember_recent_capture(t);
-    };
 
     // 棰勬祴鎵€鏈塼rack
-    for (auto& t : tracks) predict_track_robust(t);
+    kalman_bank.predictAll(dt);
+    for (auto& t : tracks) apply_track_prediction(t);
 
     int N = tracks.size();
     int M = dets.size();
     
     if (N == 0) {
         // 娌℃湁鐜版湁track鏃朵篃涓嶇珛鍗冲缓杞紝鍏堣繘鍏ending纭
-        std::vector<cv::Mat> det_hists(M);
-        for (int j = 0; j < M; j++) {
-            det_hists[j] = calc_hist(dets[j].roi);
-        }
+        compute_det_descriptors(dets);
         for (int j = 0; j < M; j++) {
-            int assigned_id = update_pending_track(dets[j], det_hists[j]);
+            int assigned_id = update_pending_track(dets[j], det_descriptors[j]);
             if (assigned_id > 0) {
                 log_debug("New person appeared: ID=%d", assigned_id);
             }
         }
-        return tracks;
+        publish_track_views(views);
+        lock.unlock();
+        dispatch_uploads(pendingUploads);
+        return;
     }
     
     if (M == 0) {
@@ -1058,71 +1170,75 @@ std::vector<Track> sort_update(const std::vector<Detection>& dets) {
                     [&](const Track& t){
                         if(t.missed > MAX_MISSED){
                             cache_lost_track(t);
-                            queue_upload_if_needed(t);
+                            collect_track_upload(t, pendingUploads);
+                            release_track(t);
                             return true;
                         }
                         return false;
                     });
         tracks.erase(it, tracks.end());
-        snapshot = tracks;
+        publish_track_views(views);
         lock.unlock();
-        for (const auto& upload : pendingUploads) {
-            if (upload.uploadPerson && !upload.personFrame.person_roi.empty()) {
-                upload_callback(upload.personFrame.person_roi, upload.trackId, "person");
-            }
-            if (upload.uploadFace && !upload.faceFrame.face_roi.empty()) {
-                upload_callback(upload.faceFrame.face_roi, upload.trackId, "face");
-            }
-            const auto& log_frame = upload.uploadFace ? upload.faceFrame : upload.personFrame;
-            log_info("Track %d upload queued: person=%d face=%d clarity=%.2f area=%.2f%% occ=%.2f motion=%.4f blur=%.2f score=%.2f",
-                     upload.trackId,
-                     upload.uploadPerson ? 1 : 0,
-                     upload.uploadFace ? 1 : 0,
-                     log_frame.clarity,
-                     log_frame.area_ratio * 100.0f,
-                     upload.uploadFace ? upload.faceOcclusion : log_frame.person_occlusion,
-                     log_frame.motion_ratio,
-                     log_frame.blur_severity,
-                     log_frame.score);
-        }
-        return snapshot;
+        dispatch_uploads(pendingUploads);
+        return;
     }
 
-    // Cost matrix construction — position-dominant weights to prevent ID swaps.
-    std::vector<std::vector<float>> cost(N, std::vector<float>(M, 1.0f));
+    // Sparse cost construction — position-dominant weights to prevent ID swaps.
+    // Geometry is evaluated for every pair; the histogram comparison only runs
+    // when the geometric lower bound can still beat ASSIGN_MAX_COST, so pairs
+    // that could never be matched are gated out before touching appearance.
+    // The surviving pairs are then grouped by detection and each detection
+    // is compared against its candidate tracks in one batched distance row.
+    compute_det_descriptors(dets);
 
-    std::vector<cv::Mat> det_hists(M);
+    assign_det_rects.resize(M);
+    assign_det_columns.resize(M);
     for (int j = 0; j < M; j++) {
-        det_hists[j] = calc_hist(dets[j].roi);
+        assign_det_rects[j] = cv::Rect2f(dets[j].x1, dets[j].y1,
+                                         dets[j].x2 - dets[j].x1, dets[j].y2 - dets[j].y1);
+        assign_det_columns.set(j, assign_det_rects[j]);
     }
+    assign_iou_row.resize(M);
+    assign_iou_scratch.resize(M);
+    auto iou_against_dets = [&](const cv::Rect2f& box, float* out) {
+        simd_iou_one_to_many(box.x, box.y, box.x + box.width, box.y + box.height, box.area(),
+                             assign_det_columns.x1.data(), assign_det_columns.y1.data(),
+                             assign_det_columns.x2.data(), assign_det_columns.y2.data(),
+                             assign_det_columns.area.data(), M, out);
+    };
 
-    // Pre-compute EKF predicted bbox for each track.
-    std::vector<cv::Rect2f> predicted_bboxes(N);
+    // Pre-compute stable and Kalman predicted bbox for each track (the
+    // batched predict above already advanced the state to this frame).
+    assign_stable_bboxes.resize(N);
+    assign_predicted_bboxes.resize(N);
     for (int i = 0; i < N; i++) {
-        float px = tracks[i].ekf.x[0] + tracks[i].ekf.x[4];
-        float py = tracks[i].ekf.x[1] + tracks[i].ekf.x[5];
-        float pw = std::max(10.0f, tracks[i].ekf.x[2] + tracks[i].ekf.x[6]);
-        float ph = std::max(10.0f, tracks[i].ekf.x[3] + tracks[i].ekf.x[7]);
-        predicted_bboxes[i] = clamp_bbox(cv::Rect2f(px, py, pw, ph));
+        assign_stable_bboxes[i] = stable_track_bbox(tracks[i]);
+        assign_predicted_bboxes[i] = kalman_bbox(tracks[i]);
     }
 
+    assignment_solver.reset(N, M);
+    assign_candidates.clear();
     for (int i=0; i<N; i++) {
-        for (int j=0; j<M; j++) {
-            cv::Rect2f det_rect(dets[j].x1, dets[j].y1,
-                               dets[j].x2-dets[j].x1, dets[j].y2-dets[j].y1);
-
-            cv::Rect2f stable_bbox = stable_track_bbox(tracks[i]);
-            // IoU: take best of raw bbox, smoothed bbox, and EKF predicted bbox.
-            float iou_score = std::max({iou(tracks[i].bbox, det_rect),
-                                        iou(stable_bbox, det_rect),
-                                        iou(predicted_bboxes[i], det_rect)});
+        const cv::Rect2f& stable_bbox = assign_stable_bboxes[i];
+        const cv::Rect2f& predicted_bbox = assign_predicted_bboxes[i];
+
+        // IoU: take best of raw bbox, smoothed bbox, and Kalman predicted bbox.
+        iou_against_dets(tracks[i].bbox, assign_iou_row.data());
+        for (const cv::Rect2f* ref : {&stable_bbox, &predicted_bbox}) {
+            iou_against_dets(*ref, assign_iou_scratch.data());
+            for (int j = 0; j < M; j++) {
+                assign_iou_row[j] = std::max(assign_iou_row[j], assign_iou_scratch[j]);
+            }
+        }
 
-            float hist_score = hist_distance(tracks[i].hist, det_hists[j]);
+        for (int j=0; j<M; j++) {
+            const cv::Rect2f& det_rect = assign_det_rects[j];
+            float iou_score = assign_iou_row[j];
 
             // Center distance: take minimum of all three references.
             float center_dist = std::min({center_distance_norm(tracks[i].bbox, det_rect),
                                           center_distance_norm(stable_bbox, det_rect),
-                                          center_distance_norm(predicted_bboxes[i], det_rect)});
+                                          center_distance_norm(predicted_bbox, det_rect)});
 
             float conf_weight = std::min(1.0f, dets[j].prop / 0.8f);
 
@@ -1130,47 +1246,89 @@ std::vector<Track> sort_update(const std::vector<Detection>& dets) {
                               std::max(stable_bbox.area(), det_rect.area());
 
             float center_cost = std::min(1.0f, center_dist / 0.28f);
-            float area_penalty = 0.0f;
-            if (area_ratio < 0.55f) {
-                float appearance_support = (1.0f - hist_score) * 0.55f + (1.0f - center_cost) * 0.45f;
-                float severity = (0.55f - area_ratio) / 0.55f;
-                float max_penalty = appearance_support > 0.65f ? 0.18f : 0.34f;
-                area_penalty = severity * max_penalty;
-            }
+            float area_severity = area_ratio < 0.55f ? (0.55f - area_ratio) / 0.55f : 0.0f;
 
             // Weights: position-dominant to prevent ID swaps between similar-looking people.
             // IoU 0.48 + hist 0.18 + center 0.26 + conf 0.05 = 0.97 + area_penalty
-            cost[i][j] = (1.0f - iou_score) * 0.48f +
-                        hist_score * 0.18f +
-                        center_cost * 0.26f +
-                        (1.0f - conf_weight) * 0.05f +
-                        area_penalty;
+            float geometry_cost = (1.0f - iou_score) * 0.48f +
+                                  center_cost * 0.26f +
+                                  (1.0f - conf_weight) * 0.05f;
 
             if (iou_score < 0.02f && center_dist > 0.24f) {
-                cost[i][j] += 0.30f;
+                geometry_cost += 0.30f;
             }
 
             if (center_dist > 0.42f) {
-                cost[i][j] += 0.25f;
-            }
-
-            if (hist_score > 0.82f) {
-                cost[i][j] += 0.20f;
+                geometry_cost += 0.25f;
             }
 
-            // Velocity consistency penalty: if EKF predicts the track should be
+            // Velocity consistency penalty: if the Kalman filter predicts the track should be
             // far from this detection, penalize the match (prevents ID swaps).
             if (tracks[i].confirmed) {
-                float pred_dist = center_distance_norm(predicted_bboxes[i], det_rect);
+                float pred_dist = center_distance_norm(predicted_bbox, det_rect);
                 if (pred_dist > 0.15f) {
-                    cost[i][j] += 0.15f;
+                    geometry_cost += 0.15f;
                 }
             }
+
+            // Histogram terms and the area penalty are non-negative and the
+            // penalty is at least severity * 0.18, so this bound is exact.
+            if (geometry_cost + area_severity * 0.18f >= ASSIGN_MAX_COST) {
+                continue;
+            }
+            assign_candidates.push_back({i, j, geometry_cost, area_severity, center_cost});
+        }
+    }
+
+    // Group the surviving pairs by detection (counting sort).
+    assign_det_offsets.assign(M + 1, 0);
+    for (const AssignCandidate& c : assign_candidates) {
+        assign_det_offsets[c.det + 1]++;
+    }
+    for (int j = 0; j < M; j++) {
+        assign_det_offsets[j + 1] += assign_det_offsets[j];
+    }
+    assign_candidate_order.resize(assign_candidates.size());
+    assign_det_cursors.assign(assign_det_offsets.begin(), assign_det_offsets.end() - 1);
+    for (int k = 0; k < static_cast<int>(assign_candidates.size()); k++) {
+        assign_candidate_order[assign_det_cursors[assign_candidates[k].det]++] = k;
+    }
+
+    for (int j = 0; j < M; j++) {
+        const int begin = assign_det_offsets[j];
+        const int end = assign_det_offsets[j + 1];
+        if (begin == end) {
+            continue;
+        }
+        assign_track_appearances.clear();
+        for (int k = begin; k < end; k++) {
+            assign_track_appearances.push_back(&tracks[assign_candidates[assign_candidate_order[k]].track].appearance);
+        }
+        appearance_distance_batch(det_descriptors[j], assign_track_appearances, assign_hist_row);
+
+        for (int k = begin; k < end; k++) {
+            const AssignCandidate& c = assign_candidates[assign_candidate_order[k]];
+            float hist_score = assign_hist_row[k - begin];
+            float area_penalty = 0.0f;
+            if (c.area_severity > 0.0f) {
+                float appearance_support = (1.0f - hist_score) * 0.55f + (1.0f - c.center_cost) * 0.45f;
+                float max_penalty = appearance_support > 0.65f ? 0.18f : 0.34f;
+                area_penalty = c.area_severity * max_penalty;
+            }
+
+            float cost = c.geometry_cost + hist_score * 0.18f + area_penalty;
+            if (hist_score > 0.82f) {
+                cost += 0.20f;
+            }
+            if (cost < ASSIGN_MAX_COST) {
+                assignment_solver.addEdge(c.track, j, cost);
+            }
         }
     }
 
     // max_cost tightened to reject weak matches that cause ID swaps.
-    std::vector<std::pair<int,int>> assignments = hungarian_algorithm(cost, 0.65f);
+    assignment_solver.solve(ASSIGN_MAX_COST, assignment_pairs);
+    const std::vector<std::pair<int,int>>& assignments = assignment_pairs;
     
     std::vector<bool> track_assigned(N, false);
     std::vector<bool> det_assigned(M, false);
@@ -1184,10 +1342,8 @@ std::vector<Track> sort_update(const std::vector<Detection>& dets) {
         // far from the track, even if the Hungarian algorithm chose it as "optimal".
         // This prevents cross-assignments between similar-looking people.
         if (tracks[track_idx].confirmed) {
-            cv::Rect2f det_rect(dets[det_idx].x1, dets[det_idx].y1,
-                               dets[det_idx].x2 - dets[det_idx].x1,
-                               dets[det_idx].y2 - dets[det_idx].y1);
-            cv::Rect2f stable_bbox = stable_track_bbox(tracks[track_idx]);
+            const cv::Rect2f& det_rect = assign_det_rects[det_idx];
+            const cv::Rect2f& stable_bbox = assign_stable_bboxes[track_idx];
             float match_iou = std::max(iou(tracks[track_idx].bbox, det_rect),
                                        iou(stable_bbox, det_rect));
             float match_center_dist = std::min(center_distance_norm(tracks[track_idx].bbox, det_rect),
@@ -1200,18 +1356,23 @@ std::vector<Track> sort_update(const std::vector<Detection>& dets) {
 
         track_assigned[track_idx] = true;
         det_assigned[det_idx] = true;
-        correct_track_robust(tracks[track_idx], dets[det_idx]);
+        correct_track_robust(tracks[track_idx], dets[det_idx], det_descriptors[det_idx], dt);
     }
 
     // 鍒涘缓鏂皌racks
+    track_grid.reset(IMAGE_WIDTH, IMAGE_HEIGHT, GRID_CELL_SIZE);
+    for (const auto& t : tracks) {
+        track_grid.insert(stable_track_bbox(t));
+    }
     for (int j=0; j<M; j++) {
         if(!det_assigned[j]){
             if (should_suppress_new_track(dets[j])) {
                 continue;
             }
 
-            int assigned_id = update_pending_track(dets[j], det_hists[j]);
+            int assigned_id = update_pending_track(dets[j], det_descriptors[j]);
             if (assigned_id > 0) {
+                track_grid.insert(stable_track_bbox(tracks.back()));
                 log_debug("New person appeared: ID=%d", assigned_id);
             }
         }
@@ -1222,34 +1383,16 @@ std::vector<Track> sort_update(const std::vector<Detection>& dets) {
                 [&](const Track& t){
                     if(t.missed > MAX_MISSED){
                         cache_lost_track(t);
-                        queue_upload_if_needed(t);
+                        collect_track_upload(t, pendingUploads);
+                        release_track(t);
                         return true;
                     }
                     return false;
                 });
     tracks.erase(it, tracks.end());
-    snapshot = tracks;
+    publish_track_views(views);
     lock.unlock();
-    for (const auto& upload : pendingUploads) {
-        if (upload.uploadPerson && !upload.personFrame.person_roi.empty()) {
-            upload_callback(upload.personFrame.person_roi, upload.trackId, "person");
-        }
-        if (upload.uploadFace && !upload.faceFrame.face_roi.empty()) {
-            upload_callback(upload.faceFrame.face_roi, upload.trackId, "face");
-        }
-        const auto& log_frame = upload.uploadFace ? upload.faceFrame : upload.personFrame;
-        log_info("Track %d upload queued: person=%d face=%d clarity=%.2f area=%.2f%% occ=%.2f motion=%.4f blur=%.2f score=%.2f",
-                 upload.trackId,
-                 upload.uploadPerson ? 1 : 0,
-                 upload.uploadFace ? 1 : 0,
-                 log_frame.clarity,
-                 log_frame.area_ratio * 100.0f,
-                 upload.uploadFace ? upload.faceOcclusion : log_frame.person_occlusion,
-                 log_frame.motion_ratio,
-                 log_frame.blur_severity,
-                 log_frame.score);
-    }
-    return snapshot;
+    dispatch_uploads(pendingUploads);
 }
 
 std::vector<Track> get_expiring_tracks() {
@@ -1266,14 +1409,15 @@ std::vector<Track> get_expiring_tracks() {
     return expiring_tracks;
 }
 
-std::vector<Track> sort_predict_only() {
+void sort_predict_only(std::vector<TrackView>& views, float dt) {
     std::lock_guard<std::mutex> lock(tracks_mutex);
+    kalman_bank.predictAll(dt);
     for (auto& t : tracks) {
         if (t.missed <= MAX_MISSED) {
-            predict_track_robust(t);
-            // Smoothly advance smoothed_bbox toward EKF prediction.
-            float alpha_c = TRACK_SMOOTH_CENTER_ALPHA * 0.5f;
-            float alpha_s = TRACK_SMOOTH_SIZE_ALPHA * 0.5f;
+            apply_track_prediction(t);
+            // Smoothly advance smoothed_bbox toward the Kalman prediction.
+            float alpha_c = alpha_for_dt(TRACK_SMOOTH_CENTER_ALPHA * 0.5f, dt);
+            float alpha_s = alpha_for_dt(TRACK_SMOOTH_SIZE_ALPHA * 0.5f, dt);
             if (is_valid_bbox(t.smoothed_bbox)) {
                 t.smoothed_bbox.x += alpha_c * (t.bbox.x - t.smoothed_bbox.x);
                 t.smoothed_bbox.y += alpha_c * (t.bbox.y - t.smoothed_bbox.y);
@@ -1284,66 +1428,258 @@ std::vector<Track> sort_predict_only() {
             }
         }
     }
-    return tracks;
+    publish_track_views(views);
 }
 
-void add_frame_candidate(int track_id, const Track::FrameData& frame_data) {
-    std::lock_guard<std::mutex> lock(tracks_mutex);
+static Track* find_track(int track_id) {
     for (auto& t : tracks) {
         if (t.id == track_id) {
-            if (t.frame_candidates.size() < g_max_frame_candidates) {
-                t.frame_candidates.push_back(frame_data);
-                t.best_clarity = std::max(t.best_clarity, frame_data.clarity);
-                log_debug("Track %d candidate stored: score=%.2f count=%zu face=%d area=%.4f",
-                          track_id,
-                          frame_data.score,
-                          t.frame_candidates.size(),
-                          is_usable_face_frame(frame_data) ? 1 : 0,
-                          frame_data.area_ratio);
-            } else {
-                auto peak_clarity_it = std::max_element(t.frame_candidates.begin(), t.frame_candidates.end(),
-                    [](const Track::FrameData& a, const Track::FrameData& b) {
-                        return a.clarity < b.clarity;
-                    });
-                auto replace_it = t.frame_candidates.end();
-                for (auto it = t.frame_candidates.begin(); it != t.frame_candidates.end(); ++it) {
-                    bool protect_peak = (it == peak_clarity_it) &&
-                                        peak_clarity_it->strong_candidate &&
-                                        peak_clarity_it->face_pose_level >= 1 &&
-                                        frame_data.clarity <= peak_clarity_it->clarity * 1.02;
-                    if (protect_peak) {
-                        continue;
-                    }
-                    if (replace_it == t.frame_candidates.end() ||
-                        overall_capture_priority(*it) < overall_capture_priority(*replace_it)) {
-                        replace_it = it;
-                    }
-                }
+            return &t;
+        }
+    }
+    return nullptr;
+}
 
-                if (replace_it == t.frame_candidates.end()) {
-                    replace_it = peak_clarity_it;
-                }
+static bool lower_capture_priority(const Track::FrameData& a, const Track::FrameData& b) {
+    return a.capture_priority > b.capture_priority;
+}
 
-                bool replace = false;
-                if (is_usable_face_frame(frame_data) || is_usable_face_frame(*replace_it)) {
-                    replace = better_face_capture(frame_data, *replace_it) ||
-                              overall_capture_priority(frame_data) > overall_capture_priority(*replace_it) + 8.0;
-                } else {
-                    replace = better_person_capture(frame_data, *replace_it) ||
-                              person_capture_priority(frame_data) > person_capture_priority(*replace_it) + 10.0;
-                }
+// Re-establishes the min-heap after frames[index] was overwritten.
+static void restore_candidate_heap(std::vector<Track::FrameData>& frames, size_t index) {
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!lower_capture_priority(frames[parent], frames[index])) {
+            break;
+        }
+        std::swap(frames[parent], frames[index]);
+        index = parent;
+    }
+    while (true) {
+        size_t smallest = index;
+        size_t left = index * 2 + 1;
+        size_t right = left + 1;
+        if (left < frames.size() && lower_capture_priority(frames[smallest], frames[left])) {
+            smallest = left;
+        }
+        if (right < frames.size() && lower_capture_priority(frames[smallest], frames[right])) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        std::swap(frames[smallest], frames[index]);
+        index = smallest;
+    }
+}
 
-                if (replace) {
-                    *replace_it = frame_data;
-                    t.best_clarity = std::max(t.best_clarity, frame_data.clarity);
-                    log_debug("Track %d candidate replaced: score=%.2f face=%d area=%.4f",
-                              track_id,
-                              frame_data.score,
-                              is_usable_face_frame(frame_data) ? 1 : 0,
-                              frame_data.area_ratio);
-                }
+static void compress_candidate_images(Track::FrameData& frame) {
+    if (!frame.person_roi.empty() && jpeg_encode_bgr(frame.person_roi, CANDIDATE_JPEG_QUALITY, frame.person_jpeg)) {
+        frame.person_roi.release();
+    }
+    if (!frame.face_roi.empty() && jpeg_encode_bgr(frame.face_roi, CANDIDATE_JPEG_QUALITY, frame.face_jpeg)) {
+        frame.face_roi.release();
+    }
+    if (frame.person_roi.empty() && frame.face_roi.empty()) {
+        frame.source.reset();
+    }
+}
+
+// Number of stored candidates that outrank `priority`.
+static size_t candidate_rank(const Track& t, double priority) {
+    size_t rank = 0;
+    for (const auto& frame : t.frame_candidates) {
+        if (frame.capture_priority > priority) {
+            rank++;
+        }
+    }
+    return rank;
+}
+
+static void store_frame_candidate(Track& t, Track::FrameData&& frame_data) {
+    auto& frames = t.frame_candidates;
+    if (frames.size() < g_max_frame_candidates) {
+        account_candidate(frame_data, true);
+        t.best_clarity = std::max(t.best_clarity, frame_data.clarity);
+        log_debug("Track %d candidate stored: score=%.2f count=%zu face=%d area=%.4f",
+                  t.id,
+                  frame_data.score,
+                  frames.size() + 1,
+                  is_usable_face_frame(frame_data) ? 1 : 0,
+                  frame_data.area_ratio);
+        frames.push_back(std::move(frame_data));
+        std::push_heap(frames.begin(), frames.end(), lower_capture_priority);
+        return;
+    }
+
+    // The lowest-priority candidate is the heap front. It is only spared when
+    // it is also the sharpest strong face frame and the newcomer is not
+    // sharper; then the next-lowest (one of its children) is replaced.
+    size_t replace_index = 0;
+    const auto& front = frames.front();
+    if (frames.size() > 1 &&
+        front.strong_candidate &&
+        front.face_pose_level >= 1 &&
+        frame_data.clarity <= front.clarity * 1.02) {
+        bool front_is_peak = std::none_of(frames.begin() + 1, frames.end(),
+            [&front](const Track::FrameData& f) { return f.clarity > front.clarity; });
+        if (front_is_peak) {
+            replace_index = 1;
+            if (frames.size() > 2 && lower_capture_priority(frames[1], frames[2])) {
+                replace_index = 2;
+            }
+        }
+    }
+
+    Track::FrameData& victim = frames[replace_index];
+    bool replace = false;
+    if (is_usable_face_frame(frame_data) || is_usable_face_frame(victim)) {
+        replace = better_face_capture(frame_data, victim) ||
+                  frame_data.capture_priority > victim.capture_priority + 8.0;
+    } else {
+        replace = better_person_capture(frame_data, victim) ||
+                  person_capture_priority(frame_data) > person_capture_priority(victim) + 10.0;
+    }
+    if (!replace) {
+        return;
+    }
+
+    account_candidate(victim, false);
+    account_candidate(frame_data, true);
+    t.best_clarity = std::max(t.best_clarity, frame_data.clarity);
+    log_debug("Track %d candidate replaced: score=%.2f face=%d area=%.4f",
+              t.id,
+              frame_data.score,
+              is_usable_face_frame(frame_data) ? 1 : 0,
+              frame_data.area_ratio);
+    victim = std::move(frame_data);
+    restore_candidate_heap(frames, replace_index);
+}
+
+// Drops the globally lowest-priority candidates until the store fits the
+// budget. A track's last candidate is never dropped.
+static void enforce_candidate_budget() {
+    if (g_candidate_budget_bytes == 0) {
+        return;
+    }
+    while (candidate_raw_bytes + candidate_jpeg_bytes > g_candidate_budget_bytes) {
+        Track* victim_track = nullptr;
+        for (auto& t : tracks) {
+            if (t.frame_candidates.size() < 2) {
+                continue;
             }
+            if (!victim_track ||
+                t.frame_candidates.front().capture_priority <
+                    victim_track->frame_candidates.front().capture_priority) {
+                victim_track = &t;
+            }
+        }
+        if (!victim_track) {
             break;
         }
+        auto& frames = victim_track->frame_candidates;
+        std::pop_heap(frames.begin(), frames.end(), lower_capture_priority);
+        account_candidate(frames.back(), false);
+        log_debug("Track %d candidate evicted for memory budget: priority=%.1f used=%zuKB",
+                  victim_track->id,
+                  frames.back().capture_priority,
+                  (candidate_raw_bytes + candidate_jpeg_bytes) / 1024);
+        frames.pop_back();
+        candidate_evictions++;
+    }
+}
+
+void add_frame_candidate(int track_id, const Track::FrameData& frame_data) {
+    Track::FrameData candidate = frame_data;
+
+    std::unique_lock<std::mutex> lock(tracks_mutex);
+    Track* t = find_track(track_id);
+    // A finalized track uploads nothing more; jobs already queued or in
+    // flight when it was finalized end up here.
+    if (!t || t->has_captured) {
+        return;
+    }
+    candidate.capture_priority = overall_capture_priority(candidate);
+
+    // Candidates that would land below the raw top entries are kept as JPEG.
+    // Encoding runs on the caller's thread with the tracker unlocked.
+    if (g_candidate_compress_below_top &&
+        candidate_rank(*t, candidate.capture_priority) >= g_candidate_raw_top) {
+        lock.unlock();
+        compress_candidate_images(candidate);
+        lock.lock();
+        t = find_track(track_id);
+        if (!t || t->has_captured) {
+            return;
+        }
+        if (!candidate.person_jpeg.empty() || !candidate.face_jpeg.empty()) {
+            candidate_compressed++;
+        }
+    }
+
+    store_frame_candidate(*t, std::move(candidate));
+    enforce_candidate_budget();
+}
+
+bool finalize_track_capture(int track_id) {
+    std::lock_guard<std::mutex> lock(tracks_mutex);
+    Track* t = find_track(track_id);
+    if (!t || t->has_captured || !upload_callback || !captured_person_ids || !captured_face_ids ||
+        t->frame_candidates.empty()) {
+        return false;
+    }
+    collect_track_upload(*t, early_uploads, true);
+    if (!is_track_fully_captured(track_id)) {
+        return false;
+    }
+    // Nothing is uploaded for this track any more: stop producing
+    // candidates and give the stored ones back to the budget.
+    t->has_captured = true;
+    for (const auto& frame : t->frame_candidates) {
+        account_candidate(frame, false);
+    }
+    t->frame_candidates.clear();
+    log_info("Track %d finalized early", track_id);
+    return true;
+}
+
+void collect_candidate_sources(std::vector<FrameHandle>& sources) {
+    std::lock_guard<std::mutex> lock(tracks_mutex);
+    for (const auto& t : tracks) {
+        for (const auto& frame : t.frame_candidates) {
+            if (frame.source) {
+                sources.push_back(frame.source);
+            }
+        }
+    }
+}
+
+void materialize_candidate_sources(uint64_t seq) {
+    std::lock_guard<std::mutex> lock(tracks_mutex);
+    for (auto& t : tracks) {
+        for (auto& frame : t.frame_candidates) {
+            if (!frame.source || frame.source->seq != seq) {
+                continue;
+            }
+            frame.person_roi = frame.person_roi.clone();
+            frame.face_roi = frame.face_roi.clone();
+            frame.source.reset();
+            account_candidate(frame, true);
+        }
+    }
+    enforce_candidate_budget();
+}
+
+CandidateMemoryStats get_candidate_memory_stats() {
+    std::lock_guard<std::mutex> lock(tracks_mutex);
+    CandidateMemoryStats stats{};
+    stats.rawBytes = candidate_raw_bytes;
+    stats.jpegBytes = candidate_jpeg_bytes;
+    stats.budgetBytes = g_candidate_budget_bytes;
+    stats.tracks = tracks.size();
+    for (const auto& t : tracks) {
+        stats.candidates += t.frame_candidates.size();
     }
+    stats.evictions = candidate_evictions;
+    stats.compressed = candidate_compressed;
+    return stats;
 }
@@ -0,0 +1,182 @@
+#include "quality_metrics.h"
+#include "simd_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// OpenCV's 8-bit BGR2GRAY fixed-point weights (15-bit).
+constexpr int kGrayB = 3735;
+constexpr int kGrayG = 19235;
+constexpr int kGrayR = 9798;
+constexpr int kGrayShift = 15;
+
+inline int reflect101(int i, int n) {
+    if (n == 1) {
+        return 0;
+    }
+    if (i < 0) {
+        return -i;
+    }
+    if (i >= n) {
+        return 2 * n - 2 - i;
+    }
+    return i;
+}
+
+// Border column x with reflected neighbours; the interior of each row goes
+// through simd_gradient_row.
+void borderPixel(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int x, int width,
+                 bool withMagnitude, GradientRowSums& s) {
+    int xl = reflect101(x - 1, width);
+    int xr = reflect101(x + 1, width);
+    int gx = (up[xr] - up[xl]) + 2 * (mid[xr] - mid[xl]) + (down[xr] - down[xl]);
+    int gy = (down[xl] + 2 * down[x] + down[xr]) - (up[xl] + 2 * up[x] + up[xr]);
+    int lap = up[x] + down[x] + mid[xl] + mid[xr] - 4 * mid[x];
+    s.luma += mid[x];
+    s.dx += gx;
+    s.dy += gy;
+    s.dxdx += gx * gx;
+    s.dydy += gy * gy;
+    s.dxdy += gx * gy;
+    s.lap += lap;
+    s.laplap += lap * lap;
+    if (withMagnitude) {
+        s.magnitude += std::sqrt(static_cast<float>(gx * gx + gy * gy));
+    }
+}
+
+void gradientPass(const uint8_t* gray, int width, int height, size_t stride, bool withMagnitude,
+                  GradientRowSums& s) {
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* up = gray + reflect101(y - 1, height) * stride;
+        const uint8_t* mid = gray + y * stride;
+        const uint8_t* down = gray + reflect101(y + 1, height) * stride;
+
+        borderPixel(up, mid, down, 0, width, withMagnitude, s);
+        simd_gradient_row(up, mid, down, width, withMagnitude, s);
+        if (width > 1) {
+            borderPixel(up, mid, down, width - 1, width, withMagnitude, s);
+        }
+    }
+}
+
+// Same as warpAffine by an integer (dx, dy) with BORDER_REPLICATE followed by
+// mean(absdiff(gray, shifted)).
+double shiftTrail(const uint8_t* gray, int width, int height, size_t stride, int dx, int dy) {
+    int64_t total = 0;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = gray + y * stride;
+        const uint8_t* src = gray + std::min(height - 1, std::max(0, y - dy)) * stride;
+        int x0 = std::min(width, std::max(0, dx));
+        int x1 = std::max(x0, std::min(width, width + dx));
+        for (int x = 0; x < x0; ++x) {
+            total += std::abs(row[x] - src[0]);
+        }
+        for (int x = x0; x < x1; ++x) {
+            total += std::abs(row[x] - src[x - dx]);
+        }
+        for (int x = x1; x < width; ++x) {
+            total += std::abs(row[x] - src[width - 1]);
+        }
+    }
+    return static_cast<double>(total) / (static_cast<double>(width) * height);
+}
+
+void shiftFromAngle(double radians, int& dx, int& dy) {
+    dx = static_cast<int>(std::round(std::cos(radians) * 2.0));
+    dy = static_cast<int>(std::round(std::sin(radians) * 2.0));
+    if (dx == 0 && dy == 0) {
+        dx = 1;
+    }
+}
+
+}  // namespace
+
+double QualityMetrics::directionalRatio() const {
+    return std::min(gradEnergyX, gradEnergyY) / (std::max(gradEnergyX, gradEnergyY) + 1e-6);
+}
+
+double QualityMetrics::blurAngleDeg() const {
+    double theta = 0.5 * std::atan2(2.0 * tensorXY, tensorXX - tensorYY);
+    return theta * 180.0 / CV_PI;
+}
+
+float QualityMetrics::motionBlurSeverity() const {
+    double total_energy = gradEnergyX + gradEnergyY;
+    if (!valid || total_energy < 1.0) {
+        return 1.0f;
+    }
+    float dir_severity = std::max(0.0f, std::min(1.0f, static_cast<float>(1.0 - directionalRatio())));
+    float sharpness_severity = std::max(0.0f, std::min(1.0f, static_cast<float>((200.0 - laplacianVar) / 200.0)));
+    float trail_severity = trailMeanGradient < 0.0 ? 0.0f :
+        std::max(0.0f, std::min(1.0f, static_cast<float>((16.0 - trailMeanGradient) / 16.0)));
+    float severity = dir_severity * 0.25f + sharpness_severity * 0.45f + trail_severity * 0.30f;
+    return std::max(0.0f, std::min(1.0f, severity));
+}
+
+bool compute_quality_metrics(const uint8_t* gray, int width, int height, size_t stride,
+                             QualityMetrics& out, unsigned flags) {
+    out = QualityMetrics();
+    if (!gray || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    GradientRowSums s;
+    gradientPass(gray, width, height, stride, (flags & QUALITY_GRADIENT_MAGNITUDE) != 0, s);
+
+    const double n = static_cast<double>(width) * height;
+    out.width = width;
+    out.height = height;
+    out.lumaMean = s.luma / n;
+    out.gradMeanX = s.dx / n;
+    out.gradMeanY = s.dy / n;
+    out.tensorXX = s.dxdx / n;
+    out.tensorYY = s.dydy / n;
+    out.tensorXY = s.dxdy / n;
+    out.gradEnergyX = std::max(0.0, out.tensorXX - out.gradMeanX * out.gradMeanX);
+    out.gradEnergyY = std::max(0.0, out.tensorYY - out.gradMeanY * out.gradMeanY);
+    out.gradMagnitudeMean = s.magnitude / n;
+    double lapMean = s.lap / n;
+    out.laplacianVar = std::max(0.0, s.laplap / n - lapMean * lapMean);
+
+    if (flags & QUALITY_SHIFT_TRAILS) {
+        int mdx, mdy, sdx, sdy;
+        shiftFromAngle(std::atan2(out.gradMeanY, out.gradMeanX), mdx, mdy);
+        shiftFromAngle(out.blurAngleDeg() * CV_PI / 180.0, sdx, sdy);
+        out.trailMeanGradient = shiftTrail(gray, width, height, stride, mdx, mdy);
+        out.trailStructure = (sdx == mdx && sdy == mdy)
+            ? out.trailMeanGradient
+            : shiftTrail(gray, width, height, stride, sdx, sdy);
+    }
+    out.valid = true;
+    return true;
+}
+
+bool compute_quality_metrics(const cv::Mat& img, QualityMetrics& out, unsigned flags) {
+    if (img.empty() || img.depth() != CV_8U) {
+        out = QualityMetrics();
+        return false;
+    }
+    if (img.channels() == 1) {
+        return compute_quality_metrics(img.data, img.cols, img.rows, img.step, out, flags);
+    }
+    if (img.channels() != 3) {
+        out = QualityMetrics();
+        return false;
+    }
+
+    thread_local std::vector<uint8_t> grayBuffer;
+    grayBuffer.resize(static_cast<size_t>(img.cols) * img.rows);
+    for (int y = 0; y < img.rows; ++y) {
+        const uint8_t* src = img.ptr<uint8_t>(y);
+        uint8_t* dst = grayBuffer.data() + static_cast<size_t>(y) * img.cols;
+        for (int x = 0; x < img.cols; ++x, src += 3) {
+            dst[x] = static_cast<uint8_t>((src[0] * kGrayB + src[1] * kGrayG + src[2] * kGrayR +
+                                           (1 << (kGrayShift - 1))) >> kGrayShift);
+        }
+    }
+    return compute_quality_metrics(grayBuffer.data(), img.cols, img.rows, img.cols, out, flags);
+}
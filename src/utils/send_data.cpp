@@ -1,4 +1,5 @@
 #include "send_data.h"
+#include "jpeg_encoder.h"
 #include <opencv2/imgcodecs.hpp>
 #include <string>
 #include <vector>
@@ -9,7 +10,9 @@
 
 std::string image_to_base64(const cv::Mat& img, const std::string& ext = ".jpg") {
     std::vector<uchar> buf;
-    if (!cv::imencode(ext, img, buf)) {
+    // 95 与 imencode 的默认 JPEG 质量一致
+    bool encoded = ext == ".jpg" ? jpeg_encode_bgr(img, 95, buf) : cv::imencode(ext, img, buf);
+    if (!encoded) {
         return "";  
     }
 
@@ -0,0 +1,797 @@
+#include "simd_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_KERNELS_NEON 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_KERNELS_X86 1
+#endif
+
+namespace {
+
+// 32-bit lane accumulators are flushed to 64-bit sums at least this often so
+// squared 10-bit gradients cannot overflow on very wide rows.
+constexpr int kGradientBlock = 1024;
+
+struct KernelTable {
+    SimdLevel level;
+    void (*median)(const uint8_t* const*, int, uint8_t*, size_t);
+    void (*deinterleaveU8)(const uint8_t*, uint8_t*, uint8_t*, uint8_t*, size_t);
+    void (*deinterleaveF32)(const float*, float*, float*, float*, size_t);
+    void (*iou)(float, float, float, float, float, const float*, const float*, const float*,
+                const float*, const float*, size_t, float*);
+    void (*gradient)(const uint8_t*, const uint8_t*, const uint8_t*, int, bool, GradientRowSums&);
+    void (*dotBatch)(const float*, const float* const*, size_t, size_t, float*);
+};
+
+// -------------------- scalar reference --------------------
+
+// Odd-even transposition network: after count rounds v is sorted, so v[mid]
+// equals what nth_element would select. The SIMD versions run the same
+// network with lane-wise min/max.
+template <typename T, typename MinFn, typename MaxFn>
+inline void sortNetwork(T* v, int count, MinFn vmin, MaxFn vmax) {
+    for (int round = 0; round < count; ++round) {
+        for (int i = round & 1; i + 1 < count; i += 2) {
+            T lo = vmin(v[i], v[i + 1]);
+            v[i + 1] = vmax(v[i], v[i + 1]);
+            v[i] = lo;
+        }
+    }
+}
+
+void medianScalarRange(const uint8_t* const* srcs, int count, uint8_t* dst, size_t begin, size_t len) {
+    uint8_t v[kSimdMedianMaxInputs] = {};
+    auto vmin = [](uint8_t a, uint8_t b) { return std::min(a, b); };
+    auto vmax = [](uint8_t a, uint8_t b) { return std::max(a, b); };
+    for (size_t i = begin; i < len; ++i) {
+        for (int f = 0; f < count; ++f) {
+            v[f] = srcs[f][i];
+        }
+        sortNetwork(v, count, vmin, vmax);
+        dst[i] = v[count / 2];
+    }
+}
+
+void medianScalar(const uint8_t* const* srcs, int count, uint8_t* dst, size_t len) {
+    medianScalarRange(srcs, count, dst, 0, len);
+}
+
+void deinterleaveU8Scalar(const uint8_t* src, uint8_t* d0, uint8_t* d1, uint8_t* d2, size_t pixels) {
+    for (size_t i = 0; i < pixels; ++i) {
+        d0[i] = src[i * 3];
+        d1[i] = src[i * 3 + 1];
+        d2[i] = src[i * 3 + 2];
+    }
+}
+
+void deinterleaveF32Scalar(const float* src, float* d0, float* d1, float* d2, size_t pixels) {
+    for (size_t i = 0; i < pixels; ++i) {
+        d0[i] = src[i * 3];
+        d1[i] = src[i * 3 + 1];
+        d2[i] = src[i * 3 + 2];
+    }
+}
+
+inline float iouOne(float ax1, float ay1, float ax2, float ay2, float areaA,
+                    float bx1, float by1, float bx2, float by2, float areaB) {
+    float w = std::max(0.0f, std::min(ax2, bx2) - std::max(ax1, bx1));
+    float h = std::max(0.0f, std::min(ay2, by2) - std::max(ay1, by1));
+    float inter = w * h;
+    return inter / (areaA + areaB - inter + 1e-6f);
+}
+
+void iouScalar(float ax1, float ay1, float ax2, float ay2, float areaA,
+               const float* x1, const float* y1, const float* x2, const float* y2,
+               const float* area, size_t count, float* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = iouOne(ax1, ay1, ax2, ay2, areaA, x1[i], y1[i], x2[i], y2[i], area[i]);
+    }
+}
+
+inline void gradientPixel(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int x,
+                          bool withMagnitude, GradientRowSums& s) {
+    int gx = (up[x + 1] - up[x - 1]) + 2 * (mid[x + 1] - mid[x - 1]) + (down[x + 1] - down[x - 1]);
+    int gy = (down[x - 1] + 2 * down[x] + down[x + 1]) - (up[x - 1] + 2 * up[x] + up[x + 1]);
+    int lap = up[x] + down[x] + mid[x - 1] + mid[x + 1] - 4 * mid[x];
+    s.luma += mid[x];
+    s.dx += gx;
+    s.dy += gy;
+    s.dxdx += gx * gx;
+    s.dydy += gy * gy;
+    s.dxdy += gx * gy;
+    s.lap += lap;
+    s.laplap += lap * lap;
+    if (withMagnitude) {
+        s.magnitude += std::sqrt(static_cast<float>(gx * gx + gy * gy));
+    }
+}
+
+void gradientScalarRange(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int begin, int end,
+                         bool withMagnitude, GradientRowSums& s) {
+    for (int x = begin; x < end; ++x) {
+        gradientPixel(up, mid, down, x, withMagnitude, s);
+    }
+}
+
+void gradientScalar(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int width,
+                    bool withMagnitude, GradientRowSums& s) {
+    gradientScalarRange(up, mid, down, 1, width - 1, withMagnitude, s);
+}
+
+inline float dotScalarOne(const float* a, const float* b, size_t len) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < len; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void dotBatchScalar(const float* a, const float* const* bs, size_t count, size_t len, float* out) {
+    for (size_t k = 0; k < count; ++k) {
+        out[k] = dotScalarOne(a, bs[k], len);
+    }
+}
+
+const KernelTable kScalarTable = {
+    SIMD_SCALAR, medianScalar, deinterleaveU8Scalar, deinterleaveF32Scalar, iouScalar, gradientScalar,
+    dotBatchScalar,
+};
+
+// -------------------- NEON (aarch64) --------------------
+#if defined(SIMD_KERNELS_NEON)
+
+template <int N>
+void medianNeonN(const uint8_t* const* srcs, uint8_t* dst, size_t len) {
+    auto vmin = [](uint8x16_t a, uint8x16_t b) { return vminq_u8(a, b); };
+    auto vmax = [](uint8x16_t a, uint8x16_t b) { return vmaxq_u8(a, b); };
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v[N];
+        for (int f = 0; f < N; ++f) {
+            v[f] = vld1q_u8(srcs[f] + i);
+        }
+        sortNetwork(v, N, vmin, vmax);
+        vst1q_u8(dst + i, v[N / 2]);
+    }
+    medianScalarRange(srcs, N, dst, i, len);
+}
+
+void medianNeon(const uint8_t* const* srcs, int count, uint8_t* dst, size_t len) {
+    switch (count) {
+        case 3: medianNeonN<3>(srcs, dst, len); break;
+        case 4: medianNeonN<4>(srcs, dst, len); break;
+        case 5: medianNeonN<5>(srcs, dst, len); break;
+        case 6: medianNeonN<6>(srcs, dst, len); break;
+        case 7: medianNeonN<7>(srcs, dst, len); break;
+        case 8: medianNeonN<8>(srcs, dst, len); break;
+        default: medianScalar(srcs, count, dst, len); break;
+    }
+}
+
+void deinterleaveU8Neon(const uint8_t* src, uint8_t* d0, uint8_t* d1, uint8_t* d2, size_t pixels) {
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x3_t px = vld3q_u8(src + i * 3);
+        vst1q_u8(d0 + i, px.val[0]);
+        vst1q_u8(d1 + i, px.val[1]);
+        vst1q_u8(d2 + i, px.val[2]);
+    }
+    deinterleaveU8Scalar(src + i * 3, d0 + i, d1 + i, d2 + i, pixels - i);
+}
+
+void deinterleaveF32Neon(const float* src, float* d0, float* d1, float* d2, size_t pixels) {
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        float32x4x3_t px = vld3q_f32(src + i * 3);
+        vst1q_f32(d0 + i, px.val[0]);
+        vst1q_f32(d1 + i, px.val[1]);
+        vst1q_f32(d2 + i, px.val[2]);
+    }
+    deinterleaveF32Scalar(src + i * 3, d0 + i, d1 + i, d2 + i, pixels - i);
+}
+
+void iouNeon(float ax1, float ay1, float ax2, float ay2, float areaA,
+             const float* x1, const float* y1, const float* x2, const float* y2,
+             const float* area, size_t count, float* out) {
+    const float32x4_t vax1 = vdupq_n_f32(ax1), vay1 = vdupq_n_f32(ay1);
+    const float32x4_t vax2 = vdupq_n_f32(ax2), vay2 = vdupq_n_f32(ay2);
+    const float32x4_t varea = vdupq_n_f32(areaA), zero = vdupq_n_f32(0.0f), eps = vdupq_n_f32(1e-6f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t w = vmaxq_f32(zero, vsubq_f32(vminq_f32(vax2, vld1q_f32(x2 + i)),
+                                                  vmaxq_f32(vax1, vld1q_f32(x1 + i))));
+        float32x4_t h = vmaxq_f32(zero, vsubq_f32(vminq_f32(vay2, vld1q_f32(y2 + i)),
+                                                  vmaxq_f32(vay1, vld1q_f32(y1 + i))));
+        float32x4_t inter = vmulq_f32(w, h);
+        float32x4_t uni = vaddq_f32(vsubq_f32(vaddq_f32(varea, vld1q_f32(area + i)), inter), eps);
+        vst1q_f32(out + i, vdivq_f32(inter, uni));
+    }
+    iouScalar(ax1, ay1, ax2, ay2, areaA, x1 + i, y1 + i, x2 + i, y2 + i, area + i, count - i, out + i);
+}
+
+void gradientNeon(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int width,
+                  bool withMagnitude, GradientRowSums& s) {
+    int x = 1;
+    const int end = width - 1;
+    while (x + 8 <= end) {
+        int32x4_t aLuma = vdupq_n_s32(0), aDx = aLuma, aDy = aLuma, aLap = aLuma;
+        int32x4_t aDxDx = aLuma, aDyDy = aLuma, aDxDy = aLuma, aLapLap = aLuma;
+        float32x4_t aMag = vdupq_n_f32(0.0f);
+        const int blockEnd = std::min(end, x + kGradientBlock);
+        for (; x + 8 <= blockEnd; x += 8) {
+            uint8x8_t ul = vld1_u8(up + x - 1), uc = vld1_u8(up + x), ur = vld1_u8(up + x + 1);
+            uint8x8_t ml = vld1_u8(mid + x - 1), mc = vld1_u8(mid + x), mr = vld1_u8(mid + x + 1);
+            uint8x8_t dl = vld1_u8(down + x - 1), dc = vld1_u8(down + x), dr = vld1_u8(down + x + 1);
+
+            int16x8_t gx = vreinterpretq_s16_u16(vsubl_u8(ur, ul));
+            gx = vaddq_s16(gx, vshlq_n_s16(vreinterpretq_s16_u16(vsubl_u8(mr, ml)), 1));
+            gx = vaddq_s16(gx, vreinterpretq_s16_u16(vsubl_u8(dr, dl)));
+            uint16x8_t rowDown = vaddq_u16(vaddl_u8(dl, dr), vshll_n_u8(dc, 1));
+            uint16x8_t rowUp = vaddq_u16(vaddl_u8(ul, ur), vshll_n_u8(uc, 1));
+            int16x8_t gy = vreinterpretq_s16_u16(vsubq_u16(rowDown, rowUp));
+            uint16x8_t cross = vaddq_u16(vaddl_u8(uc, dc), vaddl_u8(ml, mr));
+            int16x8_t lap = vreinterpretq_s16_u16(vsubq_u16(cross, vshll_n_u8(mc, 2)));
+
+            aLuma = vreinterpretq_s32_u32(vpadalq_u16(vreinterpretq_u32_s32(aLuma), vmovl_u8(mc)));
+            aDx = vpadalq_s16(aDx, gx);
+            aDy = vpadalq_s16(aDy, gy);
+            aLap = vpadalq_s16(aLap, lap);
+            int16x4_t gxl = vget_low_s16(gx), gxh = vget_high_s16(gx);
+            int16x4_t gyl = vget_low_s16(gy), gyh = vget_high_s16(gy);
+            int16x4_t lpl = vget_low_s16(lap), lph = vget_high_s16(lap);
+            aDxDx = vmlal_s16(vmlal_s16(aDxDx, gxl, gxl), gxh, gxh);
+            aDyDy = vmlal_s16(vmlal_s16(aDyDy, gyl, gyl), gyh, gyh);
+            aDxDy = vmlal_s16(vmlal_s16(aDxDy, gxl, gyl), gxh, gyh);
+            aLapLap = vmlal_s16(vmlal_s16(aLapLap, lpl, lpl), lph, lph);
+            if (withMagnitude) {
+                int32x4_t sqLo = vmlal_s16(vmull_s16(gxl, gxl), gyl, gyl);
+                int32x4_t sqHi = vmlal_s16(vmull_s16(gxh, gxh), gyh, gyh);
+                aMag = vaddq_f32(aMag, vsqrtq_f32(vcvtq_f32_s32(sqLo)));
+                aMag = vaddq_f32(aMag, vsqrtq_f32(vcvtq_f32_s32(sqHi)));
+            }
+        }
+        s.luma += vaddlvq_s32(aLuma);
+        s.dx += vaddlvq_s32(aDx);
+        s.dy += vaddlvq_s32(aDy);
+        s.lap += vaddlvq_s32(aLap);
+        s.dxdx += vaddlvq_s32(aDxDx);
+        s.dydy += vaddlvq_s32(aDyDy);
+        s.dxdy += vaddlvq_s32(aDxDy);
+        s.laplap += vaddlvq_s32(aLapLap);
+        s.magnitude += vaddvq_f32(aMag);
+    }
+    gradientScalarRange(up, mid, down, x, end, withMagnitude, s);
+}
+
+// Four candidates per pass share each load of a.
+void dotBatchNeon(const float* a, const float* const* bs, size_t count, size_t len, float* out) {
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        const float* b0 = bs[k];
+        const float* b1 = bs[k + 1];
+        const float* b2 = bs[k + 2];
+        const float* b3 = bs[k + 3];
+        float32x4_t s0 = vdupq_n_f32(0.0f), s1 = s0, s2 = s0, s3 = s0;
+        size_t i = 0;
+        for (; i + 4 <= len; i += 4) {
+            float32x4_t va = vld1q_f32(a + i);
+            s0 = vfmaq_f32(s0, va, vld1q_f32(b0 + i));
+            s1 = vfmaq_f32(s1, va, vld1q_f32(b1 + i));
+            s2 = vfmaq_f32(s2, va, vld1q_f32(b2 + i));
+            s3 = vfmaq_f32(s3, va, vld1q_f32(b3 + i));
+        }
+        out[k] = vaddvq_f32(s0) + dotScalarOne(a + i, b0 + i, len - i);
+        out[k + 1] = vaddvq_f32(s1) + dotScalarOne(a + i, b1 + i, len - i);
+        out[k + 2] = vaddvq_f32(s2) + dotScalarOne(a + i, b2 + i, len - i);
+        out[k + 3] = vaddvq_f32(s3) + dotScalarOne(a + i, b3 + i, len - i);
+    }
+    for (; k < count; ++k) {
+        const float* b = bs[k];
+        float32x4_t s0 = vdupq_n_f32(0.0f);
+        size_t i = 0;
+        for (; i + 4 <= len; i += 4) {
+            s0 = vfmaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+        }
+        out[k] = vaddvq_f32(s0) + dotScalarOne(a + i, b + i, len - i);
+    }
+}
+
+const KernelTable kNeonTable = {
+    SIMD_NEON, medianNeon, deinterleaveU8Neon, deinterleaveF32Neon, iouNeon, gradientNeon, dotBatchNeon,
+};
+
+#endif  // SIMD_KERNELS_NEON
+
+// -------------------- x86: SSE2 / SSSE3 / AVX2 --------------------
+#if defined(SIMD_KERNELS_X86)
+
+inline int64_t horizontalSum(__m128i v) {
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+inline double horizontalSum(__m128 v) {
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, v);
+    return static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+
+template <int N>
+void medianSse2N(const uint8_t* const* srcs, uint8_t* dst, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v[N];
+        for (int f = 0; f < N; ++f) {
+            v[f] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcs[f] + i));
+        }
+        for (int round = 0; round < N; ++round) {
+            for (int k = round & 1; k + 1 < N; k += 2) {
+                __m128i lo = _mm_min_epu8(v[k], v[k + 1]);
+                v[k + 1] = _mm_max_epu8(v[k], v[k + 1]);
+                v[k] = lo;
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v[N / 2]);
+    }
+    medianScalarRange(srcs, N, dst, i, len);
+}
+
+void medianSse2(const uint8_t* const* srcs, int count, uint8_t* dst, size_t len) {
+    switch (count) {
+        case 3: medianSse2N<3>(srcs, dst, len); break;
+        case 4: medianSse2N<4>(srcs, dst, len); break;
+        case 5: medianSse2N<5>(srcs, dst, len); break;
+        case 6: medianSse2N<6>(srcs, dst, len); break;
+        case 7: medianSse2N<7>(srcs, dst, len); break;
+        case 8: medianSse2N<8>(srcs, dst, len); break;
+        default: medianScalar(srcs, count, dst, len); break;
+    }
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+
+// 16 pixels = 48 bytes in three registers; each output plane gathers its
+// bytes from all three with pshufb (0x80 lanes become zero) and ORs them.
+void deinterleaveU8Ssse3(const uint8_t* src, uint8_t* d0, uint8_t* d1, uint8_t* d2, size_t pixels) {
+    alignas(16) uint8_t masks[3][3][16];
+    for (int ch = 0; ch < 3; ++ch) {
+        for (int part = 0; part < 3; ++part) {
+            for (int p = 0; p < 16; ++p) {
+                int byte = p * 3 + ch;
+                masks[ch][part][p] = (byte / 16 == part) ? static_cast<uint8_t>(byte % 16) : 0x80;
+            }
+        }
+    }
+    __m128i m[3][3];
+    for (int ch = 0; ch < 3; ++ch) {
+        for (int part = 0; part < 3; ++part) {
+            m[ch][part] = _mm_load_si128(reinterpret_cast<const __m128i*>(masks[ch][part]));
+        }
+    }
+    uint8_t* dst[3] = {d0, d1, d2};
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(src + i * 3);
+        __m128i a = _mm_loadu_si128(in), b = _mm_loadu_si128(in + 1), c = _mm_loadu_si128(in + 2);
+        for (int ch = 0; ch < 3; ++ch) {
+            __m128i plane = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m[ch][0]),
+                                                      _mm_shuffle_epi8(b, m[ch][1])),
+                                         _mm_shuffle_epi8(c, m[ch][2]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[ch] + i), plane);
+        }
+    }
+    deinterleaveU8Scalar(src + i * 3, d0 + i, d1 + i, d2 + i, pixels - i);
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+
+// a = r0 g0 b0 r1, b = g1 b1 r2 g2, c = b2 r3 g3 b3
+void deinterleaveF32Sse2(const float* src, float* d0, float* d1, float* d2, size_t pixels) {
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        const float* p = src + i * 3;
+        __m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+        __m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));       // r2 r2 r3 r3
+        __m128 r = _mm_shuffle_ps(a, bc, _MM_SHUFFLE(2, 0, 3, 0));       // r0 r1 r2 r3
+        __m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));       // g0 g0 g1 g1
+        __m128 bc2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));      // g2 g2 g3 g3
+        __m128 g = _mm_shuffle_ps(ab, bc2, _MM_SHUFFLE(2, 0, 2, 0));     // g0 g1 g2 g3
+        __m128 ab2 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));      // b0 b0 b1 b1
+        __m128 cc = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));       // b2 b2 b3 b3
+        __m128 bl = _mm_shuffle_ps(ab2, cc, _MM_SHUFFLE(2, 0, 2, 0));    // b0 b1 b2 b3
+        _mm_storeu_ps(d0 + i, r);
+        _mm_storeu_ps(d1 + i, g);
+        _mm_storeu_ps(d2 + i, bl);
+    }
+    deinterleaveF32Scalar(src + i * 3, d0 + i, d1 + i, d2 + i, pixels - i);
+}
+
+void iouSse2(float ax1, float ay1, float ax2, float ay2, float areaA,
+             const float* x1, const float* y1, const float* x2, const float* y2,
+             const float* area, size_t count, float* out) {
+    const __m128 vax1 = _mm_set1_ps(ax1), vay1 = _mm_set1_ps(ay1);
+    const __m128 vax2 = _mm_set1_ps(ax2), vay2 = _mm_set1_ps(ay2);
+    const __m128 varea = _mm_set1_ps(areaA), zero = _mm_setzero_ps(), eps = _mm_set1_ps(1e-6f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 w = _mm_max_ps(zero, _mm_sub_ps(_mm_min_ps(vax2, _mm_loadu_ps(x2 + i)),
+                                               _mm_max_ps(vax1, _mm_loadu_ps(x1 + i))));
+        __m128 h = _mm_max_ps(zero, _mm_sub_ps(_mm_min_ps(vay2, _mm_loadu_ps(y2 + i)),
+                                               _mm_max_ps(vay1, _mm_loadu_ps(y1 + i))));
+        __m128 inter = _mm_mul_ps(w, h);
+        __m128 uni = _mm_add_ps(_mm_sub_ps(_mm_add_ps(varea, _mm_loadu_ps(area + i)), inter), eps);
+        _mm_storeu_ps(out + i, _mm_div_ps(inter, uni));
+    }
+    iouScalar(ax1, ay1, ax2, ay2, areaA, x1 + i, y1 + i, x2 + i, y2 + i, area + i, count - i, out + i);
+}
+
+void gradientSse2(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int width,
+                  bool withMagnitude, GradientRowSums& s) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    auto load8 = [&](const uint8_t* p) {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+    };
+    int x = 1;
+    const int end = width - 1;
+    while (x + 8 <= end) {
+        __m128i aLuma = zero, aDx = zero, aDy = zero, aLap = zero;
+        __m128i aDxDx = zero, aDyDy = zero, aDxDy = zero, aLapLap = zero;
+        __m128 aMag = _mm_setzero_ps();
+        const int blockEnd = std::min(end, x + kGradientBlock);
+        for (; x + 8 <= blockEnd; x += 8) {
+            __m128i ul = load8(up + x - 1), uc = load8(up + x), ur = load8(up + x + 1);
+            __m128i ml = load8(mid + x - 1), mc = load8(mid + x), mr = load8(mid + x + 1);
+            __m128i dl = load8(down + x - 1), dc = load8(down + x), dr = load8(down + x + 1);
+
+            __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(ur, ul), _mm_sub_epi16(dr, dl)),
+                                       _mm_slli_epi16(_mm_sub_epi16(mr, ml), 1));
+            __m128i rowDown = _mm_add_epi16(_mm_add_epi16(dl, dr), _mm_slli_epi16(dc, 1));
+            __m128i rowUp = _mm_add_epi16(_mm_add_epi16(ul, ur), _mm_slli_epi16(uc, 1));
+            __m128i gy = _mm_sub_epi16(rowDown, rowUp);
+            __m128i lap = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(uc, dc), _mm_add_epi16(ml, mr)),
+                                        _mm_slli_epi16(mc, 2));
+
+            aLuma = _mm_add_epi32(aLuma, _mm_madd_epi16(mc, ones));
+            aDx = _mm_add_epi32(aDx, _mm_madd_epi16(gx, ones));
+            aDy = _mm_add_epi32(aDy, _mm_madd_epi16(gy, ones));
+            aLap = _mm_add_epi32(aLap, _mm_madd_epi16(lap, ones));
+            aDxDx = _mm_add_epi32(aDxDx, _mm_madd_epi16(gx, gx));
+            aDyDy = _mm_add_epi32(aDyDy, _mm_madd_epi16(gy, gy));
+            aDxDy = _mm_add_epi32(aDxDy, _mm_madd_epi16(gx, gy));
+            aLapLap = _mm_add_epi32(aLapLap, _mm_madd_epi16(lap, lap));
+            if (withMagnitude) {
+                __m128i lo = _mm_unpacklo_epi16(gx, gy);
+                __m128i hi = _mm_unpackhi_epi16(gx, gy);
+                aMag = _mm_add_ps(aMag, _mm_sqrt_ps(_mm_cvtepi32_ps(_mm_madd_epi16(lo, lo))));
+                aMag = _mm_add_ps(aMag, _mm_sqrt_ps(_mm_cvtepi32_ps(_mm_madd_epi16(hi, hi))));
+            }
+        }
+        s.luma += horizontalSum(aLuma);
+        s.dx += horizontalSum(aDx);
+        s.dy += horizontalSum(aDy);
+        s.lap += horizontalSum(aLap);
+        s.dxdx += horizontalSum(aDxDx);
+        s.dydy += horizontalSum(aDyDy);
+        s.dxdy += horizontalSum(aDxDy);
+        s.laplap += horizontalSum(aLapLap);
+        s.magnitude += horizontalSum(aMag);
+    }
+    gradientScalarRange(up, mid, down, x, end, withMagnitude, s);
+}
+
+// Four candidates per pass share each load of a.
+void dotBatchSse2(const float* a, const float* const* bs, size_t count, size_t len, float* out) {
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        const float* b0 = bs[k];
+        const float* b1 = bs[k + 1];
+        const float* b2 = bs[k + 2];
+        const float* b3 = bs[k + 3];
+        __m128 s0 = _mm_setzero_ps(), s1 = s0, s2 = s0, s3 = s0;
+        size_t i = 0;
+        for (; i + 4 <= len; i += 4) {
+            __m128 va = _mm_loadu_ps(a + i);
+            s0 = _mm_add_ps(s0, _mm_mul_ps(va, _mm_loadu_ps(b0 + i)));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(va, _mm_loadu_ps(b1 + i)));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(va, _mm_loadu_ps(b2 + i)));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(va, _mm_loadu_ps(b3 + i)));
+        }
+        out[k] = static_cast<float>(horizontalSum(s0)) + dotScalarOne(a + i, b0 + i, len - i);
+        out[k + 1] = static_cast<float>(horizontalSum(s1)) + dotScalarOne(a + i, b1 + i, len - i);
+        out[k + 2] = static_cast<float>(horizontalSum(s2)) + dotScalarOne(a + i, b2 + i, len - i);
+        out[k + 3] = static_cast<float>(horizontalSum(s3)) + dotScalarOne(a + i, b3 + i, len - i);
+    }
+    for (; k < count; ++k) {
+        const float* b = bs[k];
+        __m128 s0 = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= len; i += 4) {
+            s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        }
+        out[k] = static_cast<float>(horizontalSum(s0)) + dotScalarOne(a + i, b + i, len - i);
+    }
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+template <int N>
+void medianAvx2N(const uint8_t* const* srcs, uint8_t* dst, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v[N];
+        for (int f = 0; f < N; ++f) {
+            v[f] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcs[f] + i));
+        }
+        for (int round = 0; round < N; ++round) {
+            for (int k = round & 1; k + 1 < N; k += 2) {
+                __m256i lo = _mm256_min_epu8(v[k], v[k + 1]);
+                v[k + 1] = _mm256_max_epu8(v[k], v[k + 1]);
+                v[k] = lo;
+            }
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v[N / 2]);
+    }
+    medianScalarRange(srcs, N, dst, i, len);
+}
+
+void medianAvx2(const uint8_t* const* srcs, int count, uint8_t* dst, size_t len) {
+    switch (count) {
+        case 3: medianAvx2N<3>(srcs, dst, len); break;
+        case 4: medianAvx2N<4>(srcs, dst, len); break;
+        case 5: medianAvx2N<5>(srcs, dst, len); break;
+        case 6: medianAvx2N<6>(srcs, dst, len); break;
+        case 7: medianAvx2N<7>(srcs, dst, len); break;
+        case 8: medianAvx2N<8>(srcs, dst, len); break;
+        default: medianScalar(srcs, count, dst, len); break;
+    }
+}
+
+inline __m256i load16(const uint8_t* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+inline int64_t horizontalSum256(__m256i v) {
+    return horizontalSum(_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+inline double horizontalSum256(__m256 v) {
+    return horizontalSum(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+void gradientAvx2(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int width,
+                  bool withMagnitude, GradientRowSums& s) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    int x = 1;
+    const int end = width - 1;
+    while (x + 16 <= end) {
+        __m256i aLuma = zero, aDx = zero, aDy = zero, aLap = zero;
+        __m256i aDxDx = zero, aDyDy = zero, aDxDy = zero, aLapLap = zero;
+        __m256 aMag = _mm256_setzero_ps();
+        const int blockEnd = std::min(end, x + kGradientBlock);
+        for (; x + 16 <= blockEnd; x += 16) {
+            __m256i ul = load16(up + x - 1), uc = load16(up + x), ur = load16(up + x + 1);
+            __m256i ml = load16(mid + x - 1), mc = load16(mid + x), mr = load16(mid + x + 1);
+            __m256i dl = load16(down + x - 1), dc = load16(down + x), dr = load16(down + x + 1);
+
+            __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(ur, ul), _mm256_sub_epi16(dr, dl)),
+                                          _mm256_slli_epi16(_mm256_sub_epi16(mr, ml), 1));
+            __m256i rowDown = _mm256_add_epi16(_mm256_add_epi16(dl, dr), _mm256_slli_epi16(dc, 1));
+            __m256i rowUp = _mm256_add_epi16(_mm256_add_epi16(ul, ur), _mm256_slli_epi16(uc, 1));
+            __m256i gy = _mm256_sub_epi16(rowDown, rowUp);
+            __m256i lap = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(uc, dc), _mm256_add_epi16(ml, mr)),
+                                           _mm256_slli_epi16(mc, 2));
+
+            aLuma = _mm256_add_epi32(aLuma, _mm256_madd_epi16(mc, ones));
+            aDx = _mm256_add_epi32(aDx, _mm256_madd_epi16(gx, ones));
+            aDy = _mm256_add_epi32(aDy, _mm256_madd_epi16(gy, ones));
+            aLap = _mm256_add_epi32(aLap, _mm256_madd_epi16(lap, ones));
+            aDxDx = _mm256_add_epi32(aDxDx, _mm256_madd_epi16(gx, gx));
+            aDyDy = _mm256_add_epi32(aDyDy, _mm256_madd_epi16(gy, gy));
+            aDxDy = _mm256_add_epi32(aDxDy, _mm256_madd_epi16(gx, gy));
+            aLapLap = _mm256_add_epi32(aLapLap, _mm256_madd_epi16(lap, lap));
+            if (withMagnitude) {
+                __m256i lo = _mm256_unpacklo_epi16(gx, gy);
+                __m256i hi = _mm256_unpackhi_epi16(gx, gy);
+                aMag = _mm256_add_ps(aMag, _mm256_sqrt_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(lo, lo))));
+                aMag = _mm256_add_ps(aMag, _mm256_sqrt_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(hi, hi))));
+            }
+        }
+        s.luma += horizontalSum256(aLuma);
+        s.dx += horizontalSum256(aDx);
+        s.dy += horizontalSum256(aDy);
+        s.lap += horizontalSum256(aLap);
+        s.dxdx += horizontalSum256(aDxDx);
+        s.dydy += horizontalSum256(aDyDy);
+        s.dxdy += horizontalSum256(aDxDy);
+        s.laplap += horizontalSum256(aLapLap);
+        s.magnitude += horizontalSum256(aMag);
+    }
+    gradientSse2(up + x - 1, mid + x - 1, down + x - 1, end - x + 2, withMagnitude, s);
+}
+
+// Four candidates per pass share each load of a; no FMA, which AVX2 alone
+// does not guarantee. Leftover candidates use the same lane order, so a
+// candidate's result does not depend on its position in the batch.
+void dotBatchAvx2(const float* a, const float* const* bs, size_t count, size_t len, float* out) {
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        const float* b0 = bs[k];
+        const float* b1 = bs[k + 1];
+        const float* b2 = bs[k + 2];
+        const float* b3 = bs[k + 3];
+        __m256 s0 = _mm256_setzero_ps(), s1 = s0, s2 = s0, s3 = s0;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            __m256 va = _mm256_loadu_ps(a + i);
+            s0 = _mm256_add_ps(s0, _mm256_mul_ps(va, _mm256_loadu_ps(b0 + i)));
+            s1 = _mm256_add_ps(s1, _mm256_mul_ps(va, _mm256_loadu_ps(b1 + i)));
+            s2 = _mm256_add_ps(s2, _mm256_mul_ps(va, _mm256_loadu_ps(b2 + i)));
+            s3 = _mm256_add_ps(s3, _mm256_mul_ps(va, _mm256_loadu_ps(b3 + i)));
+        }
+        out[k] = static_cast<float>(horizontalSum256(s0)) + dotScalarOne(a + i, b0 + i, len - i);
+        out[k + 1] = static_cast<float>(horizontalSum256(s1)) + dotScalarOne(a + i, b1 + i, len - i);
+        out[k + 2] = static_cast<float>(horizontalSum256(s2)) + dotScalarOne(a + i, b2 + i, len - i);
+        out[k + 3] = static_cast<float>(horizontalSum256(s3)) + dotScalarOne(a + i, b3 + i, len - i);
+    }
+    for (; k < count; ++k) {
+        const float* b = bs[k];
+        __m256 s0 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        }
+        out[k] = static_cast<float>(horizontalSum256(s0)) + dotScalarOne(a + i, b + i, len - i);
+    }
+}
+
+#pragma GCC pop_options
+
+const KernelTable kSse2Table = {
+    SIMD_SSE2, medianSse2, deinterleaveU8Scalar, deinterleaveF32Sse2, iouSse2, gradientSse2, dotBatchSse2,
+};
+const KernelTable kSsse3Table = {
+    SIMD_SSSE3, medianSse2, deinterleaveU8Ssse3, deinterleaveF32Sse2, iouSse2, gradientSse2, dotBatchSse2,
+};
+const KernelTable kAvx2Table = {
+    SIMD_AVX2, medianAvx2, deinterleaveU8Ssse3, deinterleaveF32Sse2, iouSse2, gradientAvx2, dotBatchAvx2,
+};
+
+#endif  // SIMD_KERNELS_X86
+
+const KernelTable* tableFor(SimdLevel level) {
+    switch (level) {
+#if defined(SIMD_KERNELS_NEON)
+        case SIMD_NEON: return &kNeonTable;
+#endif
+#if defined(SIMD_KERNELS_X86)
+        case SIMD_AVX2: return &kAvx2Table;
+        case SIMD_SSSE3: return &kSsse3Table;
+        case SIMD_SSE2: return &kSse2Table;
+#endif
+        default: return &kScalarTable;
+    }
+}
+
+SimdLevel detectLevel() {
+#if defined(SIMD_KERNELS_NEON)
+    return SIMD_NEON;
+#elif defined(SIMD_KERNELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return SIMD_SSSE3;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SIMD_SSE2;
+    }
+    return SIMD_SCALAR;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+bool levelSupported(SimdLevel level, SimdLevel detected) {
+    if (level == SIMD_SCALAR || level == detected) {
+        return true;
+    }
+    // x86 levels are ordered; NEON stands alone.
+    return detected != SIMD_NEON && level != SIMD_NEON && level < detected;
+}
+
+std::atomic<const KernelTable*> activeTable{nullptr};
+
+const KernelTable& kernels() {
+    const KernelTable* table = activeTable.load(std::memory_order_acquire);
+    if (!table) {
+        table = tableFor(detectLevel());
+        activeTable.store(table, std::memory_order_release);
+    }
+    return *table;
+}
+
+}  // namespace
+
+SimdLevel simd_active_level() {
+    return kernels().level;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SIMD_SSE2: return "sse2";
+        case SIMD_SSSE3: return "ssse3";
+        case SIMD_AVX2: return "avx2";
+        case SIMD_NEON: return "neon";
+        default: return "scalar";
+    }
+}
+
+SimdLevel simd_set_level(SimdLevel level) {
+    if (!levelSupported(level, detectLevel())) {
+        level = detectLevel();
+    }
+    const KernelTable* table = tableFor(level);
+    activeTable.store(table, std::memory_order_release);
+    return table->level;
+}
+
+void simd_median_u8(const uint8_t* const* srcs, int count, uint8_t* dst, size_t len) {
+    count = std::max(1, std::min(count, kSimdMedianMaxInputs));
+    kernels().median(srcs, count, dst, len);
+}
+
+void simd_deinterleave3_u8(const uint8_t* src, uint8_t* dst0, uint8_t* dst1, uint8_t* dst2,
+                           size_t pixels) {
+    kernels().deinterleaveU8(src, dst0, dst1, dst2, pixels);
+}
+
+void simd_deinterleave3_f32(const float* src, float* dst0, float* dst1, float* dst2,
+                            size_t pixels) {
+    kernels().deinterleaveF32(src, dst0, dst1, dst2, pixels);
+}
+
+void simd_iou_one_to_many(float ax1, float ay1, float ax2, float ay2, float areaA,
+                          const float* x1, const float* y1, const float* x2, const float* y2,
+                          const float* area, size_t count, float* out) {
+    kernels().iou(ax1, ay1, ax2, ay2, areaA, x1, y1, x2, y2, area, count, out);
+}
+
+void simd_gradient_row(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int width,
+                       bool withMagnitude, GradientRowSums& sums) {
+    if (width < 3) {
+        return;
+    }
+    kernels().gradient(up, mid, down, width, withMagnitude, sums);
+}
+
+float simd_dot_f32(const float* a, const float* b, size_t len) {
+    float out = 0.0f;
+    kernels().dotBatch(a, &b, 1, len, &out);
+    return out;
+}
+
+void simd_dot_f32_batch(const float* a, const float* const* bs, size_t count, size_t len, float* out) {
+    kernels().dotBatch(a, bs, count, len, out);
+}
@@ -0,0 +1,171 @@
+#include "spatial_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+float intersectionArea(const cv::Rect2f& a, const cv::Rect2f& b) {
+    float w = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+    float h = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+    return (w > 0.0f && h > 0.0f) ? w * h : 0.0f;
+}
+
+}  // namespace
+
+void SpatialGrid::reset(float width, float height, float cellSize) {
+    cellSize = std::max(1.0f, cellSize);
+    invCell = 1.0f / cellSize;
+    cols = std::max(1, static_cast<int>(std::ceil(width * invCell)));
+    rows = std::max(1, static_cast<int>(std::ceil(height * invCell)));
+    if (cells.size() < static_cast<size_t>(cols * rows)) {
+        cells.resize(cols * rows);
+    }
+    if (indexedCount > 0) {
+        for (auto& cell : cells) {
+            cell.clear();
+        }
+    }
+    indexedCount = 0;
+    items.clear();
+    stamps.clear();
+}
+
+void SpatialGrid::cellRange(const cv::Rect2f& area, int& c0, int& r0, int& c1, int& r1) const {
+    // Boxes outside the covered extent are folded into the border cells.
+    c0 = std::min(cols - 1, std::max(0, static_cast<int>(std::floor(area.x * invCell))));
+    r0 = std::min(rows - 1, std::max(0, static_cast<int>(std::floor(area.y * invCell))));
+    c1 = std::min(cols - 1, std::max(0, static_cast<int>(std::floor((area.x + area.width) * invCell))));
+    r1 = std::min(rows - 1, std::max(0, static_cast<int>(std::floor((area.y + area.height) * invCell))));
+}
+
+int SpatialGrid::insert(const cv::Rect2f& box) {
+    items.push_back(box);
+    stamps.push_back(0);
+    return static_cast<int>(items.size()) - 1;
+}
+
+void SpatialGrid::indexPending() {
+    for (; indexedCount < items.size(); ++indexedCount) {
+        const cv::Rect2f& box = items[indexedCount];
+        if (box.width <= 0.0f || box.height <= 0.0f) {
+            continue;
+        }
+        int c0, r0, c1, r1;
+        cellRange(box, c0, r0, c1, r1);
+        for (int r = r0; r <= r1; ++r) {
+            for (int c = c0; c <= c1; ++c) {
+                cells[r * cols + c].push_back(static_cast<int>(indexedCount));
+            }
+        }
+    }
+}
+
+void SpatialGrid::query(const cv::Rect2f& area, std::vector<int>& out) {
+    collect(area, out);
+    std::sort(out.begin(), out.end());
+}
+
+void SpatialGrid::collect(const cv::Rect2f& area, std::vector<int>& out) {
+    out.clear();
+    if (items.empty()) {
+        return;
+    }
+    if (++stamp == 0) {
+        std::fill(stamps.begin(), stamps.end(), 0);
+        stamp = 1;
+    }
+    const float ax2 = area.x + area.width;
+    const float ay2 = area.y + area.height;
+    auto touches = [&](const cv::Rect2f& b) {
+        return b.width > 0.0f && b.height > 0.0f &&
+               b.x <= ax2 && area.x <= b.x + b.width &&
+               b.y <= ay2 && area.y <= b.y + b.height;
+    };
+
+    // A handful of boxes is cheaper to scan than to walk cells for.
+    if (items.size() <= kLinearScanLimit) {
+        for (int item = 0; item < static_cast<int>(items.size()); ++item) {
+            if (touches(items[item])) {
+                out.push_back(item);
+            }
+        }
+        return;
+    }
+
+    indexPending();
+    int c0, r0, c1, r1;
+    cellRange(area, c0, r0, c1, r1);
+    for (int r = r0; r <= r1; ++r) {
+        for (int c = c0; c <= c1; ++c) {
+            for (int item : cells[r * cols + c]) {
+                if (stamps[item] == stamp) {
+                    continue;
+                }
+                stamps[item] = stamp;
+                if (touches(items[item])) {
+                    out.push_back(item);
+                }
+            }
+        }
+    }
+}
+
+float SpatialGrid::maxOverlapOn(int item) {
+    const cv::Rect2f& a = items[item];
+    if (a.width <= 0.0f || a.height <= 0.0f) {
+        return 0.0f;
+    }
+    collect(a, scratch);
+    float area = std::max(1.0f, a.area());
+    float best = 0.0f;
+    for (int other : scratch) {
+        if (other == item) {
+            continue;
+        }
+        float inter = intersectionArea(a, items[other]);
+        best = std::max(best, inter / area);
+    }
+    return best;
+}
+
+float SpatialGrid::bestIou(const cv::Rect2f& box, int* bestItem) {
+    collect(box, scratch);
+    float best = 0.0f;
+    int bestIndex = -1;
+    for (int item : scratch) {
+        const cv::Rect2f& b = items[item];
+        float inter = intersectionArea(box, b);
+        if (inter <= 0.0f) {
+            continue;
+        }
+        float iou = inter / (box.area() + b.area() - inter + 1e-6f);
+        if (iou > best) {
+            best = iou;
+            bestIndex = item;
+        }
+    }
+    if (bestItem) {
+        *bestItem = bestIndex;
+    }
+    return best;
+}
+
+int SpatialGrid::nearest(const cv::Point2f& point, float maxDistance) {
+    // A box whose center lies within maxDistance touches this square.
+    cv::Rect2f area(point.x - maxDistance, point.y - maxDistance, maxDistance * 2.0f, maxDistance * 2.0f);
+    collect(area, scratch);
+    float bestSq = maxDistance * maxDistance;
+    int bestIndex = -1;
+    for (int item : scratch) {
+        const cv::Rect2f& b = items[item];
+        float dx = b.x + b.width * 0.5f - point.x;
+        float dy = b.y + b.height * 0.5f - point.y;
+        float distSq = dx * dx + dy * dy;
+        if (distSq < bestSq) {
+            bestSq = distSq;
+            bestIndex = item;
+        }
+    }
+    return bestIndex;
+}
@@ -3,6 +3,8 @@
 #include "person_detect.h"
 #include "face_detect.h"
 #include "sort_tracker.h"
+#include "quality_metrics.h"
+#include "simd_kernels.h"
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <fstream>
@@ -58,21 +60,40 @@ constexpr float kLowLightFallbackMaxBlurSeverityScale = 1.15f; // 放宽兜底
 constexpr float kLowLightMinClarityScale = 0.70f;         // 降低清晰度要求（原 1.10 提高→现降低）
 constexpr float kLowLightFallbackMinClarityScale = 0.60f; // 降低兜底清晰度要求（原 1.18→现降低）
 // 多帧融合：放宽条件以提高暗光场景融合成功率
-constexpr size_t kMultiFrameFusionHistorySize = 5;          // 积累更多历史帧（原 3）
 constexpr float kMultiFrameFusionLowLightMinStrength = 0.10f; // 更早启用融合（原 0.18）
-constexpr float kMultiFrameFusionMaxShiftRatio = 0.25f;     // 允许更大帧间位移（原 0.20）
-constexpr float kMultiFrameFusionMinSimilarity = 0.28f;     // 放宽相似度门槛（原 0.36）
+constexpr double kTrackHistoryMinDirectionalRatio = 0.40;   // 入历史池的方向梯度比下限
+constexpr double kMultiFrameFusionMinDirectionalRatio = 0.45; // 参与融合的方向梯度比下限
+constexpr uint64_t kTrackEvalIdleJobs = 64;                 // 评估状态闲置多少个评估任务后释放
 constexpr int kApproachPositiveFramesRequired = 3;
 constexpr int kApproachNegativeFramesRequired = 4;
 constexpr float kApproachJitterFreezeThreshold = 0.11f;
 constexpr float kApproachJitterRejectThreshold = 0.30f;
-
-struct MultiFrameFusionResult {
-    cv::Mat fused;
-    int acceptedFrames{0};
-    float meanSimilarity{0.0f};
-    double referenceFocus{0.0};
-    double bestAlignedFocus{0.0};
+constexpr float kTrackGridCellSize = 64.0f;
+constexpr float kPrescreenHeadWidthRatio = 0.70f;   // 预筛头部区域：人框中间 70% 宽
+constexpr float kPrescreenHeadHeightRatio = 0.40f;  // 人框上部 40% 高
+constexpr int kPrescreenMinHeadSide = 8;            // 头部区域过小时跳过预筛
+constexpr double kPrescreenPeakDecay = 0.92;        // 每帧衰减轨迹近期清晰度峰值
+constexpr float kEvalExitHorizonFrames = 60.0f;      // 预计离开画面时间超过此帧数视为不紧急
+constexpr float kEvalStrongCandidateDiscount = 0.4f; // 已有强候选的轨迹评估价值折扣
+constexpr float kEvalAgingPerDispatch = 0.02f;       // 每调度一个任务，等待中的轨迹价值增加量
+constexpr float kTrackerMinDt = 0.25f;                // 运动模型步长下限（帧）
+constexpr float kTrackerMaxDt = 6.0f;                 // 运动模型步长上限，长时间卡顿不做过度外推
+constexpr double kTrackerPeriodAlpha = 0.05;          // 处理帧间隔均值的更新速率
+constexpr size_t kFramePoolReserve = 2;              // 帧池至少保留的空闲缓冲（采集+推理各一）
+constexpr float kHeadRegionScale = 2.2f;            // 头部检测区域：上次人脸框放大倍数
+constexpr int kHeadRegionMinSide = 48;              // 头部区域过小时退回整个人体 ROI
+
+const char* const kCandidateGateNames[CANDIDATE_GATE_COUNT] = {
+    "motion",
+    "face_detect",
+    "face_score",
+    "face_box",
+    "face_geometry",
+    "pose",
+    "headshot_crop",
+    "quality",
+    "fusion",
+    "decision",
 };
 
 float clampUnit(float value) {
@@ -347,241 +368,136 @@ bool isValidTrackRect(const cv::Rect2f& rect) {
     return rect.width > 1.0f && rect.height > 1.0f;
 }
 
-cv::Rect2f selectTrackRect720p(const Track& track) {
+cv::Rect2f selectTrackRect720p(const TrackView& track) {
     return isValidTrackRect(track.smoothed_bbox) ? track.smoothed_bbox : track.bbox;
 }
 
-float computeTrackAreaTrendRatio(const Track& track) {
-    if (track.bbox_history.size() < 4) {
-        return 0.0f;
-    }
-
-    size_t span = std::min<size_t>(8, track.bbox_history.size() - 1);
-    float area_now = track.bbox_history.back();
-    float area_prev = track.bbox_history[track.bbox_history.size() - 1 - span];
-    return (area_now - area_prev) / (area_prev + 1e-6f);
+// Frames until a 720p box moving at velocity (px per frame) starts to leave
+// the image, capped at kEvalExitHorizonFrames.
+float framesToExit(const cv::Rect& box, const cv::Point2f& velocity) {
+    constexpr float kMinSpeed = 1e-3f;
+    float frames = kEvalExitHorizonFrames;
+    if (velocity.x > kMinSpeed) {
+        frames = std::min(frames, (IMAGE_WIDTH - (box.x + box.width)) / velocity.x);
+    } else if (velocity.x < -kMinSpeed) {
+        frames = std::min(frames, box.x / -velocity.x);
+    }
+    if (velocity.y > kMinSpeed) {
+        frames = std::min(frames, (IMAGE_HEIGHT - (box.y + box.height)) / velocity.y);
+    } else if (velocity.y < -kMinSpeed) {
+        frames = std::min(frames, box.y / -velocity.y);
+    }
+    return std::max(0.0f, frames);
 }
 
-cv::Rect clampRectToSize(const cv::Rect& rect, const cv::Size& bounds) {
-    int x = std::max(0, std::min(rect.x, bounds.width - 1));
-    int y = std::max(0, std::min(rect.y, bounds.height - 1));
-    int width = std::max(1, std::min(rect.width, bounds.width - x));
-    int height = std::max(1, std::min(rect.height, bounds.height - y));
-    return cv::Rect(x, y, width, height);
+// Expected gain of evaluating a frame of a track: larger people give better
+// faces, approaching people are who the capture is for, and people about to
+// leave the image get no second chance.
+float candidateCaptureValue(float areaRatio, float nearAreaRatio, bool approaching, float exitFrames) {
+    float size = std::min(1.0f, areaRatio / std::max(1e-6f, nearAreaRatio));
+    float urgency = 1.0f - std::min(1.0f, exitFrames / kEvalExitHorizonFrames);
+    return 0.45f * size + 0.35f * urgency + (approaching ? 0.20f : 0.0f);
 }
 
-cv::Rect expandRectFromCenter(const cv::Rect& rect, float scale, const cv::Size& bounds) {
-    float cx = rect.x + rect.width * 0.5f;
-    float cy = rect.y + rect.height * 0.5f;
-    float width = rect.width * scale;
-    float height = rect.height * scale;
-    cv::Rect expanded(static_cast<int>(std::round(cx - width * 0.5f)),
-                      static_cast<int>(std::round(cy - height * 0.5f)),
-                      static_cast<int>(std::round(width)),
-                      static_cast<int>(std::round(height)));
-    return clampRectToSize(expanded, bounds);
+// Where the head of a 720p person box is expected: the upper part of the
+// box, central columns.
+cv::Rect prescreenHeadRegion(const cv::Rect& box720p) {
+    int width = static_cast<int>(box720p.width * kPrescreenHeadWidthRatio);
+    int height = static_cast<int>(box720p.height * kPrescreenHeadHeightRatio);
+    return cv::Rect(box720p.x + (box720p.width - width) / 2, box720p.y, width, height);
 }
 
-double computeGrayFocusVariance(const cv::Mat& gray) {
-    if (gray.empty() || gray.cols <= 1 || gray.rows <= 1) {
-        return 0.0;
-    }
-
-    cv::Mat lap;
-    cv::Laplacian(gray, lap, CV_32F);
-    cv::Scalar mean_val, stddev_val;
-    cv::meanStdDev(lap, mean_val, stddev_val);
-    return stddev_val[0] * stddev_val[0];
+// Search window for the face of the next job: the last accepted face box,
+// stored relative to the person ROI, scaled back and enlarged around its
+// center. Empty when it falls outside the ROI.
+cv::Rect predictedHeadRegion(const cv::Rect2f& lastFace, const cv::Size& roiSize) {
+    float cx = (lastFace.x + lastFace.width * 0.5f) * roiSize.width;
+    float cy = (lastFace.y + lastFace.height * 0.5f) * roiSize.height;
+    float side = std::max(lastFace.width * roiSize.width, lastFace.height * roiSize.height) * kHeadRegionScale;
+    cv::Rect region(static_cast<int>(cx - side * 0.5f),
+                    static_cast<int>(cy - side * 0.5f),
+                    static_cast<int>(side),
+                    static_cast<int>(side));
+    return region & cv::Rect(0, 0, roiSize.width, roiSize.height);
 }
 
-MultiFrameFusionResult fuseTrackHistoryPersonRoi(const cv::Mat& reference,
-                                                 const std::vector<cv::Mat>& history,
-                                                 const cv::Rect& focus_box,
-                                                 float low_light_strength,
-                                                 float motion_ratio) {
-    MultiFrameFusionResult result;
-    if (reference.empty() || history.empty() || focus_box.width < 16 || focus_box.height < 16) {
-        return result;
-    }
-
-    cv::Rect safe_focus = expandRectFromCenter(focus_box, 1.45f, reference.size());
-
-    // ── Stage 1: Compute sharpness for reference ──
-    cv::Mat reference_gray;
-    cv::cvtColor(reference, reference_gray, cv::COLOR_BGR2GRAY);
-    double reference_focus = computeGrayFocusVariance(reference_gray(safe_focus));
-    result.referenceFocus = reference_focus;
-    result.bestAlignedFocus = reference_focus;
-
-    // Collect candidate frames: reference + aligned history frames.
-    // Each entry: {frame, focus_variance}
-    struct FrameEntry {
-        cv::Mat frame;
-        double focus;
-    };
-    std::vector<FrameEntry> candidates;
-    candidates.reserve(history.size() + 1);
-    candidates.push_back({reference.clone(), reference_focus});
-
-    cv::Mat reference_focus_f;
-    reference_gray(safe_focus).convertTo(reference_focus_f, CV_32F);
-    cv::GaussianBlur(reference_focus_f, reference_focus_f, cv::Size(0, 0), 0.8);
-
-    float similarity_sum = 0.0f;
-    int similarity_count = 0;
-
-    size_t history_begin = history.size() > kMultiFrameFusionHistorySize ?
-        history.size() - kMultiFrameFusionHistorySize : 0;
-    for (size_t i = history_begin; i < history.size(); ++i) {
-        if (history[i].empty()) {
-            continue;
-        }
-
-        cv::Mat candidate = history[i];
-        if (candidate.size() != reference.size()) {
-            cv::resize(candidate, candidate, reference.size(), 0, 0, cv::INTER_LINEAR);
-        }
-
-        cv::Mat candidate_gray;
-        cv::cvtColor(candidate, candidate_gray, cv::COLOR_BGR2GRAY);
-
-        // ── Motion blur filter: reject frames with strong directional blur ──
-        cv::Mat gx, gy;
-        cv::Sobel(candidate_gray, gx, CV_32F, 1, 0, 3);
-        cv::Sobel(candidate_gray, gy, CV_32F, 0, 1, 3);
-        cv::Scalar gx_std, gy_std;
-        cv::meanStdDev(gx, cv::noArray(), gx_std);
-        cv::meanStdDev(gy, cv::noArray(), gy_std);
-        double ex = gx_std[0] * gx_std[0], ey = gy_std[0] * gy_std[0];
-        double dir_ratio = std::min(ex, ey) / (std::max(ex, ey) + 1e-6);
-        if (dir_ratio < 0.45) {
-            continue; // Severe directional blur — skip this frame.
-        }
-
-        // ── Phase correlation alignment ──
-        cv::Mat candidate_focus_f;
-        candidate_gray(safe_focus).convertTo(candidate_focus_f, CV_32F);
-        cv::GaussianBlur(candidate_focus_f, candidate_focus_f, cv::Size(0, 0), 0.8);
-
-        cv::Point2d shift = cv::phaseCorrelate(reference_focus_f, candidate_focus_f);
-        float shift_norm = std::sqrt(static_cast<float>(shift.x * shift.x + shift.y * shift.y));
-        float max_shift = std::max(4.0f, std::min(safe_focus.width, safe_focus.height) * kMultiFrameFusionMaxShiftRatio);
-        if (shift_norm > max_shift) {
-            continue;
-        }
-
-        cv::Mat transform = (cv::Mat_<double>(2, 3) << 1.0, 0.0, shift.x,
-                                                       0.0, 1.0, shift.y);
-        cv::Mat aligned;
-        cv::warpAffine(candidate, aligned, transform, reference.size(),
-                       cv::INTER_LINEAR, cv::BORDER_REPLICATE);
-
-        // ── Similarity check ──
-        cv::Mat aligned_gray;
-        cv::cvtColor(aligned, aligned_gray, cv::COLOR_BGR2GRAY);
-        cv::Mat diff;
-        cv::absdiff(aligned_gray, reference_gray, diff);
-        cv::Mat diff_f;
-        diff.convertTo(diff_f, CV_32F);
-        cv::Mat similarity = 1.0f - (diff_f - 14.0f) / 62.0f;
-        cv::max(similarity, 0.0f, similarity);
-        cv::min(similarity, 1.0f, similarity);
-        float mean_similarity = static_cast<float>(cv::mean(similarity(safe_focus))[0]);
-        if (mean_similarity < kMultiFrameFusionMinSimilarity) {
-            continue;
-        }
-
-        // ── Sharpness of aligned frame ──
-        double aligned_focus = computeGrayFocusVariance(aligned_gray(safe_focus));
-
-        candidates.push_back({std::move(aligned), aligned_focus});
-        if (aligned_focus > result.bestAlignedFocus) {
-            result.bestAlignedFocus = aligned_focus;
-        }
-
-        similarity_sum += mean_similarity;
-        similarity_count++;
-        result.acceptedFrames++;
-    }
-
-    if (result.acceptedFrames <= 0) {
-        result.acceptedFrames = 1;
-        result.meanSimilarity = 0.0f;
-        return result;
-    }
-
-    result.meanSimilarity = similarity_count > 0 ? (similarity_sum / similarity_count) : 0.0f;
-
-    // ── Stage 2: Best-frame selection + median temporal denoising ──
-
-    // Find the sharpest frame as base.
-    double best_focus = 0.0;
-    int best_idx = 0;
-    for (int i = 0; i < static_cast<int>(candidates.size()); i++) {
-        if (candidates[i].focus > best_focus) {
-            best_focus = candidates[i].focus;
-            best_idx = i;
-        }
-    }
-
-    // Filter: keep only frames with focus >= 60% of the best (reject blurry frames).
-    double focus_threshold = best_focus * 0.60;
-    std::vector<cv::Mat> good_frames;
-    good_frames.reserve(candidates.size());
-    for (auto& entry : candidates) {
-        if (entry.focus >= focus_threshold) {
-            good_frames.push_back(std::move(entry.frame));
-        }
-    }
-
-    if (good_frames.size() <= 1) {
-        // Only 1 good frame — return it directly.
-        if (!good_frames.empty()) {
-            result.fused = good_frames[0].clone();
-        }
-        return result;
-    }
-
-    if (good_frames.size() == 2) {
-        // 2 frames — pick the sharper one (median of 2 is just average, not useful).
-        result.fused = good_frames[0].clone();
-        return result;
-    }
-
-    // ── 3+ frames: pixel-wise median fusion ──
-    // Median naturally rejects motion blur artifacts (outlier pixels).
-    int rows = good_frames[0].rows;
-    int cols = good_frames[0].cols;
-    int n = static_cast<int>(good_frames.size());
-    int mid = n / 2;
-    result.fused = cv::Mat(rows, cols, CV_8UC3);
-
-    // Ensure all frames are continuous for fast access.
-    for (auto& f : good_frames) {
-        if (!f.isContinuous()) {
-            f = f.clone();
+// Runs face detection on region of roi, downscaled to at most maxWidth.
+// Boxes and landmarks are returned in roi coordinates.
+int detectFacesInRegion(rknn_context faceCtx,
+                        const cv::Mat& roi,
+                        const cv::Rect& region,
+                        int maxWidth,
+                        std::vector<det>& faces) {
+    faces.clear();
+    int target_width = std::min(maxWidth, region.width);
+    int target_height = static_cast<int>(region.height * target_width / (float)std::max(1, region.width));
+    if (target_width <= 0 || target_height <= 0) {
+        return 0;
+    }
+
+    cv::Mat input;
+    if (target_width == region.width && target_height == region.height) {
+        roi(region).copyTo(input);
+    } else {
+        cv::resize(roi(region), input, cv::Size(target_width, target_height), 0, 0, cv::INTER_LINEAR);
+    }
+
+    int num_faces = face_detect_run(faceCtx, input, faces);
+    if (num_faces <= 0) {
+        return num_faces;
+    }
+    float scale_x = (float)region.width / (float)input.cols;
+    float scale_y = (float)region.height / (float)input.rows;
+    for (auto& face : faces) {
+        face.box.x = face.box.x * scale_x + region.x;
+        face.box.y = face.box.y * scale_y + region.y;
+        face.box.width *= scale_x;
+        face.box.height *= scale_y;
+        for (auto& lm : face.landmarks) {
+            lm.x = lm.x * scale_x + region.x;
+            lm.y = lm.y * scale_y + region.y;
         }
     }
+    return num_faces;
+}
 
-    for (int r = 0; r < rows; r++) {
-        const uint8_t* row_ptrs[7]; // max 7 frames (kMultiFrameFusionHistorySize + 1 + margin)
-        for (int f = 0; f < n; f++) {
-            row_ptrs[f] = good_frames[f].ptr<uint8_t>(r);
-        }
-        uint8_t* out_ptr = result.fused.ptr<uint8_t>(r);
-
-        for (int c = 0; c < cols * 3; c++) {
-            uint8_t vals[7];
-            for (int f = 0; f < n; f++) {
-                vals[f] = row_ptrs[f][c];
-            }
-            std::nth_element(vals, vals + mid, vals + n);
-            out_ptr[c] = vals[mid];
-        }
-    }
+// Headshot crop around the detected face inside the person ROI.
+cv::Rect headshotCropBox(const cv::Rect& face_box, const cv::Size& roi_size,
+                         const DeviceConfig::CaptureDefaults& config) {
+    int crop_w = std::max(1, static_cast<int>(face_box.width * config.headshotExpandRatio));
+    int crop_h = std::max(1, static_cast<int>(face_box.height * config.headshotExpandRatio));
+    int crop_cx = face_box.x + face_box.width / 2;
+    int crop_cy = face_box.y + face_box.height / 2 + static_cast<int>(face_box.height * config.headshotDownShift);
+    int crop_x = crop_cx - crop_w / 2;
+    int crop_y = crop_cy - crop_h / 2;
+
+    crop_x = std::max(0, std::min(roi_size.width - crop_w, crop_x));
+    crop_y = std::max(0, std::min(roi_size.height - crop_h, crop_y));
+    return cv::Rect(crop_x, crop_y,
+                    std::min(crop_w, roi_size.width - crop_x),
+                    std::min(crop_h, roi_size.height - crop_y));
+}
 
-    return result;
+// Upper-body crop uploaded as the person image.
+cv::Rect upperBodyCropBox(const cv::Rect& face_box, const cv::Size& roi_size,
+                          const DeviceConfig::CaptureDefaults& config) {
+    int upper_body_w = std::min(roi_size.width,
+        std::max(static_cast<int>(face_box.width * config.upperBodyWidthFaceRatio),
+                 static_cast<int>(roi_size.width * config.upperBodyMinWidthRatio)));
+    int upper_body_h = std::min(roi_size.height,
+        std::max(static_cast<int>(face_box.height * config.upperBodyHeightFaceRatio),
+                 static_cast<int>(roi_size.height * config.upperBodyMinHeightRatio)));
+    int upper_body_cx = face_box.x + face_box.width / 2;
+    int upper_body_cy = face_box.y + static_cast<int>(face_box.height * config.upperBodyCenterYRatio);
+    int upper_body_x = std::max(0, std::min(roi_size.width - upper_body_w, upper_body_cx - upper_body_w / 2));
+    int upper_body_y = std::max(0, std::min(roi_size.height - upper_body_h,
+        upper_body_cy - static_cast<int>(upper_body_h / config.upperBodyTopDivisor)));
+    return cv::Rect(upper_body_x,
+                    upper_body_y,
+                    std::min(upper_body_w, roi_size.width - upper_body_x),
+                    std::min(upper_body_h, roi_size.height - upper_body_y));
 }
+
 } // namespace
 
 static float rect_iou(const cv::Rect& a, const cv::Rect& b) {
@@ -596,18 +512,6 @@ static float rect_iou(const cv::Rect& a, const cv::Rect& b) {
     return inter / (uni + 1e-6f);
 }
 
-static float rect_overlap_ratio_on_a(const cv::Rect& a, const cv::Rect& b) {
-    int xx1 = std::max(a.x, b.x);
-    int yy1 = std::max(a.y, b.y);
-    int xx2 = std::min(a.x + a.width, b.x + b.width);
-    int yy2 = std::min(a.y + a.height, b.y + b.height);
-    int w = std::max(0, xx2 - xx1);
-    int h = std::max(0, yy2 - yy1);
-    float inter = static_cast<float>(w * h);
-    float a_area = static_cast<float>(std::max(1, a.area()));
-    return inter / a_area;
-}
-
 static void nmsDetections(std::vector<Detection>& dets, float iouThreshold) {
     if (dets.size() <= 1) {
         return;
@@ -617,28 +521,39 @@ static void nmsDetections(std::vector<Detection>& dets, float iouThreshold) {
         return a.prop > b.prop;
     });
 
-    std::vector<bool> suppressed(dets.size(), false);
+    // Integer boxes as in rect_iou(), laid out as columns so each kept box is
+    // compared against the remaining ones with simd_iou_one_to_many. All
+    // values are small integers, so the float IoU is the same as rect_iou().
+    const size_t count = dets.size();
+    std::vector<float> x1(count), y1(count), x2(count), y2(count), area(count), ious(count);
+    for (size_t i = 0; i < count; ++i) {
+        int x = static_cast<int>(dets[i].x1);
+        int y = static_cast<int>(dets[i].y1);
+        int w = static_cast<int>(dets[i].x2 - dets[i].x1);
+        int h = static_cast<int>(dets[i].y2 - dets[i].y1);
+        x1[i] = static_cast<float>(x);
+        y1[i] = static_cast<float>(y);
+        x2[i] = static_cast<float>(x + w);
+        y2[i] = static_cast<float>(y + h);
+        area[i] = static_cast<float>(w * h);
+    }
+
+    std::vector<bool> suppressed(count, false);
     std::vector<Detection> kept;
-    kept.reserve(dets.size());
+    kept.reserve(count);
 
-    for (size_t i = 0; i < dets.size(); ++i) {
+    for (size_t i = 0; i < count; ++i) {
         if (suppressed[i]) {
             continue;
         }
 
         kept.push_back(dets[i]);
-        cv::Rect a(static_cast<int>(dets[i].x1), static_cast<int>(dets[i].y1),
-                   static_cast<int>(dets[i].x2 - dets[i].x1),
-                   static_cast<int>(dets[i].y2 - dets[i].y1));
-
-        for (size_t j = i + 1; j < dets.size(); ++j) {
-            if (suppressed[j]) {
-                continue;
-            }
-            cv::Rect b(static_cast<int>(dets[j].x1), static_cast<int>(dets[j].y1),
-                       static_cast<int>(dets[j].x2 - dets[j].x1),
-                       static_cast<int>(dets[j].y2 - dets[j].y1));
-            if (rect_iou(a, b) > iouThreshold) {
+        size_t rest = count - i - 1;
+        simd_iou_one_to_many(x1[i], y1[i], x2[i], y2[i], area[i],
+                             &x1[i + 1], &y1[i + 1], &x2[i + 1], &y2[i + 1], &area[i + 1],
+                             rest, &ious[i + 1]);
+        for (size_t j = i + 1; j < count; ++j) {
+            if (!suppressed[j] && ious[j] > iouThreshold) {
                 suppressed[j] = true;
             }
         }
@@ -654,6 +569,7 @@ CameraTask::CameraTask(const string& personModel, const string& faceModel, int i
     
     rga_init();
     resized_buffer_720p = new unsigned char[IMAGE_WIDTH * IMAGE_HEIGHT * 3];
+    log_info("CameraTask: image kernels use %s", simd_level_name(simd_active_level()));
 }
 
 CameraTask::~CameraTask() { 
@@ -683,8 +599,7 @@ void CameraTask::stop() {
     frameCv.notify_all();
     {
         std::lock_guard<std::mutex> lock(candidateEvalMutex);
-        candidateEvalQueue.clear();
-        pendingCandidateEvalByTrack.clear();
+        clearCandidateQueue();
     }
     candidateEvalCv.notify_all();
 
@@ -694,7 +609,7 @@ void CameraTask::stop() {
     }
 
     if (worker.joinable()) worker.join();
-    trackPersonRoiHistory.clear();
+    trackStates.clear();
     log_info("CameraTask: stopped");
 }
 
@@ -715,6 +630,9 @@ void CameraTask::setRuntimeConfig(const DeviceConfig& config) {
 
     brightnessBlackThreshold.store(config.captureDefaults.brightnessBlackThreshold);
     set_max_frame_candidates(static_cast<size_t>(std::max(1, config.captureDefaults.maxFrameCandidates)));
+    set_candidate_memory_budget(static_cast<size_t>(std::max(0, config.captureDefaults.candidateMemoryBudgetMb)) * 1024 * 1024,
+                                config.captureDefaults.candidateCompressBelowTop,
+                                static_cast<size_t>(std::max(1, config.captureDefaults.candidateRawTop)));
 }
 
 DeviceConfig::CaptureDefaults CameraTask::getCaptureConfigSnapshot() const {
@@ -762,33 +680,16 @@ void CameraTask::clearTrackReject(const char* stage, int trackId) {
     rejectLogStates.erase(key);
 }
 
-// -------------------- 图像清晰度计算 --------------------
-double CameraTask::computeFocusMeasure(const Mat& img) {
+// -------------------- 图像清晰度 / 运动模糊 --------------------
+// One gray conversion feeds both measures: Laplacian variance on the
+// focusScaleFactor-downscaled view, and the motion-blur severity (directional
+// ratio, Laplacian variance, 2px shift trail) on a <=200px view.
+void CameraTask::measureCandidateQuality(const Mat& img, double& clarity, float& blurSeverity) {
+    clarity = 0.0;
+    blurSeverity = 1.0f;
     if (img.empty() || img.cols <= 0 || img.rows <= 0) {
-        return 0.0;
-    }
-
-    DeviceConfig::CaptureDefaults config = getCaptureConfigSnapshot();
-    int scale_factor = std::max(1, config.focusScaleFactor);
-    
-    int new_width = img.cols / scale_factor;
-    int new_height = img.rows / scale_factor;
-    if (new_width <= 0 || new_height <= 0) {
-        return 0.0;
+        return;
     }
-    
-    Mat small, gray, lap;
-    cv::resize(img, small, Size(new_width, new_height), 0, 0, cv::INTER_LINEAR);
-    cvtColor(small, gray, COLOR_BGR2GRAY);
-    Laplacian(gray, lap, CV_64F);
-    Scalar mean_val, stddev_val;
-    meanStdDev(lap, mean_val, stddev_val);
-    return stddev_val.val[0] * stddev_val.val[0];
-}
-
-// -------------------- 图像级运动模糊检测 --------------------
-float CameraTask::computeMotionBlurSeverity(const Mat& img) {
-    if (img.empty() || img.cols < 16 || img.rows < 16) return 1.0f;
 
     Mat gray;
     if (img.channels() == 3) {
@@ -797,58 +698,33 @@ float CameraTask::computeMotionBlurSeverity(const Mat& img) {
         gray = img;
     }
 
+    DeviceConfig::CaptureDefaults config = getCaptureConfigSnapshot();
+    int scale_factor = std::max(1, config.focusScaleFactor);
+    int new_width = img.cols / scale_factor;
+    int new_height = img.rows / scale_factor;
+    QualityMetrics metrics;
+    if (new_width > 0 && new_height > 0) {
+        Mat small;
+        if (scale_factor > 1) {
+            cv::resize(gray, small, Size(new_width, new_height), 0, 0, cv::INTER_LINEAR);
+        } else {
+            small = gray;
+        }
+        compute_quality_metrics(small, metrics);
+        clarity = metrics.laplacianVar;
+    }
+
+    if (img.cols < 16 || img.rows < 16) {
+        return;
+    }
     // 缩小到合理尺寸以加快计算
+    Mat blur_view = gray;
     if (std::max(gray.cols, gray.rows) > 200) {
         float scale = 200.0f / std::max(gray.cols, gray.rows);
-        resize(gray, gray, Size(), scale, scale, INTER_AREA);
-    }
-
-    // 1. 计算X/Y方向梯度能量
-    Mat gx, gy;
-    Sobel(gray, gx, CV_32F, 1, 0, 3);
-    Sobel(gray, gy, CV_32F, 0, 1, 3);
-
-    Scalar gx_mean, gx_std, gy_mean, gy_std;
-    meanStdDev(gx, gx_mean, gx_std);
-    meanStdDev(gy, gy_mean, gy_std);
-
-    double energy_x = gx_std.val[0] * gx_std.val[0];
-    double energy_y = gy_std.val[0] * gy_std.val[0];
-    double total_energy = energy_x + energy_y;
-
-    if (total_energy < 1.0) return 1.0f;
-
-    // 方向不均衡度：若某一方向梯度远强于另一方向，说明运动模糊
-    double dir_ratio = std::min(energy_x, energy_y) / (std::max(energy_x, energy_y) + 1e-6);
-    float dir_severity = std::max(0.0f, std::min(1.0f, (float)(1.0 - dir_ratio)));
-
-    // 2. Laplacian方差 - 综合锐度
-    Mat lap;
-    Laplacian(gray, lap, CV_32F);
-    Scalar lap_mean_val, lap_std_val;
-    meanStdDev(lap, lap_mean_val, lap_std_val);
-    double lap_var = lap_std_val.val[0] * lap_std_val.val[0];
-    float sharpness_severity = std::max(0.0f, std::min(1.0f, (float)((200.0 - lap_var) / 200.0)));
-
-    // 3. 自相似移位差分 - 运动模糊拖影检测
-    // 沿估计的主梯度方向移位2像素，运动模糊图像移位后差异小
-    double angle = std::atan2(gy_mean.val[0], gx_mean.val[0]);
-    int dx = static_cast<int>(std::round(std::cos(angle) * 2.0));
-    int dy = static_cast<int>(std::round(std::sin(angle) * 2.0));
-    if (dx == 0 && dy == 0) dx = 1;
-
-    Mat shifted;
-    Mat transform_mat = (Mat_<double>(2, 3) << 1, 0, dx, 0, 1, dy);
-    warpAffine(gray, shifted, transform_mat, gray.size(), INTER_LINEAR, BORDER_REPLICATE);
-    Mat diff;
-    absdiff(gray, shifted, diff);
-    double shift_diff = mean(diff).val[0];
-    // 移位差分越小 = 自相关越高 = 运动模糊拖影越严重
-    float trail_severity = std::max(0.0f, std::min(1.0f, (float)((16.0 - shift_diff) / 16.0)));
-
-    // 组合
-    float severity = dir_severity * 0.25f + sharpness_severity * 0.45f + trail_severity * 0.30f;
-    return std::max(0.0f, std::min(1.0f, severity));
+        resize(gray, blur_view, Size(), scale, scale, INTER_AREA);
+    }
+    compute_quality_metrics(blur_view, metrics, QUALITY_SHIFT_TRAILS);
+    blurSeverity = metrics.motionBlurSeverity();
 }
 
 bool CameraTask::isFrontalFace(const std::vector<cv::Point2f>& landmarks) {
@@ -915,507 +791,761 @@ void CameraTask::updateFPS() {
         auto totalElapsed = std::chrono::duration_cast<std::chrono::seconds>(now - startTime);
         if (totalElapsed.count() % 10 == 0 && totalElapsed.count() > 0) {
             log_info("Algo FPS: total_processed=%ld, fps=%.2f, uptime=%lds", currentFrames, currentFPS.load(), totalElapsed.count());
+            CandidateMemoryStats mem = get_candidate_memory_stats();
+            log_info("Candidate store: tracks=%zu candidates=%zu raw=%zuKB jpeg=%zuKB budget=%zuKB evicted=%llu compressed=%llu",
+                     mem.tracks,
+                     mem.candidates,
+                     mem.rawBytes / 1024,
+                     mem.jpegBytes / 1024,
+                     mem.budgetBytes / 1024,
+                     static_cast<unsigned long long>(mem.evictions),
+                     static_cast<unsigned long long>(mem.compressed));
+            logCandidateGateStats();
+            FramePoolStats pool = framePool.stats();
+            log_info("Frame pool: capacity=%zu in_use=%zu acquired=%llu exhausted=%llu heap_fallbacks=%llu",
+                     pool.capacity,
+                     pool.inUse,
+                     static_cast<unsigned long long>(pool.acquired),
+                     static_cast<unsigned long long>(pool.exhausted),
+                     static_cast<unsigned long long>(framePoolFallbacks.load()));
+            CandidateQueueStats queue = getCandidateQueueStats();
+            log_info("Eval queue: queued=%zu enqueued=%llu superseded=%llu evicted=%llu rejected=%llu retired=%llu "
+                     "finalized=%llu",
+                     queue.queued,
+                     static_cast<unsigned long long>(queue.enqueued),
+                     static_cast<unsigned long long>(queue.superseded),
+                     static_cast<unsigned long long>(queue.evicted),
+                     static_cast<unsigned long long>(queue.rejected),
+                     static_cast<unsigned long long>(queue.retired),
+                     static_cast<unsigned long long>(queue.finalized));
+        }
+    }
+}
+
+// Caller holds candidateEvalMutex. A mailbox left behind by a previous
+// occupant of the slot is emptied first.
+CameraTask::CandidateMailbox& CameraTask::candidateMailbox(int slot, uint32_t generation) {
+    if (static_cast<size_t>(slot) >= candidateMailboxes.size()) {
+        candidateMailboxes.resize(static_cast<size_t>(slot) + 1);
+    }
+    CandidateMailbox& mailbox = candidateMailboxes[slot];
+    if (mailbox.generation != generation) {
+        candidateQueueCounters.retired += mailbox.jobs.size();
+        candidateQueuedJobs -= mailbox.jobs.size();
+        mailbox.jobs.clear();
+        if (mailbox.readyIndex >= 0) {
+            unreadyCandidateMailbox(slot);
         }
+        mailbox.generation = generation;
+        mailbox.hasStrongCandidate = false;
+        mailbox.finalized = false;
+    }
+    return mailbox;
+}
+
+// Scheduling value of a mailbox: what its newest job expects to gain,
+// discounted once the track holds a strong candidate, plus a little for every
+// job dispatched since the track was last served so that nothing starves.
+float CameraTask::candidateMailboxPriority(const CandidateMailbox& mailbox) const {
+    float value = mailbox.jobs.back().captureValue;
+    if (mailbox.hasStrongCandidate) {
+        value *= kEvalStrongCandidateDiscount;
     }
+    return value + kEvalAgingPerDispatch * static_cast<float>(candidateDispatchTick - mailbox.waitingSince);
+}
+
+void CameraTask::unreadyCandidateMailbox(int slot) {
+    CandidateMailbox& mailbox = candidateMailboxes[slot];
+    int last = candidateReadySlots.back();
+    candidateReadySlots[mailbox.readyIndex] = last;
+    candidateMailboxes[last].readyIndex = mailbox.readyIndex;
+    candidateReadySlots.pop_back();
+    mailbox.readyIndex = -1;
+}
+
+void CameraTask::clearCandidateQueue() {
+    candidateMailboxes.clear();
+    candidateReadySlots.clear();
+    candidateQueuedJobs = 0;
 }
 
 bool CameraTask::enqueueCandidateEvaluation(CandidateEvalJob job) {
     DeviceConfig::CaptureDefaults config = getCaptureConfigSnapshot();
+    size_t per_track_max = static_cast<size_t>(std::max(1, config.candidatePerTrackMaxPending));
+    size_t queue_max = static_cast<size_t>(std::max(1, config.candidateQueueMax));
+    int track_id = job.trackId;
+    int slot = job.trackSlot;
+
     std::lock_guard<std::mutex> lock(candidateEvalMutex);
-    int pending_for_track = pendingCandidateEvalByTrack[job.trackId];
-    if (pending_for_track >= config.candidatePerTrackMaxPending) {
-        char detail[192];
-        std::snprintf(detail, sizeof(detail), "pending=%d max=%d queue=%zu",
-                      pending_for_track,
-                      config.candidatePerTrackMaxPending,
-                      candidateEvalQueue.size());
-        logTrackReject("queue", job.trackId, "pending_limit", detail);
+    CandidateMailbox& mailbox = candidateMailbox(slot, job.trackGeneration);
+    if (mailbox.finalized) {
+        // Built from a track snapshot taken before the track was finalized.
+        candidateQueueCounters.finalized++;
         return false;
     }
-
-    auto remove_pending_for_track = [this](int track_id) {
-        auto dropped_it = pendingCandidateEvalByTrack.find(track_id);
-        if (dropped_it != pendingCandidateEvalByTrack.end()) {
-            dropped_it->second--;
-            if (dropped_it->second <= 0) {
-                pendingCandidateEvalByTrack.erase(dropped_it);
+    if (mailbox.jobs.size() >= per_track_max) {
+        // A newer frame of the same track replaces its oldest queued one.
+        mailbox.jobs.pop_front();
+        candidateQueuedJobs--;
+        candidateQueueCounters.superseded++;
+    } else if (candidateQueuedJobs >= queue_max) {
+        // Full: make room in the least valuable mailbox, unless the new job
+        // is worth even less than that.
+        int victim_slot = -1;
+        float victim_priority = 0.0f;
+        for (int ready_slot : candidateReadySlots) {
+            float priority = candidateMailboxPriority(candidateMailboxes[ready_slot]);
+            if (victim_slot < 0 || priority < victim_priority) {
+                victim_slot = ready_slot;
+                victim_priority = priority;
             }
         }
-    };
-
-    auto drop_job_at = [&](size_t index) {
-        int dropped_track_id = candidateEvalQueue[index].trackId;
-        candidateEvalQueue.erase(candidateEvalQueue.begin() + index);
-        remove_pending_for_track(dropped_track_id);
-    };
-
-    if (candidateEvalQueue.size() >= static_cast<size_t>(config.candidateQueueMax)) {
-        size_t drop_index = candidateEvalQueue.size();
-
-        if (pending_for_track > 0) {
-            for (size_t i = 0; i < candidateEvalQueue.size(); ++i) {
-                if (candidateEvalQueue[i].trackId == job.trackId) {
-                    drop_index = i;
-                    break;
-                }
-            }
+        float job_priority = job.captureValue *
+            (mailbox.hasStrongCandidate ? kEvalStrongCandidateDiscount : 1.0f);
+        if (victim_slot < 0 || job_priority < victim_priority) {
+            candidateQueueCounters.rejected++;
+            char detail[192];
+            std::snprintf(detail, sizeof(detail), "queue=%zu value=%.2f min_queued=%.2f",
+                          candidateQueuedJobs,
+                          job_priority,
+                          victim_priority);
+            logTrackReject("queue", track_id, "queue_full", detail);
+            return false;
+        }
+        CandidateMailbox& victim = candidateMailboxes[victim_slot];
+        victim.jobs.pop_front();
+        candidateQueuedJobs--;
+        candidateQueueCounters.evicted++;
+        if (victim.jobs.empty()) {
+            unreadyCandidateMailbox(victim_slot);
         }
+    }
 
-        if (drop_index == candidateEvalQueue.size()) {
-            for (size_t i = 0; i < candidateEvalQueue.size(); ++i) {
-                int queued_track_id = candidateEvalQueue[i].trackId;
-                auto queued_it = pendingCandidateEvalByTrack.find(queued_track_id);
-                if (queued_it != pendingCandidateEvalByTrack.end() && queued_it->second > 1) {
-                    drop_index = i;
-                    break;
-                }
-            }
+    if (mailbox.jobs.empty()) {
+        mailbox.waitingSince = candidateDispatchTick;
+    }
+    mailbox.jobs.push_back(std::move(job));
+    candidateQueuedJobs++;
+    candidateQueueCounters.enqueued++;
+    if (mailbox.readyIndex < 0) {
+        mailbox.readyIndex = static_cast<int>(candidateReadySlots.size());
+        candidateReadySlots.push_back(slot);
+    }
+    clearTrackReject("queue", track_id);
+    candidateEvalCv.notify_one();
+    return true;
+}
+
+// Pops the oldest job of the most valuable mailbox. Caller holds
+// candidateEvalMutex.
+bool CameraTask::takeCandidateEvaluation(CandidateEvalJob& job) {
+    int best_slot = -1;
+    float best_priority = 0.0f;
+    for (int slot : candidateReadySlots) {
+        float priority = candidateMailboxPriority(candidateMailboxes[slot]);
+        if (best_slot < 0 || priority > best_priority) {
+            best_slot = slot;
+            best_priority = priority;
         }
+    }
+    if (best_slot < 0) {
+        return false;
+    }
 
-        if (drop_index == candidateEvalQueue.size()) {
-            for (size_t i = 0; i < candidateEvalQueue.size(); ++i) {
-                if (candidateEvalQueue[i].trackId != job.trackId) {
-                    drop_index = i;
-                    break;
-                }
-            }
+    CandidateMailbox& mailbox = candidateMailboxes[best_slot];
+    job = std::move(mailbox.jobs.front());
+    mailbox.jobs.pop_front();
+    candidateQueuedJobs--;
+    candidateDispatchTick++;
+    mailbox.waitingSince = candidateDispatchTick;
+    if (mailbox.jobs.empty()) {
+        unreadyCandidateMailbox(best_slot);
+    }
+    return true;
+}
+
+// Called once the tracker has finalized the track: its queued jobs would
+// only refill a candidate list nobody reads any more.
+void CameraTask::dropFinalizedCandidates(int slot, uint32_t generation) {
+    std::lock_guard<std::mutex> lock(candidateEvalMutex);
+    CandidateMailbox& mailbox = candidateMailbox(slot, generation);
+    mailbox.finalized = true;
+    candidateQueueCounters.finalized += mailbox.jobs.size();
+    candidateQueuedJobs -= mailbox.jobs.size();
+    mailbox.jobs.clear();
+    if (mailbox.readyIndex >= 0) {
+        unreadyCandidateMailbox(slot);
+    }
+}
+
+CandidateQueueStats CameraTask::getCandidateQueueStats() {
+    std::lock_guard<std::mutex> lock(candidateEvalMutex);
+    CandidateQueueStats stats = candidateQueueCounters;
+    stats.queued = candidateQueuedJobs;
+    return stats;
+}
+
+bool CameraTask::finishCandidateGate(CandidateGate gate,
+                                     std::chrono::steady_clock::time_point& start,
+                                     bool passed) {
+    auto now = std::chrono::steady_clock::now();
+    CandidateGateCounter& counter = candidateGateCounters[gate];
+    counter.evaluated.fetch_add(1, std::memory_order_relaxed);
+    if (passed) {
+        counter.passed.fetch_add(1, std::memory_order_relaxed);
+    }
+    counter.elapsedNs.fetch_add(
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count()),
+        std::memory_order_relaxed);
+    start = now;
+    return passed;
+}
+
+std::vector<CandidateGateStats> CameraTask::getCandidateGateStats() const {
+    std::vector<CandidateGateStats> stats;
+    stats.reserve(CANDIDATE_GATE_COUNT);
+    for (int gate = 0; gate < CANDIDATE_GATE_COUNT; ++gate) {
+        const CandidateGateCounter& counter = candidateGateCounters[gate];
+        stats.push_back({kCandidateGateNames[gate],
+                         counter.evaluated.load(std::memory_order_relaxed),
+                         counter.passed.load(std::memory_order_relaxed),
+                         counter.elapsedNs.load(std::memory_order_relaxed)});
+    }
+    return stats;
+}
+
+void CameraTask::logCandidateGateStats() {
+    std::vector<CandidateGateStats> stats = getCandidateGateStats();
+    if (stats.empty() || stats[0].evaluated == 0) {
+        return;
+    }
+    std::string line;
+    char item[96];
+    for (const CandidateGateStats& gate : stats) {
+        double mean_us = gate.evaluated > 0 ? gate.elapsedNs / 1000.0 / gate.evaluated : 0.0;
+        std::snprintf(item, sizeof(item), " %s=%llu/%llu %.0fus %.1fs",
+                      gate.name,
+                      static_cast<unsigned long long>(gate.passed),
+                      static_cast<unsigned long long>(gate.evaluated),
+                      mean_us,
+                      gate.elapsedNs / 1e9);
+        line += item;
+    }
+    log_info("Eval gates (passed/evaluated mean total):%s", line.c_str());
+}
+
+// One candidate through the capture gates, cheapest first. Motion, pose and
+// the headshot crop only need the job and the face box, so they run before
+// the quality measurement and fusion; each hoisted check rejects only what
+// the final strong/fallback decision would reject anyway.
+void CameraTask::evaluateCandidate(const CandidateEvalJob& job,
+                                   rknn_context faceCtx,
+                                   TrackStateSlab<TrackEvalState>& evalStates) {
+    if (job.personRoi.empty() || job.personRoi.cols <= 0 || job.personRoi.rows <= 0) {
+        return;
+    }
+
+    DeviceConfig::CaptureDefaults config = getCaptureConfigSnapshot();
+    AdaptiveCaptureThresholds adaptiveThresholds =
+        buildAdaptiveCaptureThresholds(config,
+                                       sensorExposureRatio.load(),
+                                       sensorGainRatio.load());
+    auto gate_start = std::chrono::steady_clock::now();
+
+    // ── Motion: required by both candidate kinds ──
+    bool motion_gate_ok = job.motionRatio < adaptiveThresholds.maxMotionRatio;
+    if (!finishCandidateGate(CANDIDATE_GATE_MOTION, gate_start, motion_gate_ok)) {
+        char detail[192];
+        std::snprintf(detail, sizeof(detail), "motion=%.4f max=%.4f area=%.4f ll=%.2f",
+                      job.motionRatio,
+                      adaptiveThresholds.maxMotionRatio,
+                      job.areaRatio,
+                      adaptiveThresholds.lowLightStrength);
+        logTrackReject("eval", job.trackId, "motion_soft_large", detail);
+        return;
+    }
+
+    // ── Face detection ──
+    // Once a face has been accepted, detection runs on a crop around where it
+    // was, at up to native resolution; the whole person ROI (downscaled to
+    // faceInputMaxWidth) is searched only until then or when the crop misses.
+    TrackEvalState& eval_state = evalStates.acquire(job.trackSlot, job.trackGeneration);
+    std::vector<det> face_result;
+    int num_faces = 0;
+    bool head_region_hit = false;
+    if (eval_state.hasFace) {
+        cv::Rect head_region = predictedHeadRegion(eval_state.lastFace, job.personRoi.size());
+        if (head_region.width >= kHeadRegionMinSide && head_region.height >= kHeadRegionMinSide) {
+            num_faces = detectFacesInRegion(faceCtx, job.personRoi, head_region, config.faceInputMaxWidth, face_result);
+            head_region_hit = num_faces > 0 && !face_result.empty();
         }
+        if (!head_region_hit) {
+            eval_state.hasFace = false;
+        }
+    }
+    if (!head_region_hit) {
+        num_faces = detectFacesInRegion(faceCtx,
+                                        job.personRoi,
+                                        cv::Rect(0, 0, job.personRoi.cols, job.personRoi.rows),
+                                        config.faceInputMaxWidth,
+                                        face_result);
+    }
+    num_faces = std::min(num_faces, static_cast<int>(face_result.size()));
+    if (!finishCandidateGate(CANDIDATE_GATE_FACE_DETECT, gate_start, num_faces > 0 && !face_result.empty())) {
+        char detail[192];
+        std::snprintf(detail, sizeof(detail), "faces=%d roi=%dx%d area=%.4f motion=%.4f",
+                      num_faces,
+                      job.personRoi.cols,
+                      job.personRoi.rows,
+                      job.areaRatio,
+                      job.motionRatio);
+        logTrackReject("eval", job.trackId, "no_face_detected", detail);
+        return;
+    }
 
-        if (drop_index == candidateEvalQueue.size()) {
-            char detail[192];
-            std::snprintf(detail, sizeof(detail), "queue=%zu pending=%d no_replace_slot",
-                          candidateEvalQueue.size(),
-                          pending_for_track);
-            logTrackReject("queue", job.trackId, "queue_full", detail);
-            return false;
+    // ── Face score / landmarks ──
+    int best_idx = 0;
+    for (int i = 1; i < num_faces; ++i) {
+        if (face_result[i].score > face_result[best_idx].score) {
+            best_idx = i;
         }
+    }
 
-        drop_job_at(drop_index);
+    det best_face = face_result[best_idx];
+    if (!finishCandidateGate(CANDIDATE_GATE_FACE_SCORE, gate_start,
+                             best_face.score >= config.minFaceScore && best_face.landmarks.size() >= 3)) {
+        char detail[192];
+        std::snprintf(detail, sizeof(detail), "score=%.2f min=%.2f landmarks=%zu",
+                      best_face.score,
+                      config.minFaceScore,
+                      best_face.landmarks.size());
+        logTrackReject("eval", job.trackId,
+                       best_face.landmarks.size() < 3 ? "landmarks_missing" : "face_score_low",
+                       detail);
+        return;
     }
 
-    pendingCandidateEvalByTrack[job.trackId] = pending_for_track + 1;
-    candidateEvalQueue.push_back(std::move(job));
-    clearTrackReject("queue", candidateEvalQueue.back().trackId);
-    candidateEvalCv.notify_one();
-    return true;
+    // ── Face box ──
+    Rect base_fbox(static_cast<int>(best_face.box.x),
+                  static_cast<int>(best_face.box.y),
+                  static_cast<int>(best_face.box.width),
+                  static_cast<int>(best_face.box.height));
+    base_fbox.x = std::max(0, std::min(base_fbox.x, job.personRoi.cols - 1));
+    base_fbox.y = std::max(0, std::min(base_fbox.y, job.personRoi.rows - 1));
+    base_fbox.width = std::min(base_fbox.width, job.personRoi.cols - base_fbox.x);
+    base_fbox.height = std::min(base_fbox.height, job.personRoi.rows - base_fbox.y);
+
+    if (base_fbox.width <= 0 || base_fbox.height <= 0) {
+        finishCandidateGate(CANDIDATE_GATE_FACE_BOX, gate_start, false);
+        char detail[160];
+        std::snprintf(detail, sizeof(detail), "base_fbox=%dx%d", base_fbox.width, base_fbox.height);
+        logTrackReject("eval", job.trackId, "face_box_invalid", detail);
+        return;
+    }
+
+    int face_short_side = std::min(base_fbox.width, base_fbox.height);
+    int face_area = base_fbox.area();
+    if (!finishCandidateGate(CANDIDATE_GATE_FACE_BOX, gate_start,
+                             face_short_side >= config.minFaceBoxShortSide &&
+                             face_area >= config.minFaceBoxArea)) {
+        char detail[224];
+        std::snprintf(detail, sizeof(detail), "short=%d min_short=%d area=%d min_area=%d",
+                      face_short_side,
+                      config.minFaceBoxShortSide,
+                      face_area,
+                      config.minFaceBoxArea);
+        logTrackReject("eval", job.trackId, "face_box_small", detail);
+        return;
+    }
+    eval_state.hasFace = true;
+    eval_state.lastFace = cv::Rect2f(static_cast<float>(base_fbox.x) / job.personRoi.cols,
+                                     static_cast<float>(base_fbox.y) / job.personRoi.rows,
+                                     static_cast<float>(base_fbox.width) / job.personRoi.cols,
+                                     static_cast<float>(base_fbox.height) / job.personRoi.rows);
+
+    // ── Face geometry inside the person box ──
+    float person_area = static_cast<float>(job.personRoi.cols * job.personRoi.rows);
+    float face_area_ratio = face_area / std::max(1.0f, person_area);
+    float face_width_ratio = static_cast<float>(base_fbox.width) / std::max(1, job.personRoi.cols);
+    float face_center_y_ratio = static_cast<float>(base_fbox.y + base_fbox.height * 0.5f) / std::max(1, job.personRoi.rows);
+    bool face_geometry_ok =
+        face_area_ratio >= config.faceMinAreaInPerson &&
+        face_width_ratio >= config.faceMinWidthRatio &&
+        face_center_y_ratio >= config.faceMinCenterYRatio &&
+        face_center_y_ratio <= config.faceMaxCenterYRatio;
+    if (!finishCandidateGate(CANDIDATE_GATE_FACE_GEOMETRY, gate_start, face_geometry_ok)) {
+        char detail[224];
+        std::snprintf(detail, sizeof(detail),
+                      "area_ratio=%.3f width_ratio=%.3f center_y=%.3f",
+                      face_area_ratio,
+                      face_width_ratio,
+                      face_center_y_ratio);
+        logTrackReject("eval", job.trackId, "face_geometry", detail);
+        return;
+    }
+
+    // ── Pose and edge occlusion ──
+    float margin_left = static_cast<float>(base_fbox.x);
+    float margin_right = static_cast<float>(job.personRoi.cols - (base_fbox.x + base_fbox.width));
+    float margin_top = static_cast<float>(base_fbox.y);
+    float margin_bottom = static_cast<float>(job.personRoi.rows - (base_fbox.y + base_fbox.height));
+    float margin_x_ratio = std::min(margin_left, margin_right) / std::max(1, base_fbox.width);
+    float margin_y_ratio = std::min(margin_top, margin_bottom) / std::max(1, base_fbox.height);
+    float min_margin_ratio = std::min(margin_x_ratio, margin_y_ratio);
+
+    float face_edge_occlusion = 0.0f;
+    if (min_margin_ratio < config.faceEdgeMinMargin) {
+        face_edge_occlusion =
+            (config.faceEdgeMinMargin - min_margin_ratio) / config.faceEdgeMinMargin;
+        face_edge_occlusion = std::max(0.0f, std::min(1.0f, face_edge_occlusion));
+    }
+
+    cv::Point2f left_eye = best_face.landmarks[0];
+    cv::Point2f right_eye = best_face.landmarks[1];
+    float dx = right_eye.x - left_eye.x;
+    if (std::fabs(dx) < 1e-5f) {
+        finishCandidateGate(CANDIDATE_GATE_POSE, gate_start, false);
+        char detail[160];
+        std::snprintf(detail, sizeof(detail), "eye_dx=%.5f", dx);
+        logTrackReject("eval", job.trackId, "eye_distance_small", detail);
+        return;
+    }
+
+    float dy = right_eye.y - left_eye.y;
+    float roll = std::fabs(std::atan2(dy, dx) * 180.0f / CV_PI);
+    float eye_center_x = (left_eye.x + right_eye.x) / 2.0f;
+    float yaw = std::fabs((best_face.landmarks[2].x - eye_center_x) / dx);
+    bool frontal_ok = isFrontalFace(best_face.landmarks);
+    bool frontal_relaxed_ok = frontal_ok ||
+        (roll < 24.0f && yaw < 0.32f && best_face.score >= 0.58f && face_edge_occlusion < 0.40f);
+    bool weak_frontal_ok = frontal_relaxed_ok ||
+        (roll < 32.0f && yaw < 0.48f && best_face.score >= config.minFaceScore && face_edge_occlusion < 0.72f);
+    // The non-image terms of the strong and fallback conditions below.
+    bool strong_pose_ok =
+        (!config.requireFrontalFace || frontal_relaxed_ok) &&
+        yaw < config.maxYaw;
+    bool fallback_pose_ok =
+        (!config.requireFrontalFace || weak_frontal_ok) &&
+        yaw < config.fallbackMaxYaw &&
+        face_edge_occlusion < config.fallbackMaxFaceEdgeOcclusion;
+    if (!finishCandidateGate(CANDIDATE_GATE_POSE, gate_start, strong_pose_ok || fallback_pose_ok)) {
+        char detail[224];
+        std::snprintf(detail, sizeof(detail),
+                      "frontal=%d relaxed=%d weak=%d roll=%.1f yaw=%.2f edge=%.2f",
+                      frontal_ok ? 1 : 0,
+                      frontal_relaxed_ok ? 1 : 0,
+                      weak_frontal_ok ? 1 : 0,
+                      roll,
+                      yaw,
+                      face_edge_occlusion);
+        const char* reason = "edge_occlusion";
+        if (config.requireFrontalFace && !weak_frontal_ok) {
+            reason = "non_frontal";
+        } else if (yaw >= config.fallbackMaxYaw) {
+            reason = "yaw_large";
+        }
+        logTrackReject("eval", job.trackId, reason, detail);
+        return;
+    }
+
+    // ── Headshot crop ──
+    Rect fbox = headshotCropBox(base_fbox, job.personRoi.size(), config);
+    if (fbox.width <= 0 || fbox.height <= 0) {
+        finishCandidateGate(CANDIDATE_GATE_HEADSHOT_CROP, gate_start, false);
+        char detail[160];
+        std::snprintf(detail, sizeof(detail), "invalid_headshot_box=%dx%d", fbox.width, fbox.height);
+        logTrackReject("eval", job.trackId, "headshot_box_invalid", detail);
+        return;
+    }
+
+    float crop_margin_left = static_cast<float>(base_fbox.x - fbox.x) / std::max(1, base_fbox.width);
+    float crop_margin_right = static_cast<float>((fbox.x + fbox.width) - (base_fbox.x + base_fbox.width)) / std::max(1, base_fbox.width);
+    float crop_margin_top = static_cast<float>(base_fbox.y - fbox.y) / std::max(1, base_fbox.height);
+    float crop_margin_bottom = static_cast<float>((fbox.y + fbox.height) - (base_fbox.y + base_fbox.height)) / std::max(1, base_fbox.height);
+    float crop_min_margin = std::min(std::min(crop_margin_left, crop_margin_right),
+                                     std::min(crop_margin_top, crop_margin_bottom));
+    bool strong_margin_ok = crop_min_margin >= config.headshotMinFaceMargin;
+    bool fallback_margin_ok = crop_min_margin >= config.fallbackHeadshotMinFaceMargin;
+    if (!finishCandidateGate(CANDIDATE_GATE_HEADSHOT_CROP, gate_start,
+                             (strong_pose_ok && strong_margin_ok) ||
+                             (fallback_pose_ok && fallback_margin_ok))) {
+        char detail[224];
+        std::snprintf(detail, sizeof(detail),
+                      "crop_margin=%.2f need=%.2f/%.2f yaw=%.2f",
+                      crop_min_margin,
+                      config.headshotMinFaceMargin,
+                      config.fallbackHeadshotMinFaceMargin,
+                      yaw);
+        logTrackReject("eval", job.trackId, "headshot_margin", detail);
+        return;
+    }
+
+    // ── Quality of the reference ROI ──
+    double reference_clarity = 0.0;
+    float reference_blur_severity = 1.0f;
+    measureCandidateQuality(job.personRoi(base_fbox), reference_clarity, reference_blur_severity);
+    finishCandidateGate(CANDIDATE_GATE_QUALITY, gate_start, true);
+    double current_clarity = reference_clarity;
+    float current_blur_severity = reference_blur_severity;
+
+    // ── Multi-frame fusion ──
+    cv::Mat fused_person_roi;
+    const cv::Mat* capture_person_roi = &job.personRoi;
+    bool multi_frame_fused = false;
+    int fusion_frame_count = 0;
+    float fusion_mean_similarity = 0.0f;
+    bool fusion_enabled =
+        (adaptiveThresholds.lowLightStrength >= kMultiFrameFusionLowLightMinStrength ||
+         job.motionRatio > 0.005f) &&
+        !job.fusionHistory.empty() &&
+        job.motionRatio <= adaptiveThresholds.maxMotionRejectRatio;
+    if (fusion_enabled) {
+        // Only the face box and the two uploaded crops are read from the fused ROI.
+        cv::Rect fusion_region = base_fbox |
+            fbox |
+            upperBodyCropBox(base_fbox, job.personRoi.size(), config);
+        TrackFusionResult fusion_result = eval_state.fusion.fuse({job.personRoi, job.roiSeq, job.personFrame},
+                                                            job.fusionHistory,
+                                                            base_fbox,
+                                                            fusion_region);
+        if (!fusion_result.fused.empty() && fusion_result.acceptedFrames >= 2) {
+            double fused_clarity = 0.0;
+            float fused_blur_severity = 1.0f;
+            measureCandidateQuality(fusion_result.fused(base_fbox), fused_clarity, fused_blur_severity);
+            bool fusion_better =
+                fused_clarity > reference_clarity * 1.06 + 3.0 ||
+                (fused_clarity >= reference_clarity * 0.99 &&
+                 fused_blur_severity + 0.06f < reference_blur_severity) ||
+                (fused_blur_severity + 0.10f < reference_blur_severity &&
+                 fused_clarity >= reference_clarity * 0.95);
+            if (fusion_better) {
+                fused_person_roi = std::move(fusion_result.fused);
+                capture_person_roi = &fused_person_roi;
+                current_clarity = fused_clarity;
+                current_blur_severity = fused_blur_severity;
+                multi_frame_fused = true;
+                fusion_frame_count = fusion_result.acceptedFrames;
+                fusion_mean_similarity = fusion_result.meanSimilarity;
+                log_debug("Track %d multi-frame fusion used: frames=%d sim=%.2f clarity=%.1f->%.1f blur=%.2f->%.2f",
+                          job.trackId,
+                          fusion_result.acceptedFrames,
+                          fusion_result.meanSimilarity,
+                          reference_clarity,
+                          fused_clarity,
+                          reference_blur_severity,
+                          fused_blur_severity);
+            }
+        }
+        finishCandidateGate(CANDIDATE_GATE_FUSION, gate_start, multi_frame_fused);
+    }
+
+    // ── Strong / fallback decision ──
+    bool strong_candidate_ok =
+        strong_pose_ok &&
+        current_clarity > adaptiveThresholds.minClarity &&
+        current_blur_severity < adaptiveThresholds.maxBlurSeverity;
+    bool fallback_candidate_ok =
+        fallback_pose_ok &&
+        current_clarity > adaptiveThresholds.fallbackMinClarity &&
+        current_blur_severity < adaptiveThresholds.fallbackMaxBlurSeverity;
+
+    if (!strong_candidate_ok && !fallback_candidate_ok) {
+        finishCandidateGate(CANDIDATE_GATE_DECISION, gate_start, false);
+        char detail[320];
+        std::snprintf(detail, sizeof(detail),
+                      "frontal=%d relaxed=%d weak=%d yaw=%.2f clarity=%.1f edge=%.2f blur=%.2f motion=%.4f ae_exp=%.2f ae_gain=%.3f ll=%.2f",
+                      frontal_ok ? 1 : 0,
+                      frontal_relaxed_ok ? 1 : 0,
+                      weak_frontal_ok ? 1 : 0,
+                      yaw,
+                      current_clarity,
+                      face_edge_occlusion,
+                      current_blur_severity,
+                      job.motionRatio,
+                      sensorExposureRatio.load(),
+                      sensorGainRatio.load(),
+                      adaptiveThresholds.lowLightStrength);
+        const char* reason = "quality_gate";
+        if (config.requireFrontalFace && !weak_frontal_ok) {
+            reason = "non_frontal";
+        } else if (current_clarity <= adaptiveThresholds.fallbackMinClarity) {
+            reason = "clarity_low";
+        } else if (current_blur_severity >= adaptiveThresholds.fallbackMaxBlurSeverity) {
+            reason = "motion_blur";
+        } else if (yaw >= config.fallbackMaxYaw) {
+            reason = "yaw_large";
+        } else if (face_edge_occlusion >= config.fallbackMaxFaceEdgeOcclusion) {
+            reason = "edge_occlusion";
+        }
+        logTrackReject("eval", job.trackId, reason, detail);
+        return;
+    }
+
+    float required_crop_margin = strong_candidate_ok ?
+        config.headshotMinFaceMargin :
+        config.fallbackHeadshotMinFaceMargin;
+    if (crop_min_margin < required_crop_margin) {
+        finishCandidateGate(CANDIDATE_GATE_DECISION, gate_start, false);
+        char detail[224];
+        std::snprintf(detail, sizeof(detail),
+                      "crop_margin=%.2f need=%.2f yaw=%.2f clarity=%.1f",
+                      crop_min_margin,
+                      required_crop_margin,
+                      yaw,
+                      current_clarity);
+        logTrackReject("eval", job.trackId, "headshot_margin", detail);
+        return;
+    }
+
+    // Crops of the plain ROI stay views into the pooled frame; the tracker
+    // copies them out only for upload or when the pool needs the frame back.
+    // Crops of a fused ROI are copied, as the fused ROI is much larger.
+    Mat face_aligned = (*capture_person_roi)(fbox);
+    cv::Rect upper_body_box = upperBodyCropBox(base_fbox, job.personRoi.size(), config);
+    cv::Mat person_aligned = (*capture_person_roi)(upper_body_box);
+    if (multi_frame_fused) {
+        face_aligned = face_aligned.clone();
+        person_aligned = person_aligned.clone();
+    }
+    float quality_weight, area_weight;
+    if (yaw < 0.15f) {
+        quality_weight = 0.8f;
+        area_weight = 0.35f;
+    } else if (yaw < 0.30f) {
+        float ratio = (yaw - 0.15f) / 0.15f;
+        quality_weight = 0.8f - ratio * 0.3f;
+        area_weight = 0.35f - ratio * 0.15f;
+    } else if (yaw < 0.50f) {
+        float ratio = (yaw - 0.30f) / 0.20f;
+        quality_weight = 0.5f - ratio * 0.25f;
+        area_weight = 0.2f - ratio * 0.12f;
+    } else {
+        float ratio = (yaw - 0.50f) / 0.20f;
+        quality_weight = 0.25f - ratio * 0.15f;
+        area_weight = 0.08f - ratio * 0.05f;
+    }
+
+    float area_score = 1.0f / (1.0f + std::fabs(job.areaRatio - config.areaScoreTargetRatio) /
+                                        std::max(1e-6f, config.areaScoreTargetRatio));
+    float clarity_norm = static_cast<float>(std::min(1.8, current_clarity / std::max(1.0, adaptiveThresholds.minClarity)));
+    float person_occ_norm = job.personOcclusion / std::max(1e-6f, config.maxPersonOcclusion);
+    person_occ_norm = std::max(0.0f, std::min(1.5f, person_occ_norm));
+    float face_edge_occ_norm = face_edge_occlusion / std::max(1e-6f, config.maxFaceEdgeOcclusion);
+    face_edge_occ_norm = std::max(0.0f, std::min(1.5f, face_edge_occ_norm));
+    float occlusion_penalty = person_occ_norm * 0.7f + face_edge_occ_norm * 0.3f;
+    float motion_penalty = std::min(1.25f, job.motionRatio / std::max(1e-6f, adaptiveThresholds.maxMotionRatio));
+    float blur_severity_penalty = std::min(1.25f, current_blur_severity / std::max(1e-6f, adaptiveThresholds.maxBlurSeverity));
+    float candidate_penalty = strong_candidate_ok ? 0.0f : config.fallbackScorePenalty;
+    float clarity_gain = std::max(0.0f, clarity_norm - 1.0f);
+    float face_confidence_bonus = std::min(1.0f, std::max(0.0f, best_face.score)) * 90.0f;
+    float frontal_bonus = frontal_ok ? 135.0f : (frontal_relaxed_ok ? 75.0f : 20.0f);
+    float crop_margin_bonus =
+        std::min(1.6f, crop_min_margin / std::max(1e-6f, required_crop_margin)) * 75.0f;
+    float face_size_bonus =
+        std::min(1.8f, face_area_ratio / std::max(1e-6f, config.faceMinAreaInPerson)) * 45.0f;
+    float yaw_penalty =
+        std::min(1.25f, yaw / std::max(0.10f, strong_candidate_ok ? config.maxYaw : config.fallbackMaxYaw)) * 60.0f;
+
+    Track::FrameData frame_data;
+    frame_data.score = current_clarity * (0.55f + quality_weight * 0.20f) +
+                       clarity_norm * 220.0f +
+                       clarity_gain * 160.0f +
+                       frontal_bonus +
+                       face_confidence_bonus +
+                       crop_margin_bonus +
+                       face_size_bonus +
+                       area_score * 1000 * area_weight * 0.22f -
+                       occlusion_penalty * config.occlusionScorePenalty * 1.15f -
+                       motion_penalty * config.motionScorePenalty * 1.30f -
+                       blur_severity_penalty * config.blurSeverityScorePenalty * 1.45f -
+                       yaw_penalty -
+                       candidate_penalty;
+    frame_data.person_roi = person_aligned;
+    frame_data.face_roi = face_aligned;
+    if (!multi_frame_fused) {
+        frame_data.source = job.personFrame;
+    }
+    frame_data.has_face = true;
+    frame_data.is_frontal = frontal_ok;
+    frame_data.face_pose_level = frontal_ok ? 2 : (frontal_relaxed_ok ? 1 : 0);
+    frame_data.strong_candidate = strong_candidate_ok;
+    frame_data.yaw_abs = yaw;
+    frame_data.clarity = current_clarity;
+    frame_data.area_ratio = job.areaRatio;
+    frame_data.person_occlusion = job.personOcclusion;
+    frame_data.face_edge_occlusion = face_edge_occlusion;
+    frame_data.motion_ratio = job.motionRatio;
+    frame_data.blur_severity = current_blur_severity;
+    // Same flags as the uploader's face measurement, so an uploaded crop is
+    // not measured a second time.
+    compute_quality_metrics(face_aligned, frame_data.face_quality, QUALITY_GRADIENT_MAGNITUDE | QUALITY_SHIFT_TRAILS);
+    add_frame_candidate(job.trackId, frame_data);
+    if (strong_candidate_ok) {
+        eval_state.hasStrongCandidate = true;
+    }
+    finishCandidateGate(CANDIDATE_GATE_DECISION, gate_start, true);
+    clearTrackReject("eval", job.trackId);
+
+    // Good enough: queue the upload now instead of when the track expires, and stop
+    // spending face inferences on it.
+    if (config.earlyFinalizeEnabled &&
+        strong_candidate_ok &&
+        current_clarity >= config.earlyFinalizeMinClarity &&
+        yaw <= config.earlyFinalizeMaxYaw &&
+        face_short_side >= config.earlyFinalizeMinFaceShortSide &&
+        finalize_track_capture(job.trackId)) {
+        dropFinalizedCandidates(job.trackSlot, job.trackGeneration);
+    }
+
+    if (multi_frame_fused) {
+        log_debug("Track %d fused candidate accepted: frames=%d sim=%.2f clarity=%.1f blur=%.2f yaw=%.2f edge=%.2f",
+                  job.trackId,
+                  fusion_frame_count,
+                  fusion_mean_similarity,
+                  current_clarity,
+                  current_blur_severity,
+                  yaw,
+                  face_edge_occlusion);
+    } else if (!strong_candidate_ok) {
+        log_debug("Track %d fallback candidate accepted: clarity=%.1f blur=%.2f yaw=%.2f edge=%.2f",
+                  job.trackId,
+                  current_clarity,
+                  current_blur_severity,
+                  yaw,
+                  face_edge_occlusion);
+    }
 }
 
 void CameraTask::candidateEvalLoop(rknn_context faceCtx) {
+    // Eval state lives on this thread only; one epoch per job.
+    TrackStateSlab<TrackEvalState> eval_states;
     while (true) {
         CandidateEvalJob job;
         {
             std::unique_lock<std::mutex> lock(candidateEvalMutex);
             candidateEvalCv.wait(lock, [this]() {
-                return !running || !candidateEvalQueue.empty();
+                return !running || candidateQueuedJobs > 0;
             });
 
-            if (!running && candidateEvalQueue.empty()) {
+            if (!running && candidateQueuedJobs == 0) {
                 break;
             }
-            if (candidateEvalQueue.empty()) {
+            if (!takeCandidateEvaluation(job)) {
                 continue;
             }
-
-            job = std::move(candidateEvalQueue.front());
-            candidateEvalQueue.pop_front();
         }
+        eval_states.beginFrame();
+        eval_states.retireIdle(kTrackEvalIdleJobs);
 
-        if (!job.personRoi.empty() && job.personRoi.cols > 0 && job.personRoi.rows > 0) {
-            DeviceConfig::CaptureDefaults config = getCaptureConfigSnapshot();
-            AdaptiveCaptureThresholds adaptiveThresholds =
-                buildAdaptiveCaptureThresholds(config,
-                                               sensorExposureRatio.load(),
-                                               sensorGainRatio.load());
-            Mat person_roi_resized;
-            int target_width = min(config.faceInputMaxWidth, job.personRoi.cols);
-            int target_height = static_cast<int>(job.personRoi.rows * target_width / (float)job.personRoi.cols);
-
-            if (target_width > 0 && target_height > 0) {
-                cv::resize(job.personRoi, person_roi_resized, Size(target_width, target_height), 0, 0, cv::INTER_LINEAR);
-
-                std::vector<det> face_result;
-                int num_faces = face_detect_run(faceCtx, person_roi_resized, face_result);
-                if (num_faces <= 0 || face_result.empty()) {
-                    char detail[192];
-                    std::snprintf(detail, sizeof(detail), "faces=%d roi=%dx%d area=%.4f motion=%.4f",
-                                  num_faces,
-                                  job.personRoi.cols,
-                                  job.personRoi.rows,
-                                  job.areaRatio,
-                                  job.motionRatio);
-                    logTrackReject("eval", job.trackId, "no_face_detected", detail);
-                } else {
-                    int best_idx = 0;
-                    for (int i = 1; i < num_faces; ++i) {
-                        if (face_result[i].score > face_result[best_idx].score) {
-                            best_idx = i;
-                        }
-                    }
-
-                    float face_scale_x = (float)job.personRoi.cols / (float)person_roi_resized.cols;
-                    float face_scale_y = (float)job.personRoi.rows / (float)person_roi_resized.rows;
-
-                    det best_face = face_result[best_idx];
-                    if (best_face.score >= config.minFaceScore && best_face.landmarks.size() >= 3) {
-                        best_face.box.x *= face_scale_x;
-                        best_face.box.y *= face_scale_y;
-                        best_face.box.width *= face_scale_x;
-                        best_face.box.height *= face_scale_y;
-                        for (auto& lm : best_face.landmarks) {
-                            lm.x *= face_scale_x;
-                            lm.y *= face_scale_y;
-                        }
-
-                        Rect base_fbox(static_cast<int>(best_face.box.x),
-                                      static_cast<int>(best_face.box.y),
-                                      static_cast<int>(best_face.box.width),
-                                      static_cast<int>(best_face.box.height));
-                        base_fbox.x = std::max(0, std::min(base_fbox.x, job.personRoi.cols - 1));
-                        base_fbox.y = std::max(0, std::min(base_fbox.y, job.personRoi.rows - 1));
-                        base_fbox.width = std::min(base_fbox.width, job.personRoi.cols - base_fbox.x);
-                        base_fbox.height = std::min(base_fbox.height, job.personRoi.rows - base_fbox.y);
-
-                        if (base_fbox.width > 0 && base_fbox.height > 0) {
-                            int face_short_side = std::min(base_fbox.width, base_fbox.height);
-                            int face_area = base_fbox.area();
-                            if (face_short_side >= config.minFaceBoxShortSide &&
-                                face_area >= config.minFaceBoxArea) {
-                                float person_area = static_cast<float>(job.personRoi.cols * job.personRoi.rows);
-                                float face_area_ratio = face_area / std::max(1.0f, person_area);
-                                float face_width_ratio = static_cast<float>(base_fbox.width) / std::max(1, job.personRoi.cols);
-                                float face_center_y_ratio = static_cast<float>(base_fbox.y + base_fbox.height * 0.5f) / std::max(1, job.personRoi.rows);
-                                bool face_geometry_ok =
-                                    face_area_ratio >= config.faceMinAreaInPerson &&
-                                    face_width_ratio >= config.faceMinWidthRatio &&
-                                    face_center_y_ratio >= config.faceMinCenterYRatio &&
-                                    face_center_y_ratio <= config.faceMaxCenterYRatio;
-
-                                if (face_geometry_ok) {
-                                    float margin_left = static_cast<float>(base_fbox.x);
-                                    float margin_right = static_cast<float>(job.personRoi.cols - (base_fbox.x + base_fbox.width));
-                                    float margin_top = static_cast<float>(base_fbox.y);
-                                    float margin_bottom = static_cast<float>(job.personRoi.rows - (base_fbox.y + base_fbox.height));
-                                    float margin_x_ratio = std::min(margin_left, margin_right) / std::max(1, base_fbox.width);
-                                    float margin_y_ratio = std::min(margin_top, margin_bottom) / std::max(1, base_fbox.height);
-                                    float min_margin_ratio = std::min(margin_x_ratio, margin_y_ratio);
-
-                                    float face_edge_occlusion = 0.0f;
-                                    if (min_margin_ratio < config.faceEdgeMinMargin) {
-                                        face_edge_occlusion =
-                                            (config.faceEdgeMinMargin - min_margin_ratio) / config.faceEdgeMinMargin;
-                                        face_edge_occlusion = std::max(0.0f, std::min(1.0f, face_edge_occlusion));
-                                    }
-
-                                    cv::Point2f left_eye = best_face.landmarks[0];
-                                    cv::Point2f right_eye = best_face.landmarks[1];
-                                    float dx = right_eye.x - left_eye.x;
-                                    if (std::fabs(dx) >= 1e-5f) {
-                                        float dy = right_eye.y - left_eye.y;
-                                        float roll = std::fabs(std::atan2(dy, dx) * 180.0f / CV_PI);
-                                        float eye_center_x = (left_eye.x + right_eye.x) / 2.0f;
-                                        float yaw = std::fabs((best_face.landmarks[2].x - eye_center_x) / dx);
-                                        bool frontal_ok = isFrontalFace(best_face.landmarks);
-                                        bool frontal_relaxed_ok = frontal_ok ||
-                                            (roll < 24.0f && yaw < 0.32f && best_face.score >= 0.58f && face_edge_occlusion < 0.40f);
-                                        bool weak_frontal_ok = frontal_relaxed_ok ||
-                                            (roll < 32.0f && yaw < 0.48f && best_face.score >= config.minFaceScore && face_edge_occlusion < 0.72f);
-                                        double reference_clarity = computeFocusMeasure(job.personRoi(base_fbox));
-                                        float reference_blur_severity = computeMotionBlurSeverity(job.personRoi(base_fbox));
-                                        double current_clarity = reference_clarity;
-                                        float current_blur_severity = reference_blur_severity;
-                                        cv::Mat fused_person_roi;
-                                        const cv::Mat* capture_person_roi = &job.personRoi;
-                                        bool multi_frame_fused = false;
-                                        int fusion_frame_count = 0;
-                                        float fusion_mean_similarity = 0.0f;
-                                        bool fusion_enabled =
-                                            (adaptiveThresholds.lowLightStrength >= kMultiFrameFusionLowLightMinStrength ||
-                                             job.motionRatio > 0.005f) &&
-                                            !job.fusionHistory.empty() &&
-                                            job.motionRatio <= adaptiveThresholds.maxMotionRejectRatio;
-                                        if (fusion_enabled) {
-                                            MultiFrameFusionResult fusion_result = fuseTrackHistoryPersonRoi(job.personRoi,
-                                                                                                             job.fusionHistory,
-                                                                                                             base_fbox,
-                                                                                                             adaptiveThresholds.lowLightStrength,
-                                                                                                             job.motionRatio);
-                                            if (!fusion_result.fused.empty() && fusion_result.acceptedFrames >= 2) {
-                                                double fused_clarity = computeFocusMeasure(fusion_result.fused(base_fbox));
-                                                float fused_blur_severity = computeMotionBlurSeverity(fusion_result.fused(base_fbox));
-                                                bool fusion_better =
-                                                    fused_clarity > reference_clarity * 1.06 + 3.0 ||
-                                                    (fused_clarity >= reference_clarity * 0.99 &&
-                                                     fused_blur_severity + 0.06f < reference_blur_severity) ||
-                                                    (fused_blur_severity + 0.10f < reference_blur_severity &&
-                                                     fused_clarity >= reference_clarity * 0.95);
-                                                if (fusion_better) {
-                                                    fused_person_roi = std::move(fusion_result.fused);
-                                                    capture_person_roi = &fused_person_roi;
-                                                    current_clarity = fused_clarity;
-                                                    current_blur_severity = fused_blur_severity;
-                                                    multi_frame_fused = true;
-                                                    fusion_frame_count = fusion_result.acceptedFrames;
-                                                    fusion_mean_similarity = fusion_result.meanSimilarity;
-                                                    log_debug("Track %d multi-frame fusion used: frames=%d sim=%.2f clarity=%.1f->%.1f blur=%.2f->%.2f",
-                                                              job.trackId,
-                                                              fusion_result.acceptedFrames,
-                                                              fusion_result.meanSimilarity,
-                                                              reference_clarity,
-                                                              fused_clarity,
-                                                              reference_blur_severity,
-                                                              fused_blur_severity);
-                                                }
-                                            }
-                                        }
-                                        bool motion_gate_ok = job.motionRatio < adaptiveThresholds.maxMotionRatio;
-                                        bool strong_candidate_ok =
-                                            (!config.requireFrontalFace || frontal_relaxed_ok) &&
-                                            current_clarity > adaptiveThresholds.minClarity &&
-                                            current_blur_severity < adaptiveThresholds.maxBlurSeverity &&
-                                            yaw < config.maxYaw &&
-                                            motion_gate_ok;
-                                        bool fallback_candidate_ok =
-                                            (!config.requireFrontalFace || weak_frontal_ok) &&
-                                            current_clarity > adaptiveThresholds.fallbackMinClarity &&
-                                            current_blur_severity < adaptiveThresholds.fallbackMaxBlurSeverity &&
-                                            yaw < config.fallbackMaxYaw &&
-                                            face_edge_occlusion < config.fallbackMaxFaceEdgeOcclusion &&
-                                            motion_gate_ok;
-
-                                        if (strong_candidate_ok || fallback_candidate_ok) {
-                                            int crop_w = std::max(1, static_cast<int>(base_fbox.width * config.headshotExpandRatio));
-                                            int crop_h = std::max(1, static_cast<int>(base_fbox.height * config.headshotExpandRatio));
-                                            int crop_cx = base_fbox.x + base_fbox.width / 2;
-                                            int crop_cy = base_fbox.y + base_fbox.height / 2 + static_cast<int>(base_fbox.height * config.headshotDownShift);
-                                            int crop_x = crop_cx - crop_w / 2;
-                                            int crop_y = crop_cy - crop_h / 2;
-
-                                            crop_x = std::max(0, std::min(job.personRoi.cols - crop_w, crop_x));
-                                            crop_y = std::max(0, std::min(job.personRoi.rows - crop_h, crop_y));
-                                            Rect fbox(crop_x, crop_y,
-                                                      std::min(crop_w, job.personRoi.cols - crop_x),
-                                                      std::min(crop_h, job.personRoi.rows - crop_y));
-
-                                            if (fbox.width > 0 && fbox.height > 0) {
-                                                float crop_margin_left = static_cast<float>(base_fbox.x - fbox.x) / std::max(1, base_fbox.width);
-                                                float crop_margin_right = static_cast<float>((fbox.x + fbox.width) - (base_fbox.x + base_fbox.width)) / std::max(1, base_fbox.width);
-                                                float crop_margin_top = static_cast<float>(base_fbox.y - fbox.y) / std::max(1, base_fbox.height);
-                                                float crop_margin_bottom = static_cast<float>((fbox.y + fbox.height) - (base_fbox.y + base_fbox.height)) / std::max(1, base_fbox.height);
-                                                float crop_min_margin = std::min(std::min(crop_margin_left, crop_margin_right),
-                                                                                 std::min(crop_margin_top, crop_margin_bottom));
-                                                float required_crop_margin = strong_candidate_ok ?
-                                                    config.headshotMinFaceMargin :
-                                                    config.fallbackHeadshotMinFaceMargin;
-                                                if (crop_min_margin >= required_crop_margin) {
-                                                    Mat face_aligned = (*capture_person_roi)(fbox).clone();
-                                                    int upper_body_w = std::min(job.personRoi.cols,
-                                                        std::max(static_cast<int>(base_fbox.width * config.upperBodyWidthFaceRatio),
-                                                                 static_cast<int>(job.personRoi.cols * config.upperBodyMinWidthRatio)));
-                                                    int upper_body_h = std::min(job.personRoi.rows,
-                                                        std::max(static_cast<int>(base_fbox.height * config.upperBodyHeightFaceRatio),
-                                                                 static_cast<int>(job.personRoi.rows * config.upperBodyMinHeightRatio)));
-                                                    int upper_body_cx = base_fbox.x + base_fbox.width / 2;
-                                                    int upper_body_cy = base_fbox.y + static_cast<int>(base_fbox.height * config.upperBodyCenterYRatio);
-                                                    int upper_body_x = std::max(0, std::min(job.personRoi.cols - upper_body_w, upper_body_cx - upper_body_w / 2));
-                                                    int upper_body_y = std::max(0, std::min(job.personRoi.rows - upper_body_h,
-                                                        upper_body_cy - static_cast<int>(upper_body_h / config.upperBodyTopDivisor)));
-                                                    cv::Rect upper_body_box(
-                                                        upper_body_x,
-                                                        upper_body_y,
-                                                        std::min(upper_body_w, job.personRoi.cols - upper_body_x),
-                                                        std::min(upper_body_h, job.personRoi.rows - upper_body_y));
-                                                    cv::Mat person_aligned = (*capture_person_roi)(upper_body_box).clone();
-                                                    float quality_weight, area_weight;
-                                                    if (yaw < 0.15f) {
-                                                        quality_weight = 0.8f;
-                                                        area_weight = 0.35f;
-                                                    } else if (yaw < 0.30f) {
-                                                        float ratio = (yaw - 0.15f) / 0.15f;
-                                                        quality_weight = 0.8f - ratio * 0.3f;
-                                                        area_weight = 0.35f - ratio * 0.15f;
-                                                    } else if (yaw < 0.50f) {
-                                                        float ratio = (yaw - 0.30f) / 0.20f;
-                                                        quality_weight = 0.5f - ratio * 0.25f;
-                                                        area_weight = 0.2f - ratio * 0.12f;
-                                                    } else {
-                                                        float ratio = (yaw - 0.50f) / 0.20f;
-                                                        quality_weight = 0.25f - ratio * 0.15f;
-                                                        area_weight = 0.08f - ratio * 0.05f;
-                                                    }
-
-                                                    float area_score = 1.0f / (1.0f + std::fabs(job.areaRatio - config.areaScoreTargetRatio) /
-                                                                                        std::max(1e-6f, config.areaScoreTargetRatio));
-                                                    float clarity_norm = static_cast<float>(std::min(1.8, current_clarity / std::max(1.0, adaptiveThresholds.minClarity)));
-                                                    float person_occ_norm = job.personOcclusion / std::max(1e-6f, config.maxPersonOcclusion);
-                                                    person_occ_norm = std::max(0.0f, std::min(1.5f, person_occ_norm));
-                                                    float face_edge_occ_norm = face_edge_occlusion / std::max(1e-6f, config.maxFaceEdgeOcclusion);
-                                                    face_edge_occ_norm = std::max(0.0f, std::min(1.5f, face_edge_occ_norm));
-                                                    float occlusion_penalty = person_occ_norm * 0.7f + face_edge_occ_norm * 0.3f;
-                                                    float motion_penalty = std::min(1.25f, job.motionRatio / std::max(1e-6f, adaptiveThresholds.maxMotionRatio));
-                                                    float blur_severity_penalty = std::min(1.25f, current_blur_severity / std::max(1e-6f, adaptiveThresholds.maxBlurSeverity));
-                                                    float candidate_penalty = strong_candidate_ok ? 0.0f : config.fallbackScorePenalty;
-                                                    float clarity_gain = std::max(0.0f, clarity_norm - 1.0f);
-                                                    float face_confidence_bonus = std::min(1.0f, std::max(0.0f, best_face.score)) * 90.0f;
-                                                    float frontal_bonus = frontal_ok ? 135.0f : (frontal_relaxed_ok ? 75.0f : 20.0f);
-                                                    float crop_margin_bonus =
-                                                        std::min(1.6f, crop_min_margin / std::max(1e-6f, required_crop_margin)) * 75.0f;
-                                                    float face_size_bonus =
-                                                        std::min(1.8f, face_area_ratio / std::max(1e-6f, config.faceMinAreaInPerson)) * 45.0f;
-                                                    float yaw_penalty =
-                                                        std::min(1.25f, yaw / std::max(0.10f, strong_candidate_ok ? config.maxYaw : config.fallbackMaxYaw)) * 60.0f;
-
-                                                    Track::FrameData frame_data;
-                                                    frame_data.score = current_clarity * (0.55f + quality_weight * 0.20f) +
-                                                                       clarity_norm * 220.0f +
-                                                                       clarity_gain * 160.0f +
-                                                                       frontal_bonus +
-                                                                       face_confidence_bonus +
-                                                                       crop_margin_bonus +
-                                                                       face_size_bonus +
-                                                                       area_score * 1000 * area_weight * 0.22f -
-                                                                       occlusion_penalty * config.occlusionScorePenalty * 1.15f -
-                                                                       motion_penalty * config.motionScorePenalty * 1.30f -
-                                                                       blur_severity_penalty * config.blurSeverityScorePenalty * 1.45f -
-                                                                       yaw_penalty -
-                                                                       candidate_penalty;
-                                                    frame_data.person_roi = person_aligned;
-                                                    frame_data.face_roi = face_aligned;
-                                                    frame_data.has_face = true;
-                                                    frame_data.is_frontal = frontal_ok;
-                                                    frame_data.face_pose_level = frontal_ok ? 2 : (frontal_relaxed_ok ? 1 : 0);
-                                                    frame_data.strong_candidate = strong_candidate_ok;
-                                                    frame_data.yaw_abs = yaw;
-                                                    frame_data.clarity = current_clarity;
-                                                    frame_data.area_ratio = job.areaRatio;
-                                                    frame_data.person_occlusion = job.personOcclusion;
-                                                    frame_data.face_edge_occlusion = face_edge_occlusion;
-                                                    frame_data.motion_ratio = job.motionRatio;
-                                                    frame_data.blur_severity = current_blur_severity;
-                                                    add_frame_candidate(job.trackId, frame_data);
-                                                    clearTrackReject("eval", job.trackId);
-
-                                                    if (multi_frame_fused) {
-                                                        log_debug("Track %d fused candidate accepted: frames=%d sim=%.2f clarity=%.1f blur=%.2f yaw=%.2f edge=%.2f",
-                                                                  job.trackId,
-                                                                  fusion_frame_count,
-                                                                  fusion_mean_similarity,
-                                                                  current_clarity,
-                                                                  current_blur_severity,
-                                                                  yaw,
-                                                                  face_edge_occlusion);
-                                                    } else if (!strong_candidate_ok) {
-                                                        log_debug("Track %d fallback candidate accepted: clarity=%.1f blur=%.2f yaw=%.2f edge=%.2f",
-                                                                  job.trackId,
-                                                                  current_clarity,
-                                                                  current_blur_severity,
-                                                                  yaw,
-                                                                  face_edge_occlusion);
-#if 0
-                                                    if (!strong_candidate_ok) {
-                                                        log_debug("Track %d 添加兜底候选帧: clarity=%.1f yaw=%.2f occ=%.2f",
-                                                                  job.trackId,
-                                                                  current_clarity,
-                                                                  yaw,
-                                                                  face_edge_occlusion);
-                                                    }
-#endif
-                                                    }
-                                                } else {
-                                                    char detail[224];
-                                                    std::snprintf(detail, sizeof(detail),
-                                                                  "crop_margin=%.2f need=%.2f yaw=%.2f clarity=%.1f",
-                                                                  crop_min_margin,
-                                                                  required_crop_margin,
-                                                                  yaw,
-                                                                  current_clarity);
-                                                    logTrackReject("eval", job.trackId, "headshot_margin", detail);
-                                                }
-                                            } else {
-                                                char detail[160];
-                                                std::snprintf(detail, sizeof(detail), "invalid_headshot_box=%dx%d", fbox.width, fbox.height);
-                                                logTrackReject("eval", job.trackId, "headshot_box_invalid", detail);
-                                            }
-                                        } else {
-                                            char detail[320];
-                                            std::snprintf(detail, sizeof(detail),
-                                                          "frontal=%d relaxed=%d weak=%d yaw=%.2f clarity=%.1f edge=%.2f blur=%.2f motion=%.4f ae_exp=%.2f ae_gain=%.3f ll=%.2f",
-                                                          frontal_ok ? 1 : 0,
-                                                          frontal_relaxed_ok ? 1 : 0,
-                                                          weak_frontal_ok ? 1 : 0,
-                                                          yaw,
-                                                          current_clarity,
-                                                          face_edge_occlusion,
-                                                          current_blur_severity,
-                                                          job.motionRatio,
-                                                          sensorExposureRatio.load(),
-                                                          sensorGainRatio.load(),
-                                                          adaptiveThresholds.lowLightStrength);
-                                            const char* reason = "quality_gate";
-                                            if (config.requireFrontalFace && !weak_frontal_ok) {
-                                                reason = "non_frontal";
-                                            } else if (!motion_gate_ok) {
-                                                reason = "motion_soft_large";
-                                            } else if (current_clarity <= adaptiveThresholds.fallbackMinClarity) {
-                                                reason = "clarity_low";
-                                            } else if (current_blur_severity >= adaptiveThresholds.fallbackMaxBlurSeverity) {
-                                                reason = "motion_blur";
-                                            } else if (yaw >= config.fallbackMaxYaw) {
-                                                reason = "yaw_large";
-                                            } else if (face_edge_occlusion >= config.fallbackMaxFaceEdgeOcclusion) {
-                                                reason = "edge_occlusion";
-                                            }
-                                            logTrackReject("eval", job.trackId, reason, detail);
-                                        }
-                                    } else {
-                                        char detail[160];
-                                        std::snprintf(detail, sizeof(detail), "eye_dx=%.5f", dx);
-                                        logTrackReject("eval", job.trackId, "eye_distance_small", detail);
-                                    }
-                                } else {
-                                    char detail[224];
-                                    std::snprintf(detail, sizeof(detail),
-                                                  "area_ratio=%.3f width_ratio=%.3f center_y=%.3f",
-                                                  face_area_ratio,
-                                                  face_width_ratio,
-                                                  face_center_y_ratio);
-                                    logTrackReject("eval", job.trackId, "face_geometry", detail);
-                                }
-                            } else {
-                                char detail[224];
-                                std::snprintf(detail, sizeof(detail), "short=%d min_short=%d area=%d min_area=%d",
-                                              face_short_side,
-                                              config.minFaceBoxShortSide,
-                                              face_area,
-                                              config.minFaceBoxArea);
-                                logTrackReject("eval", job.trackId, "face_box_small", detail);
-                            }
-                        } else {
-                            char detail[160];
-                            std::snprintf(detail, sizeof(detail), "base_fbox=%dx%d", base_fbox.width, base_fbox.height);
-                            logTrackReject("eval", job.trackId, "face_box_invalid", detail);
-                        }
-                    } else {
-                        char detail[192];
-                        std::snprintf(detail, sizeof(detail), "score=%.2f min=%.2f landmarks=%zu",
-                                      best_face.score,
-                                      config.minFaceScore,
-                                      best_face.landmarks.size());
-                        logTrackReject("eval", job.trackId,
-                                       best_face.landmarks.size() < 3 ? "landmarks_missing" : "face_score_low",
-                                       detail);
-                    }
-                }
-            }
-        }
+        evaluateCandidate(job, faceCtx, eval_states);
 
-        {
+        // Lets the scheduler discount tracks that already hold a strong candidate.
+        const TrackEvalState* eval_state = eval_states.find(job.trackSlot, job.trackGeneration);
+        if (eval_state && eval_state->hasStrongCandidate) {
             std::lock_guard<std::mutex> lock(candidateEvalMutex);
-            auto it = pendingCandidateEvalByTrack.find(job.trackId);
-            if (it != pendingCandidateEvalByTrack.end()) {
-                it->second--;
-                if (it->second <= 0) {
-                    pendingCandidateEvalByTrack.erase(it);
-                }
+            if (static_cast<size_t>(job.trackSlot) < candidateMailboxes.size() &&
+                candidateMailboxes[job.trackSlot].generation == job.trackGeneration) {
+                candidateMailboxes[job.trackSlot].hasStrongCandidate = true;
             }
         }
     }
@@ -1482,16 +1612,15 @@ void CameraTask::run() {
     }
     log_info("CameraTask: face model loaded successfully in %ld seconds", elapsed.count());
     sort_init();
-    lastTrackCenters.clear();
-    trackPersonRoiHistory.clear();
-    trackApproachStates.clear();
-    reportedPersonIds.clear();
+    trackStates.clear();
     candidateRoundRobinOffset = 0;
+    lastTrackerStepTime = {};
+    trackerFramePeriodMs = 0.0;
     hadPersonsInScene = false;
 
-    set_upload_callback([this](const cv::Mat& img, int id, const std::string& type) {
+    set_upload_callback([this](const cv::Mat& img, int id, const std::string& type, const QualityMetrics* quality) {
         if (uploadCallback) {
-            uploadCallback(img, id, type);
+            uploadCallback(img, id, type, quality);
         }
     }, &capturedPersonIds, &capturedFaceIds);
     
@@ -1524,23 +1653,23 @@ void CameraTask::run() {
    */
 
     log_info("CameraTask: starting capture/inference loops...");
-    reportedPersonIds.clear();
+    framePool.reset(static_cast<size_t>(std::max<int>(kFramePoolReserve + 1, getCaptureConfigSnapshot().framePoolSize)),
+                    CAMERA_HEIGHT, CAMERA_WIDTH, CV_8UC3);
     {
         std::lock_guard<std::mutex> lock(frameMutex);
-        latestFrame.release();
+        latestFrame.reset();
         latestFrameSeq = 0;
         consumedFrameSeq = 0;
     }
     {
         std::lock_guard<std::mutex> lock(candidateEvalMutex);
-        candidateEvalQueue.clear();
-        pendingCandidateEvalByTrack.clear();
+        clearCandidateQueue();
     }
     candidateWorker = std::thread(&CameraTask::candidateEvalLoop, this, faceCtx);
     captureWorker = std::thread(&CameraTask::captureLoop, this);
 
     while (running) {
-        Mat frame;
+        FrameHandle frame;
         {
             std::unique_lock<std::mutex> lock(frameMutex);
             frameCv.wait_for(lock, std::chrono::milliseconds(100), [this]() {
@@ -1558,8 +1687,10 @@ void CameraTask::run() {
             consumedFrameSeq = latestFrameSeq;
         }
 
-        if (frame.empty() || frame.cols <= 0 || frame.rows <= 0) {
-            log_error("CameraTask: invalid frame dimensions (width=%d, height=%d)", frame.cols, frame.rows);
+        if (!frame || frame->image.empty() || frame->image.cols <= 0 || frame->image.rows <= 0) {
+            log_error("CameraTask: invalid frame dimensions (width=%d, height=%d)",
+                      frame ? frame->image.cols : 0,
+                      frame ? frame->image.rows : 0);
             continue;
         }
         
@@ -1607,6 +1738,7 @@ void CameraTask::captureLoop() {
             }
             continue;
         }
+        auto capture_time = std::chrono::steady_clock::now();
 
         Mat frame(CAMERA_HEIGHT, CAMERA_WIDTH, CV_8UC3, buffer.data());
         if (frame.empty() || frame.cols <= 0 || frame.rows <= 0) {
@@ -1680,12 +1812,24 @@ void CameraTask::captureLoop() {
         {
             std::lock_guard<std::mutex> lock(frameMutex);
             if (latestFrameSeq == consumedFrameSeq) {
-                latestFrame = frame.clone();
+                // Pooled buffer when one is free; a heap copy keeps capture
+                // going when history and jobs hold them all.
+                std::shared_ptr<PooledFrame> published_frame = framePool.acquire();
+                if (published_frame) {
+                    frame.copyTo(published_frame->image);
+                } else {
+                    published_frame = std::make_shared<PooledFrame>();
+                    published_frame->image = frame.clone();
+                    framePoolFallbacks.fetch_add(1, std::memory_order_relaxed);
+                }
                 if (aeBrightness > boostConfig.boostMinFloor
                     && aeBrightness < boostConfig.boostThreshold) {
-                    boosted = applyBrightnessBoost(latestFrame, aeBrightness, boostConfig);
+                    boosted = applyBrightnessBoost(published_frame->image, aeBrightness, boostConfig);
                 }
                 latestFrameSeq++;
+                published_frame->seq = latestFrameSeq;
+                published_frame->captureTime = capture_time;
+                latestFrame = std::move(published_frame);
                 published = true;
             }
         }
@@ -1723,7 +1867,7 @@ void CameraTask::captureSnapshot() {
         cv::Mat frame(CAMERA_HEIGHT, CAMERA_WIDTH, CV_8UC3, buffer.data());
         if (!frame.empty()) {
             if (uploadCallback) {
-                uploadCallback(frame.clone(), 0, "manual");
+                uploadCallback(frame.clone(), 0, "manual", nullptr);
                 log_info("CameraTask: snapshot uploaded");
             }
         } else {
@@ -1735,9 +1879,87 @@ void CameraTask::captureSnapshot() {
 }
 
 
-void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
+// Retention policy of the frame pool. History entries and stored candidates
+// pin whole pooled frames; while fewer than kFramePoolReserve buffers are
+// free, the oldest frames pinned only by them get a copy of just their crops,
+// one frame per missing buffer, so those frames go back to the pool. A frame
+// that a queued or running job also holds would stay checked out after the
+// copy, so it is left alone; it returns once the jobs have run.
+void CameraTask::releasePinnedFrames() {
+    size_t available = framePool.available();
+    if (available >= kFramePoolReserve) {
+        return;
+    }
+    size_t needed = kFramePoolReserve - available;
+
+    pinnedFrames.clear();
+    collect_candidate_sources(pinnedFrames);
+    trackStates.forEach([this](TrackFrameState& state) {
+        for (const auto& entry : state.roiHistory) {
+            if (entry.frame.source) {
+                pinnedFrames.push_back(entry.frame.source);
+            }
+        }
+    });
+    std::sort(pinnedFrames.begin(), pinnedFrames.end(), [](const FrameHandle& a, const FrameHandle& b) {
+        return a->seq < b->seq;
+    });
+
+    for (size_t begin = 0; begin < pinnedFrames.size() && needed > 0;) {
+        size_t end = begin + 1;
+        while (end < pinnedFrames.size() && pinnedFrames[end] == pinnedFrames[begin]) {
+            ++end;
+        }
+        // Every pin is counted twice, by its owner and by pinnedFrames; any
+        // further reference belongs to a job.
+        const uint64_t seq = pinnedFrames[begin]->seq;
+        const long pins = static_cast<long>(end - begin);
+        if (pinnedFrames[begin].use_count() <= 2 * pins) {
+            trackStates.forEach([seq](TrackFrameState& state) {
+                for (auto& entry : state.roiHistory) {
+                    if (entry.frame.source && entry.frame.source->seq == seq) {
+                        entry.frame.materialize();
+                    }
+                }
+            });
+            materialize_candidate_sources(seq);
+            --needed;
+        }
+        begin = end;
+    }
+    // Drops the last references of the materialized frames.
+    pinnedFrames.clear();
+}
+
+// Motion-model step for a frame captured at captureTime, in units of the
+// usual interval between processed frames. Frames lost in the capture
+// handoff or to a slow pass give dt > 1 instead of one nominal step; only
+// ordinary intervals feed the average, so stalls do not stretch the unit.
+float CameraTask::trackerStepDt(std::chrono::steady_clock::time_point captureTime) {
+    if (lastTrackerStepTime == std::chrono::steady_clock::time_point{}) {
+        lastTrackerStepTime = captureTime;
+        return 1.0f;
+    }
+    double elapsed_ms = std::chrono::duration<double, std::milli>(captureTime - lastTrackerStepTime).count();
+    lastTrackerStepTime = captureTime;
+    if (elapsed_ms <= 0.0) {
+        return 1.0f;
+    }
+    if (trackerFramePeriodMs <= 0.0) {
+        trackerFramePeriodMs = elapsed_ms;
+    }
+    float dt = static_cast<float>(elapsed_ms / trackerFramePeriodMs);
+    if (dt < 2.0f) {
+        trackerFramePeriodMs += (elapsed_ms - trackerFramePeriodMs) * kTrackerPeriodAlpha;
+    }
+    return std::max(kTrackerMinDt, std::min(kTrackerMaxDt, dt));
+}
+
+void CameraTask::processFrame(const FrameHandle& frameHandle, rknn_context personCtx) {
+    const Mat& frame = frameHandle->image;
+    float tracker_dt = trackerStepDt(frameHandle->captureTime);
     static int personDetectCounter = 0;
-    static std::vector<Track> cachedTracks;
+    static std::vector<TrackView> cachedTracks;
     DeviceConfig::CaptureDefaults config = getCaptureConfigSnapshot();
     AdaptiveCaptureThresholds adaptiveThresholds =
         buildAdaptiveCaptureThresholds(config,
@@ -1831,39 +2053,30 @@ void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
         }
 
         nmsDetections(dets, 0.45f);
-        cachedTracks = sort_update(dets);
+        sort_update(dets, cachedTracks, tracker_dt);
     } else {
         // Non-detection frame: advance EKF predictions to avoid sawtooth jitter.
-        cachedTracks = sort_predict_only();
+        sort_predict_only(cachedTracks, tracker_dt);
     }
 
-    vector<Track> tracks = cachedTracks;
-    std::unordered_set<int> activeTrackIds;
+    const std::vector<TrackView>& tracks = cachedTracks;
+    trackStates.beginFrame();
 
-    std::unordered_map<int, cv::Rect> trackBoxes720p;
-    trackBoxes720p.reserve(tracks.size());
-    for (const auto& tr : tracks) {
-        cv::Rect2f stable_box = selectTrackRect720p(tr);
-        cv::Rect box((int)stable_box.x, (int)stable_box.y, (int)stable_box.width, (int)stable_box.height);
-        if (box.width > 0 && box.height > 0) {
-            trackBoxes720p.emplace(tr.id, box);
-        }
+    // Boxes and occlusion are index-aligned with `tracks`; empty boxes take
+    // no part in the overlap test.
+    trackBoxes720p.resize(tracks.size());
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        cv::Rect2f stable_box = selectTrackRect720p(tracks[i]);
+        trackBoxes720p[i] = cv::Rect((int)stable_box.x, (int)stable_box.y, (int)stable_box.width, (int)stable_box.height);
     }
 
-    std::unordered_map<int, float> trackOcclusionRatio;
-    trackOcclusionRatio.reserve(trackBoxes720p.size());
-    for (const auto& kv_a : trackBoxes720p) {
-        float max_overlap = 0.0f;
-        for (const auto& kv_b : trackBoxes720p) {
-            if (kv_a.first == kv_b.first) {
-                continue;
-            }
-            float overlap = rect_overlap_ratio_on_a(kv_a.second, kv_b.second);
-            if (overlap > max_overlap) {
-                max_overlap = overlap;
-            }
-        }
-        trackOcclusionRatio[kv_a.first] = max_overlap;
+    trackGrid.reset(IMAGE_WIDTH, IMAGE_HEIGHT, kTrackGridCellSize);
+    for (const auto& box : trackBoxes720p) {
+        trackGrid.insert(cv::Rect2f(box));
+    }
+    trackOcclusionRatio.resize(tracks.size());
+    for (size_t i = 0; i < trackBoxes720p.size(); ++i) {
+        trackOcclusionRatio[i] = trackGrid.maxOverlapOn(static_cast<int>(i));
     }
 
     if (!tracks.empty()) {
@@ -1874,8 +2087,12 @@ void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
 
     size_t track_count = tracks.size();
     for (size_t index = 0; index < track_count; ++index) {
-        auto& t = tracks[(candidateRoundRobinOffset + index) % track_count];
-        activeTrackIds.insert(t.id);
+        size_t track_index = (candidateRoundRobinOffset + index) % track_count;
+        const TrackView& t = tracks[track_index];
+        TrackFrameState& state = trackStates.acquire(t.slot, t.generation);
+        if (state.jobCooldown > 0) {
+            state.jobCooldown--;
+        }
 
         cv::Rect2f stable_bbox_720p = selectTrackRect720p(t);
         Rect bbox_720p((int)stable_bbox_720p.x, (int)stable_bbox_720p.y,
@@ -1885,12 +2102,14 @@ void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
         cv::Point2f curr_center_720p(bbox_720p.x + bbox_720p.width * 0.5f,
                                      bbox_720p.y + bbox_720p.height * 0.5f);
         float motion_ratio = 0.0f;
-        auto prev_it = lastTrackCenters.find(t.id);
-        if (prev_it != lastTrackCenters.end()) {
-            float pixel_motion = cv::norm(curr_center_720p - prev_it->second);
+        if (state.hasLastCenter) {
+            cv::Point2f step = curr_center_720p - state.lastCenter;
+            float pixel_motion = cv::norm(step);
             motion_ratio = pixel_motion * inv_diag_720p;
+            state.velocity = state.velocity * 0.6f + step * 0.4f;
         }
-        lastTrackCenters[t.id] = curr_center_720p;
+        state.lastCenter = curr_center_720p;
+        state.hasLastCenter = true;
 
         if (t.hits < config.minTrackHits) {
             char detail[160];
@@ -1899,8 +2118,8 @@ void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
             continue;
         }
 
-        if (reportedPersonIds.find(t.id) == reportedPersonIds.end()) {
-            reportedPersonIds.insert(t.id);
+        if (!state.reported) {
+            state.reported = true;
             if (personEventCallback) {
                 personEventCallback(t.id, "person_appeared");
             }
@@ -1931,63 +2150,18 @@ void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
                  std::max(1, expanded_right - expanded_x),
                  std::max(1, expanded_bottom - expanded_y));
 
-        Mat person_roi = frame(bbox_4k);
-        if (person_roi.empty() || person_roi.cols <= 0 || person_roi.rows <= 0) {
-            char detail[192];
-            std::snprintf(detail, sizeof(detail), "roi=%dx%d bbox4k=%dx%d",
-                          person_roi.cols,
-                          person_roi.rows,
-                          bbox_4k.width,
-                          bbox_4k.height);
-            logTrackReject("gate", t.id, "person_roi_invalid", detail);
-            continue;
-        }
-
-        std::vector<cv::Mat> fusion_history;
-        auto history_it = trackPersonRoiHistory.find(t.id);
-        if (history_it != trackPersonRoiHistory.end()) {
-            fusion_history.reserve(history_it->second.size());
-            for (const auto& hist_roi : history_it->second) {
-                if (!hist_roi.empty()) {
-                    fusion_history.push_back(hist_roi.clone());
-                }
-            }
-        }
-        auto& roi_history = trackPersonRoiHistory[t.id];
-        // Quality gate: only store frames that aren't severely blurred.
-        // This ensures the fusion pool has a minimum quality floor.
-        {
-            cv::Mat roi_gray;
-            cv::cvtColor(person_roi, roi_gray, cv::COLOR_BGR2GRAY);
-            cv::Mat roi_gx, roi_gy;
-            cv::Sobel(roi_gray, roi_gx, CV_32F, 1, 0, 3);
-            cv::Sobel(roi_gray, roi_gy, CV_32F, 0, 1, 3);
-            cv::Scalar gx_std, gy_std;
-            cv::meanStdDev(roi_gx, cv::noArray(), gx_std);
-            cv::meanStdDev(roi_gy, cv::noArray(), gy_std);
-            double ex = gx_std[0] * gx_std[0], ey = gy_std[0] * gy_std[0];
-            double dir_ratio = std::min(ex, ey) / (std::max(ex, ey) + 1e-6);
-            // Only store if not severely directionally blurred.
-            if (dir_ratio >= 0.40) {
-                roi_history.push_back(person_roi.clone());
-            }
-        }
-        while (roi_history.size() > kMultiFrameFusionHistorySize) {
-            roi_history.pop_front();
-        }
-
         float current_area_4k = bbox_4k.width * bbox_4k.height;
         float area_ratio = current_area_4k / (CAMERA_WIDTH * CAMERA_HEIGHT);
 
         bool near_ok = area_ratio >= config.nearAreaRatio;
         bool approach_ok = t.is_approaching || near_ok || !config.requireApproach;
-        auto& approachState = trackApproachStates[t.id];
+        auto& approachState = state.approach;
         float bbox_jitter = t.bbox_jitter;
-        bool trend_ready = t.bbox_history.size() >= 4;
-        bool history_advanced = t.bbox_history.size() != approachState.lastHistorySize;
+        bool trend_ready = t.area_history_size >= 4;
+        bool history_advanced = t.area_history_size != approachState.lastHistorySize;
         bool jitter_freeze = bbox_jitter >= kApproachJitterFreezeThreshold && !near_ok;
 
-        float area_trend_ratio = computeTrackAreaTrendRatio(t);
+        float area_trend_ratio = t.area_trend_ratio;
         if (trend_ready && history_advanced && !jitter_freeze) {
             if (area_trend_ratio > config.approachRatioPos) {
                 approachState.positiveHits = std::min(approachState.positiveHits + 1,
@@ -2022,15 +2196,17 @@ void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
         approachState.lastTrend = area_trend_ratio;
         approachState.lastJitter = bbox_jitter;
         approachState.lastAreaRatio = area_ratio;
-        approachState.lastHistorySize = t.bbox_history.size();
-        t.is_approaching = approachState.isApproaching;
-        approach_ok = t.is_approaching || near_ok || !config.requireApproach;
+        approachState.lastHistorySize = t.area_history_size;
+        bool is_approaching = approachState.isApproaching;
+        approach_ok = is_approaching || near_ok || !config.requireApproach;
         bool moving_away = trend_ready &&
                            !jitter_freeze &&
                            area_trend_ratio < config.approachRatioNeg &&
                            approachState.negativeHits >= 2 &&
                            !near_ok;
         if (t.has_captured) {
+            // Nothing more will be evaluated for this track.
+            state.roiHistory.clear();
             logTrackReject("gate", t.id, "already_captured", "track already captured");
             continue;
         }
@@ -2048,7 +2224,7 @@ void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
             char detail[224];
             std::snprintf(detail, sizeof(detail),
                           "approaching=%d near=%d trend=%.3f jitter=%.3f pos=%d neg=%d area=%.4f",
-                          t.is_approaching ? 1 : 0,
+                          is_approaching ? 1 : 0,
                           near_ok ? 1 : 0,
                           area_trend_ratio,
                           bbox_jitter,
@@ -2090,19 +2266,109 @@ void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
             continue;
         }
 
-        float person_occlusion = 0.0f;
-        auto occ_it = trackOcclusionRatio.find(t.id);
-        if (occ_it != trackOcclusionRatio.end()) {
-            person_occlusion = occ_it->second;
+        // The eval thread rejects this motion before anything else.
+        if (motion_ratio >= adaptiveThresholds.maxMotionRatio) {
+            char detail[192];
+            std::snprintf(detail, sizeof(detail), "motion=%.4f max=%.4f area=%.4f ll=%.2f",
+                          motion_ratio,
+                          adaptiveThresholds.maxMotionRatio,
+                          area_ratio,
+                          adaptiveThresholds.lowLightStrength);
+            logTrackReject("gate", t.id, "motion_soft_large", detail);
+            continue;
+        }
+
+        // At most one eval job (one face inference) per track every
+        // faceDetectInterval frames.
+        if (state.jobCooldown > 0) {
+            continue;
+        }
+
+        // ── 720p pre-screen of the head region ──
+        // Only frames whose head region has contrast and holds up against
+        // the track's recent sharpness pay for the 4K crop and face inference.
+        double head_dir_ratio = 1.0;
+        cv::Rect head_720p = prescreenHeadRegion(bbox_720p) & cv::Rect(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT);
+        if (head_720p.width >= kPrescreenMinHeadSide && head_720p.height >= kPrescreenMinHeadSide) {
+            cv::Mat head_gray;
+            cv::cvtColor(resized_frame(head_720p), head_gray, cv::COLOR_BGR2GRAY);
+            QualityMetrics head_metrics;
+            compute_quality_metrics(head_gray, head_metrics);
+            cv::Scalar head_mean, head_stddev;
+            cv::meanStdDev(head_gray, head_mean, head_stddev);
+            head_dir_ratio = head_metrics.directionalRatio();
+
+            double head_sharpness = head_metrics.laplacianVar;
+            double sharpness_floor = std::max(config.prescreenMinHeadSharpness,
+                                              state.peakHeadSharpness * config.prescreenRelativeSharpness);
+            state.peakHeadSharpness = std::max(state.peakHeadSharpness * kPrescreenPeakDecay, head_sharpness);
+            if (head_stddev[0] < config.prescreenMinHeadContrast || head_sharpness < sharpness_floor) {
+                char detail[192];
+                std::snprintf(detail, sizeof(detail), "contrast=%.1f min=%.1f sharpness=%.1f floor=%.1f head=%dx%d",
+                              head_stddev[0],
+                              config.prescreenMinHeadContrast,
+                              head_sharpness,
+                              sharpness_floor,
+                              head_720p.width,
+                              head_720p.height);
+                logTrackReject("gate", t.id,
+                               head_stddev[0] < config.prescreenMinHeadContrast ? "prescreen_low_contrast" : "prescreen_soft",
+                               detail);
+                continue;
+            }
+        }
+
+        Mat person_roi = frame(bbox_4k);
+        if (person_roi.empty() || person_roi.cols <= 0 || person_roi.rows <= 0) {
+            char detail[192];
+            std::snprintf(detail, sizeof(detail), "roi=%dx%d bbox4k=%dx%d",
+                          person_roi.cols,
+                          person_roi.rows,
+                          bbox_4k.width,
+                          bbox_4k.height);
+            logTrackReject("gate", t.id, "person_roi_invalid", detail);
+            continue;
+        }
+
+        // History entries and the job are views into pooled frames; nothing
+        // is copied here (see releasePinnedFrames()).
+        std::vector<TrackFusionFrame> fusion_history;
+        auto& roi_history = state.roiHistory;
+        fusion_history.reserve(roi_history.size());
+        for (const auto& hist_roi : roi_history) {
+            // Severe directional blur would only smear the fused result.
+            if (!hist_roi.frame.roi.empty() && hist_roi.directionalRatio >= kMultiFrameFusionMinDirectionalRatio) {
+                fusion_history.push_back(hist_roi.frame);
+            }
         }
+        TrackFusionFrame current_roi{person_roi, ++state.roiSeq, frameHandle};
+        // Only frames without strong directional blur in the head region
+        // join the fusion pool; the ratio comes from the pre-screen.
+        if (head_dir_ratio >= kTrackHistoryMinDirectionalRatio) {
+            roi_history.push_back({current_roi, head_dir_ratio});
+            while (roi_history.size() > kTrackFusionHistorySize) {
+                roi_history.pop_front();
+            }
+        }
+
+        float person_occlusion = trackOcclusionRatio[track_index];
 
         CandidateEvalJob job;
         job.trackId = t.id;
-        job.personRoi = person_roi.clone();
+        job.trackSlot = t.slot;
+        job.trackGeneration = t.generation;
+        job.personRoi = current_roi.roi;
+        job.roiSeq = current_roi.seq;
+        job.personFrame = frameHandle;
         job.fusionHistory = std::move(fusion_history);
         job.areaRatio = area_ratio;
         job.personOcclusion = person_occlusion;
         job.motionRatio = motion_ratio;
+        job.captureValue = candidateCaptureValue(area_ratio,
+                                                 config.nearAreaRatio,
+                                                 is_approaching,
+                                                 framesToExit(bbox_720p, state.velocity));
+        state.jobCooldown = std::max(1, config.faceDetectInterval);
         if (enqueueCandidateEvaluation(std::move(job))) {
             clearTrackReject("gate", t.id);
         }
@@ -2112,50 +2378,12 @@ void CameraTask::processFrame(const Mat& frame, rknn_context personCtx) {
         candidateRoundRobinOffset = (candidateRoundRobinOffset + 1) % track_count;
     }
 
-    for (auto it = lastTrackCenters.begin(); it != lastTrackCenters.end(); ) {
-        if (activeTrackIds.find(it->first) == activeTrackIds.end()) {
-            it = lastTrackCenters.erase(it);
-        } else {
-            ++it;
-        }
-    }
-
-    for (auto it = trackApproachStates.begin(); it != trackApproachStates.end(); ) {
-        if (activeTrackIds.find(it->first) == activeTrackIds.end()) {
-            it = trackApproachStates.erase(it);
-        } else {
-            ++it;
-        }
-    }
-
-    for (auto it = trackPersonRoiHistory.begin(); it != trackPersonRoiHistory.end(); ) {
-        if (activeTrackIds.find(it->first) == activeTrackIds.end()) {
-            it = trackPersonRoiHistory.erase(it);
-        } else {
-            ++it;
-        }
-    }
-
-    {
-        std::lock_guard<std::mutex> lock(candidateEvalMutex);
-        for (auto it = pendingCandidateEvalByTrack.begin(); it != pendingCandidateEvalByTrack.end(); ) {
-            if (activeTrackIds.find(it->first) == activeTrackIds.end() && it->second <= 0) {
-                it = pendingCandidateEvalByTrack.erase(it);
-            } else {
-                ++it;
-            }
-        }
-    }
-
-    for (auto it = reportedPersonIds.begin(); it != reportedPersonIds.end(); ) {
-        if (activeTrackIds.find(*it) == activeTrackIds.end()) {
-            it = reportedPersonIds.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    // Tracks the tracker no longer publishes drop their state here; eval
+    // mailboxes are keyed by generation and need no sweep.
+    size_t live_tracks = trackStates.retireUnseen();
+    releasePinnedFrames();
 
-    bool hasPersons = !activeTrackIds.empty();
+    bool hasPersons = live_tracks > 0;
     if (hadPersonsInScene && !hasPersons) {
         if (personEventCallback) {
             personEventCallback(-1, "all_person_left");
@@ -0,0 +1,71 @@
+#include "frame_pool.h"
+
+void FramePool::reset(size_t capacity, int rows, int cols, int type) {
+    auto fresh = std::make_shared<State>();
+    fresh->capacity = capacity;
+    fresh->rows = rows;
+    fresh->cols = cols;
+    fresh->type = type;
+    state = std::move(fresh);
+}
+
+std::shared_ptr<PooledFrame> FramePool::acquire() {
+    std::shared_ptr<State> pool = state;
+    if (!pool) {
+        return nullptr;
+    }
+
+    cv::Mat buffer;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (!pool->free.empty()) {
+            buffer = std::move(pool->free.back());
+            pool->free.pop_back();
+        } else if (pool->allocated < pool->capacity) {
+            pool->allocated++;
+        } else {
+            pool->exhausted++;
+            return nullptr;
+        }
+        pool->inUse++;
+        pool->acquired++;
+    }
+    if (buffer.empty()) {
+        buffer.create(pool->rows, pool->cols, pool->type);
+    }
+
+    PooledFrame* frame = new PooledFrame();
+    frame->image = std::move(buffer);
+    // The deleter holds the pool state, so frames may outlive the pool.
+    return std::shared_ptr<PooledFrame>(frame, [pool](PooledFrame* released) {
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->free.push_back(std::move(released->image));
+            pool->inUse--;
+        }
+        delete released;
+    });
+}
+
+size_t FramePool::available() const {
+    std::shared_ptr<State> pool = state;
+    if (!pool) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    return pool->capacity - pool->inUse;
+}
+
+FramePoolStats FramePool::stats() const {
+    FramePoolStats stats{};
+    std::shared_ptr<State> pool = state;
+    if (!pool) {
+        return stats;
+    }
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    stats.capacity = pool->capacity;
+    stats.inUse = pool->inUse;
+    stats.acquired = pool->acquired;
+    stats.exhausted = pool->exhausted;
+    return stats;
+}
@@ -0,0 +1,584 @@
+#include "image_enhance.h"
+#include "motion_deconvolution.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/photo.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+cv::Mat compress_face_highlights(const cv::Mat& src) {
+    if (src.empty()) {
+        return src.clone();
+    }
+
+    cv::Mat lab;
+    cv::cvtColor(src, lab, cv::COLOR_BGR2Lab);
+    std::vector<cv::Mat> channels;
+    cv::split(lab, channels);
+
+    cv::Mat lightness_f;
+    channels[0].convertTo(lightness_f, CV_32F);
+    for (int y = 0; y < lightness_f.rows; ++y) {
+        float* row = lightness_f.ptr<float>(y);
+        for (int x = 0; x < lightness_f.cols; ++x) {
+            float value = row[x];
+            if (value > 214.0f) {
+                value = 214.0f + (value - 214.0f) * 0.42f;
+            }
+            if (value > 238.0f) {
+                value = 238.0f + (value - 238.0f) * 0.22f;
+            }
+            row[x] = std::max(0.0f, std::min(255.0f, value));
+        }
+    }
+
+    lightness_f.convertTo(channels[0], CV_8U);
+    cv::merge(channels, lab);
+
+    cv::Mat out;
+    cv::cvtColor(lab, out, cv::COLOR_Lab2BGR);
+    return out;
+}
+
+cv::Mat suppress_halo_artifacts(const cv::Mat& reference, const cv::Mat& enhanced) {
+    if (reference.empty() || enhanced.empty() || reference.size() != enhanced.size()) {
+        return enhanced.clone();
+    }
+
+    cv::Mat ref_gray, enh_gray;
+    cv::cvtColor(reference, ref_gray, cv::COLOR_BGR2GRAY);
+    cv::cvtColor(enhanced, enh_gray, cv::COLOR_BGR2GRAY);
+
+    cv::Mat diff;
+    cv::subtract(enh_gray, ref_gray, diff);
+
+    cv::Mat bright_mask, gain_mask, halo_mask;
+    cv::threshold(ref_gray, bright_mask, 168, 255, cv::THRESH_BINARY);
+    cv::threshold(diff, gain_mask, 14, 255, cv::THRESH_BINARY);
+    cv::bitwise_and(bright_mask, gain_mask, halo_mask);
+    cv::GaussianBlur(halo_mask, halo_mask, cv::Size(0, 0), 2.2);
+
+    cv::Mat halo_mask_f;
+    halo_mask.convertTo(halo_mask_f, CV_32F, 1.0 / 255.0);
+    std::vector<cv::Mat> halo_channels(3, halo_mask_f);
+    cv::Mat halo3;
+    cv::merge(halo_channels, halo3);
+
+    cv::Mat ref_f, enh_f;
+    reference.convertTo(ref_f, CV_32FC3);
+    enhanced.convertTo(enh_f, CV_32FC3);
+    cv::Mat blended = enh_f.mul(1.0f - halo3 * 0.55f) + ref_f.mul(halo3 * 0.55f);
+
+    cv::Mat out;
+    blended.convertTo(out, CV_8UC3);
+    return out;
+}
+
+double estimate_blur_angle_deg(const cv::Mat& gray) {
+    QualityMetrics metrics;
+    compute_quality_metrics(gray, metrics);
+    return metrics.blurAngleDeg();
+}
+
+cv::Mat apply_directional_unsharp(const cv::Mat& src, double angle_deg, int kernel_size, float amount) {
+    if (src.empty() || kernel_size < 3 || amount <= 0.0f) {
+        return src.clone();
+    }
+
+    kernel_size = std::max(3, kernel_size | 1);
+    cv::Mat kernel = cv::Mat::zeros(kernel_size, kernel_size, CV_32F);
+    cv::Point center(kernel_size / 2, kernel_size / 2);
+    double rad = angle_deg * CV_PI / 180.0;
+    cv::Point delta(
+        static_cast<int>(std::round(std::cos(rad) * (kernel_size / 2))),
+        static_cast<int>(std::round(std::sin(rad) * (kernel_size / 2))));
+    cv::line(kernel, center - delta, center + delta, cv::Scalar(1.0f), 1, cv::LINE_AA);
+
+    double sum_kernel = cv::sum(kernel)[0];
+    if (sum_kernel <= 1e-6) {
+        kernel.at<float>(center) = 1.0f;
+        sum_kernel = 1.0;
+    }
+    kernel /= static_cast<float>(sum_kernel);
+
+    cv::Mat src_f;
+    src.convertTo(src_f, CV_32FC3);
+    cv::Mat motion_blur;
+    cv::filter2D(src_f, motion_blur, CV_32FC3, kernel, cv::Point(-1, -1), 0.0, cv::BORDER_REPLICATE);
+    cv::Mat sharpened = src_f + (src_f - motion_blur) * amount;
+    cv::Mat out;
+    sharpened.convertTo(out, CV_8UC3);
+    return out;
+}
+
+cv::Mat opencv_super_resolve_face(const cv::Mat& face, const FaceEnhanceScale& at = {}) {
+    if (face.empty()) {
+        return face.clone();
+    }
+
+    int short_edge = std::min(face.cols, face.rows);
+    if (short_edge <= 0) {
+        return face.clone();
+    }
+
+    double full_short_edge = short_edge / at.size;
+    float target_short_edge = full_short_edge < 96 ? 320.0f : (full_short_edge < 160 ? 280.0f : 240.0f);
+    float scale = std::min(2.6f, static_cast<float>(target_short_edge * at.size) / static_cast<float>(short_edge));
+    if (scale <= 1.04f) {
+        return face.clone();
+    }
+
+    cv::Mat upscaled;
+    cv::resize(face, upscaled, cv::Size(), scale, scale, scale > 1.8f ? cv::INTER_LANCZOS4 : cv::INTER_CUBIC);
+
+    cv::Mat filtered;
+    cv::bilateralFilter(upscaled, filtered, 7, 28, 18);
+
+    cv::Mat detailed;
+    cv::detailEnhance(filtered, detailed, 4.5f, 0.08f);
+
+    cv::Mat softened;
+    cv::addWeighted(filtered, 0.72, detailed, 0.28, 0, softened);
+    softened = compress_face_highlights(softened);
+    softened = suppress_halo_artifacts(filtered, softened);
+
+    cv::Mat sr = apply_unsharp_mask(softened, 0.85, 0.08f);
+    sr = suppress_halo_artifacts(filtered, sr);
+    return sr;
+}
+
+cv::Mat opencv_superres_deblur_face(const cv::Mat& face, const FaceEnhanceScale& at = {}) {
+    if (face.empty()) {
+        return face.clone();
+    }
+
+    cv::Mat sr = opencv_super_resolve_face(face, at);
+    cv::Mat deblurred = motion_deblur_enhance_face(sr, at);
+
+    QualityMetrics deblurred_metrics;
+    compute_quality_metrics(deblurred, deblurred_metrics);
+    double angle = deblurred_metrics.blurAngleDeg();
+    double focus = deblurred_metrics.laplacianVar * at.focus;
+    float severity = static_cast<float>(std::max(0.0, std::min(1.0, (220.0 - focus) / 220.0)));
+
+    if (severity > 0.35f) {
+        deblurred = apply_motion_wiener_restore_bgr(deblurred, angle, severity > 0.65f ? 11 : 9, 5.5f);
+    }
+
+    cv::Mat final_face = apply_directional_unsharp(deblurred, angle, severity > 0.60f ? 9 : 7, 0.05f + 0.04f * severity);
+    final_face = apply_unsharp_mask(final_face, 0.75, 0.04f);
+    final_face = compress_face_highlights(final_face);
+    final_face = suppress_halo_artifacts(sr, final_face);
+    return final_face;
+}
+
+cv::Mat deghost_motion_face(const cv::Mat& face, const FaceEnhanceScale& at = {}) {
+    if (face.empty()) {
+        return face.clone();
+    }
+
+    cv::Mat work = upscale_small_face(face, at);
+    QualityMetrics work_metrics;
+    compute_quality_metrics(work, work_metrics);
+    double focus = work_metrics.laplacianVar * at.focus;
+    double angle = work_metrics.blurAngleDeg();
+    float severity = static_cast<float>(std::max(0.0, std::min(1.0, (235.0 - focus) / 235.0)));
+
+    cv::Mat restored = apply_motion_wiener_restore_bgr(work, angle, severity > 0.65f ? 13 : 9, 6.5f);
+    if (severity > 0.55f) {
+        restored = apply_motion_wiener_restore_bgr(restored, angle, severity > 0.72f ? 11 : 9, 7.0f);
+    }
+
+    cv::Mat directional = apply_directional_unsharp(restored, angle, severity > 0.60f ? 7 : 5, 0.03f + 0.03f * severity);
+    cv::Mat blended;
+    cv::addWeighted(restored, 0.76, directional, 0.24, 0, blended);
+
+    cv::Mat denoised;
+    cv::bilateralFilter(blended, denoised, 5, 20, 10);
+    denoised = compress_face_highlights(denoised);
+    denoised = suppress_halo_artifacts(work, denoised);
+
+    cv::Mat final_face;
+    cv::addWeighted(denoised, 0.86, work, 0.14, 0, final_face);
+    return final_face;
+}
+
+cv::Mat opencv_aggressive_deghost_face(const cv::Mat& face, const FaceEnhanceScale& at = {}) {
+    if (face.empty()) {
+        return face.clone();
+    }
+
+    cv::Mat sr = opencv_super_resolve_face(face, at);
+    cv::Mat deghosted = deghost_motion_face(sr, at);
+    cv::Mat final_face = motion_deblur_enhance_face(deghosted, at);
+    final_face = compress_face_highlights(final_face);
+    final_face = suppress_halo_artifacts(sr, final_face);
+    return final_face;
+}
+
+} // namespace
+
+FaceQuality face_quality_from_metrics(const QualityMetrics& metrics) {
+    FaceQuality quality;
+    if (!metrics.valid) {
+        return quality;
+    }
+    quality.focus = metrics.laplacianVar;
+    quality.luma = metrics.lumaMean;
+    quality.gradient = metrics.gradMagnitudeMean;
+    quality.ghostPenalty = std::max(0.0, 18.0 - metrics.trailStructure) * 2.2;
+    if (metrics.laplacianVar > 160.0) {
+        quality.ghostPenalty *= 0.72;
+    }
+    return quality;
+}
+
+FaceQuality measure_face_quality(const cv::Mat& img) {
+    QualityMetrics metrics;
+    compute_quality_metrics(img, metrics, QUALITY_GRADIENT_MAGNITUDE | QUALITY_SHIFT_TRAILS);
+    return face_quality_from_metrics(metrics);
+}
+
+cv::Mat resize_to_long_edge(const cv::Mat& img, int target_long_edge, int interpolation) {
+    int current_long_edge = std::max(img.cols, img.rows);
+    if (img.empty() || current_long_edge <= 0 || current_long_edge <= target_long_edge) {
+        return img;
+    }
+
+    float scale = target_long_edge / static_cast<float>(current_long_edge);
+    cv::Mat resized;
+    cv::resize(img, resized, cv::Size(), scale, scale, interpolation);
+    return resized;
+}
+
+cv::Mat apply_unsharp_mask(const cv::Mat& src, double sigma, float amount) {
+    if (src.empty()) {
+        return src.clone();
+    }
+
+    cv::Mat blur;
+    cv::GaussianBlur(src, blur, cv::Size(0, 0), sigma);
+    cv::Mat out;
+    cv::addWeighted(src, 1.0f + amount, blur, -amount, 0, out);
+    return out;
+}
+
+double score_face_candidate(const cv::Mat& candidate,
+                            double base_focus,
+                            double base_luma,
+                            double base_gradient,
+                            double scale_bonus,
+                            double focus_scale) {
+    FaceQuality quality = measure_face_quality(candidate);
+    // Compared in full-size focus units, so the absolute floors below hold
+    // on a proxy as well.
+    double focus = quality.focus * focus_scale;
+    base_focus *= focus_scale;
+    double luma = quality.luma;
+    double gradient = quality.gradient;
+    double ghost_penalty = quality.ghostPenalty * 6.0;
+
+    double focus_gain = (focus - base_focus) / std::max(80.0, base_focus);
+    double gradient_gain = (gradient - base_gradient) / std::max(12.0, base_gradient);
+    double luma_penalty = std::fabs(luma - base_luma) * 2.4;
+    double oversoften_penalty =
+        std::max(0.0, base_focus * 0.95 - focus) / std::max(20.0, base_focus) * 480.0;
+
+    double score = focus_gain * 900.0 +
+                   gradient_gain * 260.0 -
+                   luma_penalty -
+                   oversoften_penalty -
+                   ghost_penalty +
+                   scale_bonus * 22.0;
+
+    if (focus >= base_focus * 1.03) {
+        score += 35.0;
+    }
+    if (gradient >= base_gradient * 1.05) {
+        score += 18.0;
+    }
+    return score;
+}
+
+cv::Mat upscale_small_face(const cv::Mat& face, const FaceEnhanceScale& at) {
+    int short_edge = std::min(face.cols, face.rows);
+    if (face.empty() || short_edge <= 0 || short_edge / at.size >= 240.0) {
+        return face.clone();
+    }
+
+    float scale = std::min(1.85f, static_cast<float>(240.0 * at.size) / static_cast<float>(short_edge));
+    if (scale <= 1.05f) {
+        return face.clone();
+    }
+
+    cv::Mat upscaled;
+    int interpolation = scale > 1.35f ? cv::INTER_LANCZOS4 : cv::INTER_CUBIC;
+    cv::resize(face, upscaled, cv::Size(), scale, scale, interpolation);
+    return upscaled;
+}
+
+cv::Mat motion_deblur_enhance_face(const cv::Mat& face, const FaceEnhanceScale& at) {
+    if (face.empty() || face.cols <= 0 || face.rows <= 0) {
+        return face;
+    }
+
+    QualityMetrics face_metrics;
+    compute_quality_metrics(face, face_metrics);
+    double mean_luma_before = face_metrics.lumaMean;
+    double lap_var = face_metrics.laplacianVar * at.focus;
+    float blur_severity = static_cast<float>(std::max(0.0, std::min(1.0, (135.0 - lap_var) / 135.0)));
+    bool needs_upscale = std::min(face.cols, face.rows) / at.size < 220.0;
+    bool needs_enhance = needs_upscale || lap_var < 210.0 || mean_luma_before < 110.0;
+    if (!needs_enhance) {
+        return face.clone();
+    }
+
+    cv::Mat work = upscale_small_face(face, at);
+
+    if (blur_severity > 0.40f) {
+        cv::Mat denoised;
+        cv::bilateralFilter(work, denoised, 5, 20, 10);
+        work = denoised;
+    }
+
+    if (mean_luma_before < 105.0) {
+        cv::Mat lab;
+        cv::cvtColor(work, lab, cv::COLOR_BGR2Lab);
+        std::vector<cv::Mat> lab_channels;
+        cv::split(lab, lab_channels);
+        double clip_limit = mean_luma_before < 85.0 ? 1.18 : 1.10;
+        cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(clip_limit, cv::Size(8, 8));
+        clahe->apply(lab_channels[0], lab_channels[0]);
+        cv::merge(lab_channels, lab);
+        cv::cvtColor(lab, work, cv::COLOR_Lab2BGR);
+    }
+
+    cv::Mat work_f;
+    work.convertTo(work_f, CV_32FC3);
+    cv::Mat base_f;
+    cv::GaussianBlur(work_f, base_f, cv::Size(0, 0), 0.75 + 0.15 * blur_severity);
+    cv::Mat detail_f = work_f - base_f;
+    float detail_gain = 0.08f + 0.05f * blur_severity;
+    cv::Mat enhanced_f = work_f + detail_f * detail_gain;
+
+    if (blur_severity > 0.40f) {
+        cv::Mat gray_work;
+        cv::cvtColor(work, gray_work, cv::COLOR_BGR2GRAY);
+        double angle = estimate_blur_angle_deg(gray_work);
+        if (blur_severity > 0.68f) {
+            work = apply_motion_wiener_restore_bgr(work, angle, 9, 6.0f);
+        }
+        cv::Mat directional_face = apply_directional_unsharp(work, angle, blur_severity > 0.70f ? 9 : 7, 0.06f + 0.04f * blur_severity);
+        directional_face.convertTo(enhanced_f, CV_32FC3);
+
+        cv::Mat kernel = cv::getGaborKernel(cv::Size(7, 7), 1.8, angle * CV_PI / 180.0, 4.5, 0.9, 0.0, CV_32F);
+        cv::Mat directional;
+        cv::filter2D(gray_work, directional, CV_32F, kernel);
+        cv::normalize(directional, directional, -6.0f, 6.0f, cv::NORM_MINMAX);
+
+        std::vector<cv::Mat> channels;
+        cv::split(enhanced_f, channels);
+        for (auto& channel : channels) {
+            channel += directional * 0.012f;
+        }
+        cv::merge(channels, enhanced_f);
+    }
+
+    cv::Mat enhanced;
+    enhanced_f.convertTo(enhanced, CV_8UC3);
+    enhanced = compress_face_highlights(enhanced);
+
+    cv::Mat blur;
+    cv::GaussianBlur(enhanced, blur, cv::Size(0, 0), 0.70 + 0.08 * blur_severity);
+    cv::Mat out;
+    float unsharp_amount = 0.04f + 0.02f * blur_severity;
+    cv::addWeighted(enhanced, 1.0f + unsharp_amount, blur, -unsharp_amount, 0, out);
+    out = suppress_halo_artifacts(work, out);
+
+    cv::Mat gray_out;
+    cv::cvtColor(out, gray_out, cv::COLOR_BGR2GRAY);
+    double mean_luma_after = cv::mean(gray_out)[0];
+    if (mean_luma_after > 1e-3) {
+        double gain = mean_luma_before / mean_luma_after;
+        gain = std::max(0.94, std::min(1.02, gain));
+        out.convertTo(out, -1, gain, 0);
+    }
+
+    return out;
+}
+
+const FaceEnhanceMode kFaceEnhanceModes[kFaceEnhanceModeCount] = {
+    {"classic", motion_deblur_enhance_face, 8.0},
+    {"opencv_sr", opencv_super_resolve_face, 18.0},
+    {"opencv_sr_deblur", opencv_superres_deblur_face, 20.0},
+    {"opencv_deghost", opencv_aggressive_deghost_face, 22.0},
+};
+
+size_t face_enhance_mode_count(double blur_severity, int short_edge) {
+    size_t mode_count = 2;
+    // 仅在严重模糊时才启用deblur/deghost流水线
+    if (blur_severity > 0.58 || short_edge < 140) {
+        mode_count = 3;
+        if (blur_severity > 0.72 || short_edge < 120) {
+            mode_count = 4;
+        }
+    }
+    return mode_count;
+}
+
+std::vector<size_t> rank_face_enhance_modes_on_proxy(const cv::Mat& face,
+                                                     const FaceQuality& base,
+                                                     size_t mode_count,
+                                                     int proxy_short_edge,
+                                                     std::chrono::steady_clock::time_point deadline) {
+    mode_count = std::min(mode_count, kFaceEnhanceModeCount);
+    FaceEnhanceScale at;
+    at.size = proxy_short_edge / static_cast<double>(std::min(face.cols, face.rows));
+    cv::Mat proxy;
+    cv::resize(face, proxy, cv::Size(), at.size, at.size, cv::INTER_AREA);
+    FaceQuality proxy_base = measure_face_quality(proxy);
+    at.focus = base.focus / std::max(1e-6, proxy_base.focus);
+
+    double proxy_scores[kFaceEnhanceModeCount];
+    std::vector<size_t> ranked;
+    for (size_t i = 0; i < mode_count; ++i) {
+        if (i > 0 && std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        const FaceEnhanceMode& mode = kFaceEnhanceModes[i];
+        proxy_scores[i] = score_face_candidate(mode.apply(proxy, at), proxy_base.focus, proxy_base.luma,
+                                               proxy_base.gradient, mode.scaleBonus, at.focus);
+        ranked.push_back(i);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [&](size_t a, size_t b) { return proxy_scores[a] > proxy_scores[b]; });
+    return ranked;
+}
+
+cv::Mat enhance_blurry_face(const cv::Mat& face,
+                            const FaceQuality& base,
+                            double blur_severity,
+                            int budget_ms,
+                            const char*& best_mode,
+                            double& best_score,
+                            size_t& modes_tried) {
+    int short_edge = std::min(face.cols, face.rows);
+    size_t mode_count = face_enhance_mode_count(blur_severity, short_edge);
+
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (budget_ms > 0) {
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget_ms);
+    }
+
+    std::vector<size_t> finalists;
+    modes_tried = 0;
+    // 候选方式不多于决赛名额时代理图排名没有意义
+    bool use_proxy = short_edge >= kFaceProxyMinSourceEdge && mode_count > kFaceProxyFinalists;
+    if (use_proxy) {
+        // 预算用尽时只跑代理图胜出者
+        finalists = rank_face_enhance_modes_on_proxy(face, base, mode_count, kFaceProxyShortEdge, deadline);
+        modes_tried = finalists.size();
+        finalists.resize(std::min(finalists.size(), kFaceProxyFinalists));
+    } else {
+        for (size_t i = 0; i < mode_count; ++i) {
+            finalists.push_back(i);
+        }
+    }
+
+    cv::Mat best_face;
+    for (size_t i = 0; i < finalists.size(); ++i) {
+        if (i > 0 && std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        const FaceEnhanceMode& mode = kFaceEnhanceModes[finalists[i]];
+        cv::Mat candidate = mode.apply(face, FaceEnhanceScale());
+        double score = score_face_candidate(candidate, base.focus, base.luma, base.gradient, mode.scaleBonus);
+        if (best_face.empty() || score > best_score) {
+            best_face = candidate;
+            best_score = score;
+            best_mode = mode.name;
+        }
+        ++modes_tried;
+    }
+    return best_face;
+}
+
+cv::Mat motion_deblur_enhance_person(const cv::Mat& person) {
+    if (person.empty() || person.cols <= 0 || person.rows <= 0) {
+        return person;
+    }
+
+    cv::Mat work = person;
+    int long_edge = std::max(work.cols, work.rows);
+    if (long_edge > 1440) {
+        work = resize_to_long_edge(work, 1440, cv::INTER_AREA);
+    }
+
+    cv::Mat gray_in;
+    cv::cvtColor(work, gray_in, cv::COLOR_BGR2GRAY);
+    QualityMetrics person_metrics;
+    compute_quality_metrics(gray_in, person_metrics);
+    double mean_luma_before = person_metrics.lumaMean;
+    double lap_var = person_metrics.laplacianVar;
+    float blur_severity = static_cast<float>(std::max(0.0, std::min(1.0, (180.0 - lap_var) / 180.0)));
+    if (blur_severity < 0.18f && mean_luma_before >= 95.0) {
+        return work.clone();
+    }
+
+    if (blur_severity > 0.35f) {
+        cv::Mat denoised;
+        cv::bilateralFilter(work, denoised, 5, 20, 16);
+        work = denoised;
+        cv::cvtColor(work, gray_in, cv::COLOR_BGR2GRAY);
+    }
+
+    cv::Mat work_f;
+    work.convertTo(work_f, CV_32FC3);
+    cv::Mat base_f;
+    cv::GaussianBlur(work_f, base_f, cv::Size(0, 0), 0.85 + 0.30 * blur_severity);
+    cv::Mat detail_f = work_f - base_f;
+    float detail_gain = 0.08f + 0.06f * blur_severity;
+    cv::Mat enhanced_f = work_f + detail_f * detail_gain;
+
+    if (blur_severity > 0.45f) {
+        double angle = estimate_blur_angle_deg(gray_in);
+        if (blur_severity > 0.70f) {
+            work = apply_motion_wiener_restore_bgr(work, angle, 11, 5.0f);
+        }
+        cv::Mat directional_person = apply_directional_unsharp(work, angle, blur_severity > 0.70f ? 11 : 9, 0.08f + 0.06f * blur_severity);
+        directional_person.convertTo(enhanced_f, CV_32FC3);
+        cv::Mat kernel = cv::getGaborKernel(cv::Size(9, 9), 2.0, angle * CV_PI / 180.0, 5.5, 0.9, 0.0, CV_32F);
+        cv::Mat directional;
+        cv::filter2D(gray_in, directional, CV_32F, kernel);
+        cv::normalize(directional, directional, -8.0f, 8.0f, cv::NORM_MINMAX);
+
+        std::vector<cv::Mat> channels;
+        cv::split(enhanced_f, channels);
+        for (auto& channel : channels) {
+            channel += directional * 0.022f;
+        }
+        cv::merge(channels, enhanced_f);
+    }
+
+    cv::Mat enhanced;
+    enhanced_f.convertTo(enhanced, CV_8UC3);
+    cv::Mat blur;
+    cv::GaussianBlur(enhanced, blur, cv::Size(0, 0), 0.75 + 0.16 * blur_severity);
+    cv::Mat out;
+    float unsharp_amount = 0.08f + 0.04f * blur_severity;
+    cv::addWeighted(enhanced, 1.0f + unsharp_amount, blur, -unsharp_amount, 0, out);
+
+    cv::Mat gray_out;
+    cv::cvtColor(out, gray_out, cv::COLOR_BGR2GRAY);
+    double mean_luma_after = cv::mean(gray_out)[0];
+    if (mean_luma_after > 1e-3) {
+        double gain = mean_luma_before / mean_luma_after;
+        gain = std::max(0.94, std::min(1.04, gain));
+        out.convertTo(out, -1, gain, 0);
+    }
+
+    return out;
+}
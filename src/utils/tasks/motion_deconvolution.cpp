@@ -0,0 +1,160 @@
+#include "motion_deconvolution.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+constexpr size_t kWienerFilterCacheBytes = 24 * 1024 * 1024;  // 每个增强线程缓存的维纳滤波器上限
+
+// Wiener filter conj(H) / (|H|^2 + 1/snr) of a line PSF at one padded DFT
+// size. The PSF is rasterized from an integer end-point offset, so
+// (dx, dy, size, snr) identifies the filter exactly.
+struct WienerFilterKey {
+    int dx;
+    int dy;
+    int rows;
+    int cols;
+    float snr;
+
+    bool operator==(const WienerFilterKey& other) const {
+        return dx == other.dx && dy == other.dy && rows == other.rows && cols == other.cols && snr == other.snr;
+    }
+};
+
+// Per-thread LRU of Wiener filters. A face goes through several candidate
+// modes with the same few kernels at the same size, so most lookups hit.
+class WienerFilterCache {
+public:
+    const cv::Mat& get(const WienerFilterKey& key) {
+        ++tick;
+        for (auto& entry : entries) {
+            if (entry.key == key) {
+                entry.lastUse = tick;
+                return entry.filter;
+            }
+        }
+
+        size_t filter_bytes = static_cast<size_t>(key.rows) * key.cols * sizeof(cv::Vec2f);
+        while (!entries.empty() && bytes + filter_bytes > kWienerFilterCacheBytes) {
+            auto oldest = std::min_element(entries.begin(), entries.end(),
+                                           [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+            bytes -= oldest->filter.total() * oldest->filter.elemSize();
+            entries.erase(oldest);
+        }
+        entries.push_back({key, build(key), tick});
+        bytes += filter_bytes;
+        return entries.back().filter;
+    }
+
+private:
+    struct Entry {
+        WienerFilterKey key;
+        cv::Mat filter;
+        uint64_t lastUse;
+    };
+
+    static cv::Mat build(const WienerFilterKey& key) {
+        // 先在小画布上画线，再以原点为中心环绕写入 PSF，复原结果不会产生半幅平移
+        int half = std::max(std::abs(key.dx), std::abs(key.dy)) + 2;
+        cv::Mat kernel = cv::Mat::zeros(2 * half + 1, 2 * half + 1, CV_32F);
+        cv::Point center(half, half);
+        cv::Point delta(key.dx, key.dy);
+        cv::line(kernel, center - delta, center + delta, cv::Scalar(1.0f), 1, cv::LINE_AA);
+        double kernel_sum = cv::sum(kernel)[0];
+        if (kernel_sum <= 1e-6) {
+            kernel.at<float>(center) = 1.0f;
+            kernel_sum = 1.0;
+        }
+
+        cv::Mat psf = cv::Mat::zeros(key.rows, key.cols, CV_32F);
+        for (int y = 0; y < kernel.rows; ++y) {
+            const float* row = kernel.ptr<float>(y);
+            int py = ((y - half) % key.rows + key.rows) % key.rows;
+            for (int x = 0; x < kernel.cols; ++x) {
+                if (row[x] != 0.0f) {
+                    int px = ((x - half) % key.cols + key.cols) % key.cols;
+                    psf.at<float>(py, px) += static_cast<float>(row[x] / kernel_sum);
+                }
+            }
+        }
+
+        cv::Mat filter;
+        cv::dft(psf, filter, cv::DFT_COMPLEX_OUTPUT);
+        float noise = 1.0f / std::max(0.5f, key.snr);
+        for (int y = 0; y < filter.rows; ++y) {
+            cv::Vec2f* row = filter.ptr<cv::Vec2f>(y);
+            for (int x = 0; x < filter.cols; ++x) {
+                float re = row[x][0];
+                float im = row[x][1];
+                float denom = re * re + im * im + noise;
+                row[x][0] = re / denom;
+                row[x][1] = -im / denom;
+            }
+        }
+        return filter;
+    }
+
+    std::vector<Entry> entries;
+    size_t bytes{0};
+    uint64_t tick{0};
+};
+
+} // namespace
+
+cv::Mat apply_motion_wiener_restore_luma(const cv::Mat& gray, double angle_deg, int kernel_len, float snr) {
+    kernel_len = std::max(3, kernel_len | 1);
+    double rad = angle_deg * CV_PI / 180.0;
+    WienerFilterKey key;
+    key.dx = static_cast<int>(std::round(std::cos(rad) * (kernel_len / 2)));
+    key.dy = static_cast<int>(std::round(std::sin(rad) * (kernel_len / 2)));
+    key.rows = cv::getOptimalDFTSize(gray.rows);
+    key.cols = cv::getOptimalDFTSize(gray.cols);
+    key.snr = snr;
+
+    static thread_local WienerFilterCache cache;
+    const cv::Mat& filter = cache.get(key);
+
+    static thread_local cv::Mat padded;
+    static thread_local cv::Mat spectrum;
+    cv::Mat gray_f;
+    gray.convertTo(gray_f, CV_32F, 1.0 / 255.0);
+    cv::copyMakeBorder(gray_f, padded, 0, key.rows - gray.rows, 0, key.cols - gray.cols, cv::BORDER_REFLECT);
+    cv::dft(padded, spectrum, cv::DFT_COMPLEX_OUTPUT);
+    cv::mulSpectrums(spectrum, filter, spectrum, 0);
+    cv::idft(spectrum, padded, cv::DFT_REAL_OUTPUT | cv::DFT_SCALE);
+
+    cv::Mat restored;
+    cv::max(padded(cv::Rect(0, 0, gray.cols, gray.rows)), 0.0, restored);
+    cv::min(restored, 1.0, restored);
+    return restored;
+}
+
+cv::Mat apply_motion_wiener_restore_bgr(const cv::Mat& src, double angle_deg, int kernel_len, float snr) {
+    if (src.empty() || kernel_len < 3) {
+        return src.clone();
+    }
+
+    cv::Mat gray;
+    cv::cvtColor(src, gray, cv::COLOR_BGR2GRAY);
+    cv::Mat restored_luma = apply_motion_wiener_restore_luma(gray, angle_deg, kernel_len, snr);
+
+    cv::Mat restored(src.size(), CV_8UC3);
+    for (int y = 0; y < src.rows; ++y) {
+        const cv::Vec3b* src_row = src.ptr<cv::Vec3b>(y);
+        const uchar* gray_row = gray.ptr<uchar>(y);
+        const float* luma_row = restored_luma.ptr<float>(y);
+        cv::Vec3b* out_row = restored.ptr<cv::Vec3b>(y);
+        for (int x = 0; x < src.cols; ++x) {
+            float ratio = (luma_row[x] + 1e-3f) / (gray_row[x] * (1.0f / 255.0f) + 1e-3f);
+            for (int c = 0; c < 3; ++c) {
+                out_row[x][c] = cv::saturate_cast<uchar>(src_row[x][c] * ratio);
+            }
+        }
+    }
+    return restored;
+}
@@ -1,4 +1,5 @@
 #include "nafnet_tiny_enhancer.h"
+#include "simd_kernels.h"
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
@@ -85,34 +86,26 @@ bool is_float_tensor(rknn_tensor_type type) {
 void pack_nchw_float(const cv::Mat& rgb_float, std::vector<float>* output) {
     const int height = rgb_float.rows;
     const int width = rgb_float.cols;
-    output->assign(static_cast<size_t>(height * width * 3), 0.0f);
+    output->resize(static_cast<size_t>(height * width * 3));
 
     const int plane = height * width;
+    float* out = output->data();
     for (int y = 0; y < height; ++y) {
-        const cv::Vec3f* row = rgb_float.ptr<cv::Vec3f>(y);
-        for (int x = 0; x < width; ++x) {
-            const int idx = y * width + x;
-            (*output)[idx] = row[x][0];
-            (*output)[plane + idx] = row[x][1];
-            (*output)[plane * 2 + idx] = row[x][2];
-        }
+        const int idx = y * width;
+        simd_deinterleave3_f32(rgb_float.ptr<float>(y), out + idx, out + plane + idx, out + plane * 2 + idx, width);
     }
 }
 
 void pack_nchw_u8(const cv::Mat& rgb_u8, std::vector<unsigned char>* output) {
     const int height = rgb_u8.rows;
     const int width = rgb_u8.cols;
-    output->assign(static_cast<size_t>(height * width * 3), 0);
+    output->resize(static_cast<size_t>(height * width * 3));
 
     const int plane = height * width;
+    unsigned char* out = output->data();
     for (int y = 0; y < height; ++y) {
-        const cv::Vec3b* row = rgb_u8.ptr<cv::Vec3b>(y);
-        for (int x = 0; x < width; ++x) {
-            const int idx = y * width + x;
-            (*output)[idx] = row[x][0];
-            (*output)[plane + idx] = row[x][1];
-            (*output)[plane * 2 + idx] = row[x][2];
-        }
+        const int idx = y * width;
+        simd_deinterleave3_u8(rgb_u8.ptr<unsigned char>(y), out + idx, out + plane + idx, out + plane * 2 + idx, width);
     }
 }
 
@@ -0,0 +1,359 @@
+#include "track_fusion.h"
+#include "quality_metrics.h"
+#include "simd_kernels.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+constexpr float kMultiFrameFusionMaxShiftRatio = 0.25f;     // 允许更大帧间位移（原 0.20）
+constexpr float kMultiFrameFusionMinSimilarity = 0.28f;     // 放宽相似度门槛（原 0.36）
+constexpr float kAnchorMinOverlap = 0.60f;                  // 焦点区与锚点重叠低于此值时重建锚点
+constexpr int kPeakCentroidRadius = 2;                      // 5x5 weighted centroid, as cv::phaseCorrelate
+
+cv::Rect clampRectToSize(const cv::Rect& rect, const cv::Size& bounds) {
+    int x = std::max(0, std::min(rect.x, bounds.width - 1));
+    int y = std::max(0, std::min(rect.y, bounds.height - 1));
+    int width = std::max(1, std::min(rect.width, bounds.width - x));
+    int height = std::max(1, std::min(rect.height, bounds.height - y));
+    return cv::Rect(x, y, width, height);
+}
+
+cv::Rect expandRectFromCenter(const cv::Rect& rect, float scale, const cv::Size& bounds) {
+    float cx = rect.x + rect.width * 0.5f;
+    float cy = rect.y + rect.height * 0.5f;
+    float width = rect.width * scale;
+    float height = rect.height * scale;
+    cv::Rect expanded(static_cast<int>(std::round(cx - width * 0.5f)),
+                      static_cast<int>(std::round(cy - height * 0.5f)),
+                      static_cast<int>(std::round(width)),
+                      static_cast<int>(std::round(height)));
+    return clampRectToSize(expanded, bounds);
+}
+
+float rectOverlap(const cv::Rect& a, const cv::Rect& b) {
+    float inter = static_cast<float>((a & b).area());
+    float uni = static_cast<float>(a.area() + b.area()) - inter;
+    return uni > 0.0f ? inter / uni : 0.0f;
+}
+
+double computeGrayFocusVariance(const cv::Mat& gray) {
+    if (gray.empty() || gray.cols <= 1 || gray.rows <= 1) {
+        return 0.0;
+    }
+
+    QualityMetrics metrics;
+    compute_quality_metrics(gray, metrics);
+    return metrics.laplacianVar;
+}
+
+// Even sizes keep the wrap-around peak symmetric (cv::phaseCorrelate's
+// quadrant swap is off by half a pixel on odd sizes).
+int evenDftSize(int n) {
+    int size = cv::getOptimalDFTSize(n);
+    while (size % 2 != 0) {
+        size = cv::getOptimalDFTSize(size + 1);
+    }
+    return size;
+}
+
+// Mean of clamp(1 - (|a - b| - 14) / 62, 0, 1) over two gray patches.
+float meanSimilarity(const cv::Mat& a, const cv::Mat& b) {
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> t{};
+        for (int d = 0; d < 256; ++d) {
+            t[d] = std::max(0.0f, std::min(1.0f, 1.0f - (static_cast<float>(d) - 14.0f) / 62.0f));
+        }
+        return t;
+    }();
+
+    double sum = 0.0;
+    for (int y = 0; y < a.rows; ++y) {
+        const uint8_t* pa = a.ptr<uint8_t>(y);
+        const uint8_t* pb = b.ptr<uint8_t>(y);
+        for (int x = 0; x < a.cols; ++x) {
+            sum += table[std::abs(pa[x] - pb[x])];
+        }
+    }
+    return static_cast<float>(sum / static_cast<double>(a.total()));
+}
+
+// Sub-pixel maximum of a circular correlation surface: weighted centroid
+// around the peak with wrapped indices, returned as a signed offset.
+cv::Point2d correlationPeak(const cv::Mat& corr) {
+    cv::Point peak;
+    cv::minMaxLoc(corr, nullptr, nullptr, nullptr, &peak);
+
+    double sx = 0.0;
+    double sy = 0.0;
+    double sw = 0.0;
+    for (int dy = -kPeakCentroidRadius; dy <= kPeakCentroidRadius; ++dy) {
+        const float* row = corr.ptr<float>((peak.y + dy + corr.rows) % corr.rows);
+        for (int dx = -kPeakCentroidRadius; dx <= kPeakCentroidRadius; ++dx) {
+            double v = row[(peak.x + dx + corr.cols) % corr.cols];
+            sx += (peak.x + dx) * v;
+            sy += (peak.y + dy) * v;
+            sw += v;
+        }
+    }
+    cv::Point2d centroid(peak.x, peak.y);
+    if (std::fabs(sw) > 1e-12) {
+        centroid = cv::Point2d(sx / sw, sy / sw);
+    }
+    if (centroid.x > corr.cols * 0.5) {
+        centroid.x -= corr.cols;
+    }
+    if (centroid.y > corr.rows * 0.5) {
+        centroid.y -= corr.rows;
+    }
+    return centroid;
+}
+
+} // namespace
+
+void TrackFusionAccumulator::reset() {
+    *this = TrackFusionAccumulator();
+}
+
+bool TrackFusionAccumulator::computeSpectrum(const cv::Mat& roi, cv::Mat& spectrum) {
+    if (roi.empty() || (anchorRect & cv::Rect(0, 0, roi.cols, roi.rows)) != anchorRect) {
+        return false;
+    }
+
+    cv::cvtColor(roi(anchorRect), patchGray, cv::COLOR_BGR2GRAY);
+    patchGray.convertTo(patchFloat, CV_32F);
+    cv::GaussianBlur(patchFloat, patchFloat, cv::Size(0, 0), 0.8);
+    // Without the mean removal and the window the patch border dominates the
+    // spectrum and the peak drifts by pixels on smooth skin texture.
+    patchFloat -= cv::mean(patchFloat);
+    cv::multiply(patchFloat, window, patchFloat);
+    cv::copyMakeBorder(patchFloat, padded,
+                       0, paddedSize.height - patchFloat.rows,
+                       0, paddedSize.width - patchFloat.cols,
+                       cv::BORDER_CONSTANT, cv::Scalar::all(0));
+    cv::dft(padded, spectrum, cv::DFT_COMPLEX_OUTPUT);
+    return true;
+}
+
+void TrackFusionAccumulator::setAnchor(const TrackFusionFrame& frame, const cv::Rect& rect) {
+    anchorRect = rect;
+    paddedSize = cv::Size(evenDftSize(rect.width), evenDftSize(rect.height));
+    cv::createHanningWindow(window, rect.size(), CV_32F);
+    alignments.clear();
+    hasAnchor = computeSpectrum(frame.roi, anchorSpectrum);
+    anchorSeq = frame.seq;
+    if (hasAnchor) {
+        alignments.push_back({frame.seq, true, cv::Point2d(0.0, 0.0)});
+    }
+}
+
+// Same estimate as cv::phaseCorrelate(anchorPatch, framePatch, window) on
+// mean-removed patches, with the anchor spectrum reused:
+// frame(x) ~ anchor(x - shift).
+TrackFusionAccumulator::Alignment TrackFusionAccumulator::alignToAnchor(const TrackFusionFrame& frame) {
+    for (const Alignment& cached : alignments) {
+        if (cached.seq == frame.seq) {
+            return cached;
+        }
+    }
+
+    Alignment alignment;
+    alignment.seq = frame.seq;
+    if (hasAnchor && computeSpectrum(frame.roi, frameSpectrum)) {
+        cv::mulSpectrums(anchorSpectrum, frameSpectrum, crossPower, 0, true);
+        for (int y = 0; y < crossPower.rows; ++y) {
+            cv::Vec2f* p = crossPower.ptr<cv::Vec2f>(y);
+            for (int x = 0; x < crossPower.cols; ++x) {
+                float inv = 1.0f / (std::sqrt(p[x][0] * p[x][0] + p[x][1] * p[x][1]) + 1e-6f);
+                p[x][0] *= inv;
+                p[x][1] *= inv;
+            }
+        }
+        cv::idft(crossPower, correlation, cv::DFT_REAL_OUTPUT);
+        alignment.shift = -correlationPeak(correlation);
+        alignment.valid = true;
+    }
+    alignments.push_back(alignment);
+    return alignment;
+}
+
+void TrackFusionAccumulator::pruneAlignments(uint64_t oldestSeq) {
+    alignments.erase(std::remove_if(alignments.begin(), alignments.end(),
+                                    [oldestSeq](const Alignment& a) { return a.seq < oldestSeq; }),
+                     alignments.end());
+}
+
+TrackFusionResult TrackFusionAccumulator::fuse(const TrackFusionFrame& reference,
+                                               const std::vector<TrackFusionFrame>& history,
+                                               const cv::Rect& focusBox,
+                                               const cv::Rect& outputRegion) {
+    TrackFusionResult result;
+    const cv::Mat& ref = reference.roi;
+    if (ref.empty() || history.empty() || focusBox.width < 16 || focusBox.height < 16) {
+        return result;
+    }
+
+    const cv::Rect roiRect(0, 0, ref.cols, ref.rows);
+    cv::Rect safe_focus = expandRectFromCenter(focusBox, 1.45f, ref.size());
+
+    // ── Stage 1: Compute sharpness for reference ──
+    cv::Mat reference_gray;
+    cv::cvtColor(ref(safe_focus), reference_gray, cv::COLOR_BGR2GRAY);
+    result.referenceFocus = computeGrayFocusVariance(reference_gray);
+    result.bestAlignedFocus = result.referenceFocus;
+
+    size_t history_begin = history.size() > kTrackFusionHistorySize ?
+        history.size() - kTrackFusionHistorySize : 0;
+    uint64_t oldest_seq = reference.seq;
+    for (size_t i = history_begin; i < history.size(); ++i) {
+        oldest_seq = std::min(oldest_seq, history[i].seq);
+    }
+
+    // The anchor is rebuilt on the reference once its frame has left the
+    // window, the face has moved off it, or it no longer fits the ROI; all
+    // ROIs of a track share one coordinate frame, so it is otherwise kept.
+    bool anchor_usable = hasAnchor && anchorSeq >= oldest_seq &&
+                         (anchorRect & roiRect) == anchorRect &&
+                         rectOverlap(anchorRect, safe_focus) >= kAnchorMinOverlap;
+    if (anchor_usable) {
+        pruneAlignments(oldest_seq);
+    } else {
+        setAnchor(reference, safe_focus);
+    }
+    Alignment reference_alignment = alignToAnchor(reference);
+    if (!reference_alignment.valid) {
+        result.acceptedFrames = 1;
+        return result;
+    }
+
+    // Only the region read back (plus the focus patch) is warped.
+    cv::Rect work = (outputRegion | safe_focus) & roiRect;
+    cv::Rect focus_in_work = safe_focus - work.tl();
+    float max_shift = std::max(4.0f, std::min(safe_focus.width, safe_focus.height) * kMultiFrameFusionMaxShiftRatio);
+
+    // Collect candidate frames: reference + aligned history frames, each
+    // covering the work region.
+    struct FrameEntry {
+        cv::Mat frame;
+        double focus;
+    };
+    std::vector<FrameEntry> candidates;
+    candidates.reserve(history.size() - history_begin + 1);
+    candidates.push_back({ref(work), result.referenceFocus});
+
+    float similarity_sum = 0.0f;
+    int similarity_count = 0;
+    cv::Mat aligned_gray;
+
+    for (size_t i = history_begin; i < history.size(); ++i) {
+        const TrackFusionFrame& frame = history[i];
+        if (frame.roi.empty()) {
+            continue;
+        }
+
+        // Frames with strong directional blur were already dropped by
+        // processFrame from the ratio cached with each history entry.
+        Alignment alignment = alignToAnchor(frame);
+        if (!alignment.valid) {
+            continue;
+        }
+
+        // frame(q + t) shows what the reference shows at q.
+        cv::Point2d t = alignment.shift - reference_alignment.shift;
+        float shift_norm = std::sqrt(static_cast<float>(t.x * t.x + t.y * t.y));
+        if (shift_norm > max_shift) {
+            continue;
+        }
+
+        cv::Mat transform = (cv::Mat_<double>(2, 3) << 1.0, 0.0, work.x + t.x,
+                                                       0.0, 1.0, work.y + t.y);
+        cv::Mat aligned;
+        cv::warpAffine(frame.roi, aligned, transform, work.size(),
+                       cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+
+        // ── Similarity check ──
+        cv::cvtColor(aligned(focus_in_work), aligned_gray, cv::COLOR_BGR2GRAY);
+        float mean_similarity = meanSimilarity(aligned_gray, reference_gray);
+        if (mean_similarity < kMultiFrameFusionMinSimilarity) {
+            continue;
+        }
+
+        // ── Sharpness of aligned frame ──
+        double aligned_focus = computeGrayFocusVariance(aligned_gray);
+
+        candidates.push_back({std::move(aligned), aligned_focus});
+        if (aligned_focus > result.bestAlignedFocus) {
+            result.bestAlignedFocus = aligned_focus;
+        }
+
+        similarity_sum += mean_similarity;
+        similarity_count++;
+        result.acceptedFrames++;
+    }
+
+    if (result.acceptedFrames <= 0) {
+        result.acceptedFrames = 1;
+        result.meanSimilarity = 0.0f;
+        return result;
+    }
+
+    result.meanSimilarity = similarity_count > 0 ? (similarity_sum / similarity_count) : 0.0f;
+
+    // ── Stage 2: Best-frame selection + median temporal denoising ──
+
+    // Find the sharpest frame as base.
+    double best_focus = 0.0;
+    for (const auto& entry : candidates) {
+        best_focus = std::max(best_focus, entry.focus);
+    }
+
+    // Filter: keep only frames with focus >= 60% of the best (reject blurry frames).
+    double focus_threshold = best_focus * 0.60;
+    std::vector<cv::Mat> good_frames;
+    good_frames.reserve(candidates.size());
+    for (auto& entry : candidates) {
+        if (entry.focus >= focus_threshold) {
+            good_frames.push_back(std::move(entry.frame));
+        }
+    }
+    if (good_frames.empty()) {
+        return result;
+    }
+
+    // Outside the work region the fused ROI is the reference.
+    result.fused = ref.clone();
+    good_frames[0].copyTo(result.fused(work));
+
+    // 1 good frame is returned directly; of 2, the first is kept (median of
+    // 2 is just the average, not useful).
+    if (good_frames.size() <= 2) {
+        return result;
+    }
+
+    // ── 3+ frames: pixel-wise median fusion ──
+    // Median naturally rejects motion blur artifacts (outlier pixels).
+    // At most kTrackFusionHistorySize history frames plus the reference.
+    int n = std::min(static_cast<int>(good_frames.size()), kSimdMedianMaxInputs);
+    cv::Rect region = outputRegion & work;
+    if (region.empty()) {
+        return result;
+    }
+
+    // The kernel picks the same element as nth_element at n / 2, 16-32
+    // bytes per step.
+    const uint8_t* frame_ptrs[kSimdMedianMaxInputs];
+    const size_t run = static_cast<size_t>(region.width) * 3;
+    const int col = (region.x - work.x) * 3;
+    for (int r = region.y; r < region.y + region.height; r++) {
+        for (int f = 0; f < n; f++) {
+            frame_ptrs[f] = good_frames[f].ptr<uint8_t>(r - work.y) + col;
+        }
+        simd_median_u8(frame_ptrs, n, result.fused.ptr<uint8_t>(r) + region.x * 3, run);
+    }
+
+    return result;
+}
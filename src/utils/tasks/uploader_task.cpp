@@ -1,23 +1,37 @@
 #include "uploader_task.h"
+#include "quality_metrics.h"
+#include "jpeg_encoder.h"
+#include "image_enhance.h"
 extern "C" {
 #include "log.h"
 }
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
-#include <opencv2/photo.hpp>
 #include <curl/curl.h>
 #include <random>
 #include <cmath>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
 
 namespace {
 constexpr size_t kUploadMaxBytes = 300 * 1024;
 constexpr size_t kUploadQueueMaxSize = 80;
 constexpr int kUploadDefaultJpegQuality = 92;
+constexpr int kUploadMinJpegQuality = 55;
+constexpr double kJpegTargetFill = 0.93;   // 码率控制按上限的 93% 预测，留出模型误差
+constexpr double kJpegAcceptFill = 0.85;   // 达到上限的 85% 即不再尝试更高质量
 constexpr int kUploadMinLongEdge = 768;
 constexpr int kUploadMaxLongEdge = 1280;
 constexpr int kUploadFaceMaxLongEdge = 1440;
 constexpr int kUploadPersonMaxLongEdge = 1600;
+constexpr int kUploadMaxRetries = 3;
+constexpr size_t kUploadEnhanceWorkers = 2;    // 增强/编码线程数
+constexpr size_t kUploadMaxInFlight = 4;       // 并发上传数，同时也是保持的长连接数
+constexpr int kUploadPollTimeoutMs = 100;
+constexpr size_t kUploadLatencySamples = 256;
+constexpr double kUploadStatsIntervalSec = 60.0;
 
 std::string generate_unique_code_12() {
     static thread_local std::mt19937 rng(std::random_device{}());
@@ -38,743 +52,476 @@ void add_form_field(curl_mime* form, const char* name, const std::string& value)
     curl_mime_data(field, value.c_str(), CURL_ZERO_TERMINATED);
 }
 
-cv::Mat resize_to_long_edge(const cv::Mat& img, int target_long_edge, int interpolation) {
-    int current_long_edge = std::max(img.cols, img.rows);
-    if (img.empty() || current_long_edge <= 0 || current_long_edge <= target_long_edge) {
-        return img;
+void encode_jpeg(const cv::Mat& img, int quality, std::vector<uchar>& buf) {
+    if (!jpeg_encode_bgr(img, quality, buf)) {
+        buf.clear();
     }
-
-    float scale = target_long_edge / static_cast<float>(current_long_edge);
-    cv::Mat resized;
-    cv::resize(img, resized, cv::Size(), scale, scale, interpolation);
-    return resized;
-}
-
-std::vector<uchar> encode_jpeg(const cv::Mat& img, int quality) {
-    std::vector<uchar> buf;
-    std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, quality};
-    cv::imencode(".jpg", img, buf, params);
-    return buf;
 }
 
-std::vector<uchar> encode_image_for_upload(const cv::Mat& img, int max_long_edge = kUploadMaxLongEdge) {
-    if (img.empty()) {
-        return {};
-    }
+// JPEG size relative to kUploadDefaultJpegQuality, measured on natural
+// images; interpolated log-linearly between the entries.
+struct JpegQualityRatio {
+    int quality;
+    double ratio;
+};
 
-    std::vector<uchar> original = encode_jpeg(img, kUploadDefaultJpegQuality);
-    if (original.size() <= kUploadMaxBytes) {
-        return original;
-    }
-
-    cv::Mat working = img;
-    int original_long_edge = std::max(img.cols, img.rows);
-    if (original_long_edge > max_long_edge) {
-        working = resize_to_long_edge(working, max_long_edge, cv::INTER_AREA);
-    }
+const JpegQualityRatio kJpegQualityRatios[] = {
+    {55, 0.32}, {58, 0.34}, {62, 0.36}, {66, 0.39}, {70, 0.42}, {74, 0.47},
+    {78, 0.53}, {82, 0.60}, {86, 0.72}, {90, 0.90}, {92, 1.00},
+};
 
-    std::vector<uchar> best = encode_jpeg(working, kUploadDefaultJpegQuality);
-    static const int kQualities[] = {90, 84, 78, 72, 66, 60, 55};
-
-    while (true) {
-        for (int quality : kQualities) {
-            std::vector<uchar> compressed = encode_jpeg(working, quality);
-            best = compressed;
-            if (compressed.size() <= kUploadMaxBytes) {
-                log_info("UploaderTask: image encoded from %zuKB to %zuKB (quality=%d, size=%dx%d)",
-                         original.size() / 1024,
-                         compressed.size() / 1024,
-                         quality,
-                         working.cols,
-                         working.rows);
-                return compressed;
-            }
-        }
-
-        int current_long_edge = std::max(working.cols, working.rows);
-        if (current_long_edge <= kUploadMinLongEdge) {
-            break;
+double jpeg_quality_ratio(int quality) {
+    for (size_t i = 1; i < std::size(kJpegQualityRatios); ++i) {
+        const JpegQualityRatio& lo = kJpegQualityRatios[i - 1];
+        const JpegQualityRatio& hi = kJpegQualityRatios[i];
+        if (quality <= hi.quality) {
+            double t = std::max(0.0, (quality - lo.quality) / static_cast<double>(hi.quality - lo.quality));
+            return std::exp(std::log(lo.ratio) + t * (std::log(hi.ratio) - std::log(lo.ratio)));
         }
-
-        int next_long_edge = std::max(kUploadMinLongEdge, static_cast<int>(std::round(current_long_edge * 0.88f)));
-        if (next_long_edge >= current_long_edge) {
-            break;
-        }
-        working = resize_to_long_edge(working, next_long_edge, cv::INTER_AREA);
     }
-
-    log_info("UploaderTask: image encoded from %zuKB to %zuKB (quality=%d, size=%dx%d)",
-             original.size() / 1024,
-             best.size() / 1024,
-             55,
-             working.cols,
-             working.rows);
-    return best;
+    return 1.0;
 }
 
-double compute_laplacian_variance(const cv::Mat& gray) {
-    cv::Mat lap;
-    cv::Laplacian(gray, lap, CV_32F);
-    cv::Scalar lap_mu, lap_sigma;
-    cv::meanStdDev(lap, lap_mu, lap_sigma);
-    return lap_sigma[0] * lap_sigma[0];
-}
+// Size model of one image: bytes ~ reference * (long_edge / probe_long_edge)^exponent
+// * jpeg_quality_ratio(quality). The exponent grows with the probe's bits per
+// pixel, since downscaling averages away more of a noisy image. reference is
+// corrected by the error of every encode.
+struct JpegSizeModel {
+    double reference;
+    int probeLongEdge;
+    double exponent;
 
-double compute_focus_measure_bgr(const cv::Mat& img) {
-    if (img.empty()) {
-        return 0.0;
-    }
-    cv::Mat gray;
-    if (img.channels() == 3) {
-        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
-    } else {
-        gray = img;
+    double predict(int long_edge, int quality) const {
+        return reference * std::pow(long_edge / static_cast<double>(probeLongEdge), exponent) *
+               jpeg_quality_ratio(quality);
     }
-    return compute_laplacian_variance(gray);
-}
 
-double compute_luma_mean_bgr(const cv::Mat& img) {
+    // Highest quality in (lo, hi) predicted to fit, or 0.
+    int pickQuality(int long_edge, int lo, int hi, double budget) const {
+        for (int quality = hi - 1; quality > lo; --quality) {
+            if (predict(long_edge, quality) <= budget) {
+                return quality;
+            }
+        }
+        return 0;
+    }
+};
+
+// Encodes img to at most kUploadMaxBytes. A probe at kUploadDefaultJpegQuality
+// is kept when it fits; otherwise the size model picks the quality and, below
+// kUploadMinJpegQuality, the scale, and each further encode bisects the
+// remaining quality range with the corrected model. Most oversized images
+// need two encodes. The result is written to out; a fitting attempt is
+// swapped in, so out and the per-thread scratch trade buffers, never copy.
+bool encode_image_for_upload(const cv::Mat& img, std::vector<uchar>& out, int max_long_edge = kUploadMaxLongEdge) {
+    out.clear();
     if (img.empty()) {
-        return 0.0;
-    }
-    cv::Mat gray;
-    if (img.channels() == 3) {
-        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
-    } else {
-        gray = img;
+        return false;
     }
-    return cv::mean(gray)[0];
-}
-
-cv::Mat apply_unsharp_mask(const cv::Mat& src, double sigma, float amount) {
-    if (src.empty()) {
-        return src.clone();
-    }
-
-    cv::Mat blur;
-    cv::GaussianBlur(src, blur, cv::Size(0, 0), sigma);
-    cv::Mat out;
-    cv::addWeighted(src, 1.0f + amount, blur, -amount, 0, out);
-    return out;
-}
 
-cv::Mat compress_face_highlights(const cv::Mat& src) {
-    if (src.empty()) {
-        return src.clone();
+    static thread_local std::vector<uchar> attempt;
+    encode_jpeg(img, kUploadDefaultJpegQuality, out);
+    if (out.size() <= kUploadMaxBytes) {
+        return !out.empty();
     }
+    size_t original_size = out.size();
+    out.clear();
 
-    cv::Mat lab;
-    cv::cvtColor(src, lab, cv::COLOR_BGR2Lab);
-    std::vector<cv::Mat> channels;
-    cv::split(lab, channels);
-
-    cv::Mat lightness_f;
-    channels[0].convertTo(lightness_f, CV_32F);
-    for (int y = 0; y < lightness_f.rows; ++y) {
-        float* row = lightness_f.ptr<float>(y);
-        for (int x = 0; x < lightness_f.cols; ++x) {
-            float value = row[x];
-            if (value > 214.0f) {
-                value = 214.0f + (value - 214.0f) * 0.42f;
+    int original_long_edge = std::max(img.cols, img.rows);
+    double bpp = original_size * 8.0 / (static_cast<double>(img.cols) * img.rows);
+    JpegSizeModel model{static_cast<double>(original_size),
+                        original_long_edge,
+                        std::max(1.6, std::min(2.4, 1.6 + 0.14 * bpp))};
+    const double budget = kUploadMaxBytes * kJpegTargetFill;
+
+    int long_edge = std::min(original_long_edge, max_long_edge);
+    int quality = model.pickQuality(long_edge, kUploadMinJpegQuality - 1, kUploadDefaultJpegQuality + 1, budget);
+    if (quality == 0) {
+        // 最低质量仍超限，按模型直接缩到预计合适的尺寸
+        double fit_scale = std::pow(budget / model.predict(original_long_edge, kUploadMinJpegQuality),
+                                    1.0 / model.exponent);
+        long_edge = std::max(kUploadMinLongEdge, std::min(long_edge, static_cast<int>(original_long_edge * fit_scale)));
+        quality = std::max(kUploadMinJpegQuality,
+                           model.pickQuality(long_edge, kUploadMinJpegQuality - 1, kUploadDefaultJpegQuality + 1, budget));
+    }
+
+    cv::Mat working;
+    int working_long_edge = 0;
+    int best_quality = 0;
+    int lo = kUploadMinJpegQuality - 1;   // highest quality known to fit at this size
+    int hi = kUploadDefaultJpegQuality + 1;  // lowest quality known not to fit
+    int encodes = 1;
+    while (true) {
+        if (working_long_edge != long_edge) {
+            working = resize_to_long_edge(img, long_edge, cv::INTER_AREA);
+            working_long_edge = long_edge;
+        }
+        encode_jpeg(working, quality, attempt);
+        ++encodes;
+        model.reference *= attempt.size() / std::max(1.0, model.predict(long_edge, quality));
+
+        if (attempt.size() <= kUploadMaxBytes) {
+            out.swap(attempt);
+            best_quality = quality;
+            lo = quality;
+            if (out.size() >= kUploadMaxBytes * kJpegAcceptFill) {
+                break;
             }
-            if (value > 238.0f) {
-                value = 238.0f + (value - 238.0f) * 0.22f;
+            int next = model.pickQuality(long_edge, lo, hi, budget);
+            if (next == 0) {
+                break;
             }
-            row[x] = std::max(0.0f, std::min(255.0f, value));
+            quality = next;
+            continue;
         }
-    }
-
-    lightness_f.convertTo(channels[0], CV_8U);
-    cv::merge(channels, lab);
-
-    cv::Mat out;
-    cv::cvtColor(lab, out, cv::COLOR_Lab2BGR);
-    return out;
-}
 
-cv::Mat suppress_halo_artifacts(const cv::Mat& reference, const cv::Mat& enhanced) {
-    if (reference.empty() || enhanced.empty() || reference.size() != enhanced.size()) {
-        return enhanced.clone();
-    }
-
-    cv::Mat ref_gray, enh_gray;
-    cv::cvtColor(reference, ref_gray, cv::COLOR_BGR2GRAY);
-    cv::cvtColor(enhanced, enh_gray, cv::COLOR_BGR2GRAY);
-
-    cv::Mat diff;
-    cv::subtract(enh_gray, ref_gray, diff);
-
-    cv::Mat bright_mask, gain_mask, halo_mask;
-    cv::threshold(ref_gray, bright_mask, 168, 255, cv::THRESH_BINARY);
-    cv::threshold(diff, gain_mask, 14, 255, cv::THRESH_BINARY);
-    cv::bitwise_and(bright_mask, gain_mask, halo_mask);
-    cv::GaussianBlur(halo_mask, halo_mask, cv::Size(0, 0), 2.2);
-
-    cv::Mat halo_mask_f;
-    halo_mask.convertTo(halo_mask_f, CV_32F, 1.0 / 255.0);
-    std::vector<cv::Mat> halo_channels(3, halo_mask_f);
-    cv::Mat halo3;
-    cv::merge(halo_channels, halo3);
-
-    cv::Mat ref_f, enh_f;
-    reference.convertTo(ref_f, CV_32FC3);
-    enhanced.convertTo(enh_f, CV_32FC3);
-    cv::Mat blended = enh_f.mul(1.0f - halo3 * 0.55f) + ref_f.mul(halo3 * 0.55f);
-
-    cv::Mat out;
-    blended.convertTo(out, CV_8UC3);
-    return out;
-}
-
-cv::Mat opencv_super_resolve_face(const cv::Mat& face) {
-    if (face.empty()) {
-        return face.clone();
-    }
-
-    int short_edge = std::min(face.cols, face.rows);
-    if (short_edge <= 0) {
-        return face.clone();
-    }
-
-    float target_short_edge = short_edge < 96 ? 320.0f : (short_edge < 160 ? 280.0f : 240.0f);
-    float scale = std::min(2.6f, target_short_edge / static_cast<float>(short_edge));
-    if (scale <= 1.04f) {
-        return face.clone();
-    }
-
-    cv::Mat upscaled;
-    cv::resize(face, upscaled, cv::Size(), scale, scale, scale > 1.8f ? cv::INTER_LANCZOS4 : cv::INTER_CUBIC);
-
-    cv::Mat filtered;
-    cv::bilateralFilter(upscaled, filtered, 7, 28, 18);
-
-    cv::Mat detailed;
-    cv::detailEnhance(filtered, detailed, 4.5f, 0.08f);
-
-    cv::Mat softened;
-    cv::addWeighted(filtered, 0.72, detailed, 0.28, 0, softened);
-    softened = compress_face_highlights(softened);
-    softened = suppress_halo_artifacts(filtered, softened);
-
-    cv::Mat sr = apply_unsharp_mask(softened, 0.85, 0.08f);
-    sr = suppress_halo_artifacts(filtered, sr);
-    return sr;
-}
-
-double estimate_blur_angle_deg(const cv::Mat& gray);
-
-double compute_gradient_energy_bgr(const cv::Mat& img) {
-    if (img.empty()) {
-        return 0.0;
-    }
-
-    cv::Mat gray;
-    if (img.channels() == 3) {
-        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
-    } else {
-        gray = img;
-    }
-
-    cv::Mat gx, gy;
-    cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
-    cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
-    cv::Mat magnitude;
-    cv::magnitude(gx, gy, magnitude);
-    return cv::mean(magnitude)[0];
-}
-
-double compute_ghost_penalty_bgr(const cv::Mat& img) {
-    if (img.empty()) {
-        return 0.0;
-    }
-
-    cv::Mat gray;
-    if (img.channels() == 3) {
-        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
-    } else {
-        gray = img;
-    }
-
-    double angle = estimate_blur_angle_deg(gray);
-    int dx = static_cast<int>(std::round(std::cos(angle * CV_PI / 180.0) * 2.0));
-    int dy = static_cast<int>(std::round(std::sin(angle * CV_PI / 180.0) * 2.0));
-    if (dx == 0 && dy == 0) {
-        dx = 1;
-    }
-
-    cv::Mat shifted;
-    cv::Mat transform = (cv::Mat_<double>(2, 3) << 1, 0, dx, 0, 1, dy);
-    cv::warpAffine(gray, shifted, transform, gray.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
-
-    cv::Mat diff;
-    cv::absdiff(gray, shifted, diff);
-    double shift_diff = cv::mean(diff)[0];
-    double penalty = std::max(0.0, 18.0 - shift_diff) * 2.2;
-
-    double lap_var = compute_laplacian_variance(gray);
-    if (lap_var > 160.0) {
-        penalty *= 0.72;
-    }
-    return penalty;
-}
-
-double score_face_candidate(const cv::Mat& candidate,
-                            double base_focus,
-                            double base_luma,
-                            double base_gradient,
-                            double scale_bonus = 0.0) {
-    double focus = compute_focus_measure_bgr(candidate);
-    double luma = compute_luma_mean_bgr(candidate);
-    double gradient = compute_gradient_energy_bgr(candidate);
-    double ghost_penalty = compute_ghost_penalty_bgr(candidate) * 6.0;
-
-    double focus_gain = (focus - base_focus) / std::max(80.0, base_focus);
-    double gradient_gain = (gradient - base_gradient) / std::max(12.0, base_gradient);
-    double luma_penalty = std::fabs(luma - base_luma) * 2.4;
-    double oversoften_penalty =
-        std::max(0.0, base_focus * 0.95 - focus) / std::max(20.0, base_focus) * 480.0;
-
-    double score = focus_gain * 900.0 +
-                   gradient_gain * 260.0 -
-                   luma_penalty -
-                   oversoften_penalty -
-                   ghost_penalty +
-                   scale_bonus * 22.0;
-
-    if (focus >= base_focus * 1.03) {
-        score += 35.0;
-    }
-    if (gradient >= base_gradient * 1.05) {
-        score += 18.0;
-    }
-    return score;
-}
-
-cv::Mat upscale_small_face(const cv::Mat& face) {
-    int short_edge = std::min(face.cols, face.rows);
-    if (face.empty() || short_edge <= 0 || short_edge >= 240) {
-        return face.clone();
-    }
-
-    float scale = std::min(1.85f, 240.0f / static_cast<float>(short_edge));
-    if (scale <= 1.05f) {
-        return face.clone();
-    }
-
-    cv::Mat upscaled;
-    int interpolation = scale > 1.35f ? cv::INTER_LANCZOS4 : cv::INTER_CUBIC;
-    cv::resize(face, upscaled, cv::Size(), scale, scale, interpolation);
-    return upscaled;
-}
-
-double estimate_blur_angle_deg(const cv::Mat& gray) {
-    cv::Mat gx, gy;
-    cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
-    cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
-
-    double sum_xx = 0.0;
-    double sum_yy = 0.0;
-    double sum_xy = 0.0;
-    for (int y = 0; y < gray.rows; ++y) {
-        const float* px = gx.ptr<float>(y);
-        const float* py = gy.ptr<float>(y);
-        for (int x = 0; x < gray.cols; ++x) {
-            double dx = px[x];
-            double dy = py[x];
-            sum_xx += dx * dx;
-            sum_yy += dy * dy;
-            sum_xy += dx * dy;
+        hi = quality;
+        if (hi - lo > 1) {
+            int next = model.pickQuality(long_edge, lo, hi, budget);
+            quality = next != 0 ? next : lo + 1;
+            continue;
         }
-    }
-
-    double theta = 0.5 * std::atan2(2.0 * sum_xy, sum_xx - sum_yy);
-    return theta * 180.0 / CV_PI;
-}
-
-cv::Mat apply_directional_unsharp(const cv::Mat& src, double angle_deg, int kernel_size, float amount) {
-    if (src.empty() || kernel_size < 3 || amount <= 0.0f) {
-        return src.clone();
-    }
-
-    kernel_size = std::max(3, kernel_size | 1);
-    cv::Mat kernel = cv::Mat::zeros(kernel_size, kernel_size, CV_32F);
-    cv::Point center(kernel_size / 2, kernel_size / 2);
-    double rad = angle_deg * CV_PI / 180.0;
-    cv::Point delta(
-        static_cast<int>(std::round(std::cos(rad) * (kernel_size / 2))),
-        static_cast<int>(std::round(std::sin(rad) * (kernel_size / 2))));
-    cv::line(kernel, center - delta, center + delta, cv::Scalar(1.0f), 1, cv::LINE_AA);
-
-    double sum_kernel = cv::sum(kernel)[0];
-    if (sum_kernel <= 1e-6) {
-        kernel.at<float>(center) = 1.0f;
-        sum_kernel = 1.0;
-    }
-    kernel /= static_cast<float>(sum_kernel);
-
-    cv::Mat src_f;
-    src.convertTo(src_f, CV_32FC3);
-    cv::Mat motion_blur;
-    cv::filter2D(src_f, motion_blur, CV_32FC3, kernel, cv::Point(-1, -1), 0.0, cv::BORDER_REPLICATE);
-    cv::Mat sharpened = src_f + (src_f - motion_blur) * amount;
-    cv::Mat out;
-    sharpened.convertTo(out, CV_8UC3);
-    return out;
-}
-
-cv::Mat apply_motion_wiener_restore_gray(const cv::Mat& gray, double angle_deg, int kernel_len, float snr) {
-    if (gray.empty() || kernel_len < 3) {
-        return gray.clone();
-    }
-
-    kernel_len = std::max(3, kernel_len | 1);
-    cv::Mat psf = cv::Mat::zeros(gray.size(), CV_32F);
-    cv::Point center(psf.cols / 2, psf.rows / 2);
-    double rad = angle_deg * CV_PI / 180.0;
-    cv::Point delta(
-        static_cast<int>(std::round(std::cos(rad) * (kernel_len / 2))),
-        static_cast<int>(std::round(std::sin(rad) * (kernel_len / 2))));
-    cv::line(psf, center - delta, center + delta, cv::Scalar(1.0f), 1, cv::LINE_AA);
-    double psf_sum = cv::sum(psf)[0];
-    if (psf_sum <= 1e-6) {
-        psf.at<float>(center) = 1.0f;
-        psf_sum = 1.0;
-    }
-    psf /= static_cast<float>(psf_sum);
-
-    cv::Mat gray_f;
-    gray.convertTo(gray_f, CV_32F, 1.0 / 255.0);
-    cv::Mat planes_img[] = {gray_f.clone(), cv::Mat::zeros(gray.size(), CV_32F)};
-    cv::Mat complex_img;
-    cv::merge(planes_img, 2, complex_img);
-    cv::dft(complex_img, complex_img);
-
-    cv::Mat planes_psf[] = {psf.clone(), cv::Mat::zeros(gray.size(), CV_32F)};
-    cv::Mat complex_psf;
-    cv::merge(planes_psf, 2, complex_psf);
-    cv::dft(complex_psf, complex_psf);
-
-    std::vector<cv::Mat> h_planes(2);
-    cv::split(complex_psf, h_planes);
-    cv::Mat mag2 = h_planes[0].mul(h_planes[0]) + h_planes[1].mul(h_planes[1]);
-    cv::Mat denom = mag2 + 1.0f / std::max(0.5f, snr);
-
-    cv::Mat real = h_planes[0] / denom;
-    cv::Mat imag = -h_planes[1] / denom;
-    cv::Mat inv_planes[] = {real, imag};
-    cv::Mat inv_filter;
-    cv::merge(inv_planes, 2, inv_filter);
-
-    cv::mulSpectrums(complex_img, inv_filter, complex_img, 0);
-    cv::idft(complex_img, gray_f, cv::DFT_REAL_OUTPUT | cv::DFT_SCALE);
-    cv::Mat restored;
-    gray_f.convertTo(restored, CV_8U, 255.0);
-    return restored;
-}
-
-cv::Mat apply_motion_wiener_restore_bgr(const cv::Mat& src, double angle_deg, int kernel_len, float snr) {
-    if (src.empty()) {
-        return src.clone();
-    }
-
-    cv::Mat gray;
-    cv::cvtColor(src, gray, cv::COLOR_BGR2GRAY);
-    cv::Mat restored_gray = apply_motion_wiener_restore_gray(gray, angle_deg, kernel_len, snr);
-
-    cv::Mat src_f, gray_f, restored_f;
-    src.convertTo(src_f, CV_32FC3);
-    gray.convertTo(gray_f, CV_32F, 1.0 / 255.0);
-    restored_gray.convertTo(restored_f, CV_32F, 1.0 / 255.0);
-
-    cv::Mat ratio;
-    cv::divide(restored_f + 1e-3f, gray_f + 1e-3f, ratio);
-    std::vector<cv::Mat> channels;
-    cv::split(src_f, channels);
-    for (auto& channel : channels) {
-        channel = channel.mul(ratio);
-    }
-    cv::Mat restored;
-    cv::merge(channels, restored);
-    restored.convertTo(restored, CV_8UC3);
-    return restored;
-}
-
-cv::Mat motion_deblur_enhance_face(const cv::Mat& face) {
-    if (face.empty() || face.cols <= 0 || face.rows <= 0) {
-        return face;
-    }
-
-    cv::Mat gray_in;
-    cv::cvtColor(face, gray_in, cv::COLOR_BGR2GRAY);
-    double mean_luma_before = cv::mean(gray_in)[0];
-    double lap_var = compute_laplacian_variance(gray_in);
-    float blur_severity = static_cast<float>(std::max(0.0, std::min(1.0, (135.0 - lap_var) / 135.0)));
-    bool needs_upscale = std::min(face.cols, face.rows) < 220;
-    bool needs_enhance = needs_upscale || lap_var < 210.0 || mean_luma_before < 110.0;
-    if (!needs_enhance) {
-        return face.clone();
-    }
-
-    cv::Mat work = upscale_small_face(face);
-
-    if (blur_severity > 0.40f) {
-        cv::Mat denoised;
-        cv::bilateralFilter(work, denoised, 5, 20, 10);
-        work = denoised;
-    }
-
-    if (mean_luma_before < 105.0) {
-        cv::Mat lab;
-        cv::cvtColor(work, lab, cv::COLOR_BGR2Lab);
-        std::vector<cv::Mat> lab_channels;
-        cv::split(lab, lab_channels);
-        double clip_limit = mean_luma_before < 85.0 ? 1.18 : 1.10;
-        cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(clip_limit, cv::Size(8, 8));
-        clahe->apply(lab_channels[0], lab_channels[0]);
-        cv::merge(lab_channels, lab);
-        cv::cvtColor(lab, work, cv::COLOR_Lab2BGR);
-    }
-
-    cv::Mat work_f;
-    work.convertTo(work_f, CV_32FC3);
-    cv::Mat base_f;
-    cv::GaussianBlur(work_f, base_f, cv::Size(0, 0), 0.75 + 0.15 * blur_severity);
-    cv::Mat detail_f = work_f - base_f;
-    float detail_gain = 0.08f + 0.05f * blur_severity;
-    cv::Mat enhanced_f = work_f + detail_f * detail_gain;
-
-    if (blur_severity > 0.40f) {
-        cv::Mat gray_work;
-        cv::cvtColor(work, gray_work, cv::COLOR_BGR2GRAY);
-        double angle = estimate_blur_angle_deg(gray_work);
-        if (blur_severity > 0.68f) {
-            work = apply_motion_wiener_restore_bgr(work, angle, 9, 6.0f);
+        if (!out.empty()) {
+            break;
         }
-        cv::Mat directional_face = apply_directional_unsharp(work, angle, blur_severity > 0.70f ? 9 : 7, 0.06f + 0.04f * blur_severity);
-        directional_face.convertTo(enhanced_f, CV_32FC3);
-
-        cv::Mat kernel = cv::getGaborKernel(cv::Size(7, 7), 1.8, angle * CV_PI / 180.0, 4.5, 0.9, 0.0, CV_32F);
-        cv::Mat directional;
-        cv::filter2D(gray_work, directional, CV_32F, kernel);
-        cv::normalize(directional, directional, -6.0f, 6.0f, cv::NORM_MINMAX);
-
-        std::vector<cv::Mat> channels;
-        cv::split(enhanced_f, channels);
-        for (auto& channel : channels) {
-            channel += directional * 0.012f;
+        if (long_edge <= kUploadMinLongEdge) {
+            // 已到最小尺寸和最低质量，保留超限结果
+            out.swap(attempt);
+            best_quality = quality;
+            break;
         }
-        cv::merge(channels, enhanced_f);
-    }
-
-    cv::Mat enhanced;
-    enhanced_f.convertTo(enhanced, CV_8UC3);
-    enhanced = compress_face_highlights(enhanced);
-
-    cv::Mat blur;
-    cv::GaussianBlur(enhanced, blur, cv::Size(0, 0), 0.70 + 0.08 * blur_severity);
-    cv::Mat out;
-    float unsharp_amount = 0.04f + 0.02f * blur_severity;
-    cv::addWeighted(enhanced, 1.0f + unsharp_amount, blur, -unsharp_amount, 0, out);
-    out = suppress_halo_artifacts(work, out);
-
-    cv::Mat gray_out;
-    cv::cvtColor(out, gray_out, cv::COLOR_BGR2GRAY);
-    double mean_luma_after = cv::mean(gray_out)[0];
-    if (mean_luma_after > 1e-3) {
-        double gain = mean_luma_before / mean_luma_after;
-        gain = std::max(0.94, std::min(1.02, gain));
-        out.convertTo(out, -1, gain, 0);
-    }
 
-    return out;
-}
-
-cv::Mat opencv_superres_deblur_face(const cv::Mat& face) {
-    if (face.empty()) {
-        return face.clone();
-    }
-
-    cv::Mat sr = opencv_super_resolve_face(face);
-    cv::Mat deblurred = motion_deblur_enhance_face(sr);
-
-    cv::Mat gray;
-    cv::cvtColor(deblurred, gray, cv::COLOR_BGR2GRAY);
-    double angle = estimate_blur_angle_deg(gray);
-    double focus = compute_laplacian_variance(gray);
-    float severity = static_cast<float>(std::max(0.0, std::min(1.0, (220.0 - focus) / 220.0)));
-
-    if (severity > 0.35f) {
-        deblurred = apply_motion_wiener_restore_bgr(deblurred, angle, severity > 0.65f ? 11 : 9, 5.5f);
-    }
-
-    cv::Mat final_face = apply_directional_unsharp(deblurred, angle, severity > 0.60f ? 9 : 7, 0.05f + 0.04f * severity);
-    final_face = apply_unsharp_mask(final_face, 0.75, 0.04f);
-    final_face = compress_face_highlights(final_face);
-    final_face = suppress_halo_artifacts(sr, final_face);
-    return final_face;
-}
-
-cv::Mat deghost_motion_face(const cv::Mat& face) {
-    if (face.empty()) {
-        return face.clone();
-    }
-
-    cv::Mat work = upscale_small_face(face);
-    cv::Mat gray;
-    cv::cvtColor(work, gray, cv::COLOR_BGR2GRAY);
-    double focus = compute_laplacian_variance(gray);
-    double angle = estimate_blur_angle_deg(gray);
-    float severity = static_cast<float>(std::max(0.0, std::min(1.0, (235.0 - focus) / 235.0)));
-
-    cv::Mat restored = apply_motion_wiener_restore_bgr(work, angle, severity > 0.65f ? 13 : 9, 6.5f);
-    if (severity > 0.55f) {
-        restored = apply_motion_wiener_restore_bgr(restored, angle, severity > 0.72f ? 11 : 9, 7.0f);
+        // 模型偏差较大时至少缩小 10%，保证循环收敛
+        int next_long_edge = static_cast<int>(long_edge * std::pow(budget / attempt.size(), 1.0 / model.exponent));
+        if (next_long_edge > long_edge * 0.97) {
+            next_long_edge = static_cast<int>(long_edge * 0.9);
+        }
+        long_edge = std::max(kUploadMinLongEdge, next_long_edge);
+        lo = kUploadMinJpegQuality - 1;
+        hi = kUploadDefaultJpegQuality + 1;
+        quality = std::max(kUploadMinJpegQuality, model.pickQuality(long_edge, lo, hi, budget));
     }
 
-    cv::Mat directional = apply_directional_unsharp(restored, angle, severity > 0.60f ? 7 : 5, 0.03f + 0.03f * severity);
-    cv::Mat blended;
-    cv::addWeighted(restored, 0.76, directional, 0.24, 0, blended);
-
-    cv::Mat denoised;
-    cv::bilateralFilter(blended, denoised, 5, 20, 10);
-    denoised = compress_face_highlights(denoised);
-    denoised = suppress_halo_artifacts(work, denoised);
+    log_info("UploaderTask: image encoded from %zuKB to %zuKB (quality=%d, size=%dx%d, encodes=%d)",
+             original_size / 1024,
+             out.size() / 1024,
+             best_quality,
+             working.cols,
+             working.rows,
+             encodes);
+    return !out.empty();
+}
+
+// One reusable easy handle of the transfer loop. The handle is reset, not
+// recreated, between uploads so it keeps its connection and TLS session.
+struct UploadTransfer {
+    CURL* easy{nullptr};
+    bool busy{false};
+    PreparedUpload upload;
+    size_t readOffset{0};
+    curl_mime* form{nullptr};
+    curl_slist* headers{nullptr};
+    std::chrono::steady_clock::time_point startedAt{};
+};
+
+// Streams the prepared JPEG straight into the multipart body.
+size_t read_upload_jpeg(char* buffer, size_t size, size_t nitems, void* arg) {
+    UploadTransfer* transfer = static_cast<UploadTransfer*>(arg);
+    const std::vector<uchar>& jpeg = transfer->upload.jpeg;
+    size_t count = std::min(size * nitems, jpeg.size() - transfer->readOffset);
+    std::memcpy(buffer, jpeg.data() + transfer->readOffset, count);
+    transfer->readOffset += count;
+    return count;
+}
+
+// Needed when curl rewinds the body, e.g. on a redirect or a reused
+// connection the server closed.
+int seek_upload_jpeg(void* arg, curl_off_t offset, int origin) {
+    UploadTransfer* transfer = static_cast<UploadTransfer*>(arg);
+    if (origin != SEEK_SET || offset < 0 || static_cast<size_t>(offset) > transfer->upload.jpeg.size()) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+    transfer->readOffset = static_cast<size_t>(offset);
+    return CURL_SEEKFUNC_OK;
+}
+
+size_t discard_response(char*, size_t size, size_t nitems, void*) {
+    return size * nitems;
+}
+
+void release_transfer_form(UploadTransfer& transfer) {
+    curl_mime_free(transfer.form);
+    transfer.form = nullptr;
+    curl_slist_free_all(transfer.headers);
+    transfer.headers = nullptr;
+}
+
+bool setup_transfer(UploadTransfer& transfer,
+                    CURLSH* share,
+                    const std::string& url,
+                    const std::string& eqCode) {
+    const UploadItem& item = transfer.upload.item;
+    CURL* curl = transfer.easy;
+    curl_easy_reset(curl);
+    transfer.readOffset = 0;
+
+    curl_mime* form = curl_mime_init(curl);
+    if (!form) {
+        return false;
+    }
+    transfer.form = form;
 
-    cv::Mat final_face;
-    cv::addWeighted(denoised, 0.86, work, 0.14, 0, final_face);
-    return final_face;
-}
+    // image 文件
+    curl_mimepart* field = curl_mime_addpart(form);
+    curl_mime_name(field, "image");
+    curl_mime_data_cb(field,
+                      static_cast<curl_off_t>(transfer.upload.jpeg.size()),
+                      read_upload_jpeg,
+                      seek_upload_jpeg,
+                      nullptr,
+                      &transfer);
+    curl_mime_filename(field, "image.jpg");
+    curl_mime_type(field, "image/jpeg");
 
-cv::Mat opencv_aggressive_deghost_face(const cv::Mat& face) {
-    if (face.empty()) {
-        return face.clone();
-    }
+    // time + camerNumber
+    add_form_field(form, "time", std::to_string(time(nullptr)));
+    add_form_field(form, "camerNumber", std::to_string(item.cameraNumber));
 
-    cv::Mat sr = opencv_super_resolve_face(face);
-    cv::Mat deghosted = deghost_motion_face(sr);
-    cv::Mat final_face = motion_deblur_enhance_face(deghosted);
-    final_face = compress_face_highlights(final_face);
-    final_face = suppress_halo_artifacts(sr, final_face);
-    return final_face;
-}
+    // /receive/image/auto/minio 需要附加字段
+    if (item.path.find("/receive/image/auto/minio") != std::string::npos) {
+        std::string imageType = "1";
+        std::string isHaveFace = "0";
 
-cv::Mat motion_deblur_enhance_person(const cv::Mat& person) {
-    if (person.empty() || person.cols <= 0 || person.rows <= 0) {
-        return person;
-    }
+        if (item.type == "face") {
+            imageType = "2";
+            isHaveFace = "1";
+        }
 
-    cv::Mat work = person;
-    int long_edge = std::max(work.cols, work.rows);
-    if (long_edge > 1440) {
-        work = resize_to_long_edge(work, 1440, cv::INTER_AREA);
+        add_form_field(form, "imageType", imageType);
+        add_form_field(form, "isHaveFace", isHaveFace);
+        std::string code = item.uniqueCode.empty() ? generate_unique_code_12() : item.uniqueCode;
+        add_form_field(form, "uniqueCode", code);
     }
 
-    cv::Mat gray_in;
-    cv::cvtColor(work, gray_in, cv::COLOR_BGR2GRAY);
-    double mean_luma_before = cv::mean(gray_in)[0];
-    double lap_var = compute_laplacian_variance(gray_in);
-    float blur_severity = static_cast<float>(std::max(0.0, std::min(1.0, (180.0 - lap_var) / 180.0)));
-    if (blur_severity < 0.18f && mean_luma_before >= 95.0) {
-        return work.clone();
-    }
+    // eq-code header
+    transfer.headers = curl_slist_append(nullptr, ("eq-code: " + eqCode).c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer.headers);
 
-    if (blur_severity > 0.35f) {
-        cv::Mat denoised;
-        cv::bilateralFilter(work, denoised, 5, 20, 16);
-        work = denoised;
-        cv::cvtColor(work, gray_in, cv::COLOR_BGR2GRAY);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_MIMEPOST, form);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_response);
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, &transfer);
+    return true;
+}
+
+// The last kUploadLatencySamples values of one latency, in ms.
+struct LatencyRing {
+    std::vector<double> samples;
+    size_t cursor{0};
+
+    void add(double ms) {
+        if (samples.size() < kUploadLatencySamples) {
+            samples.push_back(ms);
+        } else {
+            samples[cursor] = ms;
+        }
+        cursor = (cursor + 1) % kUploadLatencySamples;
     }
 
-    cv::Mat work_f;
-    work.convertTo(work_f, CV_32FC3);
-    cv::Mat base_f;
-    cv::GaussianBlur(work_f, base_f, cv::Size(0, 0), 0.85 + 0.30 * blur_severity);
-    cv::Mat detail_f = work_f - base_f;
-    float detail_gain = 0.08f + 0.06f * blur_severity;
-    cv::Mat enhanced_f = work_f + detail_f * detail_gain;
-
-    if (blur_severity > 0.45f) {
-        double angle = estimate_blur_angle_deg(gray_in);
-        if (blur_severity > 0.70f) {
-            work = apply_motion_wiener_restore_bgr(work, angle, 11, 5.0f);
+    double percentile(double fraction) const {
+        if (samples.empty()) {
+            return 0.0;
         }
-        cv::Mat directional_person = apply_directional_unsharp(work, angle, blur_severity > 0.70f ? 11 : 9, 0.08f + 0.06f * blur_severity);
-        directional_person.convertTo(enhanced_f, CV_32FC3);
-        cv::Mat kernel = cv::getGaborKernel(cv::Size(9, 9), 2.0, angle * CV_PI / 180.0, 5.5, 0.9, 0.0, CV_32F);
-        cv::Mat directional;
-        cv::filter2D(gray_in, directional, CV_32F, kernel);
-        cv::normalize(directional, directional, -8.0f, 8.0f, cv::NORM_MINMAX);
-
-        std::vector<cv::Mat> channels;
-        cv::split(enhanced_f, channels);
-        for (auto& channel : channels) {
-            channel += directional * 0.022f;
+        std::vector<double> sorted = samples;
+        size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+        return sorted[index];
+    }
+};
+
+// Throughput and per-stage latency of the upload pipeline, kept by the
+// transfer loop and logged every kUploadStatsIntervalSec. latency is enqueue
+// to completion; the stage waits are the time spent queued in front of the
+// enhancement pool and the transfer loop; transfer is curl's own total time.
+struct UploadLatencyStats {
+    LatencyRing latencyMs;
+    LatencyRing enhanceWaitMs;
+    LatencyRing enhanceMs;
+    LatencyRing transferWaitMs;
+    LatencyRing transferMs;
+    uint64_t succeeded{0};
+    uint64_t failed{0};
+    uint64_t retried{0};
+    uint64_t bytes{0};
+    std::chrono::steady_clock::time_point windowStart{std::chrono::steady_clock::now()};
+
+    void add(const PreparedUpload& upload,
+             std::chrono::steady_clock::time_point startedAt,
+             double transferTimeMs) {
+        auto now = std::chrono::steady_clock::now();
+        latencyMs.add(std::chrono::duration<double, std::milli>(now - upload.item.enqueuedAt).count());
+        enhanceWaitMs.add(upload.enhanceWaitMs);
+        enhanceMs.add(upload.enhanceMs);
+        transferWaitMs.add(std::chrono::duration<double, std::milli>(startedAt - upload.preparedAt).count());
+        transferMs.add(transferTimeMs);
+    }
+
+    // Cumulative since start: every JPEG of the process goes through these backends.
+    static void logJpegBackends() {
+        for (const auto& backend : get_jpeg_encode_stats()) {
+            if (backend.encodes + backend.failures == 0) {
+                continue;
+            }
+            double encodes = static_cast<double>(std::max<uint64_t>(backend.encodes, 1));
+            log_info("UploaderTask: jpeg %s encodes=%llu failures=%llu avg=%.1fms %.1fKB",
+                     backend.name,
+                     static_cast<unsigned long long>(backend.encodes),
+                     static_cast<unsigned long long>(backend.failures),
+                     backend.elapsedUs / 1000.0 / encodes,
+                     backend.bytes / 1024.0 / encodes);
         }
-        cv::merge(channels, enhanced_f);
     }
 
-    cv::Mat enhanced;
-    enhanced_f.convertTo(enhanced, CV_8UC3);
-    cv::Mat blur;
-    cv::GaussianBlur(enhanced, blur, cv::Size(0, 0), 0.75 + 0.16 * blur_severity);
-    cv::Mat out;
-    float unsharp_amount = 0.08f + 0.04f * blur_severity;
-    cv::addWeighted(enhanced, 1.0f + unsharp_amount, blur, -unsharp_amount, 0, out);
-
-    cv::Mat gray_out;
-    cv::cvtColor(out, gray_out, cv::COLOR_BGR2GRAY);
-    double mean_luma_after = cv::mean(gray_out)[0];
-    if (mean_luma_after > 1e-3) {
-        double gain = mean_luma_before / mean_luma_after;
-        gain = std::max(0.94, std::min(1.04, gain));
-        out.convertTo(out, -1, gain, 0);
+    void maybeLog(size_t enhanceQueued, size_t enhanceBusy, size_t transferQueued, size_t inFlight) {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - windowStart).count();
+        if (elapsed < kUploadStatsIntervalSec) {
+            return;
+        }
+        if (succeeded + failed + retried > 0) {
+            log_info("UploaderTask: %.2f img/s %.1fKB/s ok=%llu retried=%llu dropped=%llu "
+                     "latency p50/p90/p99=%.0f/%.0f/%.0fms",
+                     succeeded / elapsed,
+                     bytes / 1024.0 / elapsed,
+                     static_cast<unsigned long long>(succeeded),
+                     static_cast<unsigned long long>(retried),
+                     static_cast<unsigned long long>(failed),
+                     latencyMs.percentile(0.50),
+                     latencyMs.percentile(0.90),
+                     latencyMs.percentile(0.99));
+            log_info("UploaderTask: enhance queued=%zu busy=%zu wait p50/p90=%.0f/%.0fms run p50/p90=%.0f/%.0fms | "
+                     "transfer queued=%zu in_flight=%zu wait p50/p90=%.0f/%.0fms run p50/p90/p99=%.0f/%.0f/%.0fms",
+                     enhanceQueued,
+                     enhanceBusy,
+                     enhanceWaitMs.percentile(0.50),
+                     enhanceWaitMs.percentile(0.90),
+                     enhanceMs.percentile(0.50),
+                     enhanceMs.percentile(0.90),
+                     transferQueued,
+                     inFlight,
+                     transferWaitMs.percentile(0.50),
+                     transferWaitMs.percentile(0.90),
+                     transferMs.percentile(0.50),
+                     transferMs.percentile(0.90),
+                     transferMs.percentile(0.99));
+            logJpegBackends();
+        }
+        succeeded = 0;
+        failed = 0;
+        retried = 0;
+        bytes = 0;
+        windowStart = now;
     }
-
-    return out;
-}
+};
 }
 
 UploaderTask::UploaderTask(const std::string& eqCode, const std::string& url)
         : eqCode(eqCode),
             serverUrl(url),
-            running(false) {}
+            running(false) {
+    // 两个线程都会用到 curl，先显式初始化，避免 curl_easy_init 中的隐式初始化竞争
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    jpeg_encoder_init();
+}
 
-UploaderTask::~UploaderTask() { stop(); }
+UploaderTask::~UploaderTask() {
+    stop();
+    jpeg_encoder_shutdown();
+    curl_global_cleanup();
+}
 
 void UploaderTask::start() {
     if (running) return;
     running = true;
-    worker = std::thread(&UploaderTask::run, this);
+    for (size_t i = 0; i < kUploadEnhanceWorkers; ++i) {
+        enhanceWorkers.emplace_back(&UploaderTask::run, this);
+    }
+    transferWorker = std::thread(&UploaderTask::transferLoop, this);
 }
 
 void UploaderTask::stop() {
     running = false;
     cv.notify_all();
-    if (worker.joinable()) worker.join();
+    {
+        std::lock_guard<std::mutex> lock(transferMutex);
+        if (transferMulti) {
+            curl_multi_wakeup(static_cast<CURLM*>(transferMulti));
+        }
+    }
+    for (auto& worker : enhanceWorkers) {
+        if (worker.joinable()) worker.join();
+    }
+    enhanceWorkers.clear();
+    if (transferWorker.joinable()) transferWorker.join();
 }
 
 void UploaderTask::enqueue(const cv::Mat& img,
                           int cameraNumber,
                           const std::string& type,
                           const std::string& path,
-                          const std::string& uniqueCode) {
+                          const std::string& uniqueCode,
+                          const QualityMetrics* quality) {
     std::lock_guard<std::mutex> lock(mtx);
     if (queue.size() >= kUploadQueueMaxSize) {
-        queue.pop();
+        queue.pop_front();
         log_warn("UploaderTask: queue full(%zu), drop oldest to keep realtime path smooth", kUploadQueueMaxSize);
     }
-    queue.push({img.clone(), cameraNumber, type, path, uniqueCode, 0});
+    queue.push_back({img.clone(), cameraNumber, type, path, uniqueCode, 0, std::chrono::steady_clock::now()});
+    if (quality && quality->valid && quality->width == img.cols && quality->height == img.rows) {
+        queue.back().quality = *quality;
+    }
     cv.notify_one();
 }
 
-void UploaderTask::enqueue(const UploadItem& item) {
-    std::lock_guard<std::mutex> lock(mtx);
-    if (queue.size() >= kUploadQueueMaxSize) {
-        queue.pop();
-        log_warn("UploaderTask: queue full(%zu), drop oldest retry item", kUploadQueueMaxSize);
+void UploaderTask::enqueueTransfer(PreparedUpload upload) {
+    std::lock_guard<std::mutex> lock(transferMutex);
+    if (transferQueue.size() >= kUploadQueueMaxSize) {
+        transferQueue.pop_front();
+        log_warn("UploaderTask: transfer queue full(%zu), drop oldest encoded item", kUploadQueueMaxSize);
     }
-    queue.push(item);
-    cv.notify_one();
+    transferQueue.push_back(std::move(upload));
+    if (transferMulti) {
+        curl_multi_wakeup(static_cast<CURLM*>(transferMulti));
+    }
+}
+
+// Takes the oldest queued upload that may start now. Uploads sharing a
+// uniqueCode (the person and face images of one capture) never run
+// concurrently, so the server still receives them in enqueue order.
+bool UploaderTask::takeTransfer(const std::vector<const std::string*>& inFlightCodes, PreparedUpload& upload) {
+    std::lock_guard<std::mutex> lock(transferMutex);
+    for (auto it = transferQueue.begin(); it != transferQueue.end(); ++it) {
+        const std::string& code = it->item.uniqueCode;
+        bool blocked = false;
+        if (!code.empty()) {
+            for (const std::string* inFlight : inFlightCodes) {
+                if (*inFlight == code) {
+                    blocked = true;
+                    break;
+                }
+            }
+        }
+        if (!blocked) {
+            upload = std::move(*it);
+            transferQueue.erase(it);
+            return true;
+        }
+    }
+    return false;
 }
 
 void UploaderTask::setServerUrl(const std::string& url) {
@@ -792,52 +539,239 @@ void UploaderTask::setUploadSuccessCallback(UploadSuccessCallback cb) {
     uploadSuccessCallback = cb;
 }
 
+// Picks the oldest queued item that may be enhanced now. Like takeTransfer,
+// items sharing a uniqueCode go through one at a time, so the pool cannot
+// hand them to the transfer loop out of order. Called with mtx held.
+std::deque<UploadItem>::iterator UploaderTask::nextEnhanceItem() {
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+        const std::string& code = it->uniqueCode;
+        if (code.empty() || std::find(enhancingCodes.begin(), enhancingCodes.end(), code) == enhancingCodes.end()) {
+            return it;
+        }
+    }
+    return queue.end();
+}
+
+// Enhancement pool worker. The finished JPEG is handed to transferLoop, so
+// network I/O and the CPU-bound enhancement of other items overlap.
 void UploaderTask::run() {
     while (running) {
         std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [&]{ return !queue.empty() || !running; });
-        if (!running && queue.empty()) break;
-
-        UploadItem item = queue.front(); queue.pop();
+        auto next = queue.end();
+        cv.wait(lock, [&]{
+            next = nextEnhanceItem();
+            return next != queue.end() || !running;
+        });
+        if (!running) break;
+
+        UploadItem item = std::move(*next);
+        queue.erase(next);
+        if (!item.uniqueCode.empty()) {
+            enhancingCodes.push_back(item.uniqueCode);
+        }
+        ++enhancingItems;
         lock.unlock();
 
-        std::string resp = uploadHttp(item.img, item.cameraNumber, item.type, item.path, item.uniqueCode);
-        // 假设返回 "code":0 成功，否则重试
-        if (resp != "0" && item.retry < 3) {
-            item.retry++;
-            log_error("upload failed, retrying (%d/3), type=%s, id=%d, path=%s",
-                      item.retry, item.type.c_str(), item.cameraNumber, item.path.c_str());
-            enqueue(item);
-        } else if (resp != "0") {
-            log_error("upload failed after max retries, dropped, type=%s, id=%d, path=%s",
+        // Encoded straight into the transfer item; the buffer moves with it.
+        PreparedUpload upload;
+        auto started = std::chrono::steady_clock::now();
+        bool encoded = prepareUploadImage(item, upload.jpeg);
+        auto finished = std::chrono::steady_clock::now();
+        std::string code = item.uniqueCode;
+        if (!encoded) {
+            log_error("upload encode failed, dropped, type=%s, id=%d, path=%s",
                       item.type.c_str(), item.cameraNumber, item.path.c_str());
         } else {
-            UploadSuccessCallback cb;
+            upload.enhanceWaitMs = std::chrono::duration<double, std::milli>(started - item.enqueuedAt).count();
+            upload.enhanceMs = std::chrono::duration<double, std::milli>(finished - started).count();
+            upload.preparedAt = finished;
+            upload.item = std::move(item);
+            enqueueTransfer(std::move(upload));
+        }
+
+        // 先入传输队列再释放 uniqueCode，保证同一抓拍的人像先于人脸上传
+        lock.lock();
+        if (!code.empty()) {
+            enhancingCodes.erase(std::find(enhancingCodes.begin(), enhancingCodes.end(), code));
+        }
+        --enhancingItems;
+        lock.unlock();
+        cv.notify_all();
+    }
+}
+
+void UploaderTask::finishTransfer(PreparedUpload upload, bool ok) {
+    UploadItem& item = upload.item;
+    // 假设返回 "code":0 成功，否则重试
+    if (!ok && item.retry < kUploadMaxRetries) {
+        item.retry++;
+        log_error("upload failed, retrying (%d/%d), type=%s, id=%d, path=%s",
+                  item.retry, kUploadMaxRetries, item.type.c_str(), item.cameraNumber, item.path.c_str());
+        upload.preparedAt = std::chrono::steady_clock::now();
+        enqueueTransfer(std::move(upload));
+    } else if (!ok) {
+        log_error("upload failed after max retries, dropped, type=%s, id=%d, path=%s",
+                  item.type.c_str(), item.cameraNumber, item.path.c_str());
+    } else {
+        UploadSuccessCallback cb;
+        {
+            std::lock_guard<std::mutex> cbLock(mtx);
+            cb = uploadSuccessCallback;
+        }
+        if (cb) {
+            cb(item);
+        }
+    }
+}
+
+// Runs up to kUploadMaxInFlight uploads at once on one curl multi handle.
+// The multi handle owns the connection and DNS caches, so connections to the
+// server stay open between uploads; the share handle lets every easy handle
+// resume the same TLS session.
+void UploaderTask::transferLoop() {
+    CURLM* multi = curl_multi_init();
+    CURLSH* share = curl_share_init();
+    std::vector<UploadTransfer> transfers(kUploadMaxInFlight);
+    bool ready = multi && share;
+    for (auto& transfer : transfers) {
+        transfer.easy = ready ? curl_easy_init() : nullptr;
+        ready = ready && transfer.easy;
+    }
+    if (!ready) {
+        log_error("UploaderTask: curl multi init failed, uploads disabled");
+    } else {
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(kUploadMaxInFlight));
+        curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, static_cast<long>(kUploadMaxInFlight));
+        std::lock_guard<std::mutex> lock(transferMutex);
+        transferMulti = multi;
+    }
+
+    UploadLatencyStats stats;
+    std::vector<const std::string*> inFlightCodes;
+    inFlightCodes.reserve(kUploadMaxInFlight);
+    size_t inFlight = 0;
+
+    while (ready && running) {
+        if (inFlight < transfers.size()) {
+            std::string url;
+            std::string code;
             {
-                std::lock_guard<std::mutex> cbLock(mtx);
-                cb = uploadSuccessCallback;
+                std::lock_guard<std::mutex> lock(mtx);
+                url = serverUrl;
+                code = eqCode;
             }
-            if (cb) {
-                cb(item);
+            inFlightCodes.clear();
+            for (const auto& transfer : transfers) {
+                if (transfer.busy && !transfer.upload.item.uniqueCode.empty()) {
+                    inFlightCodes.push_back(&transfer.upload.item.uniqueCode);
+                }
             }
+            for (auto& transfer : transfers) {
+                if (transfer.busy) {
+                    continue;
+                }
+                if (!takeTransfer(inFlightCodes, transfer.upload)) {
+                    break;
+                }
+                if (!setup_transfer(transfer, share, url + transfer.upload.item.path, code)) {
+                    release_transfer_form(transfer);
+                    finishTransfer(std::move(transfer.upload), false);
+                    continue;
+                }
+                transfer.startedAt = std::chrono::steady_clock::now();
+                transfer.busy = true;
+                curl_multi_add_handle(multi, transfer.easy);
+                ++inFlight;
+                if (!transfer.upload.item.uniqueCode.empty()) {
+                    inFlightCodes.push_back(&transfer.upload.item.uniqueCode);
+                }
+            }
+        }
+
+        int stillRunning = 0;
+        curl_multi_perform(multi, &stillRunning);
+
+        int msgsLeft = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &msgsLeft)) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            UploadTransfer* transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+            CURLcode res = msg->data.result;
+            long response_code = 0;
+            double total_time = 0.0;
+            curl_easy_getinfo(transfer->easy, CURLINFO_RESPONSE_CODE, &response_code);
+            curl_easy_getinfo(transfer->easy, CURLINFO_TOTAL_TIME, &total_time);
+            curl_multi_remove_handle(multi, transfer->easy);
+            release_transfer_form(*transfer);
+            transfer->busy = false;
+            --inFlight;
+            log_debug("response code %ld, curl result %d", response_code, res);
+
+            bool ok = res == CURLE_OK && response_code == 200;
+            if (ok) {
+                ++stats.succeeded;
+                stats.bytes += transfer->upload.jpeg.size();
+                stats.add(transfer->upload, transfer->startedAt, total_time * 1000.0);
+            } else if (transfer->upload.item.retry < kUploadMaxRetries) {
+                ++stats.retried;
+            } else {
+                ++stats.failed;
+            }
+            finishTransfer(std::move(transfer->upload), ok);
         }
+
+        size_t enhanceQueued = 0;
+        size_t enhanceBusy = 0;
+        size_t transferQueued = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            enhanceQueued = queue.size();
+            enhanceBusy = enhancingItems;
+        }
+        {
+            std::lock_guard<std::mutex> lock(transferMutex);
+            transferQueued = transferQueue.size();
+        }
+        stats.maybeLog(enhanceQueued, enhanceBusy, transferQueued, inFlight);
+        curl_multi_poll(multi, nullptr, 0, kUploadPollTimeoutMs, nullptr);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(transferMutex);
+        transferMulti = nullptr;
     }
+    for (auto& transfer : transfers) {
+        if (transfer.busy) {
+            curl_multi_remove_handle(multi, transfer.easy);
+            release_transfer_form(transfer);
+        }
+        if (transfer.easy) {
+            curl_easy_cleanup(transfer.easy);
+        }
+    }
+    if (multi) curl_multi_cleanup(multi);
+    if (share) curl_share_cleanup(share);
 }
 
-std::string UploaderTask::uploadHttp(const cv::Mat& img,
-                                     int cameraNumber,
-                                     const std::string& type,
-                                     const std::string& path,
-                                     const std::string& uniqueCode) {
-    // 使用 libcurl POST 上传 form-data
-    CURL *curl = curl_easy_init();
-    if (!curl) return "1";
+bool UploaderTask::prepareUploadImage(const UploadItem& item, std::vector<uchar>& jpeg) {
+    const cv::Mat& img = item.img;
+    const std::string& type = item.type;
+    if (img.empty()) {
+        jpeg.clear();
+        return false;
+    }
 
     cv::Mat processed = img;
     if (type == "face") {
-        double base_focus = compute_focus_measure_bgr(img);
-        double base_luma = compute_luma_mean_bgr(img);
-        double base_gradient = compute_gradient_energy_bgr(img);
+        // The evaluator already measured the crop it stored as the candidate.
+        FaceQuality base_quality = item.quality.valid ? face_quality_from_metrics(item.quality)
+                                                      : measure_face_quality(img);
+        double base_focus = base_quality.focus;
+        double base_luma = base_quality.luma;
+        double base_gradient = base_quality.gradient;
         int short_edge = std::min(img.cols, img.rows);
         double blur_severity = std::max(0.0, std::min(1.0, (220.0 - base_focus) / 220.0));
 
@@ -870,45 +804,13 @@ std::string UploaderTask::uploadHttp(const cv::Mat& img,
             log_debug("UploaderTask: light blur face. focus=%.1f blur=%.2f short=%d mode=%s score=%.1f",
                       base_focus, blur_severity, short_edge, best_mode, best_score);
         } else {
-            // 中度/重度模糊 - 使用多路对比，但排除最激进的方法
-            cv::Mat classic_face = motion_deblur_enhance_face(img);
-            cv::Mat sr_face = opencv_super_resolve_face(img);
-            double classic_score = score_face_candidate(classic_face, base_focus, base_luma, base_gradient, 8.0);
-            double sr_score = score_face_candidate(sr_face, base_focus, base_luma, base_gradient, 18.0);
-
-            processed = classic_face;
-            best_mode = "classic";
-            best_score = classic_score;
-
-            if (sr_score > best_score) {
-                processed = sr_face;
-                best_score = sr_score;
-                best_mode = "opencv_sr";
-            }
-
-            // 仅在严重模糊时才启用deblur/deghost流水线
-            if (blur_severity > 0.58 || short_edge < 140) {
-                cv::Mat sr_deblur_face = opencv_superres_deblur_face(img);
-                double sr_deblur_score = score_face_candidate(sr_deblur_face, base_focus, base_luma, base_gradient, 20.0);
-                if (sr_deblur_score > best_score) {
-                    processed = sr_deblur_face;
-                    best_score = sr_deblur_score;
-                    best_mode = "opencv_sr_deblur";
-                }
+            // 中度/重度模糊 - 先在缩小的代理图上比较各增强方式，只对胜出者做全尺寸处理
+            size_t modes_tried = 0;
+            processed = enhance_blurry_face(img, base_quality, blur_severity, faceEnhanceBudgetMs.load(),
+                                            best_mode, best_score, modes_tried);
 
-                if (blur_severity > 0.72 || short_edge < 120) {
-                    cv::Mat deghost_face = opencv_aggressive_deghost_face(img);
-                    double deghost_score = score_face_candidate(deghost_face, base_focus, base_luma, base_gradient, 22.0);
-                    if (deghost_score > best_score) {
-                        processed = deghost_face;
-                        best_score = deghost_score;
-                        best_mode = "opencv_deghost";
-                    }
-                }
-            }
-
-            log_debug("UploaderTask: blurry face. focus=%.1f blur=%.2f short=%d mode=%s score=%.1f",
-                      base_focus, blur_severity, short_edge, best_mode, best_score);
+            log_debug("UploaderTask: blurry face. focus=%.1f blur=%.2f short=%d mode=%s score=%.1f tried=%zu",
+                      base_focus, blur_severity, short_edge, best_mode, best_score, modes_tried);
         }
     } else if (type == "person") {
         processed = motion_deblur_enhance_person(img);
@@ -920,53 +822,5 @@ std::string UploaderTask::uploadHttp(const cv::Mat& img,
     } else if (type == "person") {
         preferred_long_edge = kUploadPersonMaxLongEdge;
     }
-    std::vector<uchar> buf = encode_image_for_upload(processed, preferred_long_edge);
-    curl_mime *form = curl_mime_init(curl);
-    curl_mimepart *field;
-
-    // image 文件
-    field = curl_mime_addpart(form);
-    curl_mime_name(field, "image");
-    curl_mime_data(field, reinterpret_cast<char*>(buf.data()), buf.size());
-    curl_mime_filename(field, "image.jpg");
-    curl_mime_type(field, "image/jpeg");
-
-    // time + camerNumber
-    add_form_field(form, "time", std::to_string(time(nullptr)));
-    add_form_field(form, "camerNumber", std::to_string(cameraNumber));
-
-    // /receive/image/auto/minio 需要附加字段
-    if (path.find("/receive/image/auto/minio") != std::string::npos) {
-        std::string imageType = "1";
-        std::string isHaveFace = "0";
-
-        if (type == "face") {
-            imageType = "2";
-            isHaveFace = "1";
-        }
-
-        add_form_field(form, "imageType", imageType);
-        add_form_field(form, "isHaveFace", isHaveFace);
-        std::string code = uniqueCode.empty() ? generate_unique_code_12() : uniqueCode;
-        add_form_field(form, "uniqueCode", code);
-    }
-
-    // eq-code header
-    struct curl_slist *headers = nullptr;
-    headers = curl_slist_append(headers, ("eq-code: " + eqCode).c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-    curl_easy_setopt(curl, CURLOPT_URL, (serverUrl + path).c_str());
-    curl_easy_setopt(curl, CURLOPT_MIMEPOST, form);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-
-    CURLcode res = curl_easy_perform(curl);
-    long response_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-
-    curl_slist_free_all(headers);
-    curl_mime_free(form);
-    curl_easy_cleanup(curl);
-    log_debug("response code %ld, curl result %d", response_code, res);
-    return (res == CURLE_OK && response_code == 200) ? "0" : "1";
+    return encode_image_for_upload(processed, jpeg, preferred_long_edge);
 }